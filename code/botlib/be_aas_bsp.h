@@ -64,6 +64,8 @@ bsp_trace_t AAS_Trace(	vec3_t start,
 								vec3_t end,
 								int passent,
 								int contentmask);
+//trace several boxes through the world at once
+void AAS_TraceBatch(bsp_trace_t *traces, const traceRequest_t *requests, int count);
 //returns the contents at the given point
 int AAS_PointContents(vec3_t point);
 #if 0
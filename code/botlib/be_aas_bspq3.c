@@ -152,6 +152,17 @@ bsp_trace_t AAS_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int pa
 	return bsptrace;
 } //end of the function AAS_Trace
 //===========================================================================
+// traces several axial boxes through the world at once
+//
+// Parameter:				-
+// Returns:					-
+// Changes Globals:		-
+//===========================================================================
+void AAS_TraceBatch(bsp_trace_t *traces, const traceRequest_t *requests, int count)
+{
+	botimport.TraceBatch(traces, requests, count);
+} //end of the function AAS_TraceBatch
+//===========================================================================
 // returns the contents at the given point
 //
 // Parameter:				-
@@ -61,6 +61,8 @@ extern botlib_import_t botimport;
 #define INSIDEUNITS_WATERJUMP				15
 //area flag used for weapon jumping
 #define AREA_WEAPONJUMP						8192	//valid area to weapon jump to
+//number of grapple faces traced in one batch
+#define MAX_GRAPPLEFACES					64
 //number of reachabilities of each type
 static int reach_swim;			//swim
 static int reach_equalfloor;	//walk on floors with equal height
@@ -3794,9 +3796,12 @@ static void AAS_Reachability_JumpPad(void)
 //===========================================================================
 static int AAS_Reachability_Grapple(int area1num, int area2num)
 {
-	int face2num, i, j, areanum, numareas, areas[20];
+	int face2num, i, j, k, areanum, numareas, areas[20];
+	int numfaces, facenums[MAX_GRAPPLEFACES];
 	float mingrappleangle, z, hordist;
-	bsp_trace_t bsptrace;
+	traceRequest_t requests[MAX_GRAPPLEFACES], *request;
+	bsp_trace_t bsptraces[MAX_GRAPPLEFACES], *bsptrace;
+	vec3_t facecenters[MAX_GRAPPLEFACES];
 	aas_trace_t trace;
 	aas_face_t *face2;
 	aas_area_t *area1, *area2;
@@ -3835,94 +3840,113 @@ static int AAS_Reachability_Grapple(int area1num, int area2num)
 	//
 	//start is now the start point
 	//
-	for (i = 0; i < area2->numfaces; i++)
+	for (i = 0; i < area2->numfaces; )
 	{
-		face2num = aasworld.faceindex[area2->firstface + i];
-		face2 = &aasworld.faces[abs(face2num)];
-		//if it is not a solid face
-		if (!(face2->faceflags & FACE_SOLID)) continue;
-		//direction towards the first vertex of the face
-		v = aasworld.vertexes[aasworld.edges[abs(aasworld.edgeindex[face2->firstedge])].v[0]];
-		VectorSubtract(v, areastart, dir);
-		//if the face plane is facing away
-		if (DotProduct(aasworld.planes[face2->planenum].normal, dir) > 0) continue;
-		//get the center of the face
-		AAS_FaceCenter(face2num, facecenter);
-		//only go higher up with the grapple
-		if (facecenter[2] < areastart[2] + 64) continue;
-		//only use vertical faces or downward facing faces
-		if (DotProduct(aasworld.planes[face2->planenum].normal, down) < 0) continue;
-		//direction towards the face center
-		VectorSubtract(facecenter, areastart, dir);
-		//
-		z = dir[2];
-		dir[2] = 0;
-		hordist = VectorLength(dir);
-		if (!hordist) continue;
-		//if too far
-		if (hordist > 2000) continue;
-		//check the minimal angle of the movement
-		mingrappleangle = 15; //15 degrees
-		if (z / hordist < tan(2 * M_PI * mingrappleangle / 360)) continue;
-		//
-		VectorCopy(facecenter, start);
-		VectorMA(facecenter, -500, aasworld.planes[face2->planenum].normal, end);
-		//
-		bsptrace = AAS_Trace(start, NULL, NULL, end, 0, CONTENTS_SOLID);
-		//the grapple won't stick to the sky and the grapple point should be near the AAS wall
-		if ((bsptrace.surface.flags & SURF_SKY) || (bsptrace.fraction * 500 > 32)) continue;
-		//trace a full bounding box from the area center on the ground to
-		//the center of the face
-		VectorSubtract(facecenter, areastart, dir);
-		VectorNormalize(dir);
-		VectorMA(areastart, 4, dir, start);
-		VectorCopy(bsptrace.endpos, end);
-		trace = AAS_TraceClientBBox(start, end, PRESENCE_NORMAL, -1);
-		VectorSubtract(trace.endpos, facecenter, dir);
-		if (VectorLength(dir) > 24) continue;
-		//
-		VectorCopy(trace.endpos, start);
-		VectorCopy(trace.endpos, end);
-		end[2] -= AAS_FallDamageDistance();
-		trace = AAS_TraceClientBBox(start, end, PRESENCE_NORMAL, -1);
-		if (trace.fraction >= 1) continue;
-		//area to end in
-		areanum = AAS_PointAreaNum(trace.endpos);
-		//if not in lava or slime
-		if (aasworld.areasettings[areanum].contents & (AREACONTENTS_SLIME|AREACONTENTS_LAVA))
-		{
-			continue;
-		} //end if
-		//do not go to the source area
-		if (areanum == area1num) continue;
-		//don't create reachabilities if they already exist
-		if (AAS_ReachabilityExists(area1num, areanum)) continue;
-		//only end in areas we can stand
-		if (!AAS_AreaGrounded(areanum)) continue;
-		//never go through cluster portals!!
-		numareas = AAS_TraceAreas(areastart, bsptrace.endpos, areas, NULL, 20);
-		if (numareas >= 20) continue;
-		for (j = 0; j < numareas; j++)
+		//collect the faces the grapple could stick to
+		for (numfaces = 0; i < area2->numfaces && numfaces < MAX_GRAPPLEFACES; i++)
 		{
-			if (aasworld.areasettings[areas[j]].contents & AREACONTENTS_CLUSTERPORTAL) break;
+			face2num = aasworld.faceindex[area2->firstface + i];
+			face2 = &aasworld.faces[abs(face2num)];
+			//if it is not a solid face
+			if (!(face2->faceflags & FACE_SOLID)) continue;
+			//direction towards the first vertex of the face
+			v = aasworld.vertexes[aasworld.edges[abs(aasworld.edgeindex[face2->firstedge])].v[0]];
+			VectorSubtract(v, areastart, dir);
+			//if the face plane is facing away
+			if (DotProduct(aasworld.planes[face2->planenum].normal, dir) > 0) continue;
+			//get the center of the face
+			AAS_FaceCenter(face2num, facecenter);
+			//only go higher up with the grapple
+			if (facecenter[2] < areastart[2] + 64) continue;
+			//only use vertical faces or downward facing faces
+			if (DotProduct(aasworld.planes[face2->planenum].normal, down) < 0) continue;
+			//direction towards the face center
+			VectorSubtract(facecenter, areastart, dir);
+			//
+			z = dir[2];
+			dir[2] = 0;
+			hordist = VectorLength(dir);
+			if (!hordist) continue;
+			//if too far
+			if (hordist > 2000) continue;
+			//check the minimal angle of the movement
+			mingrappleangle = 15; //15 degrees
+			if (z / hordist < tan(2 * M_PI * mingrappleangle / 360)) continue;
+			//
+			facenums[numfaces] = face2num;
+			VectorCopy(facecenter, facecenters[numfaces]);
+			request = &requests[numfaces];
+			VectorCopy(facecenter, request->start);
+			VectorMA(facecenter, -500, aasworld.planes[face2->planenum].normal, request->end);
+			VectorClear(request->mins);
+			VectorClear(request->maxs);
+			request->passEntityNum = 0;
+			request->contentmask = CONTENTS_SOLID;
+			request->capsule = false;
+			numfaces++;
 		} //end for
-		if (j < numareas) continue;
-		//create a new reachability link
-		lreach = AAS_AllocReachability();
-		if (!lreach) return false;
-		lreach->areanum = areanum;
-		lreach->facenum = face2num;
-		lreach->edgenum = 0;
-		VectorCopy(areastart, lreach->start);
-		//VectorCopy(facecenter, lreach->end);
-		VectorCopy(bsptrace.endpos, lreach->end);
-		lreach->traveltype = TRAVEL_GRAPPLEHOOK;
-		VectorSubtract(lreach->end, lreach->start, dir);
-		lreach->traveltime = aassettings.rs_startgrapple + VectorLength(dir) * 0.25;
-		lreach->next = areareachability[area1num];
-		areareachability[area1num] = lreach;
+		//the faces of one area lie close together so they share the entity lookup
+		AAS_TraceBatch(bsptraces, requests, numfaces);
 		//
-		reach_grapple++;
+		for (k = 0; k < numfaces; k++)
+		{
+			face2num = facenums[k];
+			bsptrace = &bsptraces[k];
+			//the grapple won't stick to the sky and the grapple point should be near the AAS wall
+			if ((bsptrace->surface.flags & SURF_SKY) || (bsptrace->fraction * 500 > 32)) continue;
+			//trace a full bounding box from the area center on the ground to
+			//the center of the face
+			VectorSubtract(facecenters[k], areastart, dir);
+			VectorNormalize(dir);
+			VectorMA(areastart, 4, dir, start);
+			VectorCopy(bsptrace->endpos, end);
+			trace = AAS_TraceClientBBox(start, end, PRESENCE_NORMAL, -1);
+			VectorSubtract(trace.endpos, facecenters[k], dir);
+			if (VectorLength(dir) > 24) continue;
+			//
+			VectorCopy(trace.endpos, start);
+			VectorCopy(trace.endpos, end);
+			end[2] -= AAS_FallDamageDistance();
+			trace = AAS_TraceClientBBox(start, end, PRESENCE_NORMAL, -1);
+			if (trace.fraction >= 1) continue;
+			//area to end in
+			areanum = AAS_PointAreaNum(trace.endpos);
+			//if not in lava or slime
+			if (aasworld.areasettings[areanum].contents & (AREACONTENTS_SLIME|AREACONTENTS_LAVA))
+			{
+				continue;
+			} //end if
+			//do not go to the source area
+			if (areanum == area1num) continue;
+			//don't create reachabilities if they already exist
+			if (AAS_ReachabilityExists(area1num, areanum)) continue;
+			//only end in areas we can stand
+			if (!AAS_AreaGrounded(areanum)) continue;
+			//never go through cluster portals!!
+			numareas = AAS_TraceAreas(areastart, bsptrace->endpos, areas, NULL, 20);
+			if (numareas >= 20) continue;
+			for (j = 0; j < numareas; j++)
+			{
+				if (aasworld.areasettings[areas[j]].contents & AREACONTENTS_CLUSTERPORTAL) break;
+			} //end for
+			if (j < numareas) continue;
+			//create a new reachability link
+			lreach = AAS_AllocReachability();
+			if (!lreach) return false;
+			lreach->areanum = areanum;
+			lreach->facenum = face2num;
+			lreach->edgenum = 0;
+			VectorCopy(areastart, lreach->start);
+			//VectorCopy(facecenter, lreach->end);
+			VectorCopy(bsptrace->endpos, lreach->end);
+			lreach->traveltype = TRAVEL_GRAPPLEHOOK;
+			VectorSubtract(lreach->end, lreach->start, dir);
+			lreach->traveltime = aassettings.rs_startgrapple + VectorLength(dir) * 0.25;
+			lreach->next = areareachability[area1num];
+			areareachability[area1num] = lreach;
+			//
+			reach_grapple++;
+		} //end for
 	} //end for
 	//
 	return false;
@@ -175,6 +175,8 @@ typedef struct botlib_import_s
 	void		(*Trace)(bsp_trace_t *trace, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int passent, int contentmask);
 	//trace a bbox against a specific entity
 	void		(*EntityTrace)(bsp_trace_t *trace, vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int entnum, int contentmask);
+	//trace several bboxes through the world at once
+	void		(*TraceBatch)(bsp_trace_t *traces, const traceRequest_t *requests, int count);
 	//retrieve the contents at the given point
 	int			(*PointContents)(vec3_t point);
 	//check if the point is in potential visible sight
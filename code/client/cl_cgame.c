@@ -814,6 +814,92 @@ static intptr_t QDECL CL_DllSyscall( intptr_t arg, ... ) {
 }
 
 
+/*
+====================
+CL_PrefetchMapTextures
+
+Starts reading the images the renderer will look for first for the
+shaders of the map surfaces. Images of shaders defined in scripts and
+of model shaders and skins are not known before the scripts or models
+are parsed, so they are read when they are needed.
+====================
+*/
+static void CL_PrefetchMapTextures( void ) {
+	// same order the renderer tries extensions in
+	static const char *extensions[] = { "png", "tga", "jpg" };
+	dheader_t	header;
+	dshader_t	*shaders;
+	fileHandle_t f;
+	const lump_t *lump;
+	int			i, j, numShaders;
+
+	if ( FS_FOpenFileRead( cl.mapname, &f, false ) < 0 ) {
+		return;
+	}
+
+	// the shader lump follows the header in maps written by q3map,
+	// so this is a short read even from a compressed pak entry
+	lump = &header.lumps[ LUMP_SHADERS ];
+	if ( FS_Read( &header, sizeof( header ), f ) != sizeof( header )
+		|| LittleLong( header.ident ) != BSP_IDENT || LittleLong( header.version ) != BSP_VERSION
+		|| LittleLong( lump->fileofs ) < (int)sizeof( header ) || LittleLong( lump->filelen ) <= 0
+		|| LittleLong( lump->filelen ) % sizeof( dshader_t ) || LittleLong( lump->filelen ) > MAX_MAP_SHADERS * sizeof( dshader_t ) ) {
+		FS_FCloseFile( f );
+		return;
+	}
+
+	numShaders = LittleLong( lump->filelen ) / sizeof( dshader_t );
+	shaders = Z_Malloc( numShaders * sizeof( dshader_t ) );
+
+	FS_Seek( f, LittleLong( lump->fileofs ), FS_SEEK_SET );
+	if ( FS_Read( shaders, numShaders * sizeof( dshader_t ), f ) != numShaders * sizeof( dshader_t ) ) {
+		numShaders = 0;
+	}
+	FS_FCloseFile( f );
+
+	for ( i = 0; i < numShaders; i++ ) {
+		shaders[i].shader[ MAX_QPATH - 1 ] = '\0';
+		if ( !shaders[i].shader[0] || strlen( shaders[i].shader ) > MAX_QPATH - 5 ) {
+			continue;
+		}
+		for ( j = 0; j < ARRAY_LEN( extensions ); j++ ) {
+			if ( FS_PrefetchFile( va( "%s.%s", shaders[i].shader, extensions[j] ) ) ) {
+				break;
+			}
+		}
+	}
+
+	Z_Free( shaders );
+}
+
+
+/*
+====================
+CL_PrefetchGameState
+
+Starts reading the map, the models listed in the gamestate and the
+textures of the map while cgame is loaded, cgame and the renderer pick
+them up from FS_ReadFile. Sounds are not prefetched: the codecs read
+them through FS_Read, which doesn't use prefetched data.
+====================
+*/
+static void CL_PrefetchGameState( void ) {
+	const char	*name;
+	int			i;
+
+	FS_PrefetchFile( cl.mapname );
+
+	for ( i = 1; i < MAX_MODELS; i++ ) {
+		name = cl.gameState.stringData + cl.gameState.stringOffsets[ CS_MODELS + i ];
+		if ( name[0] && name[0] != '*' ) {
+			FS_PrefetchFile( name );
+		}
+	}
+
+	CL_PrefetchMapTextures();
+}
+
+
 /*
 ====================
 CL_InitCGame
@@ -839,6 +925,8 @@ void CL_InitCGame( void ) {
 	mapname = Info_ValueForKey( info, "mapname" );
 	Com_sprintf( cl.mapname, sizeof( cl.mapname ), "maps/%s.bsp", mapname );
 
+	CL_PrefetchGameState();
+
 	// allow vertex lighting for in-game elements
 	re.VertexLighting( true );
 
@@ -862,6 +950,9 @@ void CL_InitCGame( void ) {
 	// otherwise server commands sent just before a gamestate are dropped
 	VM_Call( cgvm, 3, CG_INIT, clc.serverMessageSequence, clc.lastExecutedServerCommand, clc.clientNum );
 
+	// drop whatever cgame didn't load
+	FS_FlushPrefetches();
+
 	// reset any CVAR_CHEAT cvars registered by cgame
 	if ( !clc.demoplaying && !cl_connectedToCheatServer )
 		Cvar_SetCheatState();
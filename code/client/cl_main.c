@@ -1931,6 +1931,87 @@ static void CL_Clientinfo_f( void ) {
 }
 
 
+/*
+==============
+CL_DeltaBench_f
+
+Re-encodes deltas of the buffered snapshots, e.g. during demo playback
+==============
+*/
+static void CL_DeltaBench_f( void ) {
+	const entityState_t **from, **to;
+	const playerState_t *fromPs[ PACKET_BACKUP ], *toPs[ PACKET_BACKUP ];
+	const entityState_t *oldstate, *newstate;
+	const clSnapshot_t *snap, *oldsnap;
+	int numEntities, numPlayers;
+	int oldindex, newindex;
+	int iterations;
+	int i;
+
+	if ( cls.state != CA_ACTIVE ) {
+		Com_Printf( "Not connected to a server.\n" );
+		return;
+	}
+
+	iterations = 1000;
+	if ( Cmd_Argc() > 1 ) {
+		iterations = atoi( Cmd_Argv( 1 ) );
+	}
+
+	from = Z_Malloc( MAX_PARSE_ENTITIES * sizeof( *from ) );
+	to = Z_Malloc( MAX_PARSE_ENTITIES * sizeof( *to ) );
+
+	numEntities = 0;
+	numPlayers = 0;
+
+	for ( i = 0; i < PACKET_BACKUP; i++ ) {
+		snap = &cl.snapshots[ i ];
+		if ( !snap->valid || cl.parseEntitiesNum - snap->parseEntitiesNum > MAX_PARSE_ENTITIES ) {
+			continue;
+		}
+
+		// use the same delta source as the server did
+		oldsnap = NULL;
+		if ( snap->deltaNum > 0 && snap->deltaNum != snap->messageNum ) {
+			oldsnap = &cl.snapshots[ snap->deltaNum & PACKET_MASK ];
+			if ( !oldsnap->valid || oldsnap->messageNum != snap->deltaNum ||
+				cl.parseEntitiesNum - oldsnap->parseEntitiesNum > MAX_PARSE_ENTITIES ) {
+				continue;
+			}
+		}
+
+		fromPs[ numPlayers ] = oldsnap ? &oldsnap->ps : NULL;
+		toPs[ numPlayers ] = &snap->ps;
+		numPlayers++;
+
+		oldindex = 0;
+		for ( newindex = 0; newindex < snap->numEntities; newindex++ ) {
+			newstate = &cl.parseEntities[ ( snap->parseEntitiesNum + newindex ) & ( MAX_PARSE_ENTITIES - 1 ) ];
+			oldstate = NULL;
+			if ( oldsnap ) {
+				for ( ; oldindex < oldsnap->numEntities; oldindex++ ) {
+					oldstate = &cl.parseEntities[ ( oldsnap->parseEntitiesNum + oldindex ) & ( MAX_PARSE_ENTITIES - 1 ) ];
+					if ( oldstate->number >= newstate->number ) {
+						break;
+					}
+				}
+				if ( oldindex >= oldsnap->numEntities || oldstate->number != newstate->number ) {
+					oldstate = NULL;
+				}
+			}
+			from[ numEntities ] = oldstate ? oldstate : &cl.entityBaselines[ newstate->number ];
+			to[ numEntities ] = newstate;
+			numEntities++;
+		}
+	}
+
+	MSG_BenchmarkDeltas( from, to, numEntities, fromPs, toPs, numPlayers, iterations );
+
+	Z_Free( (void *)to );
+	Z_Free( (void *)from );
+}
+
+
 /*
 ==============
 CL_Serverinfo_f
@@ -3996,6 +4077,7 @@ void CL_Init( void ) {
 	Cmd_AddCommand ("cmd", CL_ForwardToServer_f);
 	Cmd_AddCommand ("configstrings", CL_Configstrings_f);
 	Cmd_AddCommand ("clientinfo", CL_Clientinfo_f);
+	Cmd_AddCommand ("deltabench", CL_DeltaBench_f);
 	Cmd_AddCommand ("snd_restart", CL_Snd_Restart_f);
 	Cmd_AddCommand ("vid_restart", CL_Vid_Restart_f);
 	Cmd_AddCommand ("disconnect", CL_Disconnect_f);
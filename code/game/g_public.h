@@ -50,6 +50,8 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 
 #define SVF_SELF_PORTAL2		0x00020000  // merge a second pvs at entity->r.s.origin2 into snapshots
 
+#define MAX_TRACE_BATCH			1024		// max requests per G_TRACEBATCH call
+
 //===============================================================
 
 
@@ -397,6 +399,11 @@ typedef enum {
 	BOTLIB_PC_SOURCE_FILE_AND_LINE,
 
 	// engine extensions
+	G_TRACEBATCH,	// ( const traceRequest_t *requests, trace_t *results, int count );
+	// same as G_TRACE/G_TRACECAPSULE for each request, up to MAX_TRACE_BATCH per call,
+	// requests and results must not overlap
+	// syscall number is queried with trap_GetValue( "trap_TraceBatch_Q3E" )
+
 	G_TRAP_GETVALUE = COM_TRAP_GETVALUE
 
 } gameImport_t;
@@ -0,0 +1,589 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// cm_capture.c -- capturing and replaying of server collision queries
+
+#include "cm_local.h"
+
+/*
+==============================================================================
+
+"cm_capture" writes every SV_Trace() and SV_PointContents() call of the
+running server to a file: the query arguments, a hash of the result the
+world alone gave and a hash of the final result including entities.
+Capturing stops when the map is cleared.
+
+"cm_replay" runs the captured queries against the world of the same map,
+loading it first if no map is loaded, so a dedicated server started with
+"+cm_replay <file> +quit" works as a standalone collision benchmark.
+Entities are not part of the replay, world results are compared with the
+capture and every difference is reported as a mismatch.
+
+Queries are timed in blocks of REPLAY_BLOCK as single queries are too
+short for the microsecond clock, latency percentiles are block averages.
+
+==============================================================================
+*/
+
+#define CAPTURE_IDENT		(('Q'<<24)+('C'<<16)+('M'<<8)+'C')
+#define CAPTURE_VERSION		1
+
+#define CAPTURE_BUFFER		16384	// words
+#define REPLAY_BUFFER		65536	// words
+#define REPLAY_BLOCK		16
+#define REPLAY_MAX_REPORTS	4
+
+typedef enum {
+	CAPTURE_TRACE = 1,	// start[3], end[3], mins[3], maxs[3], passEntityNum, contentmask, world hash, hash
+	CAPTURE_CAPSULE,	// same as trace
+	CAPTURE_POINT		// p[3], passEntityNum, world contents, contents
+} captureQuery_t;
+
+#define TRACE_WORDS			17
+#define POINT_WORDS			7
+
+// all words are stored little endian
+typedef struct {
+	int32_t		ident;
+	int32_t		version;
+	int32_t		checksum;
+	char		mapName[ MAX_QPATH ];
+} captureHeader_t;
+
+typedef struct {
+	vec3_t		start, end, mins, maxs;
+	int			contentmask;
+	bool		capsule;
+	bool		entityHit;			// final result differs from the world result
+	unsigned int hash;				// of the world result
+	int			index;
+} replayTrace_t;
+
+typedef struct {
+	vec3_t		p;
+	bool		entityHit;
+	int			contents;			// of the world
+	int			index;
+} replayPoint_t;
+
+typedef struct {
+	const char	*name;
+	int			count;
+	int			mismatches;
+	int			entityHits;
+	int64_t		time;				// usec
+	int			*samples;			// nsec per query in a block
+	int			numSamples;
+} replayStats_t;
+
+static struct {
+	fileHandle_t	file;
+	int32_t			buffer[ CAPTURE_BUFFER ];
+	int				numWords;
+	int				numTraces;
+	int				numPoints;
+} cm_capture;
+
+bool cm_capturing;
+
+
+/*
+================
+CM_HashTrace
+================
+*/
+static unsigned int CM_HashTrace( const trace_t *tr ) {
+	unsigned int hash;
+	floatint_t	fi[8];
+	int			i;
+
+	fi[0].f = tr->fraction;
+	fi[1].f = tr->endpos[0];
+	fi[2].f = tr->endpos[1];
+	fi[3].f = tr->endpos[2];
+	fi[4].f = tr->plane.normal[0];
+	fi[5].f = tr->plane.normal[1];
+	fi[6].f = tr->plane.normal[2];
+	fi[7].f = tr->plane.dist;
+
+	hash = 2166136261u;
+	for ( i = 0; i < ARRAY_LEN( fi ); i++ ) {
+		hash = ( hash ^ fi[i].u ) * 16777619u;
+	}
+	hash = ( hash ^ (unsigned int)tr->surfaceFlags ) * 16777619u;
+	hash = ( hash ^ (unsigned int)tr->contents ) * 16777619u;
+	hash = ( hash ^ (unsigned int)tr->entityNum ) * 16777619u;
+	hash = ( hash ^ ( tr->allsolid ? 1u : 0u ) ^ ( tr->startsolid ? 2u : 0u ) ) * 16777619u;
+
+	return hash;
+}
+
+
+/*
+================
+CM_CaptureFlush
+================
+*/
+static void CM_CaptureFlush( void ) {
+	if ( cm_capture.numWords ) {
+		FS_Write( cm_capture.buffer, cm_capture.numWords * sizeof( int32_t ), cm_capture.file );
+	}
+	cm_capture.numWords = 0;
+}
+
+
+/*
+================
+CM_CaptureWords
+================
+*/
+static int32_t *CM_CaptureWords( int count ) {
+	int32_t	*words;
+
+	if ( cm_capture.numWords + count > CAPTURE_BUFFER ) {
+		CM_CaptureFlush();
+	}
+	words = cm_capture.buffer + cm_capture.numWords;
+	cm_capture.numWords += count;
+
+	return words;
+}
+
+
+/*
+================
+CM_CaptureVector
+================
+*/
+static int32_t *CM_CaptureVector( int32_t *words, const vec3_t v ) {
+	floatint_t	fi;
+	int			i;
+
+	for ( i = 0; i < 3; i++ ) {
+		fi.f = v ? v[i] : 0.0f;
+		*words++ = LittleLong( fi.i );
+	}
+
+	return words;
+}
+
+
+/*
+================
+CM_CaptureTrace
+
+Called by SV_Trace() while cm_capturing is set
+================
+*/
+void CM_CaptureTrace( const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+	int passEntityNum, int contentmask, bool capsule, const trace_t *world, const trace_t *results ) {
+	int32_t	*words;
+
+	words = CM_CaptureWords( TRACE_WORDS );
+	*words++ = LittleLong( capsule ? CAPTURE_CAPSULE : CAPTURE_TRACE );
+	words = CM_CaptureVector( words, start );
+	words = CM_CaptureVector( words, end );
+	words = CM_CaptureVector( words, mins );
+	words = CM_CaptureVector( words, maxs );
+	*words++ = LittleLong( passEntityNum );
+	*words++ = LittleLong( contentmask );
+	*words++ = LittleLong( (int32_t)CM_HashTrace( world ) );
+	*words++ = LittleLong( (int32_t)CM_HashTrace( results ) );
+
+	cm_capture.numTraces++;
+}
+
+
+/*
+================
+CM_CapturePointContents
+
+Called by SV_PointContents() while cm_capturing is set
+================
+*/
+void CM_CapturePointContents( const vec3_t p, int passEntityNum, int world, int contents ) {
+	int32_t	*words;
+
+	words = CM_CaptureWords( POINT_WORDS );
+	*words++ = LittleLong( CAPTURE_POINT );
+	words = CM_CaptureVector( words, p );
+	*words++ = LittleLong( passEntityNum );
+	*words++ = LittleLong( world );
+	*words++ = LittleLong( contents );
+
+	cm_capture.numPoints++;
+}
+
+
+/*
+================
+CM_StopCapture
+================
+*/
+void CM_StopCapture( void ) {
+	if ( !cm_capturing ) {
+		return;
+	}
+
+	CM_CaptureFlush();
+	FS_FCloseFile( cm_capture.file );
+	cm_capture.file = FS_INVALID_HANDLE;
+	cm_capturing = false;
+
+	Com_Printf( "Capture stopped, %i traces and %i point contents written.\n",
+		cm_capture.numTraces, cm_capture.numPoints );
+}
+
+
+/*
+================
+CM_StartCapture
+================
+*/
+static void CM_StartCapture( const char *name ) {
+	captureHeader_t	header;
+
+	CM_StopCapture();
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	cm_capture.file = FS_SV_FOpenFileWrite( name );
+	if ( cm_capture.file == FS_INVALID_HANDLE ) {
+		Com_Printf( S_COLOR_YELLOW "Couldn't open %s for writing.\n", name );
+		return;
+	}
+
+	Com_Memset( &header, 0, sizeof( header ) );
+	header.ident = LittleLong( CAPTURE_IDENT );
+	header.version = LittleLong( CAPTURE_VERSION );
+	header.checksum = LittleLong( cm.checksum );
+	Q_strncpyz( header.mapName, cm.name, sizeof( header.mapName ) );
+	FS_Write( &header, sizeof( header ), cm_capture.file );
+
+	cm_capture.numWords = 0;
+	cm_capture.numTraces = 0;
+	cm_capture.numPoints = 0;
+	cm_capturing = true;
+
+	Com_Printf( "Capturing collision queries on %s to %s\n", cm.name, name );
+}
+
+
+/*
+================
+CM_Capture_f
+================
+*/
+void CM_Capture_f( void ) {
+	if ( Cmd_Argc() > 1 ) {
+		CM_StartCapture( Cmd_Argv( 1 ) );
+	} else if ( cm_capturing ) {
+		CM_StopCapture();
+	} else {
+		Com_Printf( "usage: cm_capture [file], stops capturing without file\n" );
+	}
+}
+
+
+/*
+================
+CM_ReplayVector
+================
+*/
+static const int32_t *CM_ReplayVector( const int32_t *words, vec3_t v ) {
+	floatint_t	fi;
+	int			i;
+
+	for ( i = 0; i < 3; i++ ) {
+		fi.i = LittleLong( *words++ );
+		v[i] = fi.f;
+	}
+
+	return words;
+}
+
+
+/*
+================
+CM_ReplayMismatch
+================
+*/
+static void CM_ReplayMismatch( replayStats_t *stats, int index, const vec3_t start, const vec3_t end ) {
+	if ( stats->mismatches++ < REPLAY_MAX_REPORTS ) {
+		Com_Printf( S_COLOR_YELLOW "%s %i differs: (%.3f %.3f %.3f) - (%.3f %.3f %.3f)\n", stats->name, index,
+			start[0], start[1], start[2], end[0], end[1], end[2] );
+	}
+}
+
+
+/*
+================
+CM_ReplayTraces
+================
+*/
+static void CM_ReplayTraces( replayStats_t *stats, const replayTrace_t *traces, int count ) {
+	const replayTrace_t *rt;
+	trace_t	trace;
+	int64_t	start, time;
+	int		i, j, n;
+
+	for ( i = 0; i < count; i += n ) {
+		n = MIN( count - i, REPLAY_BLOCK );
+		start = Sys_Microseconds();
+		for ( j = 0, rt = traces + i; j < n; j++, rt++ ) {
+			CM_BoxTrace( &trace, rt->start, rt->end, rt->mins, rt->maxs, 0, rt->contentmask, rt->capsule );
+			// as set by SV_ClipMoveToWorld()
+			trace.entityNum = trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+			if ( CM_HashTrace( &trace ) != rt->hash ) {
+				CM_ReplayMismatch( stats, rt->index, rt->start, rt->end );
+			}
+		}
+		time = Sys_Microseconds() - start;
+		stats->time += time;
+		stats->samples[ stats->numSamples++ ] = (int)( time * 1000 / n );
+	}
+
+	for ( i = 0; i < count; i++ ) {
+		stats->entityHits += traces[i].entityHit;
+	}
+	stats->count += count;
+}
+
+
+/*
+================
+CM_ReplayPoints
+================
+*/
+static void CM_ReplayPoints( replayStats_t *stats, const replayPoint_t *points, int count ) {
+	const replayPoint_t *rp;
+	int64_t	start, time;
+	int		i, j, n;
+
+	for ( i = 0; i < count; i += n ) {
+		n = MIN( count - i, REPLAY_BLOCK );
+		start = Sys_Microseconds();
+		for ( j = 0, rp = points + i; j < n; j++, rp++ ) {
+			if ( CM_PointContents( rp->p, 0 ) != rp->contents ) {
+				CM_ReplayMismatch( stats, rp->index, rp->p, rp->p );
+			}
+		}
+		time = Sys_Microseconds() - start;
+		stats->time += time;
+		stats->samples[ stats->numSamples++ ] = (int)( time * 1000 / n );
+	}
+
+	for ( i = 0; i < count; i++ ) {
+		stats->entityHits += points[i].entityHit;
+	}
+	stats->count += count;
+}
+
+
+/*
+================
+CM_CompareSamples
+================
+*/
+static int QDECL CM_CompareSamples( const void *a, const void *b ) {
+	return *(const int *)a - *(const int *)b;
+}
+
+
+/*
+================
+CM_ReplayReport
+================
+*/
+static void CM_ReplayReport( replayStats_t *stats ) {
+	const int *s;
+	int		n;
+
+	n = stats->numSamples;
+	if ( !n ) {
+		return;
+	}
+
+	s = stats->samples;
+	qsort( stats->samples, n, sizeof( stats->samples[0] ), CM_CompareSamples );
+	Com_Printf( "%-9s %8i %9.0f %7i %7i %7i %7i %10i\n", stats->name, stats->count,
+		stats->time ? stats->count * 1000000.0 / stats->time : 0.0,
+		s[ ( n - 1 ) * 50 / 100 ], s[ ( n - 1 ) * 95 / 100 ], s[ ( n - 1 ) * 99 / 100 ], s[ n - 1 ],
+		stats->mismatches );
+}
+
+
+/*
+================
+CM_Replay_f
+================
+*/
+void CM_Replay_f( void ) {
+	captureHeader_t	header;
+	replayStats_t	traceStats, pointStats;
+	replayTrace_t	*traces, *rt;
+	replayPoint_t	*points, *rp;
+	int32_t			*buffer;
+	const int32_t	*words, *end;
+	fileHandle_t	f;
+	const char		*name;
+	int				length, checksum, maxSamples, numWords, len;
+	int				numTraces, numPoints, index, type;
+	bool			eof;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: cm_replay <file>\n" );
+		return;
+	}
+
+	if ( cm_capturing ) {
+		Com_Printf( "Can't replay while capturing.\n" );
+		return;
+	}
+
+	name = Cmd_Argv( 1 );
+	length = FS_SV_FOpenFileRead( name, &f );
+	if ( length < 0 ) {
+		Com_Printf( "Couldn't open %s\n", name );
+		return;
+	}
+
+	if ( FS_Read( &header, sizeof( header ), f ) != sizeof( header )
+		|| LittleLong( header.ident ) != CAPTURE_IDENT || LittleLong( header.version ) != CAPTURE_VERSION ) {
+		Com_Printf( "%s is not a collision capture\n", name );
+		FS_FCloseFile( f );
+		return;
+	}
+	header.mapName[ sizeof( header.mapName ) - 1 ] = '\0';
+
+	if ( strcmp( cm.name, header.mapName ) ) {
+		if ( cm.name[0] || com_sv_running->integer ) {
+			Com_Printf( "%s was captured on %s, unload %s first.\n", name, header.mapName, cm.name );
+			FS_FCloseFile( f );
+			return;
+		}
+		CM_LoadMap( header.mapName, false, &checksum );
+	}
+
+	if ( (int)cm.checksum != LittleLong( header.checksum ) ) {
+		Com_Printf( S_COLOR_YELLOW "%s checksum differs from the captured one, results will differ.\n", cm.name );
+	}
+
+	length -= sizeof( header );
+	// every buffer may end with a partial block
+	maxSamples = length / ( POINT_WORDS * sizeof( int32_t ) * REPLAY_BLOCK )
+		+ length / ( ( REPLAY_BUFFER - TRACE_WORDS ) * sizeof( int32_t ) ) + 2;
+
+	Com_Memset( &traceStats, 0, sizeof( traceStats ) );
+	Com_Memset( &pointStats, 0, sizeof( pointStats ) );
+	traceStats.name = "trace";
+	traceStats.samples = Z_Malloc( maxSamples * sizeof( int ) );
+	pointStats.name = "contents";
+	pointStats.samples = Z_Malloc( maxSamples * sizeof( int ) );
+
+	buffer = Z_Malloc( REPLAY_BUFFER * sizeof( int32_t ) );
+	traces = Z_Malloc( REPLAY_BUFFER / TRACE_WORDS * sizeof( *traces ) );
+	points = Z_Malloc( REPLAY_BUFFER / POINT_WORDS * sizeof( *points ) );
+
+	Com_Printf( "Replaying %s captured on %s\n", name, cm.name );
+
+	index = 0;
+	numWords = 0;
+	eof = false;
+	while ( !eof ) {
+		len = FS_Read( buffer + numWords, ( REPLAY_BUFFER - numWords ) * sizeof( int32_t ), f );
+		if ( len <= 0 ) {
+			eof = true;
+		} else {
+			numWords += len / sizeof( int32_t );
+		}
+
+		// decode complete records of the buffer
+		words = buffer;
+		end = buffer + numWords;
+		numTraces = numPoints = 0;
+		while ( words < end ) {
+			type = LittleLong( words[0] );
+			if ( type == CAPTURE_TRACE || type == CAPTURE_CAPSULE ) {
+				if ( end - words < TRACE_WORDS ) {
+					break;
+				}
+				rt = &traces[ numTraces++ ];
+				words = CM_ReplayVector( words + 1, rt->start );
+				words = CM_ReplayVector( words, rt->end );
+				words = CM_ReplayVector( words, rt->mins );
+				words = CM_ReplayVector( words, rt->maxs );
+				rt->contentmask = LittleLong( words[1] );
+				rt->capsule = ( type == CAPTURE_CAPSULE );
+				rt->hash = LittleLong( words[2] );
+				rt->entityHit = ( words[2] != words[3] );
+				rt->index = index++;
+				words += 4;
+			} else if ( type == CAPTURE_POINT ) {
+				if ( end - words < POINT_WORDS ) {
+					break;
+				}
+				rp = &points[ numPoints++ ];
+				words = CM_ReplayVector( words + 1, rp->p );
+				rp->contents = LittleLong( words[1] );
+				rp->entityHit = ( words[1] != words[2] );
+				rp->index = index++;
+				words += 3;
+			} else {
+				Com_Printf( S_COLOR_YELLOW "%s: bad query type %i, replay stopped\n", name, type );
+				eof = true;
+				break;
+			}
+		}
+
+		CM_ReplayTraces( &traceStats, traces, numTraces );
+		CM_ReplayPoints( &pointStats, points, numPoints );
+
+		// move incomplete record to the front
+		numWords = end - words;
+		memmove( buffer, words, numWords * sizeof( int32_t ) );
+		if ( eof && numWords && LittleLong( words[0] ) >= CAPTURE_TRACE && LittleLong( words[0] ) <= CAPTURE_POINT ) {
+			Com_Printf( S_COLOR_YELLOW "%s is truncated\n", name );
+		}
+	}
+
+	FS_FCloseFile( f );
+
+	Com_Printf( "query        count   per sec     p50     p95     p99     max (nsec) mismatches\n" );
+	CM_ReplayReport( &traceStats );
+	CM_ReplayReport( &pointStats );
+	if ( traceStats.entityHits || pointStats.entityHits ) {
+		Com_Printf( "%i traces and %i point contents were changed by entities, only world results are compared\n",
+			traceStats.entityHits, pointStats.entityHits );
+	}
+	if ( !traceStats.mismatches && !pointStats.mismatches ) {
+		Com_Printf( "all results match\n" );
+	}
+
+	Z_Free( points );
+	Z_Free( traces );
+	Z_Free( buffer );
+	Z_Free( pointStats.samples );
+	Z_Free( traceStats.samples );
+}
@@ -41,19 +41,10 @@ void SetPlaneSignbits( cplane_t *out ) {
 }
 #endif //BSPC
 
-// to allow boxes to be treated as brush models, we allocate
-// some extra indexes along with those needed by the map
-#define	BOX_BRUSHES		1
-#define	BOX_SIDES		6
-#define	BOX_LEAFS		2
-#define	BOX_PLANES		12
-
 #define	LL(x) x=LittleLong(x)
 
 
 clipMap_t	cm;
-int			c_pointcontents;
-int			c_traces, c_brush_traces, c_patch_traces;
 
 
 static byte *cmod_base;
@@ -64,13 +55,19 @@ cvar_t		*cm_noCurves;
 cvar_t		*cm_playerCurveClip;
 #endif
 
-static cmodel_t box_model;
-static cplane_t *box_planes;
-static cbrush_t *box_brush;
 
 
+typedef enum {
+	CM_NODES_DEPTH_FIRST,
+	CM_NODES_BREADTH_FIRST,
+	CM_NODES_VEB,
+	CM_NUM_NODE_LAYOUTS
+} cmNodeLayout_t;
 
-static void	CM_InitBoxHull (void);
+static void	CM_InitBoxHull( cmTraceContext_t *ctx );
+static void	CM_LayoutNodes( cmNodeLayout_t layout );
+static int	CM_TraceContextChecks( void );
+static void	CM_InitTraceContext( cmTraceContext_t *ctx, int *checks );
 void	CM_FloodAreaConnections (void);
 
 
@@ -178,7 +175,7 @@ CMod_LoadNodes
 */
 static void CMod_LoadNodes( const lump_t *l ) {
 	dnode_t	*in;
-	int		child;
+	int		child, planeNum;
 	cNode_t	*out;
 	int		i, j, count;
 
@@ -197,14 +194,303 @@ static void CMod_LoadNodes( const lump_t *l ) {
 
 	for ( i = 0; i < count; i++, out++, in++ )
 	{
-		out->plane = cm.planes + LittleLong( in->planeNum );
+		planeNum = LittleLong( in->planeNum );
+		if ( (unsigned)planeNum >= (unsigned)cm.numPlanes ) {
+			Com_Error( ERR_DROP, "%s: bad planeNum: %i", __func__, planeNum );
+		}
+		out->plane = cm.planes[ planeNum ];
 		for ( j = 0; j < 2; j++ )
 		{
 			child = LittleLong( in->children[j] );
+			if ( child >= count || -1 - child >= cm.numLeafs ) {
+				Com_Error( ERR_DROP, "%s: bad child: %i", __func__, child );
+			}
 			out->children[j] = child;
 		}
 	}
 
+	CM_LayoutNodes( CM_NODES_VEB );
+}
+
+
+/*
+===============================================================================
+
+NODE LAYOUT
+
+Nodes are only reached through their parents, so they can be stored in any
+order as long as the head node stays first. Depth first order keeps one
+child next to its parent, breadth first order keeps the upper levels
+together and van Emde Boas order recursively splits the tree into top and
+bottom subtrees of half the height each, which keeps a subtree spanning
+several levels within few cache lines at any granularity.
+
+===============================================================================
+*/
+
+static const char *nodeLayoutNames[ CM_NUM_NODE_LAYOUTS ] = {
+	"depth first",
+	"breadth first",
+	"van Emde Boas"
+};
+
+
+/*
+=================
+CM_NodeHeight
+=================
+*/
+static int CM_NodeHeight( const cNode_t *nodes, int num ) {
+	int		h0, h1;
+
+	if ( num < 0 ) {
+		return 0;
+	}
+
+	h0 = CM_NodeHeight( nodes, nodes[num].children[0] );
+	h1 = CM_NodeHeight( nodes, nodes[num].children[1] );
+
+	return 1 + MAX( h0, h1 );
+}
+
+
+/*
+=================
+CM_OrderNodesDepthFirst
+=================
+*/
+static void CM_OrderNodesDepthFirst( const cNode_t *nodes, int num, int *order, int *count ) {
+	while ( num >= 0 && order[num] < 0 ) {
+		order[num] = (*count)++;
+		CM_OrderNodesDepthFirst( nodes, nodes[num].children[0], order, count );
+		num = nodes[num].children[1];
+	}
+}
+
+
+/*
+=================
+CM_OrderNodesBreadthFirst
+=================
+*/
+static void CM_OrderNodesBreadthFirst( const cNode_t *nodes, int numNodes, int *order, int *count ) {
+	int		*queue;
+	int		head, tail, num, j;
+
+	queue = Z_Malloc( numNodes * sizeof( *queue ) );
+	head = tail = 0;
+	queue[ tail++ ] = 0;
+
+	while ( head < tail ) {
+		num = queue[ head++ ];
+		if ( order[num] >= 0 ) {
+			continue;
+		}
+		order[num] = (*count)++;
+		for ( j = 0; j < 2; j++ ) {
+			if ( nodes[num].children[j] >= 0 && tail < numNodes ) {
+				queue[ tail++ ] = nodes[num].children[j];
+			}
+		}
+	}
+
+	Z_Free( queue );
+}
+
+
+static void CM_OrderNodesVEB( const cNode_t *nodes, int num, int height, int *order, int *count );
+
+/*
+=================
+CM_OrderBottomTreesVEB
+
+Orders subtrees rooted depth levels below num
+=================
+*/
+static void CM_OrderBottomTreesVEB( const cNode_t *nodes, int num, int depth, int height, int *order, int *count ) {
+	if ( num < 0 ) {
+		return;
+	}
+
+	if ( depth == 0 ) {
+		CM_OrderNodesVEB( nodes, num, height, order, count );
+		return;
+	}
+
+	CM_OrderBottomTreesVEB( nodes, nodes[num].children[0], depth - 1, height, order, count );
+	CM_OrderBottomTreesVEB( nodes, nodes[num].children[1], depth - 1, height, order, count );
+}
+
+
+/*
+=================
+CM_OrderNodesVEB
+
+Orders the top height levels of the subtree at num
+=================
+*/
+static void CM_OrderNodesVEB( const cNode_t *nodes, int num, int height, int *order, int *count ) {
+	int		top;
+
+	if ( num < 0 || height <= 0 ) {
+		return;
+	}
+
+	if ( height == 1 ) {
+		if ( order[num] < 0 ) {
+			order[num] = (*count)++;
+		}
+		return;
+	}
+
+	top = height / 2;
+	CM_OrderNodesVEB( nodes, num, top, order, count );
+	CM_OrderBottomTreesVEB( nodes, num, top, height - top, order, count );
+}
+
+
+/*
+=================
+CM_LayoutNodes
+
+Stores nodes in the given order, keeping the head node first
+=================
+*/
+static void CM_LayoutNodes( cmNodeLayout_t layout ) {
+	cNode_t	*nodes, *out;
+	int		*order;
+	int		i, j, count;
+
+	nodes = Z_Malloc( cm.numNodes * sizeof( *nodes ) );
+	order = Z_Malloc( cm.numNodes * sizeof( *order ) );
+	Com_Memcpy( nodes, cm.nodes, cm.numNodes * sizeof( *nodes ) );
+
+	for ( i = 0; i < cm.numNodes; i++ ) {
+		order[i] = -1;
+	}
+
+	count = 0;
+	switch ( layout ) {
+	case CM_NODES_DEPTH_FIRST:
+		CM_OrderNodesDepthFirst( nodes, 0, order, &count );
+		break;
+	case CM_NODES_BREADTH_FIRST:
+		CM_OrderNodesBreadthFirst( nodes, cm.numNodes, order, &count );
+		break;
+	default:
+		CM_OrderNodesVEB( nodes, 0, CM_NodeHeight( nodes, 0 ), order, &count );
+		break;
+	}
+
+	// nodes that can't be reached from the head node go last
+	for ( i = 0; i < cm.numNodes; i++ ) {
+		if ( order[i] < 0 ) {
+			order[i] = count++;
+		}
+	}
+
+	for ( i = 0; i < cm.numNodes; i++ ) {
+		out = &cm.nodes[ order[i] ];
+		*out = nodes[i];
+		for ( j = 0; j < 2; j++ ) {
+			if ( out->children[j] >= 0 ) {
+				out->children[j] = order[ out->children[j] ];
+			}
+		}
+	}
+
+	Z_Free( order );
+	Z_Free( nodes );
+}
+
+
+/*
+=================
+CM_NodeBench_f
+
+Times tree traversals with every node layout,
+the load time layout is restored afterwards
+=================
+*/
+#define NODE_BENCH_QUERIES	100000
+void CM_NodeBench_f( void ) {
+	static const vec3_t boxMins = { -32, -32, -32 }, boxMaxs = { 32, 32, 32 };
+	static const vec3_t playerMins = { -15, -15, -24 }, playerMaxs = { 15, 15, 32 };
+	const cmodel_t *world;
+	vec3_t	*points, mins, maxs;
+	trace_t	trace;
+	int64_t	start, pointTime, boxTime, traceTime;
+	int		leafs[64];
+	int		numQueries, layout, i, j, seed, lastLeaf;
+	unsigned int hash, firstHash;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	numQueries = NODE_BENCH_QUERIES;
+	if ( Cmd_Argc() > 1 ) {
+		numQueries = atoi( Cmd_Argv( 1 ) );
+	}
+	if ( numQueries <= 0 ) {
+		Com_Printf( "usage: cm_nodeBench [queries]\n" );
+		return;
+	}
+
+	// random points in the world and trace ends close to them
+	points = Z_Malloc( numQueries * 2 * sizeof( *points ) );
+	world = &cm.cmodels[0];
+	seed = 0x5eed;
+	for ( i = 0; i < numQueries; i++ ) {
+		for ( j = 0; j < 3; j++ ) {
+			points[i*2][j] = world->mins[j] + Q_random( &seed ) * ( world->maxs[j] - world->mins[j] );
+			points[i*2+1][j] = points[i*2][j] + Q_crandom( &seed ) * 256;
+		}
+	}
+
+	Com_Printf( "%i queries, %i nodes, height %i\n", numQueries, cm.numNodes, CM_NodeHeight( cm.nodes, 0 ) );
+	Com_Printf( "layout            point    box  trace (nsec)\n" );
+
+	firstHash = 0;
+	for ( layout = 0; layout < CM_NUM_NODE_LAYOUTS; layout++ ) {
+		CM_LayoutNodes( layout );
+		hash = 0;
+
+		start = Sys_Microseconds();
+		for ( i = 0; i < numQueries; i++ ) {
+			hash = hash * 31 + CM_PointLeafnum( points[i*2] );
+		}
+		pointTime = Sys_Microseconds() - start;
+
+		start = Sys_Microseconds();
+		for ( i = 0; i < numQueries; i++ ) {
+			VectorAdd( points[i*2], boxMins, mins );
+			VectorAdd( points[i*2], boxMaxs, maxs );
+			hash = hash * 31 + CM_BoxLeafnums( mins, maxs, leafs, ARRAY_LEN( leafs ), &lastLeaf );
+		}
+		boxTime = Sys_Microseconds() - start;
+
+		start = Sys_Microseconds();
+		for ( i = 0; i < numQueries; i++ ) {
+			CM_BoxTrace( &trace, points[i*2], points[i*2+1], playerMins, playerMaxs, 0, CONTENTS_SOLID, false );
+			hash = hash * 31 + (unsigned int)( trace.fraction * 65536 );
+		}
+		traceTime = Sys_Microseconds() - start;
+
+		Com_Printf( "%-15s %7.0f %6.0f %6.0f\n", nodeLayoutNames[ layout ],
+			pointTime * 1000.0 / numQueries, boxTime * 1000.0 / numQueries, traceTime * 1000.0 / numQueries );
+
+		if ( layout == 0 ) {
+			firstHash = hash;
+		} else if ( hash != firstHash ) {
+			Com_Printf( S_COLOR_RED "results differ from the %s layout\n", nodeLayoutNames[0] );
+		}
+	}
+
+	CM_LayoutNodes( CM_NODES_VEB );
+
+	Z_Free( points );
 }
 
 /*
@@ -242,7 +528,7 @@ static void CMod_LoadBrushes( const lump_t *l ) {
 
 	count = l->filelen / sizeof(*in);
 
-	cm.brushes = Hunk_Alloc( ( BOX_BRUSHES + count ) * sizeof( *cm.brushes ), h_high );
+	cm.brushes = Hunk_Alloc( count * sizeof( *cm.brushes ), h_high );
 	cm.numBrushes = count;
 
 	out = cm.brushes;
@@ -263,6 +549,42 @@ static void CMod_LoadBrushes( const lump_t *l ) {
 }
 
 
+#ifdef CM_SIMD_BRUSHES
+/*
+=================
+CMod_LoadBrushPlanes
+
+Copies side planes of every brush into contiguous rows, padded
+with zero planes which never clip anything
+=================
+*/
+static void CMod_LoadBrushPlanes( void ) {
+	cbrush_t	*b;
+	float		*rows;
+	int			i, j, total;
+
+	total = 0;
+	for ( i = 0, b = cm.brushes; i < cm.numBrushes; i++, b++ ) {
+		b->planeStride = ( b->numsides + 3 ) & ~3;
+		total += b->planeStride * 4;
+	}
+
+	rows = Hunk_Alloc( total * sizeof( *rows ), h_high );
+
+	for ( i = 0, b = cm.brushes; i < cm.numBrushes; i++, b++ ) {
+		b->planes = rows;
+		for ( j = 0; j < b->numsides; j++ ) {
+			rows[ j ] = b->sides[j].plane->normal[0];
+			rows[ j + b->planeStride ] = b->sides[j].plane->normal[1];
+			rows[ j + b->planeStride * 2 ] = b->sides[j].plane->normal[2];
+			rows[ j + b->planeStride * 3 ] = b->sides[j].plane->dist;
+		}
+		rows += b->planeStride * 4;
+	}
+}
+#endif
+
+
 /*
 =================
 CMod_LoadLeafs
@@ -283,7 +605,7 @@ static void CMod_LoadLeafs( const lump_t *l )
 	if ( count < 1 )
 		Com_Error( ERR_DROP, "%s: map with no leafs", __func__ );
 
-	cm.leafs = Hunk_Alloc( ( BOX_LEAFS + count ) * sizeof( *cm.leafs ), h_high );
+	cm.leafs = Hunk_Alloc( count * sizeof( *cm.leafs ), h_high );
 	cm.numLeafs = count;
 
 	out = cm.leafs;
@@ -328,7 +650,7 @@ static void CMod_LoadPlanes( const lump_t *l )
 	if ( count < 1 )
 		Com_Error( ERR_DROP, "%s: map with no planes", __func__ );
 
-	cm.planes = Hunk_Alloc( ( BOX_PLANES + count ) * sizeof( *cm.planes ), h_high );
+	cm.planes = Hunk_Alloc( count * sizeof( *cm.planes ), h_high );
 	cm.numPlanes = count;
 
 	out = cm.planes;
@@ -368,7 +690,7 @@ static void CMod_LoadLeafBrushes( const lump_t *l )
 
 	count = l->filelen / sizeof(*in);
 
-	cm.leafbrushes = Hunk_Alloc( (count + BOX_BRUSHES) * sizeof( *cm.leafbrushes ), h_high );
+	cm.leafbrushes = Hunk_Alloc( count * sizeof( *cm.leafbrushes ), h_high );
 	cm.numLeafBrushes = count;
 
 	out = cm.leafbrushes;
@@ -445,7 +767,7 @@ static void CMod_LoadBrushSides( const lump_t *l )
 	}
 	count = l->filelen / sizeof(*in);
 
-	cm.brushsides = Hunk_Alloc( ( BOX_SIDES + count ) * sizeof( *cm.brushsides ), h_high );
+	cm.brushsides = Hunk_Alloc( count * sizeof( *cm.brushsides ), h_high );
 	cm.numBrushSides = count;
 
 	out = cm.brushsides;
@@ -686,6 +1008,9 @@ void CM_LoadMap( const char *name, bool clientload, int *checksum ) {
 	CMod_LoadPlanes (&header.lumps[LUMP_PLANES]);
 	CMod_LoadBrushSides (&header.lumps[LUMP_BRUSHSIDES]);
 	CMod_LoadBrushes (&header.lumps[LUMP_BRUSHES]);
+#ifdef CM_SIMD_BRUSHES
+	CMod_LoadBrushPlanes();
+#endif
 	CMod_LoadSubmodels (&header.lumps[LUMP_MODELS]);
 	CMod_LoadNodes (&header.lumps[LUMP_NODES]);
 	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES]);
@@ -694,11 +1019,11 @@ void CM_LoadMap( const char *name, bool clientload, int *checksum ) {
 
 	CMod_CheckLeafBrushes();
 
+	CM_InitTraceContext( &cm.context, Hunk_Alloc( CM_TraceContextChecks() * sizeof( int ), h_high ) );
+
 	// we are NOT freeing the file, because it is cached for the ref
 	FS_FreeFile( buf );
 
-	CM_InitBoxHull();
-
 	CM_FloodAreaConnections();
 
 	// allow this to be cached if it is loaded by the server
@@ -714,25 +1039,105 @@ CM_ClearMap
 ==================
 */
 void CM_ClearMap( void ) {
+#ifndef BSPC
+	CM_StopCapture();
+#endif
 	Com_Memset( &cm, 0, sizeof( cm ) );
 	CM_ClearLevelPatches();
 }
 
 
+/*
+==================
+CM_TraceContextChecks
+
+Number of checkcounts a context needs for the loaded map
+==================
+*/
+static int CM_TraceContextChecks( void ) {
+	return cm.numBrushes + cm.numSurfaces;
+}
+
+
+/*
+==================
+CM_InitTraceContext
+==================
+*/
+static void CM_InitTraceContext( cmTraceContext_t *ctx, int *checks ) {
+	Com_Memset( ctx, 0, sizeof( *ctx ) );
+	ctx->numBrushes = cm.numBrushes;
+	ctx->numSurfaces = cm.numSurfaces;
+	ctx->brushChecks = checks;
+	ctx->surfaceChecks = checks + ctx->numBrushes;
+
+	CM_InitBoxHull( ctx );
+}
+
+
+/*
+==================
+CM_CreateTraceContext
+
+Main thread only, the context comes from the zone
+==================
+*/
+cmTraceContext_t *CM_CreateTraceContext( void ) {
+	cmTraceContext_t *ctx;
+
+	if ( !cm.numNodes ) {
+		Com_Error( ERR_DROP, "%s: map not loaded", __func__ );
+	}
+
+	ctx = Z_Malloc( sizeof( *ctx ) + CM_TraceContextChecks() * sizeof( int ) );
+	CM_InitTraceContext( ctx, (int *)( ctx + 1 ) );
+
+	return ctx;
+}
+
+
+/*
+==================
+CM_FreeTraceContext
+==================
+*/
+void CM_FreeTraceContext( cmTraceContext_t *ctx ) {
+	Z_Free( ctx );
+}
+
+
+/*
+==================
+CM_TakeTraceCounters
+==================
+*/
+void CM_TakeTraceCounters( int *traces, int *brushTraces, int *patchTraces, int *pointContents ) {
+	*traces = cm.context.traces;
+	*brushTraces = cm.context.brushTraces;
+	*patchTraces = cm.context.patchTraces;
+	*pointContents = cm.context.pointContents;
+
+	cm.context.traces = 0;
+	cm.context.brushTraces = 0;
+	cm.context.patchTraces = 0;
+	cm.context.pointContents = 0;
+}
+
+
 /*
 ==================
 CM_ClipHandleToModel
 ==================
 */
-cmodel_t *CM_ClipHandleToModel( clipHandle_t handle ) {
+cmodel_t *CM_ClipHandleToModel( cmTraceContext_t *ctx, clipHandle_t handle ) {
 	if ( handle < 0 ) {
 		Com_Error( ERR_DROP, "CM_ClipHandleToModel: bad handle %i", handle );
 	}
 	if ( handle < cm.numSubModels ) {
 		return &cm.cmodels[handle];
 	}
-	if ( handle == BOX_MODEL_HANDLE ) {
-		return &box_model;
+	if ( handle == BOX_MODEL_HANDLE || handle == CAPSULE_MODEL_HANDLE ) {
+		return &ctx->boxModel;
 	}
 	if ( handle < MAX_SUBMODELS ) {
 		Com_Error( ERR_DROP, "CM_ClipHandleToModel: bad handle %i < %i < %i", 
@@ -794,46 +1199,40 @@ int CM_LeafArea( int leafnum ) {
 ===================
 CM_InitBoxHull
 
-Set up the planes and nodes so that the six floats of a bounding box
-can just be stored out and get a proper clipping hull structure.
+Set up the planes of the box brush of a trace context so that the six
+floats of a bounding box can just be stored out and get a proper clipping
+hull structure. The brush is kept out of the map arrays and is tested
+directly, its model has an empty leaf.
 ===================
 */
-static void CM_InitBoxHull( void )
+static void CM_InitBoxHull( cmTraceContext_t *ctx )
 {
 	int			i;
 	int			side;
 	cplane_t	*p;
 	cbrushside_t	*s;
 
-	box_planes = &cm.planes[cm.numPlanes];
-
-	box_brush = &cm.brushes[cm.numBrushes];
-	box_brush->numsides = 6;
-	box_brush->sides = cm.brushsides + cm.numBrushSides;
-	box_brush->contents = CONTENTS_BODY;
-
-	box_model.leaf.numLeafBrushes = 1;
-//	box_model.leaf.firstLeafBrush = cm.numBrushes;
-	box_model.leaf.firstLeafBrush = cm.numLeafBrushes;
-	cm.leafbrushes[cm.numLeafBrushes] = cm.numBrushes;
+	ctx->boxBrush.numsides = 6;
+	ctx->boxBrush.sides = ctx->boxSides;
+	ctx->boxBrush.contents = CONTENTS_BODY;
 
 	for ( i = 0; i < 6; i++ )
 	{
 		side = i & 1;
 
 		// brush sides
-		s = &cm.brushsides[cm.numBrushSides + i];
-		s->plane = cm.planes + ( cm.numPlanes + i * 2 + side );
+		s = &ctx->boxSides[i];
+		s->plane = &ctx->boxPlanes[i * 2 + side];
 		s->surfaceFlags = 0;
 
 		// planes
-		p = &box_planes[i * 2];
+		p = &ctx->boxPlanes[i * 2];
 		p->type = i >> 1;
 		p->signbits = 0;
 		VectorClear( p->normal );
 		p->normal[i >> 1] = 1;
 
-		p = &box_planes[i * 2 + 1];
+		p = &ctx->boxPlanes[i * 2 + 1];
 		p->type = 3 + ( i >> 1 );
 		p->signbits = 0;
 		VectorClear( p->normal );
@@ -846,42 +1245,54 @@ static void CM_InitBoxHull( void )
 
 /*
 ===================
-CM_TempBoxModel
+CM_TempBoxModelCtx
 
 To keep everything totally uniform, bounding boxes are turned into small
 BSP trees instead of being compared directly.
 Capsules are handled differently though.
 ===================
 */
-clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+clipHandle_t CM_TempBoxModelCtx( cmTraceContext_t *ctx, const vec3_t mins, const vec3_t maxs, int capsule ) {
+	cplane_t *planes;
 
-	VectorCopy( mins, box_model.mins );
-	VectorCopy( maxs, box_model.maxs );
+	VectorCopy( mins, ctx->boxModel.mins );
+	VectorCopy( maxs, ctx->boxModel.maxs );
 
 	if ( capsule ) {
 		return CAPSULE_MODEL_HANDLE;
 	}
 
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = -maxs[0];
-	box_planes[2].dist = mins[0];
-	box_planes[3].dist = -mins[0];
-	box_planes[4].dist = maxs[1];
-	box_planes[5].dist = -maxs[1];
-	box_planes[6].dist = mins[1];
-	box_planes[7].dist = -mins[1];
-	box_planes[8].dist = maxs[2];
-	box_planes[9].dist = -maxs[2];
-	box_planes[10].dist = mins[2];
-	box_planes[11].dist = -mins[2];
-
-	VectorCopy( mins, box_brush->bounds[0] );
-	VectorCopy( maxs, box_brush->bounds[1] );
+	planes = ctx->boxPlanes;
+	planes[0].dist = maxs[0];
+	planes[1].dist = -maxs[0];
+	planes[2].dist = mins[0];
+	planes[3].dist = -mins[0];
+	planes[4].dist = maxs[1];
+	planes[5].dist = -maxs[1];
+	planes[6].dist = mins[1];
+	planes[7].dist = -mins[1];
+	planes[8].dist = maxs[2];
+	planes[9].dist = -maxs[2];
+	planes[10].dist = mins[2];
+	planes[11].dist = -mins[2];
+
+	VectorCopy( mins, ctx->boxBrush.bounds[0] );
+	VectorCopy( maxs, ctx->boxBrush.bounds[1] );
 
 	return BOX_MODEL_HANDLE;
 }
 
 
+/*
+===================
+CM_TempBoxModel
+===================
+*/
+clipHandle_t CM_TempBoxModel( const vec3_t mins, const vec3_t maxs, int capsule ) {
+	return CM_TempBoxModelCtx( &cm.context, mins, maxs, capsule );
+}
+
+
 /*
 ===================
 CM_ModelBounds
@@ -890,7 +1301,7 @@ CM_ModelBounds
 void CM_ModelBounds( clipHandle_t model, vec3_t mins, vec3_t maxs ) {
 	cmodel_t *cmod;
 
-	cmod = CM_ClipHandleToModel( model );
+	cmod = CM_ClipHandleToModel( &cm.context, model );
 	VectorCopy( cmod->mins, mins );
 	VectorCopy( cmod->maxs, maxs );
 }
@@ -28,6 +28,12 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define	BOX_MODEL_HANDLE		255
 #define CAPSULE_MODEL_HANDLE	254
 
+// brush side planes are also kept as rows of floats for two-wide
+// double precision tests, see CM_TraceThroughBrushPlanes
+#if idx64 || arm64
+#define CM_SIMD_BRUSHES
+#endif
+
 
 // forced double-precison functions
 #define DotProductDP(x,y)		((double)(x)[0]*(y)[0]+(double)(x)[1]*(y)[1]+(double)(x)[2]*(y)[2])
@@ -73,9 +79,12 @@ static ID_INLINE vec_t VectorNormalizeDP( vec3_t v ) {
 }
 
 
+// nodes carry their plane and are stored in van Emde Boas order
+// after loading, see CM_LayoutNodes
 typedef struct {
-	cplane_t	*plane;
+	cplane_t	plane;
 	int			children[2];		// negative numbers are leafs
+	int			pad;				// two nodes per cache line
 } cNode_t;
 
 typedef struct {
@@ -106,12 +115,14 @@ typedef struct {
 	vec3_t		bounds[2];
 	int			numsides;
 	cbrushside_t	*sides;
-	int			checkcount;		// to avoid repeated testings
+#ifdef CM_SIMD_BRUSHES
+	float		*planes;		// normal x, y, z and dist rows of planeStride, NULL for the box brush
+	int			planeStride;
+#endif
 } cbrush_t;
 
 
 typedef struct {
-	int			checkcount;				// to avoid repeated testings
 	int			surfaceFlags;
 	int			contents;
 	struct patchCollide_s	*pc;
@@ -123,6 +134,39 @@ typedef struct {
 	int			floodvalid;
 } cArea_t;
 
+// state of collision queries, each thread running them needs its own
+struct cmTraceContext_s {
+	int			checkcount;			// incremented on each query
+	int			numBrushes;
+	int			numSurfaces;
+	int			*brushChecks;		// checkcount of the last query that tested
+	int			*surfaceChecks;		// the brush or patch, to avoid repeated testings
+
+	// statistics, may be zeroed
+	int			traces;
+	int			brushTraces;
+	int			patchTraces;
+	int			pointContents;
+	int			patchQueries;		// patch traces and position tests
+	int			patchFacets;		// facets of the queried patches
+	int			patchFacetTests;	// facets in hierarchy leaves that were reached
+
+	// temp box model, set by CM_TempBoxModelCtx and only tested
+	// through the handle it returns, never reached from the map
+	cmodel_t	boxModel;
+	cbrush_t	boxBrush;
+	cbrushside_t boxSides[6];
+	cplane_t	boxPlanes[12];
+
+#ifdef CM_SIMD_BRUSHES
+	// cross-check of the brush side loops, see CM_CompareBrushPaths
+	bool		scalarBrushes;		// skip the vectorized side loops
+	bool		compareBrushes;		// run every brush test through both loops
+	int			brushCompares;
+	int			brushMismatches;
+#endif
+};
+
 typedef struct {
 	char		name[MAX_QPATH];
 
@@ -169,7 +213,8 @@ typedef struct {
 	cPatch_t	**surfaces;			// non-patches will be NULL
 
 	int			floodvalid;
-	int			checkcount;					// incremented on each trace
+
+	cmTraceContext_t context;		// for queries that don't pass their own
 
 	unsigned int checksum;
 } clipMap_t;
@@ -180,8 +225,6 @@ typedef struct {
 #define	SURFACE_CLIP_EPSILON	(0.125)
 
 extern	clipMap_t	cm;
-extern	int			c_pointcontents;
-extern	int			c_traces, c_brush_traces, c_patch_traces;
 extern	cvar_t		*cm_noAreas;
 extern	cvar_t		*cm_noCurves;
 extern	cvar_t		*cm_playerCurveClip;
@@ -210,6 +253,7 @@ typedef struct {
 	bool		isPoint;	// optimized case
 	trace_t		trace;		// returned from trace call
 	sphere_t	sphere;		// sphere for oriendted capsule collision
+	cmTraceContext_t *ctx;	// tested brushes and patches
 } traceWork_t;
 
 typedef struct leafList_s {
@@ -230,7 +274,7 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum );
 
 void CM_BoxLeafnums_r( leafList_t *ll, int nodenum );
 
-cmodel_t	*CM_ClipHandleToModel( clipHandle_t handle );
+cmodel_t	*CM_ClipHandleToModel( cmTraceContext_t *ctx, clipHandle_t handle );
 bool CM_BoundsIntersect( const vec3_t mins, const vec3_t maxs, const vec3_t mins2, const vec3_t maxs2 );
 bool CM_BoundsIntersectPoint( const vec3_t mins, const vec3_t maxs, const vec3_t point );
 
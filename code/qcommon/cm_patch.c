@@ -425,6 +425,10 @@ static	patchPlane_t	planes[MAX_PATCH_PLANES];
 static	int				numFacets;
 static	facet_t			facets[MAX_FACETS];
 
+static	int				numFacetNodes;
+static	facetNode_t		facetNodes[MAX_FACETS*2];
+static	vec3_t			facetBounds[MAX_FACETS][2];
+
 #define	NORMAL_EPSILON	0.0001
 #define	DIST_EPSILON	0.02
 
@@ -1012,6 +1016,125 @@ static void CM_AddFacetBevels( facet_t *facet ) {
 
 }
 
+/*
+==================
+CM_FacetBounds
+
+Only axial surface and border planes limit the space a trace
+can hit a facet in, the bounds are unlimited where there is none
+==================
+*/
+#define	FACET_UNBOUNDED		1.0e30f
+static void CM_FacetBounds( const facet_t *facet, vec3_t bounds[2] ) {
+	const float	*plane;
+	float		dist;
+	int			i, j, axis, planeNum, sign;
+
+	VectorSet( bounds[0], -FACET_UNBOUNDED, -FACET_UNBOUNDED, -FACET_UNBOUNDED );
+	VectorSet( bounds[1], FACET_UNBOUNDED, FACET_UNBOUNDED, FACET_UNBOUNDED );
+
+	// the surface plane is followed by the borders, the
+	// facet is behind all of them after inward flipping
+	for ( i = -1; i < facet->numBorders; i++ ) {
+		if ( i < 0 ) {
+			planeNum = facet->surfacePlane;
+			sign = 1;
+		} else {
+			planeNum = facet->borderPlanes[i];
+			sign = facet->borderInward[i] ? -1 : 1;
+		}
+		plane = planes[ planeNum ].plane;
+
+		for ( axis = 0; axis < 3; axis++ ) {
+			if ( plane[axis] != 1.0f && plane[axis] != -1.0f ) {
+				continue;
+			}
+			for ( j = 0; j < 3; j++ ) {
+				if ( j != axis && plane[j] != 0.0f ) {
+					break;
+				}
+			}
+			if ( j < 3 ) {
+				continue;
+			}
+			dist = plane[3] * sign;
+			if ( plane[axis] * sign > 0 ) {
+				if ( dist < bounds[1][axis] ) {
+					bounds[1][axis] = dist;
+				}
+			} else {
+				if ( -dist > bounds[0][axis] ) {
+					bounds[0][axis] = -dist;
+				}
+			}
+		}
+	}
+
+	// expand by one unit for epsilon purposes, like the patch bounds
+	for ( axis = 0; axis < 3; axis++ ) {
+		bounds[0][axis] -= 1;
+		bounds[1][axis] += 1;
+	}
+}
+
+
+/*
+==================
+CM_AddFacetNodes
+
+Splits a range of facets in halves, facets are generated row
+by row from the grid so halves of a range are close in space
+==================
+*/
+static void CM_AddFacetNodes( int firstFacet, int count ) {
+	facetNode_t	*node;
+	int			i, half;
+
+	node = &facetNodes[ numFacetNodes++ ];
+	node->firstFacet = firstFacet;
+
+	ClearBounds( node->bounds[0], node->bounds[1] );
+	for ( i = firstFacet; i < firstFacet + count; i++ ) {
+		AddPointToBounds( facetBounds[i][0], node->bounds[0], node->bounds[1] );
+		AddPointToBounds( facetBounds[i][1], node->bounds[0], node->bounds[1] );
+	}
+
+	if ( count <= FACETS_PER_NODE ) {
+		node->numFacets = count;
+	} else {
+		node->numFacets = 0;
+		half = count / 2;
+		CM_AddFacetNodes( firstFacet, half );
+		CM_AddFacetNodes( firstFacet + half, count - half );
+	}
+
+	node->skip = numFacetNodes;
+}
+
+
+/*
+==================
+CM_BuildFacetNodes
+==================
+*/
+static void CM_BuildFacetNodes( patchCollide_t *pf ) {
+	int		i;
+
+	for ( i = 0; i < numFacets; i++ ) {
+		CM_FacetBounds( &facets[i], facetBounds[i] );
+	}
+
+	numFacetNodes = 0;
+	if ( numFacets ) {
+		CM_AddFacetNodes( 0, numFacets );
+	}
+
+	pf->numNodes = numFacetNodes;
+	pf->nodes = Hunk_Alloc( numFacetNodes * sizeof( *pf->nodes ), h_high );
+	Com_Memcpy( pf->nodes, facetNodes, numFacetNodes * sizeof( *pf->nodes ) );
+}
+
+
 typedef enum {
 	EN_TOP,
 	EN_RIGHT,
@@ -1179,6 +1302,8 @@ static void CM_PatchCollideFromGrid( const cGrid_t *grid, patchCollide_t *pf ) {
 	Com_Memcpy( pf->facets, facets, numFacets * sizeof( *pf->facets ) );
 	pf->planes = Hunk_Alloc( numPlanes * sizeof( *pf->planes ), h_high );
 	Com_Memcpy( pf->planes, planes, numPlanes * sizeof( *pf->planes ) );
+
+	CM_BuildFacetNodes( pf );
 }
 
 
@@ -1268,6 +1393,49 @@ TRACE TESTING
 ================================================================================
 */
 
+/*
+====================
+CM_NextFacet
+
+Returns the first facet from facetNum on that is in a hierarchy leaf
+touched by the trace bounds, numFacets when there are no more.
+*nodeNum is the leaf of the previous facet, -1 to start a walk.
+====================
+*/
+static int CM_NextFacet( const traceWork_t *tw, const patchCollide_t *pc, int *nodeNum, int facetNum ) {
+	const facetNode_t *node;
+	int n;
+
+	n = *nodeNum;
+	if ( n < 0 ) {
+		n = 0;
+	} else {
+		node = &pc->nodes[n];
+		if ( facetNum < node->firstFacet + node->numFacets ) {
+			return facetNum;
+		}
+		n = node->skip;
+	}
+
+	while ( n < pc->numNodes ) {
+		node = &pc->nodes[n];
+		if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1], node->bounds[0], node->bounds[1] ) ) {
+			n = node->skip;
+			continue;
+		}
+		if ( node->numFacets ) {
+			*nodeNum = n;
+			tw->ctx->patchFacetTests += node->numFacets;
+			return node->firstFacet;
+		}
+		n++;
+	}
+
+	*nodeNum = n;
+	return pc->numFacets;
+}
+
+
 /*
 ====================
 CM_TracePointThroughPatchCollide
@@ -1281,7 +1449,7 @@ static void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patc
 	float		intersect;
 	const 		patchPlane_t	*pp;
 	const 		facet_t	*facet;
-	int			i, j, k;
+	int			i, j, k, node, first;
 	float		offset;
 	float		d1, d2;
 #ifndef BSPC
@@ -1294,6 +1462,15 @@ static void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patc
 	}
 #endif
 
+	tw->ctx->patchQueries++;
+	tw->ctx->patchFacets += pc->numFacets;
+
+	node = -1;
+	first = CM_NextFacet( tw, pc, &node, 0 );
+	if ( first == pc->numFacets ) {
+		return;		// no facet is close
+	}
+
 	// determine the trace's relationship to all planes
 	pp = pc->planes;
 	for ( i = 0 ; i < pc->numPlanes ; i++, pp++ ) {
@@ -1317,8 +1494,8 @@ static void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patc
 
 
 	// see if any of the surface planes are intersected
-	facet = pc->facets;
-	for ( i = 0 ; i < pc->numFacets ; i++, facet++ ) {
+	for ( i = first ; i < pc->numFacets ; i = CM_NextFacet( tw, pc, &node, i + 1 ) ) {
+		facet = &pc->facets[i];
 		if ( !frontFacing[facet->surfacePlane] ) {
 			continue;
 		}
@@ -1344,10 +1521,11 @@ static void CM_TracePointThroughPatchCollide( traceWork_t *tw, const struct patc
 		if ( j == facet->numBorders ) {
 			// we hit this facet
 #ifndef BSPC
-			if (!cv) {
+			// debug surface is only updated by queries of the main thread
+			if ( tw->ctx == &cm.context && !cv ) {
 				cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
 			}
-			if (cv->integer) {
+			if ( tw->ctx == &cm.context && cv->integer ) {
 				debugPatchCollide = pc;
 				debugFacet = facet;
 			}
@@ -1424,7 +1602,7 @@ CM_TraceThroughPatchCollide
 ====================
 */
 void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc ) {
-	int i, j, hit, hitnum;
+	int i, j, hit, hitnum, node;
 	float offset, enterFrac, leaveFrac, t;
 	patchPlane_t *pp;
 	facet_t	*facet;
@@ -1446,8 +1624,12 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 
 	Vector4Set(bestplane, 0, 0, 0, 0);
 
-	facet = pc->facets;
-	for ( i = 0 ; i < pc->numFacets ; i++, facet++ ) {
+	tw->ctx->patchQueries++;
+	tw->ctx->patchFacets += pc->numFacets;
+
+	node = -1;
+	for ( i = CM_NextFacet( tw, pc, &node, 0 ) ; i < pc->numFacets ; i = CM_NextFacet( tw, pc, &node, i + 1 ) ) {
+		facet = &pc->facets[i];
 		enterFrac = -1.0;
 		leaveFrac = 1.0;
 		hitnum = -1;
@@ -1535,10 +1717,11 @@ void CM_TraceThroughPatchCollide( traceWork_t *tw, const struct patchCollide_s *
 				//	enterFrac = 0;
 				//}
 #ifndef BSPC
-				if (!cv) {
+				// debug surface is only updated by queries of the main thread
+				if ( tw->ctx == &cm.context && !cv ) {
 					cv = Cvar_Get( "r_debugSurfaceUpdate", "1", 0 );
 				}
-				if (cv && cv->integer) {
+				if ( tw->ctx == &cm.context && cv->integer ) {
 					debugPatchCollide = pc;
 					debugFacet = facet;
 				}
@@ -1567,7 +1750,7 @@ CM_PositionTestInPatchCollide
 ====================
 */
 bool CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchCollide_s *pc ) {
-	int i, j;
+	int i, j, node;
 	float offset, t;
 	patchPlane_t *pp;
 	facet_t	*facet;
@@ -1577,9 +1760,13 @@ bool CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchCollide_s
 	if (tw->isPoint) {
 		return false;
 	}
-	//
-	facet = pc->facets;
-	for ( i = 0 ; i < pc->numFacets ; i++, facet++ ) {
+
+	tw->ctx->patchQueries++;
+	tw->ctx->patchFacets += pc->numFacets;
+
+	node = -1;
+	for ( i = CM_NextFacet( tw, pc, &node, 0 ) ; i < pc->numFacets ; i = CM_NextFacet( tw, pc, &node, i + 1 ) ) {
+		facet = &pc->facets[i];
 		pp = &pc->planes[ facet->surfacePlane ];
 		VectorCopy(pp->plane, plane);
 		plane[3] = pp->plane[3];
@@ -1649,6 +1836,62 @@ bool CM_PositionTestInPatchCollide( traceWork_t *tw, const struct patchCollide_s
 	return false;
 }
 
+/*
+==================
+CM_PatchStats_f
+
+Facet counts of the loaded patches and how many facets
+main thread queries had to test with the facet hierarchy
+==================
+*/
+void CM_PatchStats_f( void ) {
+	const patchCollide_t *pc;
+	cmTraceContext_t *ctx;
+	int		i, numPatches, totalFacets, maxFacets, totalNodes;
+
+	ctx = &cm.context;
+
+	if ( !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		ctx->patchQueries = 0;
+		ctx->patchFacets = 0;
+		ctx->patchFacetTests = 0;
+		return;
+	}
+
+	numPatches = totalFacets = maxFacets = totalNodes = 0;
+	for ( i = 0; i < cm.numSurfaces; i++ ) {
+		if ( !cm.surfaces[i] ) {
+			continue;
+		}
+		pc = cm.surfaces[i]->pc;
+		numPatches++;
+		totalFacets += pc->numFacets;
+		totalNodes += pc->numNodes;
+		if ( pc->numFacets > maxFacets ) {
+			maxFacets = pc->numFacets;
+		}
+	}
+
+	if ( !numPatches ) {
+		Com_Printf( "No patches loaded.\n" );
+		return;
+	}
+
+	Com_Printf( "%i patches, %i facets, %i max per patch, %.1f average\n",
+		numPatches, totalFacets, maxFacets, (float)totalFacets / numPatches );
+	Com_Printf( "%i hierarchy nodes, %i facets per leaf\n", totalNodes, FACETS_PER_NODE );
+
+	if ( !ctx->patchQueries ) {
+		Com_Printf( "no patch queries yet\n" );
+		return;
+	}
+
+	Com_Printf( "%i patch queries, %.1f facets tested per query, %.1f without hierarchy\n",
+		ctx->patchQueries, (float)ctx->patchFacetTests / ctx->patchQueries,
+		(float)ctx->patchFacets / ctx->patchQueries );
+}
+
+
 /*
 =======================================================================
 
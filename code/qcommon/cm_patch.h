@@ -76,12 +76,26 @@ typedef struct {
 	bool		borderNoAdjust[4+6+16];
 } facet_t;
 
+// bounding volume hierarchy over the facets of a patch, nodes are stored
+// depth first and leaves keep facets in their original order so hits
+// are found in the same order as by a linear scan
+#define	FACETS_PER_NODE		4
+
+typedef struct {
+	vec3_t		bounds[2];
+	int			firstFacet;
+	int			numFacets;		// 0 for interior nodes
+	int			skip;			// first node after this subtree
+} facetNode_t;
+
 typedef struct patchCollide_s {
 	vec3_t			bounds[2];
 	int				numPlanes;			// surface planes plus edge planes
 	patchPlane_t	*planes;
 	int				numFacets;
 	facet_t			*facets;
+	int				numNodes;
+	facetNode_t		*nodes;
 } patchCollide_t;
 
 
@@ -23,6 +23,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "qfiles.h"
 
 
+// queries that pass their own context can run on several threads at once,
+// each context also has its own temp box model, see CM_TempBoxModelCtx
+typedef struct cmTraceContext_s cmTraceContext_t;
+
 void		CM_LoadMap( const char *name, bool clientload, int *checksum);
 void		CM_ClearMap( void );
 clipHandle_t CM_InlineModel( int index );		// 0 = world, 1 + are bmodels
@@ -46,6 +50,42 @@ void		CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 						clipHandle_t model, int brushmask,
 						const vec3_t origin, const vec3_t angles, bool capsule );
 
+// contexts are created for the loaded map and must be freed before it is cleared,
+// both calls use the zone allocator and are for the main thread only
+cmTraceContext_t *CM_CreateTraceContext( void );
+void		CM_FreeTraceContext( cmTraceContext_t *ctx );
+
+// the handle refers to the box of the given context and is only valid with it
+clipHandle_t CM_TempBoxModelCtx( cmTraceContext_t *ctx, const vec3_t mins, const vec3_t maxs, int capsule );
+
+int			CM_PointContentsCtx( cmTraceContext_t *ctx, const vec3_t p, clipHandle_t model );
+int			CM_TransformedPointContentsCtx( cmTraceContext_t *ctx, const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles );
+
+void		CM_BoxTraceCtx( cmTraceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
+						const vec3_t mins, const vec3_t maxs,
+						clipHandle_t model, int brushmask, bool capsule );
+void		CM_TransformedBoxTraceCtx( cmTraceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
+						const vec3_t mins, const vec3_t maxs,
+						clipHandle_t model, int brushmask,
+						const vec3_t origin, const vec3_t angles, bool capsule );
+
+// returns and zeroes statistics of queries without context
+void		CM_TakeTraceCounters( int *traces, int *brushTraces, int *patchTraces, int *pointContents );
+
+void		CM_TraceStress_f( void );
+void		CM_PatchStats_f( void );
+void		CM_NodeBench_f( void );
+
+// cm_capture.c, queries are captured by the server while cm_capturing is set
+extern bool	cm_capturing;
+
+void		CM_CaptureTrace( const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+						int passEntityNum, int contentmask, bool capsule, const trace_t *world, const trace_t *results );
+void		CM_CapturePointContents( const vec3_t p, int passEntityNum, int world, int contents );
+void		CM_StopCapture( void );
+void		CM_Capture_f( void );
+void		CM_Replay_f( void );
+
 byte		*CM_ClusterPVS (int cluster);
 
 int			CM_PointLeafnum( const vec3_t p );
@@ -36,7 +36,7 @@ static int CM_PointLeafnum_r( const vec3_t p, int num ) {
 	while (num >= 0)
 	{
 		node = cm.nodes + num;
-		plane = node->plane;
+		plane = &node->plane;
 		
 		if (plane->type < 3)
 			d = p[plane->type] - plane->dist;
@@ -48,8 +48,6 @@ static int CM_PointLeafnum_r( const vec3_t p, int num ) {
 			num = node->children[0];
 	}
 
-	c_pointcontents++;		// optimize counter
-
 	return -1 - num;
 }
 
@@ -57,6 +55,7 @@ int CM_PointLeafnum( const vec3_t p ) {
 	if ( !cm.numNodes ) {	// map not loaded
 		return 0;
 	}
+	cm.context.pointContents++;		// optimize counter
 	return CM_PointLeafnum_r (p, 0);
 }
 
@@ -100,11 +99,11 @@ void CM_StoreBrushes( leafList_t *ll, int nodenum ) {
 
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
-		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( cm.context.brushChecks[brushnum] == cm.context.checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		cm.context.brushChecks[brushnum] = cm.context.checkcount;
+		b = &cm.brushes[brushnum];
 		for ( i = 0 ; i < 3 ; i++ ) {
 			if ( b->bounds[0][i] >= ll->bounds[1][i] || b->bounds[1][i] <= ll->bounds[0][i] ) {
 				break;
@@ -149,7 +148,7 @@ void CM_BoxLeafnums_r( leafList_t *ll, int nodenum ) {
 		}
 	
 		node = &cm.nodes[nodenum];
-		plane = node->plane;
+		plane = &node->plane;
 		s = BoxOnPlaneSide( ll->bounds[0], ll->bounds[1], plane );
 		if (s == 1) {
 			nodenum = node->children[0];
@@ -172,8 +171,6 @@ CM_BoxLeafnums
 int	CM_BoxLeafnums( const vec3_t mins, const vec3_t maxs, int *list, int listsize, int *lastLeaf) {
 	leafList_t	ll;
 
-	cm.checkcount++;
-
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
 	ll.count = 0;
@@ -197,7 +194,7 @@ CM_BoxBrushes
 int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int listsize ) {
 	leafList_t	ll;
 
-	cm.checkcount++;
+	cm.context.checkcount++;
 
 	VectorCopy( mins, ll.bounds[0] );
 	VectorCopy( maxs, ll.bounds[1] );
@@ -219,28 +216,61 @@ int CM_BoxBrushes( const vec3_t mins, const vec3_t maxs, cbrush_t **list, int li
 
 /*
 ==================
-CM_PointContents
+CM_PointInBrush
+==================
+*/
+static bool CM_PointInBrush( const vec3_t p, const cbrush_t *b ) {
+	int			i;
+	float		d;
+
+	if ( !CM_BoundsIntersectPoint( b->bounds[0], b->bounds[1], p ) ) {
+		return false;
+	}
+
+	// see if the point is in the brush
+	for ( i = 0 ; i < b->numsides ; i++ ) {
+		d = DotProduct( p, b->sides[i].plane->normal );
+// FIXME test for Cash
+//			if ( d >= b->sides[i].plane->dist ) {
+		if ( d > b->sides[i].plane->dist ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+==================
+CM_PointContentsCtx
 
 ==================
 */
-int CM_PointContents( const vec3_t p, clipHandle_t model ) {
+int CM_PointContentsCtx( cmTraceContext_t *ctx, const vec3_t p, clipHandle_t model ) {
 	int			leafnum;
-	int			i, k;
+	int			k;
 	int			brushnum;
 	cLeaf_t		*leaf;
 	cbrush_t	*b;
 	int			contents;
-	float		d;
 	cmodel_t	*clipm;
 
 	if (!cm.numNodes) {	// map not loaded
 		return 0;
 	}
 
+	if ( model == BOX_MODEL_HANDLE ) {
+		// the box brush of the context isn't in the map arrays
+		b = &ctx->boxBrush;
+		return CM_PointInBrush( p, b ) ? b->contents : 0;
+	}
+
 	if ( model ) {
-		clipm = CM_ClipHandleToModel( model );
+		clipm = CM_ClipHandleToModel( ctx, model );
 		leaf = &clipm->leaf;
 	} else {
+		ctx->pointContents++;		// optimize counter
 		leafnum = CM_PointLeafnum_r (p, 0);
 		leaf = &cm.leafs[leafnum];
 	}
@@ -250,21 +280,7 @@ int CM_PointContents( const vec3_t p, clipHandle_t model ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 		b = &cm.brushes[brushnum];
 
-		if ( !CM_BoundsIntersectPoint( b->bounds[0], b->bounds[1], p ) ) {
-			continue;
-		}
-
-		// see if the point is in the brush
-		for ( i = 0 ; i < b->numsides ; i++ ) {
-			d = DotProduct( p, b->sides[i].plane->normal );
-// FIXME test for Cash
-//			if ( d >= b->sides[i].plane->dist ) {
-			if ( d > b->sides[i].plane->dist ) {
-				break;
-			}
-		}
-
-		if ( i == b->numsides ) {
+		if ( CM_PointInBrush( p, b ) ) {
 			contents |= b->contents;
 		}
 	}
@@ -274,13 +290,13 @@ int CM_PointContents( const vec3_t p, clipHandle_t model ) {
 
 /*
 ==================
-CM_TransformedPointContents
+CM_TransformedPointContentsCtx
 
 Handles offsetting and rotation of the end points for moving and
 rotating entities
 ==================
 */
-int	CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles) {
+int	CM_TransformedPointContentsCtx( cmTraceContext_t *ctx, const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles) {
 	vec3_t		p_l;
 	vec3_t		temp;
 	vec3_t		forward, right, up;
@@ -300,7 +316,27 @@ int	CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_
 		p_l[2] = DotProduct (temp, up);
 	}
 
-	return CM_PointContents( p_l, model );
+	return CM_PointContentsCtx( ctx, p_l, model );
+}
+
+
+/*
+==================
+CM_PointContents
+==================
+*/
+int CM_PointContents( const vec3_t p, clipHandle_t model ) {
+	return CM_PointContentsCtx( &cm.context, p, model );
+}
+
+
+/*
+==================
+CM_TransformedPointContents
+==================
+*/
+int CM_TransformedPointContents( const vec3_t p, clipHandle_t model, const vec3_t origin, const vec3_t angles ) {
+	return CM_TransformedPointContentsCtx( &cm.context, p, model, origin, angles );
 }
 
 
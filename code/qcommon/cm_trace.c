@@ -138,6 +138,286 @@ static float SquareRootFloat(float number) {
 }
 
 
+#ifdef CM_SIMD_BRUSHES
+/*
+===============================================================================
+
+VECTORIZED BRUSH TESTS
+
+Side planes are tested two at a time in double precision using the rows
+built by CMod_LoadBrushPlanes. Every value goes through the same double
+operations in the same order as the scalar loops below and is rounded to
+float wherever they store to a float, so results are bit-identical and
+client prediction still matches the server. Float products are exact in
+double, which makes fused multiply-add harmless in the double precision
+sites, but not in the single precision DotProduct of the box offsets, so
+this file is built with -ffp-contract=off.
+
+===============================================================================
+*/
+
+#if idx64
+#include <emmintrin.h>
+
+typedef __m128d		v2d_t;
+typedef __m128d		v2mask_t;
+
+#define V2_Set( x )				_mm_set1_pd( x )
+#define V2_Set2( x, y )			_mm_set_pd( y, x )
+#define V2_False()				_mm_setzero_pd()
+#define V2_LoadFloats( p )		_mm_cvtps_pd( _mm_castsi128_ps( _mm_loadl_epi64( (const __m128i *)(p) ) ) )
+#define V2_Store( p, a )		_mm_storeu_pd( p, a )
+#define V2_Add( a, b )			_mm_add_pd( a, b )
+#define V2_Sub( a, b )			_mm_sub_pd( a, b )
+#define V2_Mul( a, b )			_mm_mul_pd( a, b )
+#define V2_Div( a, b )			_mm_div_pd( a, b )
+#define V2_RoundFloat( a )		_mm_cvtps_pd( _mm_cvtpd_ps( a ) )
+#define V2_Gt( a, b )			_mm_cmpgt_pd( a, b )
+#define V2_Ge( a, b )			_mm_cmpge_pd( a, b )
+#define V2_Lt( a, b )			_mm_cmplt_pd( a, b )
+#define V2_And( a, b )			_mm_and_pd( a, b )
+#define V2_Or( a, b )			_mm_or_pd( a, b )
+#define V2_AndNot( a, b )		_mm_andnot_pd( b, a )
+#define V2_Select( m, a, b )	_mm_or_pd( _mm_and_pd( m, a ), _mm_andnot_pd( m, b ) )
+#define V2_Any( m )				( _mm_movemask_pd( m ) != 0 )
+
+#else // arm64
+#include <arm_neon.h>
+
+typedef float64x2_t	v2d_t;
+typedef uint64x2_t	v2mask_t;
+
+#define V2_Set( x )				vdupq_n_f64( x )
+#define V2_Set2( x, y )			vcombine_f64( vdup_n_f64( x ), vdup_n_f64( y ) )
+#define V2_False()				vdupq_n_u64( 0 )
+#define V2_LoadFloats( p )		vcvt_f64_f32( vld1_f32( p ) )
+#define V2_Store( p, a )		vst1q_f64( p, a )
+#define V2_Add( a, b )			vaddq_f64( a, b )
+#define V2_Sub( a, b )			vsubq_f64( a, b )
+#define V2_Mul( a, b )			vmulq_f64( a, b )
+#define V2_Div( a, b )			vdivq_f64( a, b )
+#define V2_RoundFloat( a )		vcvt_f64_f32( vcvt_f32_f64( a ) )
+#define V2_Gt( a, b )			vcgtq_f64( a, b )
+#define V2_Ge( a, b )			vcgeq_f64( a, b )
+#define V2_Lt( a, b )			vcltq_f64( a, b )
+#define V2_And( a, b )			vandq_u64( a, b )
+#define V2_Or( a, b )			vorrq_u64( a, b )
+#define V2_AndNot( a, b )		vbicq_u64( a, b )
+#define V2_Select( m, a, b )	vbslq_f64( m, a, b )
+#define V2_Any( m )				( ( vgetq_lane_u64( m, 0 ) | vgetq_lane_u64( m, 1 ) ) != 0 )
+
+#endif
+
+// same evaluation order as DotProductDP
+#define V2_Dot( x, y, z, nx, ny, nz )	V2_Add( V2_Add( V2_Mul( x, nx ), V2_Mul( y, ny ) ), V2_Mul( z, nz ) )
+
+typedef struct {
+	float		enterFrac;
+	float		leaveFrac;
+	int			leadSide;		// -1 if no side was entered
+	bool		getout;
+	bool		startout;
+} brushClip_t;
+
+
+/*
+================
+CM_BoxInBrushPlanes
+
+Non-axial side loop of CM_TestBoxInBrush, returns false if
+the start position is in front of any side
+================
+*/
+static bool CM_BoxInBrushPlanes( const traceWork_t *tw, const cbrush_t *brush ) {
+	const float *rows = brush->planes;
+	const int stride = brush->planeStride;
+	const v2d_t zero = V2_Set( 0.0 );
+	v2d_t	nx, ny, nz, dist, d1, t, sx, sy, sz;
+	v2d_t	ox, oy, oz, ax, ay, az, bx, by, bz;
+	v2mask_t m;
+	vec3_t	startp;
+	int		i;
+
+	if ( tw->sphere.use ) {
+		// closest capsule point, start - offset or start + offset
+		VectorSubtract( tw->start, tw->sphere.offset, startp );
+		ax = V2_Set( startp[0] ); ay = V2_Set( startp[1] ); az = V2_Set( startp[2] );
+		VectorAdd( tw->start, tw->sphere.offset, startp );
+		bx = V2_Set( startp[0] ); by = V2_Set( startp[1] ); bz = V2_Set( startp[2] );
+		ox = V2_Set( tw->sphere.offset[0] ); oy = V2_Set( tw->sphere.offset[1] ); oz = V2_Set( tw->sphere.offset[2] );
+
+		for ( i = 6; i < brush->numsides; i += 2 ) {
+			nx = V2_LoadFloats( rows + i );
+			ny = V2_LoadFloats( rows + i + stride );
+			nz = V2_LoadFloats( rows + i + stride * 2 );
+			dist = V2_RoundFloat( V2_Add( V2_LoadFloats( rows + i + stride * 3 ), V2_Set( tw->sphere.radius ) ) );
+
+			t = V2_Dot( nx, ny, nz, ox, oy, oz );
+			m = V2_Gt( t, zero );
+			sx = V2_Select( m, ax, bx );
+			sy = V2_Select( m, ay, by );
+			sz = V2_Select( m, az, bz );
+
+			d1 = V2_Sub( V2_Dot( sx, sy, sz, nx, ny, nz ), dist );
+			if ( V2_Any( V2_Gt( d1, zero ) ) ) {
+				return false;
+			}
+		}
+	} else {
+		// mins and maxs to pick the corner for each plane
+		ax = V2_Set( tw->size[0][0] ); ay = V2_Set( tw->size[0][1] ); az = V2_Set( tw->size[0][2] );
+		bx = V2_Set( tw->size[1][0] ); by = V2_Set( tw->size[1][1] ); bz = V2_Set( tw->size[1][2] );
+		sx = V2_Set( tw->start[0] ); sy = V2_Set( tw->start[1] ); sz = V2_Set( tw->start[2] );
+
+		for ( i = 6; i < brush->numsides; i += 2 ) {
+			nx = V2_LoadFloats( rows + i );
+			ny = V2_LoadFloats( rows + i + stride );
+			nz = V2_LoadFloats( rows + i + stride * 2 );
+
+			ox = V2_Select( V2_Lt( nx, zero ), bx, ax );
+			oy = V2_Select( V2_Lt( ny, zero ), by, ay );
+			oz = V2_Select( V2_Lt( nz, zero ), bz, az );
+
+			// the scalar loop uses single precision DotProduct here
+			t = V2_RoundFloat( V2_Add( V2_RoundFloat( V2_Mul( ox, nx ) ), V2_RoundFloat( V2_Mul( oy, ny ) ) ) );
+			t = V2_RoundFloat( V2_Add( t, V2_RoundFloat( V2_Mul( oz, nz ) ) ) );
+			dist = V2_RoundFloat( V2_Sub( V2_LoadFloats( rows + i + stride * 3 ), t ) );
+
+			d1 = V2_Sub( V2_Dot( sx, sy, sz, nx, ny, nz ), dist );
+			if ( V2_Any( V2_Gt( d1, zero ) ) ) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/*
+================
+CM_TraceThroughBrushPlanes
+
+Side loop of CM_TraceThroughBrush, returns false if the trace
+is completely in front of any side
+================
+*/
+static bool CM_TraceThroughBrushPlanes( const traceWork_t *tw, const cbrush_t *brush, brushClip_t *clip ) {
+	const float *rows = brush->planes;
+	const int stride = brush->planeStride;
+	const v2d_t zero = V2_Set( 0.0 );
+	const v2d_t one = V2_Set( 1.0 );
+	const v2d_t epsilon = V2_Set( SURFACE_CLIP_EPSILON );
+	v2d_t	nx, ny, nz, dist, d1, d2, t, f, denom;
+	v2d_t	sx, sy, sz, ex, ey, ez, ox, oy, oz;
+	v2d_t	ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz;
+	v2d_t	enterFrac, leaveFrac, leadSide, index;
+	v2mask_t getout, startout, m, cross, enter;
+	double	enters[2], leaves[2], leads[2];
+	vec3_t	p;
+	int		i, lane;
+
+	enterFrac = V2_Set( -1.0 );
+	leaveFrac = V2_Set( 1.0 );
+	leadSide = V2_Set( -1.0 );
+	index = V2_Set2( 0.0, 1.0 );
+	getout = V2_False();
+	startout = V2_False();
+
+	// chosen per plane for capsules, per trace for boxes
+	sx = sy = sz = ex = ey = ez = ox = oy = oz = zero;
+
+	if ( tw->sphere.use ) {
+		// closest capsule points, minus or plus offset
+		VectorSubtract( tw->start, tw->sphere.offset, p );
+		ax = V2_Set( p[0] ); ay = V2_Set( p[1] ); az = V2_Set( p[2] );
+		VectorSubtract( tw->end, tw->sphere.offset, p );
+		bx = V2_Set( p[0] ); by = V2_Set( p[1] ); bz = V2_Set( p[2] );
+		VectorAdd( tw->start, tw->sphere.offset, p );
+		cx = V2_Set( p[0] ); cy = V2_Set( p[1] ); cz = V2_Set( p[2] );
+		VectorAdd( tw->end, tw->sphere.offset, p );
+		dx = V2_Set( p[0] ); dy = V2_Set( p[1] ); dz = V2_Set( p[2] );
+		ox = V2_Set( tw->sphere.offset[0] ); oy = V2_Set( tw->sphere.offset[1] ); oz = V2_Set( tw->sphere.offset[2] );
+	} else {
+		// mins and maxs to pick the corner for each plane
+		ax = V2_Set( tw->size[0][0] ); ay = V2_Set( tw->size[0][1] ); az = V2_Set( tw->size[0][2] );
+		bx = V2_Set( tw->size[1][0] ); by = V2_Set( tw->size[1][1] ); bz = V2_Set( tw->size[1][2] );
+		sx = V2_Set( tw->start[0] ); sy = V2_Set( tw->start[1] ); sz = V2_Set( tw->start[2] );
+		ex = V2_Set( tw->end[0] ); ey = V2_Set( tw->end[1] ); ez = V2_Set( tw->end[2] );
+	}
+
+	for ( i = 0; i < brush->numsides; i += 2 ) {
+		nx = V2_LoadFloats( rows + i );
+		ny = V2_LoadFloats( rows + i + stride );
+		nz = V2_LoadFloats( rows + i + stride * 2 );
+
+		if ( tw->sphere.use ) {
+			dist = V2_RoundFloat( V2_Add( V2_LoadFloats( rows + i + stride * 3 ), V2_Set( tw->sphere.radius ) ) );
+
+			t = V2_Dot( nx, ny, nz, ox, oy, oz );
+			m = V2_Gt( t, zero );
+			sx = V2_Select( m, ax, cx );
+			sy = V2_Select( m, ay, cy );
+			sz = V2_Select( m, az, cz );
+			ex = V2_Select( m, bx, dx );
+			ey = V2_Select( m, by, dy );
+			ez = V2_Select( m, bz, dz );
+		} else {
+			ox = V2_Select( V2_Lt( nx, zero ), bx, ax );
+			oy = V2_Select( V2_Lt( ny, zero ), by, ay );
+			oz = V2_Select( V2_Lt( nz, zero ), bz, az );
+			dist = V2_Sub( V2_LoadFloats( rows + i + stride * 3 ), V2_Dot( ox, oy, oz, nx, ny, nz ) );
+		}
+
+		d1 = V2_Sub( V2_Dot( sx, sy, sz, nx, ny, nz ), dist );
+		d2 = V2_Sub( V2_Dot( ex, ey, ez, nx, ny, nz ), dist );
+
+		getout = V2_Or( getout, V2_Gt( d2, zero ) );
+		startout = V2_Or( startout, V2_Gt( d1, zero ) );
+
+		// if completely in front of face, no intersection with the entire brush
+		m = V2_And( V2_Gt( d1, zero ), V2_Or( V2_Ge( d2, epsilon ), V2_Ge( d2, d1 ) ) );
+		if ( V2_Any( m ) ) {
+			return false;
+		}
+
+		// planes that are crossed, padding planes never are
+		cross = V2_Or( V2_Gt( d1, zero ), V2_Gt( d2, zero ) );
+		enter = V2_Gt( d1, d2 );
+		denom = V2_Sub( d1, d2 );
+
+		f = V2_RoundFloat( V2_Div( V2_Sub( d1, epsilon ), denom ) );
+		f = V2_Select( V2_Lt( f, zero ), zero, f );
+		m = V2_And( V2_And( cross, enter ), V2_Gt( f, enterFrac ) );
+		enterFrac = V2_Select( m, f, enterFrac );
+		leadSide = V2_Select( m, index, leadSide );
+
+		f = V2_RoundFloat( V2_Div( V2_Add( d1, epsilon ), denom ) );
+		f = V2_Select( V2_Gt( f, one ), one, f );
+		m = V2_And( V2_AndNot( cross, enter ), V2_Lt( f, leaveFrac ) );
+		leaveFrac = V2_Select( m, f, leaveFrac );
+
+		index = V2_Add( index, V2_Set( 2.0 ) );
+	}
+
+	V2_Store( enters, enterFrac );
+	V2_Store( leaves, leaveFrac );
+	V2_Store( leads, leadSide );
+
+	// the scalar loop keeps the first side with the latest enter fraction
+	lane = ( enters[1] > enters[0] || ( enters[1] == enters[0] && leads[1] < leads[0] ) ) ? 1 : 0;
+
+	clip->enterFrac = enters[ lane ];
+	clip->leadSide = (int)leads[ lane ];
+	clip->leaveFrac = leaves[1] < leaves[0] ? leaves[1] : leaves[0];
+	clip->getout = V2_Any( getout );
+	clip->startout = V2_Any( startout );
+
+	return true;
+}
+#endif // CM_SIMD_BRUSHES
+
+
 /*
 ===============================================================================
 
@@ -175,7 +455,14 @@ static void CM_TestBoxInBrush( traceWork_t *tw, const cbrush_t *brush ) {
 		return;
 	}
 
-   if ( tw->sphere.use ) {
+#ifdef CM_SIMD_BRUSHES
+	if ( brush->planes && !tw->ctx->scalarBrushes ) {
+		if ( !CM_BoxInBrushPlanes( tw, brush ) ) {
+			return;
+		}
+	} else
+#endif
+	if ( tw->sphere.use ) {
 		// the first six planes are the axial planes, so we only
 		// need to test the remainder
 		for ( i = 6 ; i < brush->numsides ; i++ ) {
@@ -226,6 +513,61 @@ static void CM_TestBoxInBrush( traceWork_t *tw, const cbrush_t *brush ) {
 }
 
 
+/*
+================
+CM_TracesEqual
+
+Bitwise comparison, float results must not differ in any bit
+================
+*/
+static bool CM_TracesEqual( const trace_t *ta, const trace_t *tb ) {
+	return ta->allsolid == tb->allsolid
+		&& ta->startsolid == tb->startsolid
+		&& !memcmp( &ta->fraction, &tb->fraction, sizeof( ta->fraction ) )
+		&& !memcmp( ta->endpos, tb->endpos, sizeof( ta->endpos ) )
+		&& !memcmp( ta->plane.normal, tb->plane.normal, sizeof( ta->plane.normal ) )
+		&& !memcmp( &ta->plane.dist, &tb->plane.dist, sizeof( ta->plane.dist ) )
+		&& ta->plane.type == tb->plane.type
+		&& ta->plane.signbits == tb->plane.signbits
+		&& ta->surfaceFlags == tb->surfaceFlags
+		&& ta->contents == tb->contents;
+}
+
+
+#ifdef CM_SIMD_BRUSHES
+/*
+================
+CM_CompareBrushTests
+
+Runs a brush test with the vectorized and with the scalar side loop,
+the query goes on with the scalar result
+================
+*/
+static void CM_CompareBrushTests( traceWork_t *tw, const cbrush_t *brush, void (*test)( traceWork_t *, const cbrush_t * ) ) {
+	trace_t		before, vectorized;
+
+	before = tw->trace;
+	test( tw, brush );
+
+	if ( !brush->planes ) {
+		return;
+	}
+
+	vectorized = tw->trace;
+	tw->trace = before;
+
+	tw->ctx->scalarBrushes = true;
+	test( tw, brush );
+	tw->ctx->scalarBrushes = false;
+
+	tw->ctx->brushCompares++;
+	if ( !CM_TracesEqual( &vectorized, &tw->trace ) ) {
+		tw->ctx->brushMismatches++;
+	}
+}
+#endif
+
+
 /*
 ================
 CM_TestInLeaf
@@ -233,23 +575,28 @@ CM_TestInLeaf
 */
 static void CM_TestInLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 	int			k;
-	int			brushnum;
+	int			brushnum, surfnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
 	// test box position against all brushes in the leaf
 	for (k=0 ; k<leaf->numLeafBrushes ; k++) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
-		b = &cm.brushes[brushnum];
-		if (b->checkcount == cm.checkcount) {
+		if ( tw->ctx->brushChecks[brushnum] == tw->ctx->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->ctx->brushChecks[brushnum] = tw->ctx->checkcount;
+		b = &cm.brushes[brushnum];
 
 		if ( !(b->contents & tw->contents)) {
 			continue;
 		}
 
+#ifdef CM_SIMD_BRUSHES
+		if ( tw->ctx->compareBrushes ) {
+			CM_CompareBrushTests( tw, b, CM_TestBoxInBrush );
+		} else
+#endif
 		CM_TestBoxInBrush( tw, b );
 		if ( tw->trace.allsolid ) {
 			return;
@@ -263,14 +610,15 @@ static void CM_TestInLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif //BSPC
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->ctx->surfaceChecks[surfnum] == tw->ctx->checkcount ) {
 				continue;	// already checked this brush in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->ctx->surfaceChecks[surfnum] = tw->ctx->checkcount;
 
 			if ( !(patch->contents & tw->contents)) {
 				continue;
@@ -287,6 +635,29 @@ static void CM_TestInLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 }
 
 
+/*
+================
+CM_TestInBoxModel
+
+The box brush of the context isn't part of the map, no checkcount needed
+================
+*/
+static void CM_TestInBoxModel( traceWork_t *tw ) {
+	const cbrush_t *b = &tw->ctx->boxBrush;
+
+	if ( !(b->contents & tw->contents) ) {
+		return;
+	}
+
+#ifdef CM_SIMD_BRUSHES
+	if ( tw->ctx->compareBrushes ) {
+		CM_CompareBrushTests( tw, b, CM_TestBoxInBrush );
+	} else
+#endif
+	CM_TestBoxInBrush( tw, b );
+}
+
+
 /*
 ==================
 CM_TestCapsuleInCapsule
@@ -294,15 +665,16 @@ CM_TestCapsuleInCapsule
 capsule inside capsule check
 ==================
 */
-static void CM_TestCapsuleInCapsule( traceWork_t *tw, clipHandle_t model ) {
+static void CM_TestCapsuleInCapsule( traceWork_t *tw ) {
 	int i;
-	vec3_t mins, maxs;
+	const float *mins, *maxs;
 	vec3_t top, bottom;
 	vec3_t p1, p2, tmp;
 	vec3_t offset, symetricSize[2];
 	float radius, halfwidth, halfheight, offs, r;
 
-	CM_ModelBounds(model, mins, maxs);
+	mins = tw->ctx->boxModel.mins;
+	maxs = tw->ctx->boxModel.maxs;
 
 	VectorAdd(tw->start, tw->sphere.offset, top);
 	VectorSubtract(tw->start, tw->sphere.offset, bottom);
@@ -364,14 +736,13 @@ CM_TestBoundingBoxInCapsule
 bounding box inside capsule check
 ==================
 */
-static void CM_TestBoundingBoxInCapsule( traceWork_t *tw, clipHandle_t model ) {
+static void CM_TestBoundingBoxInCapsule( traceWork_t *tw ) {
 	vec3_t mins, maxs, offset, size[2];
-	clipHandle_t h;
-	cmodel_t *cmod;
 	int i;
 
 	// mins maxs of the capsule
-	CM_ModelBounds(model, mins, maxs);
+	VectorCopy( tw->ctx->boxModel.mins, mins );
+	VectorCopy( tw->ctx->boxModel.maxs, maxs );
 
 	// offset for capsule center
 	for ( i = 0 ; i < 3 ; i++ ) {
@@ -389,10 +760,9 @@ static void CM_TestBoundingBoxInCapsule( traceWork_t *tw, clipHandle_t model ) {
 	VectorSet( tw->sphere.offset, 0, 0, size[1][2] - tw->sphere.radius );
 
 	// replace the capsule with the bounding box
-	h = CM_TempBoxModel(tw->size[0], tw->size[1], 0);
+	CM_TempBoxModelCtx( tw->ctx, tw->size[0], tw->size[1], false );
 	// calculate collision
-	cmod = CM_ClipHandleToModel( h );
-	CM_TestInLeaf( tw, &cmod->leaf );
+	CM_TestInBoxModel( tw );
 }
 
 
@@ -423,13 +793,8 @@ static void CM_PositionTest( traceWork_t *tw ) {
 	ll.lastLeaf = 0;
 	ll.overflowed = false;
 
-	cm.checkcount++;
-
 	CM_BoxLeafnums_r( &ll, 0 );
 
-
-	cm.checkcount++;
-
 	// test the contents of the leafs
 	for (i=0 ; i < ll.count ; i++) {
 		CM_TestInLeaf( tw, &cm.leafs[leafs[i]] );
@@ -456,7 +821,7 @@ CM_TraceThroughPatch
 static void CM_TraceThroughPatch( traceWork_t *tw, const cPatch_t *patch ) {
 	float		oldFrac;
 
-	c_patch_traces++;
+	tw->ctx->patchTraces++;
 
 	oldFrac = tw->trace.fraction;
 
@@ -486,6 +851,9 @@ static void CM_TraceThroughBrush( traceWork_t *tw, const cbrush_t *brush ) {
 	double		t;
 	vec3_t		startp;
 	vec3_t		endp;
+#ifdef CM_SIMD_BRUSHES
+	brushClip_t	clip;
+#endif
 
 	enterFrac = -1.0;
 	leaveFrac = 1.0;
@@ -495,13 +863,28 @@ static void CM_TraceThroughBrush( traceWork_t *tw, const cbrush_t *brush ) {
 		return;
 	}
 
-	c_brush_traces++;
+	tw->ctx->brushTraces++;
 
 	getout = false;
 	startout = false;
 
 	leadside = NULL;
 
+#ifdef CM_SIMD_BRUSHES
+	if ( brush->planes && !tw->ctx->scalarBrushes ) {
+		if ( !CM_TraceThroughBrushPlanes( tw, brush, &clip ) ) {
+			return;
+		}
+		enterFrac = clip.enterFrac;
+		leaveFrac = clip.leaveFrac;
+		getout = clip.getout;
+		startout = clip.startout;
+		if ( clip.leadSide >= 0 ) {
+			leadside = brush->sides + clip.leadSide;
+			clipplane = leadside->plane;
+		}
+	} else
+#endif
 	if ( tw->sphere.use ) {
 		//
 		// compare the trace against all planes of the brush
@@ -664,7 +1047,7 @@ CM_TraceThroughLeaf
 */
 static void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 	int			k;
-	int			brushnum;
+	int			brushnum, surfnum;
 	cbrush_t	*b;
 	cPatch_t	*patch;
 
@@ -672,11 +1055,11 @@ static void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 	for ( k = 0 ; k < leaf->numLeafBrushes ; k++ ) {
 		brushnum = cm.leafbrushes[leaf->firstLeafBrush+k];
 
-		b = &cm.brushes[brushnum];
-		if ( b->checkcount == cm.checkcount ) {
+		if ( tw->ctx->brushChecks[brushnum] == tw->ctx->checkcount ) {
 			continue;	// already checked this brush in another leaf
 		}
-		b->checkcount = cm.checkcount;
+		tw->ctx->brushChecks[brushnum] = tw->ctx->checkcount;
+		b = &cm.brushes[brushnum];
 
 		if ( !(b->contents & tw->contents) ) {
 			continue;
@@ -687,6 +1070,11 @@ static void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 			continue;
 		}
 
+#ifdef CM_SIMD_BRUSHES
+		if ( tw->ctx->compareBrushes ) {
+			CM_CompareBrushTests( tw, b, CM_TraceThroughBrush );
+		} else
+#endif
 		CM_TraceThroughBrush( tw, b );
 		if ( !tw->trace.fraction ) {
 			return;
@@ -700,14 +1088,15 @@ static void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 	if ( !cm_noCurves->integer ) {
 #endif
 		for ( k = 0 ; k < leaf->numLeafSurfaces ; k++ ) {
-			patch = cm.surfaces[ cm.leafsurfaces[ leaf->firstLeafSurface + k ] ];
+			surfnum = cm.leafsurfaces[ leaf->firstLeafSurface + k ];
+			patch = cm.surfaces[ surfnum ];
 			if ( !patch ) {
 				continue;
 			}
-			if ( patch->checkcount == cm.checkcount ) {
+			if ( tw->ctx->surfaceChecks[surfnum] == tw->ctx->checkcount ) {
 				continue;	// already checked this patch in another leaf
 			}
-			patch->checkcount = cm.checkcount;
+			tw->ctx->surfaceChecks[surfnum] = tw->ctx->checkcount;
 
 			if ( !(patch->contents & tw->contents) ) {
 				continue;
@@ -723,6 +1112,32 @@ static void CM_TraceThroughLeaf( traceWork_t *tw, const cLeaf_t *leaf ) {
 
 #define RADIUS_EPSILON		1.0f
 
+/*
+================
+CM_TraceThroughBoxModel
+================
+*/
+static void CM_TraceThroughBoxModel( traceWork_t *tw ) {
+	const cbrush_t *b = &tw->ctx->boxBrush;
+
+	if ( !(b->contents & tw->contents) ) {
+		return;
+	}
+
+	if ( !CM_BoundsIntersect( tw->bounds[0], tw->bounds[1],
+				b->bounds[0], b->bounds[1] ) ) {
+		return;
+	}
+
+#ifdef CM_SIMD_BRUSHES
+	if ( tw->ctx->compareBrushes ) {
+		CM_CompareBrushTests( tw, b, CM_TraceThroughBrush );
+	} else
+#endif
+	CM_TraceThroughBrush( tw, b );
+}
+
+
 /*
 ================
 CM_TraceThroughSphere
@@ -925,14 +1340,15 @@ CM_TraceCapsuleThroughCapsule
 capsule vs. capsule collision (not rotated)
 ================
 */
-static void CM_TraceCapsuleThroughCapsule( traceWork_t *tw, clipHandle_t model ) {
+static void CM_TraceCapsuleThroughCapsule( traceWork_t *tw ) {
 	int i;
-	vec3_t mins, maxs;
+	const float *mins, *maxs;
 	vec3_t top, bottom, starttop, startbottom, endtop, endbottom;
 	vec3_t offset, symetricSize[2];
 	float radius, halfwidth, halfheight, offs, h;
 
-	CM_ModelBounds(model, mins, maxs);
+	mins = tw->ctx->boxModel.mins;
+	maxs = tw->ctx->boxModel.maxs;
 	// test trace bounds vs. capsule bounds
 	if ( tw->bounds[0][0] > maxs[0] + RADIUS_EPSILON
 		|| tw->bounds[0][1] > maxs[1] + RADIUS_EPSILON
@@ -988,14 +1404,13 @@ CM_TraceBoundingBoxThroughCapsule
 bounding box vs. capsule collision
 ================
 */
-static void CM_TraceBoundingBoxThroughCapsule( traceWork_t *tw, clipHandle_t model ) {
+static void CM_TraceBoundingBoxThroughCapsule( traceWork_t *tw ) {
 	vec3_t mins, maxs, offset, size[2];
-	clipHandle_t h;
-	cmodel_t *cmod;
 	int i;
 
 	// mins maxs of the capsule
-	CM_ModelBounds(model, mins, maxs);
+	VectorCopy( tw->ctx->boxModel.mins, mins );
+	VectorCopy( tw->ctx->boxModel.maxs, maxs );
 
 	// offset for capsule center
 	for ( i = 0 ; i < 3 ; i++ ) {
@@ -1013,10 +1428,9 @@ static void CM_TraceBoundingBoxThroughCapsule( traceWork_t *tw, clipHandle_t mod
 	VectorSet( tw->sphere.offset, 0, 0, size[1][2] - tw->sphere.radius );
 
 	// replace the capsule with the bounding box
-	h = CM_TempBoxModel(tw->size[0], tw->size[1], false);
+	CM_TempBoxModelCtx( tw->ctx, tw->size[0], tw->size[1], false );
 	// calculate collision
-	cmod = CM_ClipHandleToModel( h );
-	CM_TraceThroughLeaf( tw, &cmod->leaf );
+	CM_TraceThroughBoxModel( tw );
 }
 
 //=========================================================================================
@@ -1056,7 +1470,7 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 	// and the offset for the size of the box
 	//
 	node = cm.nodes + num;
-	plane = node->plane;
+	plane = &node->plane;
 
 	// adjust the plane distance appropriately for mins/maxs
 	if ( plane->type < 3 ) {
@@ -1141,21 +1555,22 @@ static void CM_TraceThroughTree( traceWork_t *tw, int num, float p1f, float p2f,
 CM_Trace
 ==================
 */
-static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
+static void CM_Trace( cmTraceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs,
 						clipHandle_t model, const vec3_t origin, int brushmask, bool capsule, const sphere_t *sphere ) {
 	int			i;
 	traceWork_t	tw;
 	vec3_t		offset;
 	cmodel_t	*cmod;
 
-	cmod = CM_ClipHandleToModel( model );
+	cmod = CM_ClipHandleToModel( ctx, model );
 
-	cm.checkcount++;		// for multi-check avoidance
+	ctx->checkcount++;		// for multi-check avoidance
 
-	c_traces++;				// for statistics, may be zeroed
+	ctx->traces++;			// for statistics, may be zeroed
 
 	// fill in a default trace
 	Com_Memset( &tw, 0, sizeof(tw) );
+	tw.ctx = ctx;
 	tw.trace.fraction = 1;	// assume it goes the entire distance until shown otherwise
 	VectorCopy(origin, tw.modelOrigin);
 
@@ -1267,23 +1682,26 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 #ifdef ALWAYS_BBOX_VS_BBOX // FIXME - compile time flag?
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
 				tw.sphere.use = false;
-				CM_TestInLeaf( &tw, &cmod->leaf );
+				CM_TestInBoxModel( &tw );
 			}
 			else
 #elif defined(ALWAYS_CAPSULE_VS_CAPSULE)
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
-				CM_TestCapsuleInCapsule( &tw, model );
+				CM_TestCapsuleInCapsule( &tw );
 			}
 			else
 #endif
 			if ( model == CAPSULE_MODEL_HANDLE ) {
 				if ( tw.sphere.use ) {
-					CM_TestCapsuleInCapsule( &tw, model );
+					CM_TestCapsuleInCapsule( &tw );
 				}
 				else {
-					CM_TestBoundingBoxInCapsule( &tw, model );
+					CM_TestBoundingBoxInCapsule( &tw );
 				}
 			}
+			else if ( model == BOX_MODEL_HANDLE ) {
+				CM_TestInBoxModel( &tw );
+			}
 			else {
 				CM_TestInLeaf( &tw, &cmod->leaf );
 			}
@@ -1311,23 +1729,26 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 #ifdef ALWAYS_BBOX_VS_BBOX
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
 				tw.sphere.use = false;
-				CM_TraceThroughLeaf( &tw, &cmod->leaf );
+				CM_TraceThroughBoxModel( &tw );
 			}
 			else
 #elif defined(ALWAYS_CAPSULE_VS_CAPSULE)
 			if ( model == BOX_MODEL_HANDLE || model == CAPSULE_MODEL_HANDLE) {
-				CM_TraceCapsuleThroughCapsule( &tw, model );
+				CM_TraceCapsuleThroughCapsule( &tw );
 			}
 			else
 #endif
 			if ( model == CAPSULE_MODEL_HANDLE ) {
 				if ( tw.sphere.use ) {
-					CM_TraceCapsuleThroughCapsule( &tw, model );
+					CM_TraceCapsuleThroughCapsule( &tw );
 				}
 				else {
-					CM_TraceBoundingBoxThroughCapsule( &tw, model );
+					CM_TraceBoundingBoxThroughCapsule( &tw );
 				}
 			}
+			else if ( model == BOX_MODEL_HANDLE ) {
+				CM_TraceThroughBoxModel( &tw );
+			}
 			else {
 				CM_TraceThroughLeaf( &tw, &cmod->leaf );
 			}
@@ -1357,25 +1778,25 @@ static void CM_Trace( trace_t *results, const vec3_t start, const vec3_t end, co
 
 /*
 ==================
-CM_BoxTrace
+CM_BoxTraceCtx
 ==================
 */
-void CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
+void CM_BoxTraceCtx( cmTraceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
 						const vec3_t mins, const vec3_t maxs,
 						clipHandle_t model, int brushmask, bool capsule ) {
-	CM_Trace( results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
+	CM_Trace( ctx, results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
 }
 
 
 /*
 ==================
-CM_TransformedBoxTrace
+CM_TransformedBoxTraceCtx
 
 Handles offsetting and rotation of the end points for moving and
 rotating entities
 ==================
 */
-void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
+void CM_TransformedBoxTraceCtx( cmTraceContext_t *ctx, trace_t *results, const vec3_t start, const vec3_t end,
 						const vec3_t mins, const vec3_t maxs,
 						clipHandle_t model, int brushmask,
 						const vec3_t origin, const vec3_t angles, bool capsule ) {
@@ -1449,7 +1870,7 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 	}
 
 	// sweep the box through the model
-	CM_Trace( &trace, start_l, end_l, symetricSize[0], symetricSize[1], model, origin, brushmask, capsule, &sphere );
+	CM_Trace( ctx, &trace, start_l, end_l, symetricSize[0], symetricSize[1], model, origin, brushmask, capsule, &sphere );
 
 	// if the bmodel was rotated and there was a collision
 	if ( rotated && trace.fraction != 1.0 ) {
@@ -1466,3 +1887,367 @@ void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t
 
 	*results = trace;
 }
+
+
+/*
+==================
+CM_BoxTrace
+==================
+*/
+void CM_BoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
+						const vec3_t mins, const vec3_t maxs,
+						clipHandle_t model, int brushmask, bool capsule ) {
+	CM_Trace( &cm.context, results, start, end, mins, maxs, model, vec3_origin, brushmask, capsule, NULL );
+}
+
+
+/*
+==================
+CM_TransformedBoxTrace
+==================
+*/
+void CM_TransformedBoxTrace( trace_t *results, const vec3_t start, const vec3_t end,
+						const vec3_t mins, const vec3_t maxs,
+						clipHandle_t model, int brushmask,
+						const vec3_t origin, const vec3_t angles, bool capsule ) {
+	CM_TransformedBoxTraceCtx( &cm.context, results, start, end, mins, maxs, model, brushmask, origin, angles, capsule );
+}
+
+
+/*
+===============================================================================
+
+CONCURRENCY STRESS TEST
+
+===============================================================================
+*/
+
+#define STRESS_QUERIES		65536
+#define STRESS_ROUNDS		4
+#define MAX_STRESS_SLICES	64
+
+typedef struct {
+	vec3_t			start, end;
+	vec3_t			mins, maxs;
+	vec3_t			origin, angles;
+	clipHandle_t	model;
+	int				brushmask;
+	bool			capsule;
+	bool			tempBox;		// model is an entity box built in the context
+	bool			tempCapsule;
+	vec3_t			boxMins, boxMaxs;
+} cmStressQuery_t;
+
+typedef struct {
+	trace_t			trace;
+	int				contents;
+} cmStressResult_t;
+
+typedef struct {
+	const cmStressQuery_t	*queries;
+	cmStressResult_t		*results;
+	cmTraceContext_t		*contexts[ MAX_STRESS_SLICES ];
+	int						numQueries;
+	int						numSlices;
+} cmStressJob_t;
+
+
+/*
+==================
+CM_RunStressQuery
+==================
+*/
+static void CM_RunStressQuery( cmTraceContext_t *ctx, const cmStressQuery_t *q, cmStressResult_t *r ) {
+	clipHandle_t model;
+
+	model = q->model;
+	if ( q->tempBox ) {
+		model = CM_TempBoxModelCtx( ctx, q->boxMins, q->boxMaxs, q->tempCapsule );
+	}
+
+	if ( model ) {
+		CM_TransformedBoxTraceCtx( ctx, &r->trace, q->start, q->end, q->mins, q->maxs, model,
+			q->brushmask, q->origin, q->angles, q->capsule );
+		if ( q->tempBox ) {
+			// the capsule traces above may have replaced the box
+			model = CM_TempBoxModelCtx( ctx, q->boxMins, q->boxMaxs, q->tempCapsule );
+		}
+		r->contents = CM_TransformedPointContentsCtx( ctx, q->end, model, q->origin, q->angles );
+	} else {
+		CM_BoxTraceCtx( ctx, &r->trace, q->start, q->end, q->mins, q->maxs, 0, q->brushmask, q->capsule );
+		r->contents = CM_PointContentsCtx( ctx, q->end, 0 );
+	}
+}
+
+
+/*
+==================
+CM_StressJob
+
+Runs a contiguous slice of queries with the context of the slice
+==================
+*/
+static void CM_StressJob( void *data, int slice ) {
+	const cmStressJob_t *job = (const cmStressJob_t *)data;
+	int i, first, last;
+
+	first = (int)( (int64_t)job->numQueries * slice / job->numSlices );
+	last = (int)( (int64_t)job->numQueries * ( slice + 1 ) / job->numSlices );
+
+	for ( i = first; i < last; i++ ) {
+		CM_RunStressQuery( job->contexts[ slice ], &job->queries[ i ], &job->results[ i ] );
+	}
+}
+
+
+/*
+==================
+CM_StressResultsEqual
+
+Bitwise comparison, float results must not differ in any bit
+==================
+*/
+static bool CM_StressResultsEqual( const cmStressResult_t *a, const cmStressResult_t *b ) {
+	return a->contents == b->contents && CM_TracesEqual( &a->trace, &b->trace );
+}
+
+
+/*
+==================
+CM_MakeStressQuery
+
+Random sweeps through the world, inline models and entity boxes,
+mixing points, boxes, capsules and position tests
+==================
+*/
+static void CM_MakeStressQuery( cmStressQuery_t *q, int *seed ) {
+	static const int masks[3] = { CONTENTS_SOLID, CONTENTS_SOLID | CONTENTS_PLAYERCLIP | CONTENTS_BODY, -1 };
+	const float *mins, *maxs;
+	float size;
+	int i, r;
+
+	Com_Memset( q, 0, sizeof( *q ) );
+
+	if ( cm.numSubModels > 1 && ( Q_rand( seed ) & 3 ) == 0 ) {
+		q->model = 1 + ( Q_rand( seed ) & 0x7fff ) % ( cm.numSubModels - 1 );
+		for ( i = 0; i < 3; i++ ) {
+			q->origin[i] = Q_crandom( seed ) * 64;
+		}
+		if ( Q_rand( seed ) & 1 ) {
+			q->angles[YAW] = Q_random( seed ) * 360;
+		}
+	} else if ( ( Q_rand( seed ) & 7 ) == 0 ) {
+		q->tempBox = true;
+		q->tempCapsule = ( Q_rand( seed ) & 3 ) == 0;
+		size = 8 + Q_random( seed ) * 24;
+		VectorSet( q->boxMins, -size, -size, -24 );
+		VectorSet( q->boxMaxs, size, size, 32 );
+		for ( i = 0; i < 3; i++ ) {
+			q->origin[i] = Q_crandom( seed ) * 64;
+		}
+	}
+
+	if ( q->tempBox ) {
+		mins = q->boxMins;
+		maxs = q->boxMaxs;
+	} else {
+		mins = cm.cmodels[ q->model ].mins;
+		maxs = cm.cmodels[ q->model ].maxs;
+	}
+
+	for ( i = 0; i < 3; i++ ) {
+		q->start[i] = q->origin[i] + mins[i] - 64 + Q_random( seed ) * ( maxs[i] - mins[i] + 128 );
+		q->end[i] = q->start[i] + Q_crandom( seed ) * 512;
+	}
+
+	r = ( Q_rand( seed ) & 0x7fff ) % 10;
+	if ( r == 0 ) {
+		VectorCopy( q->start, q->end );
+	}
+
+	r = ( Q_rand( seed ) & 0x7fff ) % 3;
+	if ( r == 1 ) {
+		VectorSet( q->mins, -15, -15, -24 );
+		VectorSet( q->maxs, 15, 15, 32 );
+	} else if ( r == 2 ) {
+		size = 1 + Q_random( seed ) * 31;
+		VectorSet( q->mins, -size, -size, -size );
+		VectorSet( q->maxs, size, size, size * 2 );
+	}
+
+	q->capsule = r && ( ( Q_rand( seed ) & 0x7fff ) % 10 ) == 0;
+	q->brushmask = masks[ ( Q_rand( seed ) & 0x7fff ) % 3 ];
+}
+
+
+/*
+==================
+CM_CompareBrushPaths
+
+Runs every brush test of the queries through the vectorized and the
+scalar side loops and counts the tests whose traces differ in any bit
+==================
+*/
+static void CM_CompareBrushPaths( const cmStressQuery_t *queries, int numQueries ) {
+#ifdef CM_SIMD_BRUSHES
+	cmTraceContext_t *ctx;
+	cmStressResult_t result;
+	int i, mismatches, firstMismatch;
+
+	ctx = CM_CreateTraceContext();
+	ctx->compareBrushes = true;
+
+	firstMismatch = -1;
+	for ( i = 0; i < numQueries; i++ ) {
+		mismatches = ctx->brushMismatches;
+		CM_RunStressQuery( ctx, &queries[i], &result );
+		if ( firstMismatch < 0 && ctx->brushMismatches != mismatches ) {
+			firstMismatch = i;
+		}
+	}
+
+	Com_Printf( "%i queries, %i brush tests compared\n", numQueries, ctx->brushCompares );
+	if ( ctx->brushMismatches ) {
+		const cmStressQuery_t *q = &queries[ firstMismatch ];
+		Com_Printf( S_COLOR_RED "%i mismatched results, first: query %i model %i (%.1f %.1f %.1f) -> (%.1f %.1f %.1f)\n",
+			ctx->brushMismatches, firstMismatch, q->model, q->start[0], q->start[1], q->start[2], q->end[0], q->end[1], q->end[2] );
+	} else {
+		Com_Printf( "all brush tests match\n" );
+	}
+
+	CM_FreeTraceContext( ctx );
+#else
+	Com_Printf( "Vectorized brush tests are not compiled in.\n" );
+#endif
+}
+
+
+/*
+==================
+CM_TraceStress_f
+
+Runs the same random queries on the main thread without context and
+concurrently with one context per slice, results must be identical.
+With "simd" the queries instead cross-check the brush side loops.
+==================
+*/
+void CM_TraceStress_f( void ) {
+	cmStressQuery_t *queries;
+	cmStressResult_t *serial, *parallel;
+	cmStressJob_t job;
+	int64_t start, serialTime, parallelTime;
+	int numQueries, rounds, threads, mismatches, firstMismatch, hits;
+	int i, n, seed, arg;
+	bool simd;
+
+	if ( !cm.numNodes ) {
+		Com_Printf( "No map loaded.\n" );
+		return;
+	}
+
+	simd = ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "simd" ) );
+	arg = simd ? 2 : 1;
+
+	numQueries = STRESS_QUERIES;
+	if ( Cmd_Argc() > arg ) {
+		numQueries = atoi( Cmd_Argv( arg ) );
+	}
+	rounds = STRESS_ROUNDS;
+	if ( !simd && Cmd_Argc() > arg + 1 ) {
+		rounds = atoi( Cmd_Argv( arg + 1 ) );
+	}
+	if ( numQueries <= 0 || rounds <= 0 ) {
+		Com_Printf( "usage: cm_traceStress [queries] [rounds]\n"
+			"       cm_traceStress simd [queries]\n" );
+		return;
+	}
+
+	if ( simd ) {
+		queries = Z_Malloc( numQueries * sizeof( *queries ) );
+		seed = 0x1d2c3b4a;
+		for ( i = 0; i < numQueries; i++ ) {
+			CM_MakeStressQuery( &queries[i], &seed );
+		}
+		CM_CompareBrushPaths( queries, numQueries );
+		Z_Free( queries );
+		return;
+	}
+
+	queries = Z_Malloc( numQueries * sizeof( *queries ) );
+	serial = Z_Malloc( numQueries * sizeof( *serial ) );
+	parallel = Z_Malloc( numQueries * sizeof( *parallel ) );
+
+	seed = 0x1d2c3b4a;
+	for ( i = 0; i < numQueries; i++ ) {
+		CM_MakeStressQuery( &queries[i], &seed );
+	}
+
+	start = Sys_Microseconds();
+	for ( i = 0; i < numQueries; i++ ) {
+		CM_RunStressQuery( &cm.context, &queries[i], &serial[i] );
+	}
+	serialTime = Sys_Microseconds() - start;
+
+	hits = 0;
+	for ( i = 0; i < numQueries; i++ ) {
+		if ( serial[i].trace.fraction < 1.0f || serial[i].trace.startsolid ) {
+			hits++;
+		}
+	}
+
+	threads = Com_JobThreads();
+
+	job.queries = queries;
+	job.results = parallel;
+	job.numQueries = numQueries;
+	job.numSlices = MIN( threads * 4, MAX_STRESS_SLICES );
+	for ( i = 0; i < job.numSlices; i++ ) {
+		job.contexts[i] = CM_CreateTraceContext();
+	}
+
+	mismatches = 0;
+	firstMismatch = -1;
+	parallelTime = 0;
+	for ( n = 0; n < rounds; n++ ) {
+		Com_Memset( parallel, 0, numQueries * sizeof( *parallel ) );
+
+		start = Sys_Microseconds();
+		Com_ParallelFor( CM_StressJob, &job, job.numSlices );
+		parallelTime += Sys_Microseconds() - start;
+
+		for ( i = 0; i < numQueries; i++ ) {
+			if ( !CM_StressResultsEqual( &serial[i], &parallel[i] ) ) {
+				if ( firstMismatch < 0 ) {
+					firstMismatch = i;
+				}
+				mismatches++;
+			}
+		}
+	}
+
+	for ( i = 0; i < job.numSlices; i++ ) {
+		CM_FreeTraceContext( job.contexts[i] );
+	}
+
+	if ( serialTime <= 0 ) {
+		serialTime = 1;
+	}
+	if ( parallelTime <= 0 ) {
+		parallelTime = 1;
+	}
+
+	Com_Printf( "%i queries (%i hits), %i rounds on %i threads\n", numQueries, hits, rounds, threads );
+	Com_Printf( "serial:   %8.0f queries/sec\n", numQueries * 1e6 / serialTime );
+	Com_Printf( "parallel: %8.0f queries/sec\n", (double)numQueries * rounds * 1e6 / parallelTime );
+	if ( mismatches ) {
+		const cmStressQuery_t *q = &queries[ firstMismatch ];
+		Com_Printf( S_COLOR_RED "%i mismatched results, first: query %i model %i (%.1f %.1f %.1f) -> (%.1f %.1f %.1f)\n",
+			mismatches, firstMismatch, q->model, q->start[0], q->start[1], q->start[2], q->end[0], q->end[1], q->end[2] );
+	} else {
+		Com_Printf( "all results match\n" );
+	}
+
+	Z_Free( parallel );
+	Z_Free( serial );
+	Z_Free( queries );
+}
@@ -977,6 +977,10 @@ all big things are allocated on the hunk.
 #define USE_STATIC_TAGS
 #define USE_TRASH_TEST
 
+#define	SLABID			0x1d4a12	// id of small blocks allocated from slab pages
+#define SLAB_MAX_SIZE	512
+#define SLAB_PAGE_SIZE	16384
+
 #ifdef ZONE_DEBUG
 typedef struct zonedebug_s {
 	const char *label;
@@ -1302,6 +1306,360 @@ static void MergeBlock( memblock_t *curr_free, const memblock_t *next )
 }
 
 
+/*
+==============================================================================
+
+						SLAB ALLOCATOR
+
+Main zone allocations up to SLAB_MAX_SIZE bytes are served from per size
+class pages which are allocated from the main zone with TAG_SLAB. That keeps
+short-lived strings and structures from fragmenting the zone and makes both
+allocation and freeing constant time. TAG_SMALL allocations stay in the small
+zone, which is too small to hold a page of every class.
+
+Every slab object has a regular memblock_t header, with SLABID instead of
+ZONEID and the owning page in the prev field, so Z_Free, tags and the trash
+tester work the same way for both kinds of blocks.
+
+Pages of a class are kept in a circular list with pages that have free
+objects first. An empty page is released back to the zone unless it is the
+last page of its class.
+
+==============================================================================
+*/
+
+typedef struct slabpage_s {
+	struct slabpage_s	*next, *prev;
+	struct slabclass_s	*cls;
+	memblock_t	*freelist;
+	int			used;		// objects in use
+} slabpage_t;
+
+typedef struct slabclass_s {
+	slabpage_t	*pages;		// pages with free objects come first
+	int			size;		// largest allocation size of this class
+	int			blockSize;	// including the header and the trash tester
+	int			perPage;
+	int			numPages;
+	int			used;
+	int			peak;
+	int			allocs;		// total number of allocations
+} slabclass_t;
+
+static const int slabSizes[] = { 16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512 };
+
+#define NUM_SLAB_CLASSES ARRAY_LEN( slabSizes )
+
+static slabclass_t slabClasses[ NUM_SLAB_CLASSES ];
+static byte slabIndex[ SLAB_MAX_SIZE / 16 + 1 ];	// class of ( size + 15 ) / 16
+static bool slabsEnabled;
+
+#define SLAB_HEADER_SIZE	PAD( sizeof( slabpage_t ), sizeof( intptr_t ) )
+#define SLAB_OBJECTS( page ) ( (byte *)( page ) + SLAB_HEADER_SIZE )
+
+
+/*
+========================
+Z_InitSlabs
+========================
+*/
+static void Z_InitSlabs( void ) {
+	slabclass_t *cls;
+	int i, n, size;
+
+	Com_Memset( slabClasses, 0, sizeof( slabClasses ) );
+
+	for ( i = 0, n = 0; i < ARRAY_LEN( slabIndex ); i++ ) {
+		if ( i * 16 > slabSizes[ n ] ) {
+			n++;
+		}
+		slabIndex[ i ] = n;
+	}
+
+	for ( i = 0; i < NUM_SLAB_CLASSES; i++ ) {
+		cls = &slabClasses[ i ];
+		size = slabSizes[ i ] + sizeof( memblock_t );
+#ifdef USE_TRASH_TEST
+		size += 4;
+#endif
+		cls->size = slabSizes[ i ];
+		cls->blockSize = PAD( size, sizeof( intptr_t ) );
+		cls->perPage = ( SLAB_PAGE_SIZE - SLAB_HEADER_SIZE ) / cls->blockSize;
+	}
+
+	slabsEnabled = true;
+}
+
+
+/*
+========================
+Z_NewSlabPage
+
+Allocates a page from the main zone and puts it at the list head
+========================
+*/
+static slabpage_t *Z_NewSlabPage( slabclass_t *cls ) {
+	slabpage_t *page;
+	memblock_t *block;
+	byte *obj;
+	int i;
+
+	page = Z_TagMalloc( SLAB_PAGE_SIZE, TAG_SLAB );
+	page->cls = cls;
+	page->used = 0;
+	page->freelist = NULL;
+
+	// link objects so that lower addresses are used first
+	obj = SLAB_OBJECTS( page ) + ( cls->perPage - 1 ) * cls->blockSize;
+	for ( i = 0; i < cls->perPage; i++, obj -= cls->blockSize ) {
+		block = (memblock_t *)obj;
+		block->next = page->freelist;
+		block->prev = (memblock_t *)page;
+		block->size = cls->blockSize;
+		block->tag = TAG_FREE;
+		block->id = SLABID;
+		page->freelist = block;
+	}
+
+	if ( cls->pages ) {
+		page->next = cls->pages;
+		page->prev = cls->pages->prev;
+		page->next->prev = page;
+		page->prev->next = page;
+	} else {
+		page->next = page->prev = page;
+	}
+	cls->pages = page;
+	cls->numPages++;
+
+	return page;
+}
+
+
+/*
+========================
+Z_SlabAlloc
+========================
+*/
+static memblock_t *Z_SlabAlloc( int size, memtag_t tag ) {
+	slabclass_t *cls;
+	slabpage_t *page;
+	memblock_t *block;
+
+	cls = &slabClasses[ slabIndex[ ( size + 15 ) >> 4 ] ];
+
+	page = cls->pages;
+	if ( page == NULL || page->freelist == NULL ) {
+		page = Z_NewSlabPage( cls );
+	}
+
+	block = page->freelist;
+	page->freelist = block->next;
+	page->used++;
+
+	// full pages go to the end of the list
+	if ( page->freelist == NULL ) {
+		cls->pages = page->next;
+	}
+
+	cls->allocs++;
+	if ( ++cls->used > cls->peak ) {
+		cls->peak = cls->used;
+	}
+
+	block->next = NULL;
+	block->tag = tag;
+
+#ifdef USE_TRASH_TEST
+	*(int *)((byte *)block + block->size - 4) = ZONEID;
+#endif
+
+	return block;
+}
+
+
+/*
+========================
+Z_SlabPageFreed
+
+Releases the page if it became empty or moves it to
+the list head if it was full before objects were freed
+========================
+*/
+static void Z_SlabPageFreed( slabpage_t *page, bool wasFull ) {
+	slabclass_t *cls = page->cls;
+
+	if ( page->used == 0 && cls->numPages > 1 ) {
+		if ( cls->pages == page ) {
+			cls->pages = page->next;
+		}
+		page->prev->next = page->next;
+		page->next->prev = page->prev;
+		cls->numPages--;
+		Z_Free( page );
+		return;
+	}
+
+	if ( wasFull && cls->pages != page ) {
+		page->prev->next = page->next;
+		page->next->prev = page->prev;
+		page->next = cls->pages;
+		page->prev = cls->pages->prev;
+		page->next->prev = page;
+		page->prev->next = page;
+		cls->pages = page;
+	}
+}
+
+
+/*
+========================
+Z_SlabFreeBlock
+========================
+*/
+static void Z_SlabFreeBlock( memblock_t *block ) {
+	slabpage_t *page = (slabpage_t *)block->prev;
+
+	Com_Memset( block + 1, 0xaa, block->size - sizeof( *block ) );
+
+	block->tag = TAG_FREE;
+	block->next = page->freelist;
+	page->freelist = block;
+	page->used--;
+	page->cls->used--;
+}
+
+
+/*
+========================
+Z_SlabFree
+========================
+*/
+static void Z_SlabFree( memblock_t *block ) {
+	slabpage_t *page = (slabpage_t *)block->prev;
+	bool wasFull = ( page->freelist == NULL );
+
+	Z_SlabFreeBlock( block );
+	Z_SlabPageFreed( page, wasFull );
+}
+
+
+/*
+========================
+Z_SlabFreeTags
+========================
+*/
+static int Z_SlabFreeTags( memtag_t tag ) {
+	slabclass_t *cls;
+	slabpage_t *page, *next;
+	memblock_t *block;
+	bool wasFull;
+	int i, j, n, count;
+
+	count = 0;
+	for ( i = 0; i < NUM_SLAB_CLASSES; i++ ) {
+		cls = &slabClasses[ i ];
+		page = cls->pages;
+		// pages may be released or moved to the list head,
+		// so walk the original list with saved next pointers
+		for ( n = cls->numPages; n > 0; n--, page = next ) {
+			next = page->next;
+			wasFull = ( page->freelist == NULL );
+			for ( j = 0; j < cls->perPage; j++ ) {
+				block = (memblock_t *)( SLAB_OBJECTS( page ) + j * cls->blockSize );
+				if ( block->tag == tag ) {
+					Z_SlabFreeBlock( block );
+					count++;
+				}
+			}
+			Z_SlabPageFreed( page, wasFull );
+		}
+	}
+
+	return count;
+}
+
+
+/*
+==============================================================================
+
+Allocation trace, "zonetrace <file>" records every Z_TagMalloc and Z_Free
+call until "zonetrace" is called again, "zonereplay <file>" replays it with
+and without slabs. Records are kept in malloc'ed memory so recording does
+not affect the zone itself, and replay runs in scratch zones sized from the
+trace so the live zones are left alone.
+
+==============================================================================
+*/
+
+#define ZONETRACE_MAGIC		0x43525a5a	// "ZZRC"
+#define ZONETRACE_VERSION	1
+
+// stored little endian
+typedef struct {
+	int		size;		// -1 for Z_Free
+	int		tag;
+	int		ptrLow;
+	int		ptrHigh;
+} zoneTraceRecord_t;
+
+static struct {
+	zoneTraceRecord_t *records;
+	int			numRecords;
+	int			maxRecords;
+	bool		active;
+	bool		overflow;
+	char		name[ MAX_OSPATH ];
+} zoneTrace;
+
+
+/*
+========================
+Z_TraceRecord
+========================
+*/
+static void Z_TraceRecord( const void *ptr, int size, memtag_t tag ) {
+	zoneTraceRecord_t *rec;
+	uint64_t p;
+
+	if ( tag == TAG_SLAB ) {
+		return;
+	}
+
+	if ( zoneTrace.numRecords == zoneTrace.maxRecords ) {
+		rec = realloc( zoneTrace.records, ( zoneTrace.maxRecords * 2 + 65536 ) * sizeof( *rec ) );
+		if ( rec == NULL ) {
+			zoneTrace.active = false;
+			zoneTrace.overflow = true;
+			return;
+		}
+		zoneTrace.records = rec;
+		zoneTrace.maxRecords = zoneTrace.maxRecords * 2 + 65536;
+	}
+
+	p = (uint64_t)(intptr_t)ptr;
+	rec = &zoneTrace.records[ zoneTrace.numRecords++ ];
+	rec->size = LittleLong( size );
+	rec->tag = LittleLong( tag );
+	rec->ptrLow = LittleLong( (int)( p & 0xFFFFFFFF ) );
+	rec->ptrHigh = LittleLong( (int)( p >> 32 ) );
+}
+
+
+static void Z_TraceAlloc( const void *ptr, int size, memtag_t tag ) {
+	if ( zoneTrace.active ) {
+		Z_TraceRecord( ptr, size, tag );
+	}
+}
+
+
+static void Z_TraceFree( const void *ptr, memtag_t tag ) {
+	if ( zoneTrace.active ) {
+		Z_TraceRecord( ptr, -1, tag );
+	}
+}
+
+
 /*
 ========================
 Z_Free
@@ -1316,7 +1674,7 @@ void Z_Free( void *ptr ) {
 	}
 
 	block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	if (block->id != ZONEID) {
+	if (block->id != ZONEID && block->id != SLABID) {
 		Com_Error( ERR_FATAL, "Z_Free: freed a pointer without ZONEID" );
 	}
 
@@ -1338,6 +1696,13 @@ void Z_Free( void *ptr ) {
 	}
 #endif
 
+	Z_TraceFree( ptr, block->tag );
+
+	if ( block->id == SLABID ) {
+		Z_SlabFree( block );
+		return;
+	}
+
 	if ( block->tag == TAG_SMALL ) {
 		zone = smallzone;
 	} else {
@@ -1406,7 +1771,7 @@ int Z_FreeTags( memtag_t tag ) {
 		zone = mainzone;
 	}
 
-	count = 0;
+	count = ( zone == mainzone ) ? Z_SlabFreeTags( tag ) : 0;
 	for ( block = zone->blocklist.next ; ; ) {
 		if ( block->tag == tag && block->id == ZONEID ) {
 			if ( block->prev->tag == TAG_FREE )
@@ -1434,10 +1799,10 @@ Z_TagMalloc
 */
 #ifdef ZONE_DEBUG
 void *Z_TagMallocDebug( int size, memtag_t tag, char *label, char *file, int line ) {
-	int		allocSize;
 #else
 void *Z_TagMalloc( int size, memtag_t tag ) {
 #endif
+	int		allocSize;
 	int		extra;
 #ifndef USE_MULTI_SEGMENT
 	memblock_t	*start, *rover;
@@ -1449,15 +1814,29 @@ void *Z_TagMalloc( int size, memtag_t tag ) {
 		Com_Error( ERR_FATAL, "Z_TagMalloc: tried to use with TAG_FREE" );
 	}
 
+	if ( size < 0 ) {
+		Com_Error( ERR_FATAL, "Z_TagMalloc: bad size %i", size );
+	}
+
 	if ( tag == TAG_SMALL ) {
 		zone = smallzone;
 	} else {
 		zone = mainzone;
 	}
 
-#ifdef ZONE_DEBUG
 	allocSize = size;
+
+	if ( size <= SLAB_MAX_SIZE && slabsEnabled && zone == mainzone ) {
+		base = Z_SlabAlloc( size, tag );
+#ifdef ZONE_DEBUG
+		base->d.label = label;
+		base->d.file = file;
+		base->d.line = line;
+		base->d.allocSize = allocSize;
 #endif
+		Z_TraceAlloc( base + 1, allocSize, tag );
+		return (void *) ( base + 1 );
+	}
 
 #ifdef USE_MULTI_SEGMENT
 	if ( size < (sizeof( freeblock_t ) ) ) {
@@ -1547,6 +1926,8 @@ void *Z_TagMalloc( int size, memtag_t tag ) {
 	*(int *)((byte *)base + base->size - 4) = ZONEID;
 #endif
 
+	Z_TraceAlloc( base + 1, allocSize, tag );
+
 	return (void *) ( base + 1 );
 }
 
@@ -1631,11 +2012,30 @@ static void Z_CheckHeap( void ) {
 Z_LogZoneHeap
 ========================
 */
-static void Z_LogZoneHeap( memzone_t *zone, const char *name ) {
 #ifdef ZONE_DEBUG
-	char dump[32], *ptr;
-	int  i, j;
+static void Z_LogBlock( const memblock_t *block ) {
+	char dump[32], buf[4096];
+	const char *ptr;
+	int  i, j, len;
+
+	ptr = ((const char *) block) + sizeof(memblock_t);
+	j = 0;
+	for (i = 0; i < 20 && i < block->d.allocSize; i++) {
+		if (ptr[i] >= 32 && ptr[i] < 127) {
+			dump[j++] = ptr[i];
+		}
+		else {
+			dump[j++] = '_';
+		}
+	}
+	dump[j] = '\0';
+	len = Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
+	FS_Write( buf, len, logfile );
+}
 #endif
+
+
+static void Z_LogZoneHeap( memzone_t *zone, const char *name ) {
 	memblock_t	*block;
 	char		buf[4096];
 	int size, allocSize, numBlocks;
@@ -1653,19 +2053,7 @@ static void Z_LogZoneHeap( memzone_t *zone, const char *name ) {
 	for ( block = zone->blocklist.next ; ; ) {
 		if ( block->tag != TAG_FREE ) {
 #ifdef ZONE_DEBUG
-			ptr = ((char *) block) + sizeof(memblock_t);
-			j = 0;
-			for (i = 0; i < 20 && i < block->d.allocSize; i++) {
-				if (ptr[i] >= 32 && ptr[i] < 127) {
-					dump[j++] = ptr[i];
-				}
-				else {
-					dump[j++] = '_';
-				}
-			}
-			dump[j] = '\0';
-			len = Com_sprintf(buf, sizeof(buf), "size = %8d: %s, line: %d (%s) [%s]\r\n", block->d.allocSize, block->d.file, block->d.line, block->d.label, dump);
-			FS_Write( buf, len, logfile );
+			Z_LogBlock( block );
 			allocSize += block->d.allocSize;
 #endif
 			size += block->size;
@@ -1690,6 +2078,46 @@ static void Z_LogZoneHeap( memzone_t *zone, const char *name ) {
 }
 
 
+/*
+========================
+Z_LogSlabHeap
+========================
+*/
+static void Z_LogSlabHeap( void ) {
+	const slabclass_t *cls;
+	const slabpage_t *page;
+	const memblock_t *block;
+	char		buf[4096];
+	int size, numBlocks;
+	int i, j, n, len;
+
+	if ( logfile == FS_INVALID_HANDLE || !FS_Initialized() )
+		return;
+
+	size = numBlocks = 0;
+	len = Com_sprintf( buf, sizeof(buf), "\r\n================\r\nSLAB log\r\n================\r\n" );
+	FS_Write( buf, len, logfile );
+	for ( i = 0; i < NUM_SLAB_CLASSES; i++ ) {
+		cls = &slabClasses[ i ];
+		for ( n = 0, page = cls->pages; n < cls->numPages; n++, page = page->next ) {
+			for ( j = 0; j < cls->perPage; j++ ) {
+				block = (const memblock_t *)( SLAB_OBJECTS( page ) + j * cls->blockSize );
+				if ( block->tag != TAG_FREE ) {
+#ifdef ZONE_DEBUG
+					Z_LogBlock( block );
+#endif
+					size += block->size;
+					numBlocks++;
+				}
+			}
+		}
+	}
+	len = Com_sprintf( buf, sizeof( buf ), "%d SLAB memory in %d blocks\r\n", size, numBlocks );
+	FS_Write( buf, len, logfile );
+	FS_Flush( logfile );
+}
+
+
 /*
 ========================
 Z_LogHeap
@@ -1698,6 +2126,7 @@ Z_LogHeap
 void Z_LogHeap( void ) {
 	Z_LogZoneHeap( mainzone, "MAIN" );
 	Z_LogZoneHeap( smallzone, "SMALL" );
+	Z_LogSlabHeap();
 }
 
 #ifdef USE_STATIC_TAGS
@@ -1829,7 +2258,8 @@ static const char *tagName[ TAG_COUNT ] = {
 	"RENDERER",
 	"CLIENTS",
 	"SMALL",
-	"STATIC"
+	"STATIC",
+	"SLAB"
 };
 
 typedef struct zone_stats_s {
@@ -1842,6 +2272,7 @@ typedef struct zone_stats_s {
 	int freeBlocks;
 	int freeSmallest;
 	int freeLargest;
+	int slabBytes;
 } zone_stats_t;
 
 
@@ -1866,7 +2297,23 @@ static void Zone_Stats( const char *name, const memzone_t *z, bool printDetails,
 			Com_Printf( "block:%p  size:%8i  tag: %s\n", (void *)block, block->size,
 				(unsigned)tag < TAG_COUNT ? tagName[ tag ] : va( "%i", tag ) );
 		}
-		if ( block->tag != TAG_FREE ) {
+		if ( block->tag == TAG_SLAB ) {
+			// count slab objects in use by their tags
+			const slabpage_t *page = (const slabpage_t *)( block + 1 );
+			const memblock_t *obj;
+			int i;
+			st.zoneBytes += block->size;
+			st.zoneBlocks++;
+			st.slabBytes += block->size;
+			for ( i = 0; i < page->cls->perPage; i++ ) {
+				obj = (const memblock_t *)( SLAB_OBJECTS( page ) + i * page->cls->blockSize );
+				if ( obj->tag == TAG_BOTLIB ) {
+					st.botlibBytes += obj->size;
+				} else if ( obj->tag == TAG_RENDERER ) {
+					st.rendererBytes += obj->size;
+				}
+			}
+		} else if ( block->tag != TAG_FREE ) {
 			st.zoneBytes += block->size;
 			st.zoneBlocks++;
 			if ( block->tag == TAG_BOTLIB ) {
@@ -1915,62 +2362,478 @@ static void Zone_Stats( const char *name, const memzone_t *z, bool printDetails,
 }
 
 
+static void Hunk_LogScratch( fileHandle_t f );
+
 /*
 =================
 Com_Meminfo_f
 =================
 */
 static void Com_Meminfo_f( void ) {
+	const slabclass_t *cls;
 	zone_stats_t st;
 	int		unused;
+	int		i, total;
+
+	Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i low mark\n", hunk_low.mark );
+	Com_Printf( "%8i low permanent\n", hunk_low.permanent );
+	if ( hunk_low.temp != hunk_low.permanent ) {
+		Com_Printf( "%8i low temp\n", hunk_low.temp );
+	}
+	Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i high mark\n", hunk_high.mark );
+	Com_Printf( "%8i high permanent\n", hunk_high.permanent );
+	if ( hunk_high.temp != hunk_high.permanent ) {
+		Com_Printf( "%8i high temp\n", hunk_high.temp );
+	}
+	Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
+	Com_Printf( "\n" );
+	Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
+	unused = 0;
+	if ( hunk_low.tempHighwater > hunk_low.permanent ) {
+		unused += hunk_low.tempHighwater - hunk_low.permanent;
+	}
+	if ( hunk_high.tempHighwater > hunk_high.permanent ) {
+		unused += hunk_high.tempHighwater - hunk_high.permanent;
+	}
+	Com_Printf( "%8i unused highwater\n", unused );
+	Com_Printf( "\n" );
+
+	Hunk_LogScratch( FS_INVALID_HANDLE );
+	Com_Printf( "\n" );
+
+	Zone_Stats( "main", mainzone, !Q_stricmp( Cmd_Argv(1), "main" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
+	Com_Printf( "%8i bytes total main zone\n\n", mainzone->size );
+	Com_Printf( "%8i bytes in %i main zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
+		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
+	Com_Printf( "        %8i bytes in botlib\n", st.botlibBytes );
+	Com_Printf( "        %8i bytes in renderer\n", st.rendererBytes );
+	Com_Printf( "        %8i bytes in other\n", st.zoneBytes - ( st.botlibBytes + st.rendererBytes ) );
+	Com_Printf( "        %8i bytes in slab pages\n", st.slabBytes );
+	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
+	if ( st.freeBlocks > 1 ) {
+		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
+	}
+
+	Zone_Stats( "small", smallzone, !Q_stricmp( Cmd_Argv(1), "small" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
+	Com_Printf( "%8i bytes total small zone\n\n", smallzone->size );
+	Com_Printf( "%8i bytes in %i small zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
+		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
+	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
+	if ( st.freeBlocks > 1 ) {
+		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
+	}
+
+	Com_Printf( "slab  pages    used   total  occupancy    peak     allocs\n" );
+	for ( i = 0; i < NUM_SLAB_CLASSES; i++ ) {
+		cls = &slabClasses[ i ];
+		if ( !cls->allocs ) {
+			continue;
+		}
+		total = cls->numPages * cls->perPage;
+		Com_Printf( "%4i %6i %7i %7i %9.1f%% %7i %10i\n", cls->size, cls->numPages, cls->used, total,
+			total ? cls->used * 100.0 / total : 0.0, cls->peak, cls->allocs );
+	}
+}
+
+/*
+=================
+Com_ZoneTrace_f
+=================
+*/
+static void Com_ZoneTrace_f( void ) {
+	fileHandle_t f;
+	int		header[2];
+	int		numRecords;
+
+	if ( zoneTrace.active || zoneTrace.overflow ) {
+		// stop recording before the file system allocates anything
+		zoneTrace.active = false;
+		numRecords = zoneTrace.numRecords;
+
+		if ( zoneTrace.overflow ) {
+			Com_Printf( S_COLOR_YELLOW "Zone trace stopped after %i calls, out of memory.\n", numRecords );
+		}
+
+		f = FS_SV_FOpenFileWrite( zoneTrace.name );
+		if ( f == FS_INVALID_HANDLE ) {
+			Com_Printf( S_COLOR_YELLOW "Couldn't open %s for writing.\n", zoneTrace.name );
+		} else {
+			header[0] = LittleLong( ZONETRACE_MAGIC );
+			header[1] = LittleLong( ZONETRACE_VERSION );
+			FS_Write( header, sizeof( header ), f );
+			FS_Write( zoneTrace.records, numRecords * sizeof( zoneTraceRecord_t ), f );
+			FS_FCloseFile( f );
+			Com_Printf( "Wrote %i zone calls to %s\n", numRecords, zoneTrace.name );
+		}
+
+		free( zoneTrace.records );
+		Com_Memset( &zoneTrace, 0, sizeof( zoneTrace ) );
+
+		if ( Cmd_Argc() < 2 ) {
+			return;
+		}
+	}
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: zonetrace <file> to start recording, zonetrace to stop\n" );
+		return;
+	}
+
+	Q_strncpyz( zoneTrace.name, Cmd_Argv( 1 ), sizeof( zoneTrace.name ) );
+	zoneTrace.active = true;
+
+	Com_Printf( "Recording zone calls to %s\n", zoneTrace.name );
+}
+
+
+typedef struct {
+	int		size;		// -1 for Z_Free
+	int		tag;
+	int		slot;
+} zoneReplayOp_t;
+
+
+/*
+=================
+Com_LoadZoneTrace
+
+Converts recorded pointers to slot numbers, frees of blocks
+allocated before recording started are dropped
+=================
+*/
+static zoneReplayOp_t *Com_LoadZoneTrace( const char *name, int *numOps, int *numSlots ) {
+	zoneTraceRecord_t *records;
+	zoneReplayOp_t *ops;
+	uint64_t *keys, ptr;
+	int		*values;
+	int		header[2];
+	int		i, len, numRecords, size, tag;
+	unsigned int mask, h;
+	fileHandle_t f;
+
+	len = FS_SV_FOpenFileRead( name, &f );
+	if ( f == FS_INVALID_HANDLE ) {
+		Com_Printf( "Couldn't open %s\n", name );
+		return NULL;
+	}
+
+	if ( len < (int)sizeof( header ) || FS_Read( header, sizeof( header ), f ) != sizeof( header )
+		|| LittleLong( header[0] ) != ZONETRACE_MAGIC || LittleLong( header[1] ) != ZONETRACE_VERSION ) {
+		Com_Printf( "%s is not a zone trace\n", name );
+		FS_FCloseFile( f );
+		return NULL;
+	}
+
+	numRecords = ( len - sizeof( header ) ) / sizeof( zoneTraceRecord_t );
+	records = malloc( numRecords * sizeof( *records ) + 1 );
+	ops = malloc( numRecords * sizeof( *ops ) + 1 );
+	for ( mask = 1; mask < numRecords * 2; mask <<= 1 )
+		;
+	keys = calloc( mask, sizeof( *keys ) );
+	values = malloc( mask * sizeof( *values ) );
+	mask--;
+
+	if ( !records || !ops || !keys || !values ) {
+		Com_Printf( S_COLOR_YELLOW "Not enough memory to load %s\n", name );
+		free( records ); free( ops ); free( keys ); free( values );
+		FS_FCloseFile( f );
+		return NULL;
+	}
+
+	FS_Read( records, numRecords * sizeof( *records ), f );
+	FS_FCloseFile( f );
+
+	*numOps = 0;
+	*numSlots = 0;
+	for ( i = 0; i < numRecords; i++ ) {
+		size = LittleLong( records[i].size );
+		tag = LittleLong( records[i].tag );
+		ptr = (uint64_t)(unsigned int)LittleLong( records[i].ptrLow ) | ( (uint64_t)LittleLong( records[i].ptrHigh ) << 32 );
+
+		h = (unsigned int)( ( ptr >> 3 ) * 0x9E3779B97F4A7C15ULL >> 32 ) & mask;
+		while ( keys[h] && keys[h] != ptr ) {
+			h = ( h + 1 ) & mask;
+		}
+
+		if ( size >= 0 ) {
+			if ( tag <= TAG_FREE || tag >= TAG_COUNT || tag == TAG_STATIC || tag == TAG_SLAB || size > ( 64 << 20 ) ) {
+				continue;
+			}
+			keys[h] = ptr;
+			values[h] = *numSlots;
+			ops[*numOps].size = size;
+			ops[*numOps].tag = tag;
+			ops[*numOps].slot = (*numSlots)++;
+			(*numOps)++;
+		} else if ( keys[h] && values[h] >= 0 ) {
+			ops[*numOps].size = -1;
+			ops[*numOps].tag = 0;
+			ops[*numOps].slot = values[h];
+			values[h] = -1;
+			(*numOps)++;
+		}
+	}
+
+	free( values );
+	free( keys );
+	free( records );
+
+	return ops;
+}
+
+
+/*
+=================
+Com_ZoneTracePeak
+
+Returns the largest amount of memory the trace keeps allocated at once
+from the main and from the small zone, including block headers
+=================
+*/
+static void Com_ZoneTracePeak( const zoneReplayOp_t *ops, int numOps, int numSlots, int64_t *peak ) {
+	int64_t	live[2];
+	int		*sizes;
+	int		i, z, size;
+
+	live[0] = live[1] = 0;
+	peak[0] = peak[1] = 0;
+
+	// block size of each slot, negative for the small zone
+	sizes = calloc( numSlots + 1, sizeof( *sizes ) );
+	if ( !sizes ) {
+		peak[0] = peak[1] = -1;
+		return;
+	}
+
+	for ( i = 0; i < numOps; i++ ) {
+		if ( ops[i].size >= 0 ) {
+			size = PAD( ops[i].size + sizeof( memblock_t ) + 4, sizeof( intptr_t ) );
+			z = ( ops[i].tag == TAG_SMALL );
+			sizes[ ops[i].slot ] = z ? -size : size;
+			live[z] += size;
+			if ( live[z] > peak[z] ) {
+				peak[z] = live[z];
+			}
+		} else {
+			size = sizes[ ops[i].slot ];
+			z = ( size < 0 );
+			live[z] -= abs( size );
+		}
+	}
+
+	free( sizes );
+}
+
+
+/*
+=================
+Com_NewReplayZone
+=================
+*/
+static memzone_t *Com_NewReplayZone( int size ) {
+	memzone_t *zone;
+
+	zone = calloc( size, 1 );
+	if ( zone ) {
+		Z_ClearZone( zone, zone, size, 1 );
+	}
+
+	return zone;
+}
+
+
+/*
+=================
+Com_FreeReplayZone
+
+Releases the zone together with the segments it has grown
+=================
+*/
+static void Com_FreeReplayZone( memzone_t *zone ) {
+#ifdef USE_MULTI_SEGMENT
+	memblock_t *block, *next, *segment;
+
+	// blocks of a segment follow its separator, so the previous
+	// segment can go as soon as the next separator is reached
+	segment = NULL;
+	for ( block = zone->blocklist.next; block != &zone->blocklist; block = next ) {
+		next = block->next;
+		if ( block->id == -ZONEID ) {
+			free( segment );
+			segment = block;
+		}
+	}
+	free( segment );
+#endif
+	free( zone );
+}
+
+
+/*
+=================
+Com_ReplayZoneOps
+
+Replays the trace into scratch zones, so the live zones and slabs are
+neither touched nor grown. Returns elapsed microseconds, -1 if the
+scratch zones ran out of memory
+=================
+*/
+static int64_t Com_ReplayZoneOps( const zoneReplayOp_t *ops, int numOps, void **ptrs, const int *zoneSize, zone_stats_t *st ) {
+	slabclass_t	liveSlabs[ NUM_SLAB_CLASSES ];
+	memzone_t *liveMain, *liveSmall;
+	memzone_t *zone;
+	int64_t	start, elapsed;
+	int		i;
+
+	liveMain = mainzone;
+	liveSmall = smallzone;
+
+	mainzone = Com_NewReplayZone( zoneSize[0] );
+	smallzone = Com_NewReplayZone( zoneSize[1] );
+	if ( !mainzone || !smallzone ) {
+		free( mainzone );
+		free( smallzone );
+		mainzone = liveMain;
+		smallzone = liveSmall;
+		Com_Printf( S_COLOR_YELLOW "Not enough memory for replay zones\n" );
+		return -1;
+	}
+
+	// start with empty slab classes, pages come from the scratch zone
+	Com_Memcpy( liveSlabs, slabClasses, sizeof( liveSlabs ) );
+	for ( i = 0; i < NUM_SLAB_CLASSES; i++ ) {
+		slabClasses[i].pages = NULL;
+		slabClasses[i].numPages = 0;
+		slabClasses[i].used = 0;
+		slabClasses[i].peak = 0;
+		slabClasses[i].allocs = 0;
+	}
+
+	elapsed = 0;
+	start = Sys_Microseconds();
+	for ( i = 0; i < numOps; i++ ) {
+		if ( ops[i].size >= 0 ) {
+			zone = ( ops[i].tag == TAG_SMALL ) ? smallzone : mainzone;
+			if ( Z_AvailableZoneMemory( zone ) < ops[i].size + SLAB_PAGE_SIZE ) {
+				elapsed = -1;
+				break;
+			}
+			ptrs[ ops[i].slot ] = Z_TagMalloc( ops[i].size, ops[i].tag );
+		} else {
+			Z_Free( ptrs[ ops[i].slot ] );
+		}
+	}
+
+	if ( elapsed == 0 ) {
+		elapsed = Sys_Microseconds() - start;
+		// state of the zone at the end of the trace
+		Zone_Stats( "main", mainzone, false, st );
+	}
+
+	Com_FreeReplayZone( mainzone );
+	Com_FreeReplayZone( smallzone );
+
+	mainzone = liveMain;
+	smallzone = liveSmall;
+	Com_Memcpy( slabClasses, liveSlabs, sizeof( liveSlabs ) );
+
+	if ( elapsed < 0 ) {
+		Com_Printf( S_COLOR_YELLOW "Replay zones ran out of memory at zone call %i of %i\n", i, numOps );
+	}
+
+	return elapsed;
+}
+
+
+/*
+=================
+Com_ZoneReplay_f
+
+Replays a zone trace with and without slabs
+=================
+*/
+static void Com_ZoneReplay_f( void ) {
+	zoneReplayOp_t *ops;
+	zone_stats_t st[2];
+	int64_t	best[2], peak[2], t;
+	void	**ptrs;
+	int		zoneSize[2];
+	int		numOps, numSlots, passes;
+	int		i, mode;
+	bool	slabs;
+
+	if ( Cmd_Argc() < 2 ) {
+		Com_Printf( "usage: zonereplay <file> [passes]\n" );
+		return;
+	}
 
-	Com_Printf( "%8i bytes total hunk\n", s_hunkTotal );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i low mark\n", hunk_low.mark );
-	Com_Printf( "%8i low permanent\n", hunk_low.permanent );
-	if ( hunk_low.temp != hunk_low.permanent ) {
-		Com_Printf( "%8i low temp\n", hunk_low.temp );
+	if ( zoneTrace.active ) {
+		Com_Printf( "Stop zone recording first.\n" );
+		return;
 	}
-	Com_Printf( "%8i low tempHighwater\n", hunk_low.tempHighwater );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i high mark\n", hunk_high.mark );
-	Com_Printf( "%8i high permanent\n", hunk_high.permanent );
-	if ( hunk_high.temp != hunk_high.permanent ) {
-		Com_Printf( "%8i high temp\n", hunk_high.temp );
+
+	passes = atoi( Cmd_Argv( 2 ) );
+	if ( passes <= 0 ) {
+		passes = 3;
 	}
-	Com_Printf( "%8i high tempHighwater\n", hunk_high.tempHighwater );
-	Com_Printf( "\n" );
-	Com_Printf( "%8i total hunk in use\n", hunk_low.permanent + hunk_high.permanent );
-	unused = 0;
-	if ( hunk_low.tempHighwater > hunk_low.permanent ) {
-		unused += hunk_low.tempHighwater - hunk_low.permanent;
+
+	ops = Com_LoadZoneTrace( Cmd_Argv( 1 ), &numOps, &numSlots );
+	if ( !ops ) {
+		return;
 	}
-	if ( hunk_high.tempHighwater > hunk_high.permanent ) {
-		unused += hunk_high.tempHighwater - hunk_high.permanent;
+
+	// room for fragmentation and for the slab pages of every class
+	Com_ZoneTracePeak( ops, numOps, numSlots, peak );
+	for ( i = 0; i < 2; i++ ) {
+		if ( peak[i] < 0 || peak[i] > ( 512 << 20 ) ) {
+			Com_Printf( S_COLOR_YELLOW "%s needs too much memory to replay\n", Cmd_Argv( 1 ) );
+			free( ops );
+			return;
+		}
+		zoneSize[i] = peak[i] * 2 + NUM_SLAB_CLASSES * SLAB_PAGE_SIZE * 2 + sizeof( memzone_t );
 	}
-	Com_Printf( "%8i unused highwater\n", unused );
-	Com_Printf( "\n" );
 
-	Zone_Stats( "main", mainzone, !Q_stricmp( Cmd_Argv(1), "main" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
-	Com_Printf( "%8i bytes total main zone\n\n", mainzone->size );
-	Com_Printf( "%8i bytes in %i main zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
-		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
-	Com_Printf( "        %8i bytes in botlib\n", st.botlibBytes );
-	Com_Printf( "        %8i bytes in renderer\n", st.rendererBytes );
-	Com_Printf( "        %8i bytes in other\n", st.zoneBytes - ( st.botlibBytes + st.rendererBytes ) );
-	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
-	if ( st.freeBlocks > 1 ) {
-		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
+	ptrs = calloc( numSlots + 1, sizeof( ptrs[0] ) );
+	if ( !ptrs ) {
+		free( ops );
+		return;
 	}
 
-	Zone_Stats( "small", smallzone, !Q_stricmp( Cmd_Argv(1), "small" ) || !Q_stricmp( Cmd_Argv(1), "all" ), &st );
-	Com_Printf( "%8i bytes total small zone\n\n", smallzone->size );
-	Com_Printf( "%8i bytes in %i small zone blocks%s\n", st.zoneBytes, st.zoneBlocks,
-		st.zoneSegments > 1 ? va( " and %i segments", st.zoneSegments ) : "" );
-	Com_Printf( "        %8i bytes in %i free blocks\n", st.freeBytes, st.freeBlocks );
-	if ( st.freeBlocks > 1 ) {
-		Com_Printf( "        (largest: %i bytes, smallest: %i bytes)\n\n", st.freeLargest, st.freeSmallest );
+	slabs = slabsEnabled;
+	best[0] = best[1] = 0;
+
+	for ( i = 0; i < passes; i++ ) {
+		for ( mode = 0; mode < 2; mode++ ) {
+			slabsEnabled = ( mode == 0 );
+			t = Com_ReplayZoneOps( ops, numOps, ptrs, zoneSize, &st[ mode ] );
+			if ( t < 0 ) {
+				break;
+			}
+			if ( i == 0 || t < best[ mode ] ) {
+				best[ mode ] = t;
+			}
+		}
+		if ( mode < 2 ) {
+			break;
+		}
+	}
+
+	slabsEnabled = slabs;
+
+	if ( i == passes ) {
+		Com_Printf( "%i zone calls, %i allocations, best of %i passes\n", numOps, numSlots, passes );
+		for ( mode = 0; mode < 2; mode++ ) {
+			Com_Printf( "%s %6.2f msec, %5.1f nsec per call, %i main zone free blocks\n", mode == 0 ? "slabs:" : "zone: ",
+				best[ mode ] / 1000.0, numOps ? best[ mode ] * 1000.0 / numOps : 0.0, st[ mode ].freeBlocks );
+		}
 	}
+
+	free( ptrs );
+	free( ops );
 }
 
 
@@ -2074,6 +2937,8 @@ static void Com_InitZoneMemory( void ) {
 		Com_Error( ERR_FATAL, "Zone data failed to allocate %i megs", mainZoneSize / (1024*1024) );
 	}
 	Z_ClearZone( mainzone, mainzone, mainZoneSize, 1 );
+
+	Z_InitSlabs();
 }
 
 
@@ -2106,6 +2971,7 @@ void Hunk_Log( void ) {
 	FS_Write(buf, strlen(buf), logfile);
 	Com_sprintf(buf, sizeof(buf), "%d hunk blocks\r\n", numBlocks);
 	FS_Write(buf, strlen(buf), logfile);
+	Hunk_LogScratch(logfile);
 }
 
 
@@ -2159,6 +3025,398 @@ void Hunk_SmallLog( void ) {
 #endif
 
 
+/*
+==============================================================================
+
+SCRATCH ARENAS
+
+Every thread that asks for scratch memory gets its own bump allocator, so
+worker threads can use short lived buffers without touching the hunk temp
+stack, which belongs to the main thread. Allocations are released together
+with Hunk_ScratchReset() to a mark taken by Hunk_ScratchMark().
+
+Arenas have a fixed size and their own allocation, made before the file
+system starts so the startup pk3 scan can already use them. They are meant
+for small temporaries, SCRATCH_SIZE at most; anything that may be larger must
+be ready to fall back to another allocator when Hunk_AllocScratch() returns
+NULL.
+A thread claims an arena on its first allocation and gives it back with
+Hunk_ReleaseScratch() before it exits.
+
+Nothing here may print or error out, running out of scratch memory only
+returns NULL and is counted. With HUNK_DEBUG every allocation is followed
+by a guard word that is checked on reset, overwritten guards are counted
+and reported by meminfo and hunklog.
+
+==============================================================================
+*/
+
+#define MAX_SCRATCH_ARENAS	20
+#define SCRATCH_SIZE		0x40000		// 256 KB per arena
+#define SCRATCH_ALIGN		16
+#define SCRATCH_MAGIC		0x5c7a7c11
+#define SCRATCH_GUARD		0xfd5c4a7e
+
+typedef struct {
+	byte		*base;
+	int			size;
+	int			used;
+	int			peak;
+	bool		claimed;
+
+	int			allocs;
+	int			failed;			// requests that didn't fit
+	int			failedLargest;
+	int			overruns;		// overwritten guards, HUNK_DEBUG only
+	int			overrunSize;	// size of the last overrun allocation
+} scratchArena_t;
+
+#ifdef HUNK_DEBUG
+typedef struct {
+	unsigned int	magic;
+	int				size;
+	int				pad[2];
+} scratchHeader_t;
+#endif
+
+static scratchArena_t		s_scratch[ MAX_SCRATCH_ARENAS ];
+static void					*s_scratchMutex;
+static THREADLOCAL scratchArena_t *s_threadScratch;
+
+
+/*
+=================
+Hunk_InitScratch
+
+Called before the file system is started
+=================
+*/
+static void Hunk_InitScratch( void ) {
+	byte *base;
+	int i;
+
+	base = calloc( MAX_SCRATCH_ARENAS * SCRATCH_SIZE + 63, 1 );
+	if ( !base ) {
+		Com_Error( ERR_FATAL, "Scratch arenas failed to allocate %i bytes", MAX_SCRATCH_ARENAS * SCRATCH_SIZE );
+	}
+
+	// cacheline align
+	base = PADP( base, 64 );
+
+	for ( i = 0; i < MAX_SCRATCH_ARENAS; i++ ) {
+		s_scratch[i].base = base + i * SCRATCH_SIZE;
+		s_scratch[i].size = SCRATCH_SIZE;
+	}
+
+	s_scratchMutex = Sys_CreateMutex();
+}
+
+
+/*
+=================
+Hunk_ClaimScratch
+=================
+*/
+static scratchArena_t *Hunk_ClaimScratch( void ) {
+	scratchArena_t *arena;
+	int i;
+
+	if ( s_scratchMutex ) {
+		Sys_LockMutex( s_scratchMutex );
+	}
+
+	arena = NULL;
+	for ( i = 0; i < MAX_SCRATCH_ARENAS; i++ ) {
+		if ( s_scratch[i].base && !s_scratch[i].claimed ) {
+			arena = &s_scratch[i];
+			arena->claimed = true;
+			arena->used = 0;
+			break;
+		}
+	}
+
+	if ( s_scratchMutex ) {
+		Sys_UnlockMutex( s_scratchMutex );
+	}
+
+	return arena;
+}
+
+
+#ifdef HUNK_DEBUG
+/*
+=================
+Hunk_CheckScratch
+
+Checks guards of allocations above the mark
+=================
+*/
+static void Hunk_CheckScratch( scratchArena_t *arena, int mark ) {
+	const scratchHeader_t *hdr;
+	unsigned int guard;
+	int offset;
+
+	offset = mark;
+	while ( offset < arena->used ) {
+		hdr = (const scratchHeader_t *)( arena->base + offset );
+		if ( hdr->magic != SCRATCH_MAGIC ) {
+			// header was overwritten by the previous allocation, can't walk further
+			arena->overruns++;
+			return;
+		}
+		Com_Memcpy( &guard, (const byte *)( hdr + 1 ) + hdr->size, sizeof( guard ) );
+		if ( guard != SCRATCH_GUARD ) {
+			arena->overruns++;
+			arena->overrunSize = hdr->size;
+		}
+		offset += PAD( sizeof( *hdr ) + hdr->size + sizeof( guard ), SCRATCH_ALIGN );
+	}
+}
+#endif
+
+
+/*
+=================
+Hunk_AllocScratch
+
+Returns NULL if the arena of the calling thread is exhausted
+=================
+*/
+void *Hunk_AllocScratch( int size ) {
+	scratchArena_t *arena;
+	byte *buf;
+	int need;
+
+	arena = s_threadScratch;
+	if ( !arena ) {
+		arena = s_threadScratch = Hunk_ClaimScratch();
+		if ( !arena ) {
+			return NULL;
+		}
+	}
+
+	// reject huge sizes before padding can overflow
+	need = -1;
+	if ( size >= 0 && size <= arena->size - arena->used ) {
+#ifdef HUNK_DEBUG
+		need = PAD( sizeof( scratchHeader_t ) + size + sizeof( unsigned int ), SCRATCH_ALIGN );
+#else
+		need = PAD( size, SCRATCH_ALIGN );
+#endif
+	}
+
+	if ( need < 0 || need > arena->size - arena->used ) {
+		arena->failed++;
+		if ( size > arena->failedLargest ) {
+			arena->failedLargest = size;
+		}
+		return NULL;
+	}
+
+	buf = arena->base + arena->used;
+	arena->used += need;
+	arena->allocs++;
+	if ( arena->used > arena->peak ) {
+		arena->peak = arena->used;
+	}
+
+#ifdef HUNK_DEBUG
+	{
+		scratchHeader_t *hdr = (scratchHeader_t *)buf;
+		unsigned int guard = SCRATCH_GUARD;
+
+		hdr->magic = SCRATCH_MAGIC;
+		hdr->size = size;
+		buf = (byte *)( hdr + 1 );
+		Com_Memcpy( buf + size, &guard, sizeof( guard ) );
+	}
+#endif
+
+	return buf;
+}
+
+
+/*
+=================
+Hunk_ScratchMark
+=================
+*/
+int Hunk_ScratchMark( void ) {
+	if ( !s_threadScratch ) {
+		return 0;
+	}
+	return s_threadScratch->used;
+}
+
+
+/*
+=================
+Hunk_ScratchReset
+
+Frees everything the calling thread allocated since the mark
+=================
+*/
+void Hunk_ScratchReset( int mark ) {
+	scratchArena_t *arena = s_threadScratch;
+
+	if ( !arena || mark >= arena->used ) {
+		return;
+	}
+
+#ifdef HUNK_DEBUG
+	Hunk_CheckScratch( arena, mark );
+#endif
+
+	arena->used = mark;
+}
+
+
+/*
+=================
+Hunk_ReleaseScratch
+
+Gives the arena back, called by threads before they exit
+=================
+*/
+void Hunk_ReleaseScratch( void ) {
+	scratchArena_t *arena = s_threadScratch;
+
+	if ( !arena ) {
+		return;
+	}
+
+	Hunk_ScratchReset( 0 );
+	s_threadScratch = NULL;
+
+	if ( s_scratchMutex ) {
+		Sys_LockMutex( s_scratchMutex );
+	}
+	arena->claimed = false;
+	if ( s_scratchMutex ) {
+		Sys_UnlockMutex( s_scratchMutex );
+	}
+}
+
+
+
+/*
+=================
+Hunk_WriteScratchLine
+=================
+*/
+static void Hunk_WriteScratchLine( fileHandle_t f, char *buf, int size ) {
+	if ( f == FS_INVALID_HANDLE ) {
+		Com_Printf( "%s\n", buf );
+	} else {
+		Q_strcat( buf, size, "\r\n" );
+		FS_Write( buf, strlen( buf ), f );
+	}
+}
+
+
+/*
+=================
+Hunk_LogScratch
+
+Prints arena usage to the console or writes it to a log file,
+arenas claimed by running threads are marked with '*'
+=================
+*/
+static void Hunk_LogScratch( fileHandle_t f ) {
+	const scratchArena_t *arena;
+	char	buf[256];
+	int		i;
+
+	Com_sprintf( buf, sizeof( buf ), "%8i bytes in %i scratch arenas", SCRATCH_SIZE * MAX_SCRATCH_ARENAS, MAX_SCRATCH_ARENAS );
+	Hunk_WriteScratchLine( f, buf, sizeof( buf ) );
+
+	Com_sprintf( buf, sizeof( buf ), "arena     used     peak   allocs  failed  largest  overruns" );
+	Hunk_WriteScratchLine( f, buf, sizeof( buf ) );
+
+	for ( i = 0, arena = s_scratch; i < MAX_SCRATCH_ARENAS; i++, arena++ ) {
+		if ( !arena->allocs && !arena->failed ) {
+			continue;
+		}
+		Com_sprintf( buf, sizeof( buf ), "%4i%s %8i %8i %8i %7i %8i %9i", i, arena->claimed ? "*" : " ",
+			arena->used, arena->peak, arena->allocs, arena->failed, arena->failedLargest, arena->overruns );
+		if ( arena->overrunSize ) {
+			Q_strcat( buf, sizeof( buf ), va( " (last %i bytes)", arena->overrunSize ) );
+		}
+		Hunk_WriteScratchLine( f, buf, sizeof( buf ) );
+	}
+}
+
+
+#ifdef HUNK_DEBUG
+/*
+=================
+Hunk_ScratchTest_f
+
+Exhausts and overruns the scratch arena of the main thread on purpose and
+checks that both are counted, the arena is restored afterwards
+=================
+*/
+static void Hunk_ScratchTest_f( void ) {
+	scratchArena_t *arena;
+	scratchArena_t saved;
+	bool	claimed;
+	bool	passed;
+	int		count;
+	byte	*buf;
+	int		mark;
+	int		size;
+
+	claimed = false;
+	if ( !s_threadScratch ) {
+		s_threadScratch = Hunk_ClaimScratch();
+		claimed = true;
+	}
+
+	arena = s_threadScratch;
+	if ( !arena ) {
+		Com_Printf( "scratchtest: no free scratch arena\n" );
+		return;
+	}
+
+	saved = *arena;
+	passed = true;
+
+	// a request larger than the whole arena must fail and be counted
+	count = arena->failed;
+	if ( Hunk_AllocScratch( arena->size + 1 ) != NULL || arena->failed != count + 1 || arena->failedLargest < arena->size + 1 ) {
+		Com_Printf( S_COLOR_RED "scratchtest: exhausted arena not reported\n" );
+		passed = false;
+	}
+
+	// write over the guard word of a single allocation
+	mark = Hunk_ScratchMark();
+	size = 100;
+	buf = Hunk_AllocScratch( size );
+	if ( !buf ) {
+		Com_Printf( S_COLOR_RED "scratchtest: allocation of %i bytes failed\n", size );
+		passed = false;
+	} else {
+		count = arena->overruns;
+		Com_Memset( buf, 0xAA, size + sizeof( unsigned int ) );
+		Hunk_ScratchReset( mark );
+		if ( arena->overruns != count + 1 || arena->overrunSize != size ) {
+			Com_Printf( S_COLOR_RED "scratchtest: overrun of %i bytes not reported\n", size );
+			passed = false;
+		}
+	}
+
+	Hunk_LogScratch( FS_INVALID_HANDLE );
+
+	*arena = saved;
+	if ( claimed ) {
+		Hunk_ReleaseScratch();
+	}
+
+	Com_Printf( "scratchtest: %s\n", passed ? "passed" : S_COLOR_RED "FAILED" );
+}
+#endif
+
+
 /*
 =================
 Com_InitHunkMemory
@@ -2192,12 +3450,15 @@ static void Com_InitHunkMemory( void ) {
 	Hunk_Clear();
 
 	Cmd_AddCommand( "meminfo", Com_Meminfo_f );
+	Cmd_AddCommand( "zonetrace", Com_ZoneTrace_f );
+	Cmd_AddCommand( "zonereplay", Com_ZoneReplay_f );
 #ifdef ZONE_DEBUG
 	Cmd_AddCommand( "zonelog", Z_LogHeap );
 #endif
 #ifdef HUNK_DEBUG
 	Cmd_AddCommand( "hunklog", Hunk_Log );
 	Cmd_AddCommand( "hunksmalllog", Hunk_SmallLog );
+	Cmd_AddCommand( "scratchtest", Hunk_ScratchTest_f );
 #endif
 }
 
@@ -3828,6 +5089,12 @@ void Com_Init( char *commandLine ) {
 	// done early so bind command exists
 	Com_InitKeyCommands();
 
+	// filesystem scans pk3 files on job threads
+	Com_InitJobs();
+
+	// the scan reads central directories into scratch arenas
+	Hunk_InitScratch();
+
 	FS_InitFilesystem();
 
 	com_logfile = Cvar_Get( "logfile", "0", CVAR_TEMP );
@@ -3945,6 +5212,12 @@ void Com_Init( char *commandLine ) {
 
 	Cmd_AddCommand( "quit", Com_Quit_f );
 	Cmd_AddCommand( "changeVectors", MSG_ReportChangeVectors_f );
+	Cmd_AddCommand( "huffbench", Huff_Benchmark_f );
+	Cmd_AddCommand( "cm_traceStress", CM_TraceStress_f );
+	Cmd_AddCommand( "cm_patchStats", CM_PatchStats_f );
+	Cmd_AddCommand( "cm_nodeBench", CM_NodeBench_f );
+	Cmd_AddCommand( "cm_capture", CM_Capture_f );
+	Cmd_AddCommand( "cm_replay", CM_Replay_f );
 	Cmd_AddCommand( "writeconfig", Com_WriteConfig_f );
 	Cmd_SetCommandCompletionFunc( "writeconfig", Cmd_CompleteWriteCfgName );
 	Cmd_AddCommand( "game_restart", Com_GameRestart_f );
@@ -3980,6 +5253,8 @@ void Com_Init( char *commandLine ) {
 	}
 #endif
 
+	MSG_InitDeltaFields();
+
 	// Pick a random port value
 	Com_RandomBytes( (byte*)&qport, sizeof( qport ) );
 	Netchan_Init( qport & 0xffff );
@@ -4330,6 +5605,9 @@ void Com_Frame( bool noDelay ) {
 
 	Cbuf_Execute();
 
+	// deliver files read in background
+	FS_CompleteAsyncReads( false );
+
 	// mess with msec if needed
 	msec = Com_ModifyMsec( realMsec );
 
@@ -4434,16 +5712,11 @@ void Com_Frame( bool noDelay ) {
 	// trace optimization tracking
 	//
 	if ( com_showtrace->integer ) {
+		int		traces, brushTraces, patchTraces, pointContents;
 
-		extern	int c_traces, c_brush_traces, c_patch_traces;
-		extern	int	c_pointcontents;
-
-		Com_Printf ("%4i traces  (%ib %ip) %4i points\n", c_traces,
-			c_brush_traces, c_patch_traces, c_pointcontents);
-		c_traces = 0;
-		c_brush_traces = 0;
-		c_patch_traces = 0;
-		c_pointcontents = 0;
+		CM_TakeTraceCounters( &traces, &brushTraces, &patchTraces, &pointContents );
+		Com_Printf ("%4i traces  (%ib %ip) %4i points\n", traces,
+			brushTraces, patchTraces, pointContents);
 	}
 
 	com_frameNumber++;
@@ -4456,6 +5729,8 @@ Com_Shutdown
 =================
 */
 static void Com_Shutdown( void ) {
+	Com_ShutdownJobs();
+
 	if ( logfile != FS_INVALID_HANDLE ) {
 		FS_FCloseFile( logfile );
 		logfile = FS_INVALID_HANDLE;
@@ -226,6 +226,8 @@ static const unsigned pak_checksums[] = {
 #define MAX_ZPATH 256
 #define MAX_FILEHASH_SIZE 4096
 
+#define SIZE_ZIP_CENTRAL_ITEM 46
+
 typedef struct fileInPack_s
 {
 	char *name;				   // name of the file
@@ -316,6 +318,8 @@ static cvar_t *fs_gamedirvar;
 static cvar_t *fs_locked;
 #endif
 static cvar_t *fs_excludeReference;
+static cvar_t *fs_mmap;
+static cvar_t *fs_asyncRead;
 
 static searchpath_t *fs_searchpaths;
 static int fs_readCount; // total bytes read
@@ -329,6 +333,14 @@ static int fs_dirCount;	   // total number of directories in searchpath
 
 static int fs_checksumFeed;
 
+static struct
+{
+	int64_t scan;  // usec reading central directories, wall time
+	int64_t build; // usec building pak hash tables and checksums
+	int paks;	   // paks read from disk
+	int threads;
+} fs_startupTimes;
+
 typedef union qfile_gus
 {
 	FILE *o;
@@ -385,6 +397,8 @@ void Com_ReadCDKey(const char *filename);
 
 static int FS_GetModList(char *listbuf, int bufsize);
 static void FS_CheckIdPaks(void);
+static void FS_IndexDiskChanged(void);
+static void FS_InvalidatePrefetches(void);
 void FS_Reload(void);
 
 /*
@@ -712,6 +726,8 @@ static void FS_CopyFile(const char *fromOSPath, const char *toOSPath)
 		}
 	}
 
+	FS_IndexDiskChanged();
+
 	if (fwrite(buf, 1, len, f) != len)
 	{
 		free(buf);
@@ -731,7 +747,7 @@ FS_AllowedExtension
 */
 bool FS_AllowedExtension(const char *fileName, bool allowPk3s, const char **ext)
 {
-	static const char *extlist[] = {"dll", "exe", "so", "dylib", "qvm", "pk3"};
+	static const char *extlist[] = {"dll", "exe", "so", "dylib", "qvm", "jit", "pk3"};
 	const char *e;
 	int i, n;
 
@@ -802,6 +818,7 @@ void FS_Remove(const char *osPath)
 	FS_CheckFilenameIsNotAllowed(osPath, __func__, true);
 
 	remove(osPath);
+	FS_IndexDiskChanged();
 }
 
 /*
@@ -815,6 +832,7 @@ void FS_HomeRemove(const char *osPath)
 
 	remove(FS_BuildOSPath(fs_homepath->string,
 						  fs_gamedir, osPath));
+	FS_IndexDiskChanged();
 }
 
 /*
@@ -941,6 +959,8 @@ fileHandle_t FS_SV_FOpenFileWrite(const char *filename)
 		}
 	}
 
+	FS_IndexDiskChanged();
+
 	Q_strncpyz(fd->name, filename, sizeof(fd->name));
 	fd->handleSync = false;
 	fd->zipFile = false;
@@ -1035,6 +1055,58 @@ int FS_SV_FOpenFileRead(const char *filename, fileHandle_t *fp)
 	return -1;
 }
 
+/*
+===========
+FS_SV_MapFile
+
+Maps a file found the same way as FS_SV_FOpenFileRead and copies the
+path of the mapped file to mappedPath, returns NULL if it can't be found
+or mapped, release with Sys_UnmapFile
+===========
+*/
+void *FS_SV_MapFile(const char *filename, int *length, char *mappedPath, int mappedPathSize)
+{
+	const char *paths[3];
+	const char *ospath;
+	void *data;
+	int numPaths, i;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+	}
+
+	numPaths = 0;
+	paths[numPaths++] = fs_homepath->string;
+	if (Q_stricmp(fs_homepath->string, fs_basepath->string) != 0)
+	{
+		paths[numPaths++] = fs_basepath->string;
+	}
+	if (fs_steampath->string[0])
+	{
+		paths[numPaths++] = fs_steampath->string;
+	}
+
+	for (i = 0; i < numPaths; i++)
+	{
+		ospath = FS_BuildOSPath(paths[i], filename, NULL);
+
+		if (fs_debug->integer)
+		{
+			Com_Printf("FS_SV_MapFile: %s\n", ospath);
+		}
+
+		data = Sys_MapFile(ospath, length);
+		if (data)
+		{
+			Q_strncpyz(mappedPath, ospath, mappedPathSize);
+			return data;
+		}
+	}
+
+	return NULL;
+}
+
 /*
 ===========
 FS_SV_Rename
@@ -1068,6 +1140,8 @@ void FS_SV_Rename(const char *from, const char *to)
 		FS_CopyFile(from_ospath, to_ospath);
 		FS_Remove(from_ospath);
 	}
+
+	FS_IndexDiskChanged();
 }
 
 /*
@@ -1111,6 +1185,8 @@ void FS_Rename(const char *from, const char *to)
 		FS_CopyFile(from_ospath, to_ospath);
 		FS_Remove(from_ospath);
 	}
+
+	FS_IndexDiskChanged();
 }
 
 #ifdef USE_HANDLE_CACHE
@@ -1325,6 +1401,8 @@ fileHandle_t FS_FOpenFileWrite(const char *filename)
 		}
 	}
 
+	FS_IndexDiskChanged();
+
 	Q_strncpyz(fd->name, filename, sizeof(fd->name));
 	fd->handleSync = false;
 	fd->zipFile = false;
@@ -1385,6 +1463,8 @@ fileHandle_t FS_FOpenFileAppend(const char *filename)
 		}
 	}
 
+	FS_IndexDiskChanged();
+
 	Q_strncpyz(fd->name, filename, sizeof(fd->name));
 	fd->handleSync = false;
 	fd->zipFile = false;
@@ -1627,615 +1707,2015 @@ static int FS_OpenFileInPak(fileHandle_t *file, pack_t *pak, fileInPack_t *pakFi
 }
 
 /*
-===========
-FS_FOpenFileRead
+==========================================================================
 
-Finds the file in the search path.
-Returns filesize and an open FILE pointer.
-Used for streaming data out of either a
-separate file or a ZIP file.
-===========
+GLOBAL FILE INDEX
+
+Every pak file entry of every search path is hashed into one table in
+search path order, so a lookup probes a single hash chain instead of every
+pak. Directory search paths are checked against cached listings of the
+directories lookups keep touching. A directory is opened directly until it
+has been looked into FS_LISTING_WARMUP times, so a single lookup never costs
+more than the open it replaces, and listings are read without a stat() per
+entry. Listings are dropped whenever the engine creates, renames or removes
+a file and at every level change. Files other programs add or remove are
+caught by checking the modification time of a listed directory once per
+frame when it is used. Pure server and directory policy checks are done at
+lookup, so they may change at any time.
+
+==========================================================================
 */
-extern bool com_fullyInitialized;
 
-int FS_FOpenFileRead(const char *filename, fileHandle_t *file, bool uniqueFILE)
+#define FS_LISTING_WARMUP 4 // lookups in a directory before it is listed
+#define FS_LISTING_HASH 256
+#define MAX_INDEXHASH_SIZE (1 << 20)
+
+#if defined(_WIN32) || defined(__APPLE__)
+#define FS_OSNameCompare Q_stricmp // case insensitive file systems
+#else
+#define FS_OSNameCompare strcmp
+#endif
+
+typedef struct fsIndexEntry_s
 {
 	const searchpath_t *search;
-	char *netpath;
-	pack_t *pak;
 	fileInPack_t *pakFile;
-	directory_t *dir;
-	long hash;
-	long fullHash;
-	FILE *temp;
-	int length;
-	fileHandleData_t *f;
+	int order; // position in fs_searchpaths
+	struct fsIndexEntry_s *next;
+} fsIndexEntry_t;
+
+typedef struct fsListing_s
+{
+	char *path;	 // relative to search path directory, no trailing slash
+	int dirIndex;
+	int generation;
+	int lookups;   // while not listed
+	bool listed;
+	bool complete; // false if there were too many files to list
+	bool recent;   // directory changed in the second it was listed
+	fileTime_t mtime;
+	int checkTime; // com_frameTime of the last mtime check
+	char **names;
+	int numNames;
+	int hashSize;
+	int *hashHead; // name index + 1
+	int *hashNext;
+	struct fsListing_s *next;
+} fsListing_t;
 
-	if (!fs_searchpaths)
-	{
-		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
-	}
+static struct
+{
+	bool valid;
+	bool disabled; // linear search, for benchmarking
+	int hashSize;
+	fsIndexEntry_t **hashTable;
+	fsIndexEntry_t *entries;
+	int numDirs;
+	const searchpath_t **dirs;
+	int *dirOrder;
+	int generation; // incremented when the engine changes files on the disk
+	fsListing_t *listings[FS_LISTING_HASH];
+} fs_index;
 
-	if (!filename)
-	{
-		Com_Error(ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n");
-	}
+/*
+=================
+FS_IndexHashSize
+=================
+*/
+static int FS_IndexHashSize(int count, int maxSize)
+{
+	int hashSize;
 
-	// qpaths are not supposed to have a leading slash
-	if (filename[0] == '/' || filename[0] == '\\')
+	for (hashSize = 2; hashSize < maxSize && hashSize < count; hashSize <<= 1)
+		;
+
+	return hashSize;
+}
+
+/*
+=================
+FS_ClearListing
+=================
+*/
+static void FS_ClearListing(fsListing_t *list)
+{
+	if (list->names)
 	{
-		filename++;
+		Sys_FreeFileList(list->names);
+		list->names = NULL;
 	}
-
-	// make absolutely sure that it can't back up the path.
-	// The searchpaths do guarantee that something will always
-	// be prepended, so we don't need to worry about "c:" or "//limbo"
-	if (FS_CheckDirTraversal(filename))
+	if (list->hashHead)
 	{
-		*file = FS_INVALID_HANDLE;
-		return -1;
+		Z_Free(list->hashHead);
+		list->hashHead = NULL;
 	}
+	list->numNames = 0;
+	list->listed = false;
+}
 
-	// we will calculate full hash only once then just mask it by current pack->hashSize
-	// we can do that as long as we know properties of our hash function
-	fullHash = FS_HashFileName(filename, 0U);
+/*
+=================
+FS_FreeListings
 
-	if (file == NULL)
+Forgets all directories, including how often they were looked into
+=================
+*/
+static void FS_FreeListings(void)
+{
+	fsListing_t *list, *next;
+	int i;
+
+	for (i = 0; i < FS_LISTING_HASH; i++)
 	{
-		// just wants to see if file is there
-		for (search = fs_searchpaths; search; search = search->next)
+		for (list = fs_index.listings[i]; list; list = next)
 		{
-			// is the element a pak file?
-			if (search->pack && search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
-			{
-				// skip non-pure files
-				if (!FS_PakIsPure(search->pack))
-					continue;
-				// look through all the pak file elements
-				pak = search->pack;
-				pakFile = pak->hashTable[hash];
-				do
-				{
-					// case and separator insensitive comparisons
-					if (!FS_FilenameCompare(pakFile->name, filename))
-					{
-						// found it!
-						return pakFile->size;
-					}
-					pakFile = pakFile->next;
-				} while (pakFile != NULL);
-			}
-			else if (search->dir && search->policy != DIR_DENY)
-			{
-				dir = search->dir;
-				netpath = FS_BuildOSPath(dir->path, dir->gamedir, filename);
-				temp = Sys_FOpen(netpath, "rb");
-				if (temp)
-				{
-					length = FS_FileLength(temp);
-					fclose(temp);
-					return length;
-				}
-			}
+			next = list->next;
+			FS_ClearListing(list);
+			Z_Free(list);
 		}
-		return -1;
+		fs_index.listings[i] = NULL;
 	}
+}
 
-	// make sure the q3key file is only readable by the quake3.exe at initialization
-	// any other time the key should only be accessed in memory using the provided functions
-	if (com_fullyInitialized && strstr(filename, "q3key"))
+/*
+=================
+FS_FreeIndex
+=================
+*/
+static void FS_FreeIndex(void)
+{
+	int generation;
+
+	FS_FreeListings();
+
+	if (fs_index.hashTable)
 	{
-		*file = FS_INVALID_HANDLE;
-		return -1;
+		Z_Free(fs_index.hashTable);
 	}
-
-	//
-	// search through the path, one element at a time
-	//
-	for (search = fs_searchpaths; search; search = search->next)
+	if (fs_index.entries)
 	{
-		// is the element a pak file?
-		if (search->pack && search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
-		{
-			// disregard if it doesn't match one of the allowed pure pak files
-			if (!FS_PakIsPure(search->pack))
-			{
-				continue;
-			}
-			// look through all the pak file elements
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do
-			{
-				// case and separator insensitive comparisons
-				if (!FS_FilenameCompare(pakFile->name, filename))
-				{
-					// found it!
-					return FS_OpenFileInPak(file, pak, pakFile, uniqueFILE);
-				}
-				pakFile = pakFile->next;
-			} while (pakFile != NULL);
-		}
-		else if (search->dir && search->policy != DIR_DENY)
-		{
-			// check a file in the directory tree
-			dir = search->dir;
-
-			netpath = FS_BuildOSPath(dir->path, dir->gamedir, filename);
-
-			temp = Sys_FOpen(netpath, "rb");
-			if (temp == NULL)
-			{
-				continue;
-			}
-
-			*file = FS_HandleForFile();
-			f = &fsh[*file];
-			FS_InitHandle(f);
+		Z_Free(fs_index.entries);
+	}
+	if (fs_index.dirs)
+	{
+		Z_Free((void *)fs_index.dirs);
+	}
+	if (fs_index.dirOrder)
+	{
+		Z_Free(fs_index.dirOrder);
+	}
 
-			f->handleFiles.file.o = temp;
-			Q_strncpyz(f->name, filename, sizeof(f->name));
-			f->zipFile = false;
+	generation = fs_index.generation;
+	Com_Memset(&fs_index, 0, sizeof(fs_index));
+	fs_index.generation = generation;
+}
 
-			if (fs_debug->integer)
-			{
-				Com_Printf("FS_FOpenFileRead: %s (found in '%s/%s')\n", filename,
-						   dir->path, dir->gamedir);
-			}
+/*
+=================
+FS_InvalidateIndex
 
-			return FS_FileLength(f->handleFiles.file.o);
-		}
-	}
+Search path order has been changed
+=================
+*/
+static void FS_InvalidateIndex(void)
+{
+	fs_index.valid = false;
+	FS_InvalidatePrefetches();
+}
 
-#ifdef FS_MISSING
-	if (missingFiles)
-	{
-		fprintf(missingFiles, "%s\n", filename);
-	}
-#endif
+/*
+=================
+FS_IndexDiskChanged
 
-	*file = FS_INVALID_HANDLE;
-	return -1;
+The engine has created, renamed or removed a file, directory listings are outdated
+=================
+*/
+static void FS_IndexDiskChanged(void)
+{
+	fs_index.generation++;
+	FS_InvalidatePrefetches();
 }
 
 /*
-===========
-FS_TouchFileInPak
-===========
+=================
+FS_BuildIndex
+=================
 */
-void FS_TouchFileInPak(const char *filename)
+static void FS_BuildIndex(void)
 {
-	const searchpath_t *search;
-	long fullHash, hash;
-	pack_t *pak;
+	const searchpath_t *search, **paths;
+	fsIndexEntry_t *e;
 	fileInPack_t *pakFile;
+	int i, j, n, numPaths, numEntries;
+	unsigned long hash;
 
-	fullHash = FS_HashFileName(filename, 0U);
+	FS_FreeIndex();
 
+	numPaths = 0;
+	numEntries = 0;
 	for (search = fs_searchpaths; search; search = search->next)
 	{
+		if (search->pack)
+			numEntries += search->pack->numfiles;
+		else if (search->dir)
+			fs_index.numDirs++;
+		numPaths++;
+	}
 
-		// is the element a pak file?
-		if (!search->pack)
-			continue;
+	paths = Z_Malloc((numPaths + 1) * sizeof(paths[0]));
+	for (search = fs_searchpaths, n = 0; search; search = search->next)
+	{
+		paths[n++] = search;
+	}
 
-		if (search->pack->exclude) // skip paks in \fs_excludeReference list
-			continue;
+	fs_index.hashSize = FS_IndexHashSize(numEntries, MAX_INDEXHASH_SIZE);
+	fs_index.hashTable = Z_Malloc(fs_index.hashSize * sizeof(fs_index.hashTable[0]));
+	fs_index.entries = Z_Malloc((numEntries + 1) * sizeof(fs_index.entries[0]));
+	fs_index.dirs = Z_Malloc((fs_index.numDirs + 1) * sizeof(fs_index.dirs[0]));
+	fs_index.dirOrder = Z_Malloc((fs_index.numDirs + 1) * sizeof(fs_index.dirOrder[0]));
 
-		if (search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
+	for (i = 0, n = 0; i < numPaths; i++)
+	{
+		if (paths[i]->dir)
 		{
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do
+			fs_index.dirs[n] = paths[i];
+			fs_index.dirOrder[n] = i;
+			n++;
+		}
+	}
+
+	// insert in reverse order so every chain is sorted by search path order
+	e = fs_index.entries;
+	for (i = numPaths - 1; i >= 0; i--)
+	{
+		if (!paths[i]->pack)
+			continue;
+		for (j = 0; j < paths[i]->pack->hashSize; j++)
+		{
+			for (pakFile = paths[i]->pack->hashTable[j]; pakFile && e < fs_index.entries + numEntries; pakFile = pakFile->next)
 			{
-				// case and separator insensitive comparisons
-				if (!FS_FilenameCompare(pakFile->name, filename))
-				{
-					// found it!
-					if (!(pak->referenced & FS_GENERAL_REF) && FS_GeneralRef(filename))
-					{
-						pak->referenced |= FS_GENERAL_REF;
-					}
-					if (!(pak->referenced & FS_CGAME_REF) && !strcmp(filename, "vm/cgame.qvm"))
-					{
-						pak->referenced |= FS_CGAME_REF;
-					}
-					if (!(pak->referenced & FS_UI_REF) && !strcmp(filename, "vm/ui.qvm"))
-					{
-						pak->referenced |= FS_UI_REF;
-					}
-					return;
-				}
-				pakFile = pakFile->next;
-			} while (pakFile != NULL);
+				hash = FS_HashFileName(pakFile->name, fs_index.hashSize);
+				e->search = paths[i];
+				e->pakFile = pakFile;
+				e->order = i;
+				e->next = fs_index.hashTable[hash];
+				fs_index.hashTable[hash] = e;
+				e++;
+			}
 		}
 	}
+
+	Z_Free((void *)paths);
+
+	fs_index.valid = true;
 }
 
 /*
-===========
-FS_Home_FOpenFileRead
-===========
+=================
+FS_ReadListing
+=================
 */
-int FS_Home_FOpenFileRead(const char *filename, fileHandle_t *file)
+static void FS_ReadListing(fsListing_t *list)
 {
-	char path[MAX_OSPATH * 3 + 1];
-	fileHandleData_t *fd;
-	fileHandle_t f;
+	const directory_t *dir = fs_index.dirs[list->dirIndex]->dir;
+	char ospath[MAX_OSPATH];
+	fileOffset_t size;
+	fileTime_t ctime;
+	unsigned long hash;
+	int i;
 
-	if (!fs_searchpaths)
-	{
-		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
-	}
+	Q_strncpyz(ospath, FS_BuildOSPath(dir->path, dir->gamedir, list->path), sizeof(ospath));
 
-	// should never happen but for safe
-	if (!file)
+	// taken before listing, so changes made while listing show up on the next check,
+	// and with one second resolution a change in the same second may be missed
+	Sys_GetFileStats(ospath, &size, &list->mtime, &ctime);
+	list->recent = list->mtime >= (fileTime_t)Com_RealTime(NULL) - 1;
+	list->checkTime = com_frameTime;
+
+	// a directory that can't be read has no files to open either
+	list->names = Sys_ListDirNames(ospath, &list->numNames);
+	list->complete = list->numNames < MAX_FOUND_FILES - 1;
+	list->listed = true;
+
+	list->hashSize = FS_IndexHashSize(list->numNames, MAX_FILEHASH_SIZE);
+	list->hashHead = Z_Malloc((list->hashSize + list->numNames) * sizeof(int));
+	list->hashNext = list->hashHead + list->hashSize;
+	for (i = 0; i < list->numNames; i++)
 	{
-		return -1;
+		hash = FS_HashFileName(list->names[i], list->hashSize);
+		list->hashNext[i] = list->hashHead[hash];
+		list->hashHead[hash] = i + 1;
 	}
+}
 
-	// allocate new file handle
-	f = FS_HandleForFile();
-	fd = &fsh[f];
-	FS_InitHandle(fd);
+/*
+=================
+FS_ListingChanged
 
-	Com_sprintf(path, sizeof(path), "%s%c%s%c%s", fs_homepath->string,
-				PATH_SEP, fs_gamedir, PATH_SEP, filename);
+Checks modification time of a listed directory
+=================
+*/
+static bool FS_ListingChanged(fsListing_t *list)
+{
+	const directory_t *dir = fs_index.dirs[list->dirIndex]->dir;
+	fileOffset_t size;
+	fileTime_t mtime, ctime;
 
-	if (fs_debug->integer)
-	{
-		Com_Printf("%s: %s\n", __func__, path);
-	}
+	list->checkTime = com_frameTime;
 
-	fd->handleFiles.file.o = Sys_FOpen(path, "rb");
-	if (fd->handleFiles.file.o != NULL)
+	if (list->recent)
 	{
-		Q_strncpyz(fd->name, filename, sizeof(fd->name));
-		fd->handleSync = false;
-		fd->zipFile = false;
-		*file = f;
-		return FS_FileLength(fd->handleFiles.file.o);
+		return true;
 	}
 
-	*file = FS_INVALID_HANDLE;
-	return -1;
+	Sys_GetFileStats(FS_BuildOSPath(dir->path, dir->gamedir, list->path), &size, &mtime, &ctime);
+
+	return mtime != list->mtime;
 }
 
 /*
 =================
-FS_Read
+FS_GetListing
 
-Properly handles partial reads
+Returns cached listing of a directory in directory search path or NULL
+while the directory is not looked into often enough to be listed
 =================
 */
-int FS_Read(void *buffer, int len, fileHandle_t f)
+static const fsListing_t *FS_GetListing(int dirIndex, const char *path)
 {
-	int block, remaining;
-	int read;
-	byte *buf;
-	int tries;
+	fsListing_t *list;
+	unsigned long listHash;
 
-	if (!fs_searchpaths)
+	listHash = (FS_HashFileName(path, FS_LISTING_HASH) + dirIndex) & (FS_LISTING_HASH - 1);
+
+	for (list = fs_index.listings[listHash]; list; list = list->next)
 	{
-		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+		if (list->dirIndex == dirIndex && !FS_OSNameCompare(list->path, path))
+		{
+			break;
+		}
 	}
 
-	if (f <= 0 || f >= MAX_FILE_HANDLES)
+	if (!list)
 	{
-		return 0;
+		list = Z_Malloc(sizeof(*list) + strlen(path) + 1);
+		list->path = (char *)(list + 1);
+		strcpy(list->path, path);
+		list->dirIndex = dirIndex;
+		list->generation = fs_index.generation;
+		list->next = fs_index.listings[listHash];
+		fs_index.listings[listHash] = list;
 	}
 
-	buf = (byte *)buffer;
-	fs_readCount += len;
+	if (list->generation != fs_index.generation)
+	{
+		// a directory that was in use is listed again right away
+		FS_ClearListing(list);
+		list->generation = fs_index.generation;
+	}
+	else if (list->listed && list->checkTime != com_frameTime && FS_ListingChanged(list))
+	{
+		// another program has added or removed files
+		FS_ClearListing(list);
+	}
 
-	if (!fsh[f].zipFile)
+	if (!list->listed)
 	{
-		remaining = len;
-		tries = 0;
-		while (remaining)
+		if (++list->lookups < FS_LISTING_WARMUP)
 		{
-			block = remaining;
-			read = fread(buf, 1, block, fsh[f].handleFiles.file.o);
-			if (read == 0)
-			{
-				// we might have been trying to read from a CD, which
-				// sometimes returns a 0 read on windows
-				if (!tries)
-				{
-					tries = 1;
-				}
-				else
-				{
-					return len - remaining; // Com_Error (ERR_FATAL, "FS_Read: 0 bytes read");
-				}
-			}
+			return NULL;
+		}
+		FS_ReadListing(list);
+	}
 
-			if (read == -1)
-			{
-				Com_Error(ERR_FATAL, "FS_Read: -1 bytes read");
-			}
+	return list;
+}
 
-			remaining -= read;
-			buf += read;
+/*
+=================
+FS_DirHasFile
+
+Returns 1 if file exists in directory search path, 0 if it does not and
+-1 if that can't be told from directory listing. A directory that is not
+listed yet is checked by opening the file.
+=================
+*/
+static int FS_DirHasFile(int dirIndex, const char *filename)
+{
+	const directory_t *dir;
+	char path[MAX_OSPATH];
+	const fsListing_t *list;
+	const char *name, *s;
+	FILE *f;
+	int i;
+
+	// leave anything unusual to the file system
+	for (s = filename; *s; s++)
+	{
+		if (*s == '\\' || *s == ':' || (*s == '/' && (s[1] == '/' || s[1] == '\0')) || (*s == '.' && (s == filename || s[-1] == '/')))
+		{
+			return -1;
 		}
-		return len;
+	}
+
+	name = strrchr(filename, '/');
+	if (name)
+	{
+		if (name - filename >= sizeof(path))
+		{
+			return -1;
+		}
+		Q_strncpyz(path, filename, name - filename + 1);
+		name++;
 	}
 	else
 	{
-		return unzReadCurrentFile(fsh[f].handleFiles.file.z, buffer, len);
+		path[0] = '\0';
+		name = filename;
+	}
+
+	list = FS_GetListing(dirIndex, path);
+	if (!list)
+	{
+		dir = fs_index.dirs[dirIndex]->dir;
+		f = Sys_FOpen(FS_BuildOSPath(dir->path, dir->gamedir, filename), "rb");
+		if (!f)
+		{
+			return 0;
+		}
+		fclose(f);
+		return 1;
+	}
+
+	if (!list->complete)
+	{
+		return -1;
+	}
+
+	for (i = list->hashHead[FS_HashFileName(name, list->hashSize)]; i; i = list->hashNext[i - 1])
+	{
+		if (!FS_OSNameCompare(list->names[i - 1], name))
+		{
+			return 1;
+		}
 	}
+
+	return 0;
 }
 
 /*
 =================
-FS_Write
+FS_IndexFind
 
-Properly handles partial writes
+Returns search path a linear search would find the file in, may return
+a directory the file is not in when listing can't be used
 =================
 */
-int FS_Write(const void *buffer, int len, fileHandle_t h)
+static const searchpath_t *FS_IndexFind(const char *filename, unsigned long fullHash, fileInPack_t **pakFile)
 {
-	int block, remaining;
-	int written;
-	byte *buf;
-	int tries;
-	FILE *f;
+	const fsIndexEntry_t *e, *found;
+	int i, order;
 
-	if (!fs_searchpaths)
+	if (!fs_index.valid)
 	{
-		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+		FS_BuildIndex();
 	}
 
-	// if ( h <= 0 || h >= MAX_FILE_HANDLES ) {
-	//	return 0;
-	// }
-
-	f = FS_FileForHandle(h);
-	buf = (byte *)buffer;
-
-	remaining = len;
-	tries = 0;
-	while (remaining)
+	// chains are sorted by search path order
+	found = NULL;
+	for (e = fs_index.hashTable[fullHash & (fs_index.hashSize - 1)]; e; e = e->next)
 	{
-		block = remaining;
-		written = fwrite(buf, 1, block, f);
-		if (written == 0)
+		if (!FS_FilenameCompare(e->pakFile->name, filename) && FS_PakIsPure(e->search->pack))
 		{
-			if (!tries)
-			{
-				tries = 1;
-			}
-			else
-			{
-				Com_Printf("FS_Write: 0 bytes written\n");
-				return 0;
-			}
+			found = e;
+			break;
 		}
+	}
 
-		if (written == -1)
+	order = found ? found->order : INT_MAX;
+	for (i = 0; i < fs_index.numDirs && fs_index.dirOrder[i] < order; i++)
+	{
+		if (fs_index.dirs[i]->policy != DIR_DENY && FS_DirHasFile(i, filename) != 0)
 		{
-			Com_Printf("FS_Write: -1 bytes written\n");
-			return 0;
+			return fs_index.dirs[i];
 		}
-
-		remaining -= written;
-		buf += written;
 	}
-	if (fsh[h].handleSync)
+
+	if (found)
 	{
-		fflush(f);
+		*pakFile = found->pakFile;
+		return found->search;
 	}
-	return len;
+
+	return NULL;
 }
 
-void QDECL FS_Printf(fileHandle_t h, const char *fmt, ...)
+/*
+=================
+FS_OpenFileInDir
+=================
+*/
+static int FS_OpenFileInDir(fileHandle_t *file, const searchpath_t *search, const char *filename)
 {
-	va_list argptr;
-	char msg[MAXPRINTMSG];
+	const directory_t *dir = search->dir;
+	fileHandleData_t *f;
+	FILE *temp;
 
-	va_start(argptr, fmt);
-	Q_vsnprintf(msg, sizeof(msg), fmt, argptr);
-	va_end(argptr);
+	temp = Sys_FOpen(FS_BuildOSPath(dir->path, dir->gamedir, filename), "rb");
+	if (temp == NULL)
+	{
+		return -1;
+	}
 
-	FS_Write(msg, strlen(msg), h);
+	if (file == NULL)
+	{
+		// just wants to see if file is there
+		int length = FS_FileLength(temp);
+		fclose(temp);
+		return length;
+	}
+
+	*file = FS_HandleForFile();
+	f = &fsh[*file];
+	FS_InitHandle(f);
+
+	f->handleFiles.file.o = temp;
+	Q_strncpyz(f->name, filename, sizeof(f->name));
+	f->zipFile = false;
+
+	if (fs_debug->integer)
+	{
+		Com_Printf("FS_FOpenFileRead: %s (found in '%s/%s')\n", filename,
+				   dir->path, dir->gamedir);
+	}
+
+	return FS_FileLength(f->handleFiles.file.o);
 }
 
-#define PK3_SEEK_BUFFER_SIZE 65536
+/*
+===========
+FS_FOpenFileRead
+
+Finds the file in the search path.
+Returns filesize and an open FILE pointer.
+Used for streaming data out of either a
+separate file or a ZIP file.
+===========
+*/
+extern bool com_fullyInitialized;
+
+int FS_FOpenFileRead(const char *filename, fileHandle_t *file, bool uniqueFILE)
+{
+	const searchpath_t *search;
+	char *netpath;
+	pack_t *pak;
+	fileInPack_t *pakFile;
+	directory_t *dir;
+	long hash;
+	long fullHash;
+	FILE *temp;
+	int length;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+	}
+
+	if (!filename)
+	{
+		Com_Error(ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed\n");
+	}
+
+	// qpaths are not supposed to have a leading slash
+	if (filename[0] == '/' || filename[0] == '\\')
+	{
+		filename++;
+	}
+
+	// make absolutely sure that it can't back up the path.
+	// The searchpaths do guarantee that something will always
+	// be prepended, so we don't need to worry about "c:" or "//limbo"
+	if (FS_CheckDirTraversal(filename))
+	{
+		*file = FS_INVALID_HANDLE;
+		return -1;
+	}
+
+	// we will calculate full hash only once then just mask it by current pack->hashSize
+	// we can do that as long as we know properties of our hash function
+	fullHash = FS_HashFileName(filename, 0U);
+
+	if (file == NULL)
+	{
+		// just wants to see if file is there
+		if (!fs_index.disabled)
+		{
+			pakFile = NULL;
+			search = FS_IndexFind(filename, fullHash, &pakFile);
+			if (search && search->pack)
+				return pakFile->size;
+			if (search == NULL)
+				return -1;
+			// directory listing may be outdated or inconclusive
+			if ((length = FS_OpenFileInDir(NULL, search, filename)) >= 0)
+				return length;
+		}
+		for (search = fs_searchpaths; search; search = search->next)
+		{
+			// is the element a pak file?
+			if (search->pack && search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
+			{
+				// skip non-pure files
+				if (!FS_PakIsPure(search->pack))
+					continue;
+				// look through all the pak file elements
+				pak = search->pack;
+				pakFile = pak->hashTable[hash];
+				do
+				{
+					// case and separator insensitive comparisons
+					if (!FS_FilenameCompare(pakFile->name, filename))
+					{
+						// found it!
+						return pakFile->size;
+					}
+					pakFile = pakFile->next;
+				} while (pakFile != NULL);
+			}
+			else if (search->dir && search->policy != DIR_DENY)
+			{
+				dir = search->dir;
+				netpath = FS_BuildOSPath(dir->path, dir->gamedir, filename);
+				temp = Sys_FOpen(netpath, "rb");
+				if (temp)
+				{
+					length = FS_FileLength(temp);
+					fclose(temp);
+					return length;
+				}
+			}
+		}
+		return -1;
+	}
+
+	// make sure the q3key file is only readable by the quake3.exe at initialization
+	// any other time the key should only be accessed in memory using the provided functions
+	if (com_fullyInitialized && strstr(filename, "q3key"))
+	{
+		*file = FS_INVALID_HANDLE;
+		return -1;
+	}
+
+	if (!fs_index.disabled)
+	{
+		pakFile = NULL;
+		search = FS_IndexFind(filename, fullHash, &pakFile);
+		if (search && search->pack)
+			return FS_OpenFileInPak(file, search->pack, pakFile, uniqueFILE);
+		if (search && (length = FS_OpenFileInDir(file, search, filename)) >= 0)
+			return length;
+		if (search == NULL)
+			goto notfound;
+	}
+
+	//
+	// search through the path, one element at a time
+	//
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+		// is the element a pak file?
+		if (search->pack && search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
+		{
+			// disregard if it doesn't match one of the allowed pure pak files
+			if (!FS_PakIsPure(search->pack))
+			{
+				continue;
+			}
+			// look through all the pak file elements
+			pak = search->pack;
+			pakFile = pak->hashTable[hash];
+			do
+			{
+				// case and separator insensitive comparisons
+				if (!FS_FilenameCompare(pakFile->name, filename))
+				{
+					// found it!
+					return FS_OpenFileInPak(file, pak, pakFile, uniqueFILE);
+				}
+				pakFile = pakFile->next;
+			} while (pakFile != NULL);
+		}
+		else if (search->dir && search->policy != DIR_DENY)
+		{
+			// check a file in the directory tree
+			if ((length = FS_OpenFileInDir(file, search, filename)) >= 0)
+			{
+				return length;
+			}
+		}
+	}
+
+notfound:
+#ifdef FS_MISSING
+	if (missingFiles)
+	{
+		fprintf(missingFiles, "%s\n", filename);
+	}
+#endif
+
+	*file = FS_INVALID_HANDLE;
+	return -1;
+}
+
+/*
+===========
+FS_TouchFileInPak
+===========
+*/
+void FS_TouchFileInPak(const char *filename)
+{
+	const searchpath_t *search;
+	long fullHash, hash;
+	pack_t *pak;
+	fileInPack_t *pakFile;
+
+	fullHash = FS_HashFileName(filename, 0U);
+
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+
+		// is the element a pak file?
+		if (!search->pack)
+			continue;
+
+		if (search->pack->exclude) // skip paks in \fs_excludeReference list
+			continue;
+
+		if (search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
+		{
+			pak = search->pack;
+			pakFile = pak->hashTable[hash];
+			do
+			{
+				// case and separator insensitive comparisons
+				if (!FS_FilenameCompare(pakFile->name, filename))
+				{
+					// found it!
+					if (!(pak->referenced & FS_GENERAL_REF) && FS_GeneralRef(filename))
+					{
+						pak->referenced |= FS_GENERAL_REF;
+					}
+					if (!(pak->referenced & FS_CGAME_REF) && !strcmp(filename, "vm/cgame.qvm"))
+					{
+						pak->referenced |= FS_CGAME_REF;
+					}
+					if (!(pak->referenced & FS_UI_REF) && !strcmp(filename, "vm/ui.qvm"))
+					{
+						pak->referenced |= FS_UI_REF;
+					}
+					return;
+				}
+				pakFile = pakFile->next;
+			} while (pakFile != NULL);
+		}
+	}
+}
+
+/*
+===========
+FS_Home_FOpenFileRead
+===========
+*/
+int FS_Home_FOpenFileRead(const char *filename, fileHandle_t *file)
+{
+	char path[MAX_OSPATH * 3 + 1];
+	fileHandleData_t *fd;
+	fileHandle_t f;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+	}
+
+	// should never happen but for safe
+	if (!file)
+	{
+		return -1;
+	}
+
+	// allocate new file handle
+	f = FS_HandleForFile();
+	fd = &fsh[f];
+	FS_InitHandle(fd);
+
+	Com_sprintf(path, sizeof(path), "%s%c%s%c%s", fs_homepath->string,
+				PATH_SEP, fs_gamedir, PATH_SEP, filename);
+
+	if (fs_debug->integer)
+	{
+		Com_Printf("%s: %s\n", __func__, path);
+	}
+
+	fd->handleFiles.file.o = Sys_FOpen(path, "rb");
+	if (fd->handleFiles.file.o != NULL)
+	{
+		Q_strncpyz(fd->name, filename, sizeof(fd->name));
+		fd->handleSync = false;
+		fd->zipFile = false;
+		*file = f;
+		return FS_FileLength(fd->handleFiles.file.o);
+	}
+
+	*file = FS_INVALID_HANDLE;
+	return -1;
+}
+
+/*
+=================
+FS_Read
+
+Properly handles partial reads
+=================
+*/
+int FS_Read(void *buffer, int len, fileHandle_t f)
+{
+	int block, remaining;
+	int read;
+	byte *buf;
+	int tries;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+	}
+
+	if (f <= 0 || f >= MAX_FILE_HANDLES)
+	{
+		return 0;
+	}
+
+	buf = (byte *)buffer;
+	fs_readCount += len;
+
+	if (!fsh[f].zipFile)
+	{
+		remaining = len;
+		tries = 0;
+		while (remaining)
+		{
+			block = remaining;
+			read = fread(buf, 1, block, fsh[f].handleFiles.file.o);
+			if (read == 0)
+			{
+				// we might have been trying to read from a CD, which
+				// sometimes returns a 0 read on windows
+				if (!tries)
+				{
+					tries = 1;
+				}
+				else
+				{
+					return len - remaining; // Com_Error (ERR_FATAL, "FS_Read: 0 bytes read");
+				}
+			}
+
+			if (read == -1)
+			{
+				Com_Error(ERR_FATAL, "FS_Read: -1 bytes read");
+			}
+
+			remaining -= read;
+			buf += read;
+		}
+		return len;
+	}
+	else
+	{
+		return unzReadCurrentFile(fsh[f].handleFiles.file.z, buffer, len);
+	}
+}
+
+/*
+=================
+FS_Write
+
+Properly handles partial writes
+=================
+*/
+int FS_Write(const void *buffer, int len, fileHandle_t h)
+{
+	int block, remaining;
+	int written;
+	byte *buf;
+	int tries;
+	FILE *f;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+	}
+
+	// if ( h <= 0 || h >= MAX_FILE_HANDLES ) {
+	//	return 0;
+	// }
+
+	f = FS_FileForHandle(h);
+	buf = (byte *)buffer;
+
+	remaining = len;
+	tries = 0;
+	while (remaining)
+	{
+		block = remaining;
+		written = fwrite(buf, 1, block, f);
+		if (written == 0)
+		{
+			if (!tries)
+			{
+				tries = 1;
+			}
+			else
+			{
+				Com_Printf("FS_Write: 0 bytes written\n");
+				return 0;
+			}
+		}
+
+		if (written == -1)
+		{
+			Com_Printf("FS_Write: -1 bytes written\n");
+			return 0;
+		}
+
+		remaining -= written;
+		buf += written;
+	}
+	if (fsh[h].handleSync)
+	{
+		fflush(f);
+	}
+	return len;
+}
+
+void QDECL FS_Printf(fileHandle_t h, const char *fmt, ...)
+{
+	va_list argptr;
+	char msg[MAXPRINTMSG];
+
+	va_start(argptr, fmt);
+	Q_vsnprintf(msg, sizeof(msg), fmt, argptr);
+	va_end(argptr);
+
+	FS_Write(msg, strlen(msg), h);
+}
+
+#define PK3_SEEK_BUFFER_SIZE 65536
+
+/*
+=================
+FS_Seek
+
+=================
+*/
+int FS_Seek(fileHandle_t f, long offset, fsOrigin_t origin)
+{
+	int _origin;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+		return -1;
+	}
+
+	if (fsh[f].zipFile == true)
+	{
+		// FIXME: this is really, really crappy
+		//(but better than what was here before)
+		byte buffer[PK3_SEEK_BUFFER_SIZE];
+		int remainder;
+		int currentPosition = FS_FTell(f);
+
+		// change negative offsets into FS_SEEK_SET
+		if (offset < 0)
+		{
+			switch (origin)
+			{
+			case FS_SEEK_END:
+				remainder = fsh[f].zipFileLen + offset;
+				break;
+
+			case FS_SEEK_CUR:
+				remainder = currentPosition + offset;
+				break;
+
+			case FS_SEEK_SET:
+			default:
+				remainder = 0;
+				break;
+			}
+
+			if (remainder < 0)
+			{
+				remainder = 0;
+			}
+
+			origin = FS_SEEK_SET;
+		}
+		else
+		{
+			if (origin == FS_SEEK_END)
+			{
+				remainder = fsh[f].zipFileLen - currentPosition + offset;
+			}
+			else
+			{
+				remainder = offset;
+			}
+		}
+
+		switch (origin)
+		{
+		case FS_SEEK_SET:
+			if (remainder == currentPosition)
+			{
+				return offset;
+			}
+			unzSetCurrentFileInfoPosition(fsh[f].handleFiles.file.z, fsh[f].zipFilePos);
+			unzOpenCurrentFile(fsh[f].handleFiles.file.z);
+			// fallthrough
+
+		case FS_SEEK_END:
+		case FS_SEEK_CUR:
+			while (remainder > PK3_SEEK_BUFFER_SIZE)
+			{
+				FS_Read(buffer, PK3_SEEK_BUFFER_SIZE, f);
+				remainder -= PK3_SEEK_BUFFER_SIZE;
+			}
+			FS_Read(buffer, remainder, f);
+			return offset;
+
+		default:
+			Com_Error(ERR_FATAL, "Bad origin in FS_Seek");
+			return -1;
+		}
+	}
+	else
+	{
+		FILE *file;
+		file = FS_FileForHandle(f);
+		switch (origin)
+		{
+		case FS_SEEK_CUR:
+			_origin = SEEK_CUR;
+			break;
+		case FS_SEEK_END:
+			_origin = SEEK_END;
+			break;
+		case FS_SEEK_SET:
+			_origin = SEEK_SET;
+			break;
+		default:
+			Com_Error(ERR_FATAL, "Bad origin in FS_Seek");
+			return -1;
+		}
+
+		return fseek(file, offset, _origin);
+	}
+}
+
+/*
+======================================================================================
+
+CONVENIENCE FUNCTIONS FOR ENTIRE FILES
+
+======================================================================================
+*/
+
+bool FS_FileIsInPAK(const char *filename, int *pChecksum, char *pakName)
+{
+	const searchpath_t *search;
+	const pack_t *pak;
+	const fileInPack_t *pakFile;
+	long hash;
+	long fullHash;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+	}
+
+	if (!filename)
+	{
+		Com_Error(ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed");
+	}
+
+	// qpaths are not supposed to have a leading slash
+	while (filename[0] == '/' || filename[0] == '\\')
+		filename++;
+
+	// make absolutely sure that it can't back up the path.
+	// The searchpaths do guarantee that something will always
+	// be prepended, so we don't need to worry about "c:" or "//limbo"
+	if (FS_CheckDirTraversal(filename))
+	{
+		return false;
+	}
+
+	fullHash = FS_HashFileName(filename, 0U);
+
+	//
+	// search through the path, one element at a time
+	//
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+
+		// is the element a pak file?
+		if (search->pack && search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
+		{
+			// disregard if it doesn't match one of the allowed pure pak files
+			// if ( !FS_PakIsPure( search->pack ) ) {
+			//	continue;
+			//}
+			//
+			if (search->pack->exclude)
+			{
+				continue;
+			}
+
+			// look through all the pak file elements
+			pak = search->pack;
+			pakFile = pak->hashTable[hash];
+			do
+			{
+				// case and separator insensitive comparisons
+				if (!FS_FilenameCompare(pakFile->name, filename))
+				{
+					if (pChecksum)
+					{
+						*pChecksum = pak->pure_checksum;
+					}
+					if (pakName)
+					{
+						Com_sprintf(pakName, MAX_OSPATH, "%s/%s", pak->pakGamename, pak->pakBasename);
+					}
+					return true;
+				}
+				pakFile = pakFile->next;
+			} while (pakFile != NULL);
+		}
+	}
+	return false;
+}
+
+/*
+==========================================================================
+
+MAPPED PAK FILES
+
+Large stored pk3 entries are handed out by FS_ReadFile as copy-on-write
+views of the pk3 file, so pages are read on demand and only pages the
+caller modifies use private memory. Large compressed entries are inflated
+straight from a view into the temp hunk without going through stdio.
+
+==========================================================================
+*/
+
+#define MIN_MAPPED_SIZE 0x10000
+#define MAX_MAPPED_FILES 64
+
+typedef struct
+{
+	byte *data;
+	int length; // mapped length
+} fsMappedFile_t;
+
+static fsMappedFile_t fs_mappedFiles[MAX_MAPPED_FILES];
+static int fs_numMappedFiles;
+
+/*
+============
+FS_ReadMappedFile
+
+Returns NULL if file should be read through its handle
+============
+*/
+static byte *FS_ReadMappedFile(fileHandle_t h, int len)
+{
+	const fileHandleData_t *f = &fsh[h];
+	const file_in_zip_read_info_s *info;
+	int64_t offset;
+	int compressedLen;
+	byte *data, *buf;
+
+	if (!fs_mmap->integer || !f->zipFile || len < MIN_MAPPED_SIZE)
+	{
+		return NULL;
+	}
+
+	info = ((unz_s *)f->handleFiles.file.z)->pfile_in_zip_read;
+	if (info == NULL || info->rest_read_uncompressed != (unsigned long)len)
+	{
+		return NULL;
+	}
+
+	offset = (int64_t)info->pos_in_zipfile + info->byte_before_the_zipfile;
+
+	if (info->compression_method == 0)
+	{
+		if (fs_numMappedFiles == MAX_MAPPED_FILES)
+		{
+			return NULL;
+		}
+		// there is always a header or central directory after file data,
+		// so the view can cover the trailing zero
+		data = Sys_MapFileRange(f->pak->pakFilename, offset, len + 1);
+		if (data == NULL)
+		{
+			return NULL;
+		}
+		data[len] = '\0';
+		fs_mappedFiles[fs_numMappedFiles].data = data;
+		fs_mappedFiles[fs_numMappedFiles].length = len + 1;
+		fs_numMappedFiles++;
+		return data;
+	}
+
+	compressedLen = (int)info->rest_read_compressed;
+	data = Sys_MapFileRange(f->pak->pakFilename, offset, compressedLen);
+	if (data == NULL)
+	{
+		return NULL;
+	}
+
+	buf = Hunk_AllocateTempMemory(len + 1);
+	if (unzInflateBuffer(buf, len, data, compressedLen) != len)
+	{
+		Com_Printf(S_COLOR_YELLOW "Error inflating %s from %s\n", f->name, f->pak->pakFilename);
+		Hunk_FreeTempMemory(buf);
+		buf = NULL;
+	}
+	else
+	{
+		buf[len] = '\0';
+	}
+
+	Sys_UnmapFileRange(data, compressedLen);
+
+	return buf;
+}
+
+/*
+============
+FS_FreeMappedFile
+
+Returns false if buffer is not a mapped file
+============
+*/
+static bool FS_FreeMappedFile(void *buffer)
+{
+	int i;
+
+	for (i = 0; i < fs_numMappedFiles; i++)
+	{
+		if (fs_mappedFiles[i].data == buffer)
+		{
+			Sys_UnmapFileRange(fs_mappedFiles[i].data, fs_mappedFiles[i].length);
+			fs_mappedFiles[i] = fs_mappedFiles[--fs_numMappedFiles];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+==========================================================================
+
+ASYNCHRONOUS READS
+
+FS_ReadFileAsync() and FS_PrefetchFile() look files up on the main thread
+through FS_FOpenFileRead(), so pure checks and pak references are the same
+as for FS_ReadFile(). The I/O thread then reads and inflates file data into
+malloc'ed memory, it never touches the zone, hunk or search paths.
+
+Callbacks are called by FS_CompleteAsyncReads() on the main thread, which
+runs every frame. Prefetched files are kept until FS_ReadFile() asks for
+them or FS_FlushPrefetches() drops them. Buffers handed out either way are
+released with FS_FreeFile().
+
+Without the I/O thread requests are read when they are queued, callbacks
+are still called from FS_CompleteAsyncReads().
+
+==========================================================================
+*/
+
+#define MAX_ASYNC_READS 256
+#define MAX_ASYNC_BUFFERS 256
+#define MAX_PREFETCH_BYTES (64 * 1024 * 1024)
+
+typedef enum
+{
+	ASYNC_FREE,
+	ASYNC_QUEUED,
+	ASYNC_READING,
+	ASYNC_DONE
+} fsAsyncState_t;
+
+typedef struct
+{
+	fsAsyncState_t state;
+	int seq;
+	int generation;
+
+	char qpath[MAX_QPATH];
+	char pakFilename[MAX_OSPATH];
+	int pakIndex;
+	FILE *file;			// files in directories are read through the opened FILE
+	int64_t offset;		// of entry data in the pk3 file
+	int compressedLen;	// 0 for stored entries
+	int length;
+	bool mapped;		// read through a mapped view
+	byte *data;			// NULL if reading failed
+
+	fsReadCallback_t callback; // NULL for prefetches
+	void *userData;
+} fsAsyncRead_t;
+
+static struct
+{
+	fsAsyncRead_t reads[MAX_ASYNC_READS];
+	int numReads;
+	int prefetchBytes;
+	int seq;
+	int generation; // bumped when prefetched data may be outdated
+
+	byte *buffers[MAX_ASYNC_BUFFERS]; // handed out, released by FS_FreeFile
+	int numBuffers;
+
+	void *thread;
+	void *mutex;
+	void *wake;
+	void *done;
+	bool shutdown;
+	bool failed;
+} fs_async;
+
+/*
+============
+FS_InvalidatePrefetches
+============
+*/
+static void FS_InvalidatePrefetches(void)
+{
+	fs_async.generation++;
+}
+
+/*
+============
+FS_AsyncLoad
+
+Runs on the I/O thread, must not use anything but malloc and OS calls
+============
+*/
+static byte *FS_AsyncLoad(fsAsyncRead_t *r)
+{
+	byte *buf, *data;
+	FILE *f;
+	int len;
+
+	buf = malloc(r->length + 1);
+	if (buf == NULL)
+	{
+		return NULL;
+	}
+
+	if (r->file)
+	{
+		len = (int)fread(buf, 1, r->length, r->file);
+		fclose(r->file);
+		r->file = NULL;
+		if (len != r->length)
+		{
+			free(buf);
+			return NULL;
+		}
+		buf[r->length] = '\0';
+		return buf;
+	}
+
+	len = r->compressedLen ? r->compressedLen : r->length;
+
+	data = r->mapped ? Sys_MapFileRange(r->pakFilename, r->offset, len) : NULL;
+	if (data)
+	{
+		if (!r->compressedLen)
+		{
+			Com_Memcpy(buf, data, len);
+		}
+		else if (unzInflateBuffer(buf, r->length, data, len) != r->length)
+		{
+			free(buf);
+			buf = NULL;
+		}
+		Sys_UnmapFileRange(data, len);
+	}
+	else
+	{
+		// read through stdio
+		data = r->compressedLen ? malloc(len) : buf;
+		f = Sys_FOpen(r->pakFilename, "rb");
+		if (!data || !f || fseek(f, (long)r->offset, SEEK_SET) != 0 || fread(data, 1, len, f) != (size_t)len)
+		{
+			free(buf);
+			buf = NULL;
+		}
+		else if (r->compressedLen && unzInflateBuffer(buf, r->length, data, len) != r->length)
+		{
+			free(buf);
+			buf = NULL;
+		}
+		if (r->compressedLen)
+		{
+			free(data);
+		}
+		if (f)
+		{
+			fclose(f);
+		}
+	}
+
+	if (buf)
+	{
+		buf[r->length] = '\0';
+	}
+
+	return buf;
+}
+
+/*
+============
+FS_AsyncThread
+============
+*/
+static void FS_AsyncThread(void *arg)
+{
+	fsAsyncRead_t *r, *next;
+	byte *data;
+	int i;
+
+	Sys_LockMutex(fs_async.mutex);
+	while (!fs_async.shutdown)
+	{
+		// oldest request first
+		next = NULL;
+		for (i = 0, r = fs_async.reads; i < MAX_ASYNC_READS; i++, r++)
+		{
+			if (r->state == ASYNC_QUEUED && (!next || r->seq - next->seq < 0))
+			{
+				next = r;
+			}
+		}
+
+		if (!next)
+		{
+			Sys_WaitCond(fs_async.wake, fs_async.mutex);
+			continue;
+		}
+
+		next->state = ASYNC_READING;
+		Sys_UnlockMutex(fs_async.mutex);
+
+		data = FS_AsyncLoad(next);
+
+		Sys_LockMutex(fs_async.mutex);
+		next->data = data;
+		next->state = ASYNC_DONE;
+		Sys_BroadcastCond(fs_async.done);
+	}
+	Sys_UnlockMutex(fs_async.mutex);
+}
+
+/*
+============
+FS_StartAsyncThread
+
+Returns false if requests should be read on the main thread
+============
+*/
+static bool FS_StartAsyncThread(void)
+{
+	if (fs_async.thread)
+	{
+		return true;
+	}
+
+	if (!fs_asyncRead->integer || fs_async.failed)
+	{
+		return false;
+	}
+
+	fs_async.mutex = Sys_CreateMutex();
+	fs_async.wake = Sys_CreateCond();
+	fs_async.done = Sys_CreateCond();
+	if (fs_async.mutex && fs_async.wake && fs_async.done)
+	{
+		fs_async.thread = Sys_CreateThread(FS_AsyncThread, NULL);
+	}
+
+	if (!fs_async.thread)
+	{
+		Com_Printf(S_COLOR_YELLOW "WARNING: couldn't start file I/O thread, reading files synchronously\n");
+		if (fs_async.mutex)
+			Sys_DestroyMutex(fs_async.mutex);
+		if (fs_async.wake)
+			Sys_DestroyCond(fs_async.wake);
+		if (fs_async.done)
+			Sys_DestroyCond(fs_async.done);
+		fs_async.mutex = fs_async.wake = fs_async.done = NULL;
+		fs_async.failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+============
+FS_LockAsync
+============
+*/
+static void FS_LockAsync(void)
+{
+	if (fs_async.thread)
+	{
+		Sys_LockMutex(fs_async.mutex);
+	}
+}
+
+/*
+============
+FS_UnlockAsync
+============
+*/
+static void FS_UnlockAsync(void)
+{
+	if (fs_async.thread)
+	{
+		Sys_UnlockMutex(fs_async.mutex);
+	}
+}
+
+/*
+============
+FS_FinishAsyncRead
+
+Waits for the request, reads it right away if the thread didn't start it yet.
+Must be called with the lock held.
+============
+*/
+static void FS_FinishAsyncRead(fsAsyncRead_t *r)
+{
+	byte *data;
+
+	if (r->state == ASYNC_QUEUED)
+	{
+		r->state = ASYNC_READING;
+		FS_UnlockAsync();
+		data = FS_AsyncLoad(r);
+		FS_LockAsync();
+		r->data = data;
+		r->state = ASYNC_DONE;
+		return;
+	}
+
+	while (r->state != ASYNC_DONE)
+	{
+		Sys_WaitCond(fs_async.done, fs_async.mutex);
+	}
+}
+
+/*
+============
+FS_ReleaseAsyncRead
+
+Request must be finished, must be called with the lock held
+============
+*/
+static void FS_ReleaseAsyncRead(fsAsyncRead_t *r)
+{
+	if (r->file)
+	{
+		fclose(r->file);
+	}
+	if (r->data)
+	{
+		free(r->data);
+	}
+	if (!r->callback)
+	{
+		fs_async.prefetchBytes -= r->length;
+	}
+	fs_async.numReads--;
+
+	Com_Memset(r, 0, sizeof(*r));
+}
+
+/*
+============
+FS_HandOutAsyncRead
+
+Transfers request data to the caller like FS_ReadFile would
+============
+*/
+static byte *FS_HandOutAsyncRead(fsAsyncRead_t *r)
+{
+	byte *buf;
+
+	if (fs_async.numBuffers < MAX_ASYNC_BUFFERS)
+	{
+		buf = r->data;
+		fs_async.buffers[fs_async.numBuffers++] = buf;
+	}
+	else
+	{
+		buf = Hunk_AllocateTempMemory(r->length + 1);
+		Com_Memcpy(buf, r->data, r->length + 1);
+		free(r->data);
+	}
+	r->data = NULL;
+
+	fs_lastPakIndex = r->pakIndex;
+	fs_readCount += r->length;
+	fs_loadCount++;
+	fs_loadStack++;
+
+	return buf;
+}
+
+/*
+============
+FS_FreeAsyncBuffer
+
+Returns false if buffer was not handed out by an asynchronous read
+============
+*/
+static bool FS_FreeAsyncBuffer(void *buffer)
+{
+	int i;
+
+	for (i = 0; i < fs_async.numBuffers; i++)
+	{
+		if (fs_async.buffers[i] == buffer)
+		{
+			free(buffer);
+			fs_async.buffers[i] = fs_async.buffers[--fs_async.numBuffers];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+============
+FS_QueueAsyncRead
+
+Returns file length, -1 if file was not found
+============
+*/
+static int FS_QueueAsyncRead(const char *qpath, fsReadCallback_t callback, void *userData)
+{
+	const file_in_zip_read_info_s *info;
+	fileHandleData_t *f;
+	fsAsyncRead_t *r;
+	fileHandle_t h;
+	long len;
+	int i;
+
+	for (i = 0, r = fs_async.reads; i < MAX_ASYNC_READS; i++, r++)
+	{
+		if (r->state == ASYNC_FREE)
+			break;
+	}
+	if (i == MAX_ASYNC_READS)
+	{
+		return -2;
+	}
+
+	len = FS_FOpenFileRead(qpath, &h, false);
+	if (h == FS_INVALID_HANDLE)
+	{
+		return -1;
+	}
+
+	f = &fsh[h];
+	if (f->zipFile)
+	{
+		info = ((unz_s *)f->handleFiles.file.z)->pfile_in_zip_read;
+		if (info == NULL || info->rest_read_uncompressed != (unsigned long)len)
+		{
+			FS_FCloseFile(h);
+			return -2;
+		}
+		r->offset = (int64_t)info->pos_in_zipfile + info->byte_before_the_zipfile;
+		r->compressedLen = info->compression_method ? (int)info->rest_read_compressed : 0;
+		Q_strncpyz(r->pakFilename, f->pak->pakFilename, sizeof(r->pakFilename));
+		r->pakIndex = f->pak->index;
+	}
+	else
+	{
+		// take the opened FILE from the handle
+		r->file = f->handleFiles.file.o;
+		f->handleFiles.file.o = NULL;
+		r->pakIndex = -1;
+	}
+	FS_FCloseFile(h);
+
+	Q_strncpyz(r->qpath, qpath, sizeof(r->qpath));
+	r->length = len;
+	r->mapped = fs_mmap->integer != 0;
+	r->callback = callback;
+	r->userData = userData;
+	r->generation = fs_async.generation;
+	r->seq = fs_async.seq++;
+	fs_async.numReads++;
+
+	if (!FS_StartAsyncThread())
+	{
+		r->data = FS_AsyncLoad(r);
+		r->state = ASYNC_DONE;
+		return len;
+	}
+
+	Sys_LockMutex(fs_async.mutex);
+	r->state = ASYNC_QUEUED;
+	Sys_BroadcastCond(fs_async.wake);
+	Sys_UnlockMutex(fs_async.mutex);
+
+	return len;
+}
+
+/*
+============
+FS_ReadFileAsync
+
+Returns file length or -1 if file was not found, callback is not called then
+============
+*/
+int FS_ReadFileAsync(const char *qpath, fsReadCallback_t callback, void *userData)
+{
+	void *buf;
+	int len;
+
+	if (!fs_searchpaths)
+	{
+		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
+	}
+
+	if (!qpath || !qpath[0] || !callback)
+	{
+		Com_Error(ERR_FATAL, "FS_ReadFileAsync with empty name or no callback");
+	}
+
+	// journaled config files go through FS_ReadFile
+	len = com_journalDataFile != FS_INVALID_HANDLE ? -2 : FS_QueueAsyncRead(qpath, callback, userData);
+	if (len != -2)
+	{
+		return len;
+	}
+
+	// can't be queued, read it now
+	len = FS_ReadFile(qpath, &buf);
+	if (buf)
+	{
+		callback(qpath, buf, len, userData);
+	}
+
+	return len;
+}
+
+/*
+============
+FS_PrefetchFile
+
+Starts reading a file that FS_ReadFile will be asked for soon,
+returns false if file was not found or can't be prefetched
+============
+*/
+bool FS_PrefetchFile(const char *qpath)
+{
+	fsAsyncRead_t *r;
+	int i, len;
+
+	if (!fs_searchpaths || !qpath || !qpath[0] || com_journalDataFile != FS_INVALID_HANDLE)
+	{
+		return false;
+	}
+
+	// prefetching only makes sense with the thread
+	if (fs_async.prefetchBytes >= MAX_PREFETCH_BYTES || !FS_StartAsyncThread())
+	{
+		return false;
+	}
+
+	for (i = 0, r = fs_async.reads; i < MAX_ASYNC_READS; i++, r++)
+	{
+		if (r->state != ASYNC_FREE && !r->callback && r->generation == fs_async.generation && !Q_stricmp(r->qpath, qpath))
+		{
+			return true;
+		}
+	}
+
+	len = FS_QueueAsyncRead(qpath, NULL, NULL);
+	if (len < 0)
+	{
+		return false;
+	}
+
+	fs_async.prefetchBytes += len;
+
+	return true;
+}
 
 /*
-=================
-FS_Seek
+============
+FS_ReadPrefetchedFile
 
-=================
+Returns -1 if file was not prefetched or prefetched data is outdated
+============
 */
-int FS_Seek(fileHandle_t f, long offset, fsOrigin_t origin)
+static int FS_ReadPrefetchedFile(const char *qpath, void **buffer)
 {
-	int _origin;
+	fsAsyncRead_t *r;
+	int i, len;
 
-	if (!fs_searchpaths)
+	if (!fs_async.numReads)
 	{
-		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
 		return -1;
 	}
 
-	if (fsh[f].zipFile == true)
+	for (i = 0, r = fs_async.reads; i < MAX_ASYNC_READS; i++, r++)
 	{
-		// FIXME: this is really, really crappy
-		//(but better than what was here before)
-		byte buffer[PK3_SEEK_BUFFER_SIZE];
-		int remainder;
-		int currentPosition = FS_FTell(f);
+		if (r->state != ASYNC_FREE && !r->callback && !Q_stricmp(r->qpath, qpath))
+			break;
+	}
+	if (i == MAX_ASYNC_READS)
+	{
+		return -1;
+	}
 
-		// change negative offsets into FS_SEEK_SET
-		if (offset < 0)
-		{
-			switch (origin)
-			{
-			case FS_SEEK_END:
-				remainder = fsh[f].zipFileLen + offset;
-				break;
+	FS_LockAsync();
+	FS_FinishAsyncRead(r);
+	if (r->data && r->generation == fs_async.generation)
+	{
+		len = r->length;
+		*buffer = FS_HandOutAsyncRead(r);
+	}
+	else
+	{
+		len = -1;
+	}
+	FS_ReleaseAsyncRead(r);
+	FS_UnlockAsync();
 
-			case FS_SEEK_CUR:
-				remainder = currentPosition + offset;
-				break;
+	return len;
+}
 
-			case FS_SEEK_SET:
-			default:
-				remainder = 0;
-				break;
-			}
+/*
+============
+FS_FlushPrefetches
 
-			if (remainder < 0)
-			{
-				remainder = 0;
-			}
+Drops prefetched files nobody asked for
+============
+*/
+void FS_FlushPrefetches(void)
+{
+	fsAsyncRead_t *r;
+	int i;
 
-			origin = FS_SEEK_SET;
+	FS_LockAsync();
+	for (i = 0, r = fs_async.reads; i < MAX_ASYNC_READS; i++, r++)
+	{
+		if (r->state == ASYNC_FREE || r->callback)
+			continue;
+
+		if (r->state == ASYNC_QUEUED)
+		{
+			r->state = ASYNC_DONE;
 		}
 		else
 		{
-			if (origin == FS_SEEK_END)
-			{
-				remainder = fsh[f].zipFileLen - currentPosition + offset;
-			}
-			else
-			{
-				remainder = offset;
-			}
+			FS_FinishAsyncRead(r);
 		}
+		FS_ReleaseAsyncRead(r);
+	}
+	FS_UnlockAsync();
+}
 
-		switch (origin)
+/*
+============
+FS_CompleteAsyncReads
+
+Calls callbacks of finished reads, waits for all reads if wait is set
+============
+*/
+void FS_CompleteAsyncReads(bool wait)
+{
+	fsAsyncRead_t *r, *next;
+	fsReadCallback_t callback;
+	void *userData, *buf;
+	char qpath[MAX_QPATH];
+	int i, len, pending;
+
+	while (fs_async.numReads)
+	{
+		FS_LockAsync();
+
+		next = NULL;
+		pending = 0;
+		for (i = 0, r = fs_async.reads; i < MAX_ASYNC_READS; i++, r++)
 		{
-		case FS_SEEK_SET:
-			if (remainder == currentPosition)
-			{
-				return offset;
-			}
-			unzSetCurrentFileInfoPosition(fsh[f].handleFiles.file.z, fsh[f].zipFilePos);
-			unzOpenCurrentFile(fsh[f].handleFiles.file.z);
-			// fallthrough
+			if (r->state == ASYNC_FREE || !r->callback)
+				continue;
+			if (r->state != ASYNC_DONE)
+				pending++;
+			else if (!next || r->seq - next->seq < 0)
+				next = r;
+		}
 
-		case FS_SEEK_END:
-		case FS_SEEK_CUR:
-			while (remainder > PK3_SEEK_BUFFER_SIZE)
+		if (!next)
+		{
+			if (wait && pending)
 			{
-				FS_Read(buffer, PK3_SEEK_BUFFER_SIZE, f);
-				remainder -= PK3_SEEK_BUFFER_SIZE;
+				Sys_WaitCond(fs_async.done, fs_async.mutex);
+				FS_UnlockAsync();
+				continue;
 			}
-			FS_Read(buffer, remainder, f);
-			return offset;
+			FS_UnlockAsync();
+			break;
+		}
 
-		default:
-			Com_Error(ERR_FATAL, "Bad origin in FS_Seek");
-			return -1;
+		Q_strncpyz(qpath, next->qpath, sizeof(qpath));
+		callback = next->callback;
+		userData = next->userData;
+		if (next->data)
+		{
+			len = next->length;
+			buf = FS_HandOutAsyncRead(next);
 		}
-	}
-	else
-	{
-		FILE *file;
-		file = FS_FileForHandle(f);
-		switch (origin)
+		else
 		{
-		case FS_SEEK_CUR:
-			_origin = SEEK_CUR;
-			break;
-		case FS_SEEK_END:
-			_origin = SEEK_END;
-			break;
-		case FS_SEEK_SET:
-			_origin = SEEK_SET;
-			break;
-		default:
-			Com_Error(ERR_FATAL, "Bad origin in FS_Seek");
-			return -1;
+			Com_Printf(S_COLOR_YELLOW "WARNING: couldn't read %s\n", qpath);
+			len = -1;
+			buf = NULL;
 		}
+		FS_ReleaseAsyncRead(next);
 
-		return fseek(file, offset, _origin);
+		FS_UnlockAsync();
+
+		// may queue new reads
+		callback(qpath, buf, len, userData);
 	}
 }
 
 /*
-======================================================================================
-
-CONVENIENCE FUNCTIONS FOR ENTIRE FILES
+============
+FS_ShutdownAsync
 
-======================================================================================
+Drops all requests, callbacks of pending reads are not called
+============
 */
-
-bool FS_FileIsInPAK(const char *filename, int *pChecksum, char *pakName)
+static void FS_ShutdownAsync(void)
 {
-	const searchpath_t *search;
-	const pack_t *pak;
-	const fileInPack_t *pakFile;
-	long hash;
-	long fullHash;
+	int i;
 
-	if (!fs_searchpaths)
+	if (fs_async.thread)
 	{
-		Com_Error(ERR_FATAL, "Filesystem call made without initialization");
-	}
+		Sys_LockMutex(fs_async.mutex);
+		fs_async.shutdown = true;
+		Sys_BroadcastCond(fs_async.wake);
+		Sys_UnlockMutex(fs_async.mutex);
 
-	if (!filename)
-	{
-		Com_Error(ERR_FATAL, "FS_FOpenFileRead: NULL 'filename' parameter passed");
-	}
+		Sys_JoinThread(fs_async.thread);
 
-	// qpaths are not supposed to have a leading slash
-	while (filename[0] == '/' || filename[0] == '\\')
-		filename++;
+		Sys_DestroyMutex(fs_async.mutex);
+		Sys_DestroyCond(fs_async.wake);
+		Sys_DestroyCond(fs_async.done);
 
-	// make absolutely sure that it can't back up the path.
-	// The searchpaths do guarantee that something will always
-	// be prepended, so we don't need to worry about "c:" or "//limbo"
-	if (FS_CheckDirTraversal(filename))
-	{
-		return false;
+		fs_async.thread = NULL;
+		fs_async.mutex = fs_async.wake = fs_async.done = NULL;
+		fs_async.shutdown = false;
 	}
 
-	fullHash = FS_HashFileName(filename, 0U);
-
-	//
-	// search through the path, one element at a time
-	//
-	for (search = fs_searchpaths; search; search = search->next)
+	for (i = 0; i < MAX_ASYNC_READS; i++)
 	{
-
-		// is the element a pak file?
-		if (search->pack && search->pack->hashTable[(hash = fullHash & (search->pack->hashSize - 1))])
+		if (fs_async.reads[i].state != ASYNC_FREE)
 		{
-			// disregard if it doesn't match one of the allowed pure pak files
-			// if ( !FS_PakIsPure( search->pack ) ) {
-			//	continue;
-			//}
-			//
-			if (search->pack->exclude)
-			{
-				continue;
-			}
-
-			// look through all the pak file elements
-			pak = search->pack;
-			pakFile = pak->hashTable[hash];
-			do
-			{
-				// case and separator insensitive comparisons
-				if (!FS_FilenameCompare(pakFile->name, filename))
-				{
-					if (pChecksum)
-					{
-						*pChecksum = pak->pure_checksum;
-					}
-					if (pakName)
-					{
-						Com_sprintf(pakName, MAX_OSPATH, "%s/%s", pak->pakGamename, pak->pakBasename);
-					}
-					return true;
-				}
-				pakFile = pakFile->next;
-			} while (pakFile != NULL);
+			FS_ReleaseAsyncRead(&fs_async.reads[i]);
 		}
 	}
-	return false;
+
+	fs_async.failed = false;
 }
 
 /*
@@ -2320,6 +3800,15 @@ int FS_ReadFile(const char *qpath, void **buffer)
 		}
 	}
 
+	if (buffer && !isConfig)
+	{
+		len = FS_ReadPrefetchedFile(qpath, buffer);
+		if (len >= 0)
+		{
+			return len;
+		}
+	}
+
 	// look for it in the filesystem or pack files
 	len = FS_FOpenFileRead(qpath, &h, false);
 	if (h == FS_INVALID_HANDLE)
@@ -2351,16 +3840,26 @@ int FS_ReadFile(const char *qpath, void **buffer)
 		return len;
 	}
 
-	buf = Hunk_AllocateTempMemory(len + 1);
-	*buffer = buf;
+	buf = isConfig ? NULL : FS_ReadMappedFile(h, len);
+	if (buf)
+	{
+		*buffer = buf;
+		fs_readCount += len;
+	}
+	else
+	{
+		buf = Hunk_AllocateTempMemory(len + 1);
+		*buffer = buf;
 
-	FS_Read(buf, len, h);
+		FS_Read(buf, len, h);
+
+		// guarantee that it will have a trailing 0 for string operations
+		buf[len] = '\0';
+	}
 
 	fs_loadCount++;
 	fs_loadStack++;
 
-	// guarantee that it will have a trailing 0 for string operations
-	buf[len] = '\0';
 	FS_FCloseFile(h);
 
 	// if we are journaling and it is a config file, write it to the journal file
@@ -2391,7 +3890,10 @@ void FS_FreeFile(void *buffer)
 	}
 	fs_loadStack--;
 
-	Hunk_FreeTempMemory(buffer);
+	if (!FS_FreeAsyncBuffer(buffer) && !FS_FreeMappedFile(buffer))
+	{
+		Hunk_FreeTempMemory(buffer);
+	}
 
 	// if all of our temp files are free, clear all of our space
 	if (fs_loadStack == 0)
@@ -3039,6 +4541,8 @@ static bool FS_SaveCache(void)
 	if (f == NULL)
 		return false;
 
+	FS_IndexDiskChanged();
+
 	FS_WriteCacheHeader(f);
 
 	while (sp != NULL)
@@ -3102,35 +4606,142 @@ static void FS_LoadCache(void)
 
 	fs_cacheLoaded = true;
 
-	Com_Printf("...found %i cached paks\n", fs_paksCached);
-}
+	Com_Printf("...found %i cached paks\n", fs_paksCached);
+}
+
+#endif // USE_PK3_CACHE_FILE
+
+#endif // USE_PK3_CACHE
+
+typedef struct
+{
+	unsigned long pos;	// info position in zip
+	unsigned long size; // uncompressed
+	unsigned long crc;
+	int method;
+	int name; // offset in names
+} fsZipEntry_t;
+
+typedef struct
+{
+	int numEntries;
+	fsZipEntry_t *entries;
+	char *names;
+} fsZipScan_t;
+
+typedef struct
+{
+	char *path;
+	fsZipScan_t *scan;
+} fsZipScanJob_t;
+
+/*
+=================
+FS_ScanZipFile
+
+Reads names, positions and checksums of all entries of a zip file. Uses
+only malloc(), stdio and the scratch arena of the calling thread so paks
+can be scanned on worker threads, release with free()
+=================
+*/
+static fsZipScan_t *FS_ScanZipFile(const char *zipfile)
+{
+	fsZipScan_t *scan;
+	fsZipEntry_t *e;
+	const byte *p, *end;
+	unsigned long offset, size, count, i;
+	int nameLen, extraLen, commentLen, mark;
+	bool scratch;
+	byte *dir;
+	char *name;
+
+	// the central directory is only needed until the names are copied
+	mark = Hunk_ScratchMark();
+
+	dir = unzReadCentralDir(zipfile, &offset, &size, &count, &scratch);
+	if (dir == NULL)
+	{
+		Hunk_ScratchReset(mark);
+		return NULL;
+	}
+
+	// names can't take more space than the central directory
+	scan = malloc(sizeof(*scan) + count * sizeof(scan->entries[0]) + size + count);
+	if (scan == NULL)
+	{
+		if (scratch)
+			Hunk_ScratchReset(mark);
+		else
+			free(dir);
+		return NULL;
+	}
+
+	scan->entries = (fsZipEntry_t *)(scan + 1);
+	scan->names = (char *)(scan->entries + count);
+	scan->numEntries = 0;
+
+	p = dir;
+	end = dir + size;
+	name = scan->names;
+	for (i = 0; i < count; i++)
+	{
+		if (p + SIZE_ZIP_CENTRAL_ITEM > end || memcmp(p, "PK\x01\x02", 4) != 0)
+		{
+			break;
+		}
+
+		nameLen = (unsigned short)LittleShort(*(const short *)(p + 28));
+		extraLen = (unsigned short)LittleShort(*(const short *)(p + 30));
+		commentLen = (unsigned short)LittleShort(*(const short *)(p + 32));
+		if (p + SIZE_ZIP_CENTRAL_ITEM + nameLen > end)
+		{
+			break;
+		}
+
+		e = scan->entries + scan->numEntries++;
+		e->pos = offset + (unsigned long)(p - dir);
+		e->method = (unsigned short)LittleShort(*(const short *)(p + 10));
+		e->crc = LittleLong(*(const int *)(p + 16));
+		e->size = (unsigned int)LittleLong(*(const int *)(p + 24));
+		e->name = (int)(name - scan->names);
+
+		// same limit as unzGetCurrentFileInfo() with MAX_ZPATH buffer
+		Com_Memcpy(name, p + SIZE_ZIP_CENTRAL_ITEM, MIN(nameLen, MAX_ZPATH - 1));
+		name[MIN(nameLen, MAX_ZPATH - 1)] = '\0';
+		name += strlen(name) + 1;
+
+		p += SIZE_ZIP_CENTRAL_ITEM + nameLen + extraLen + commentLen;
+	}
 
-#endif // USE_PK3_CACHE_FILE
+	if (scratch)
+		Hunk_ScratchReset(mark);
+	else
+		free(dir);
 
-#endif // USE_PK3_CACHE
+	return scan;
+}
 
 /*
 =================
 FS_LoadZipFile
 
 Creates a new pak_t in the search chain for the contents
-of a zip file.
+of a zip file, scan is read from zipfile if not provided.
 =================
 */
-static pack_t *FS_LoadZipFile(const char *zipfile)
+static pack_t *FS_LoadZipFile(const char *zipfile, const fsZipScan_t *scan)
 {
+	fsZipScan_t *ownScan;
+	const fsZipEntry_t *e;
 	fileInPack_t *curFile;
 	pack_t *pack;
-	unzFile uf;
-	int err;
-	unz_global_info gi;
 	char filename_inzip[MAX_ZPATH];
-	unz_file_info file_info;
-	unsigned int i, namelen, hashSize, size;
+	unsigned int namelen, hashSize, size;
 	long hash;
 	int fs_numHeaderLongs;
 	int *fs_headerLongs;
-	int filecount;
+	int filecount, i;
+	int64_t start;
 	char *namePtr;
 	const char *basename;
 	int fileNameLen;
@@ -3154,6 +4765,20 @@ static pack_t *FS_LoadZipFile(const char *zipfile)
 	}
 #endif
 
+	ownScan = NULL;
+	if (scan == NULL)
+	{
+		start = Sys_Microseconds();
+		scan = ownScan = FS_ScanZipFile(zipfile);
+		fs_startupTimes.scan += Sys_Microseconds() - start;
+		if (scan == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	start = Sys_Microseconds();
+
 	// extract basename from zip path
 	basename = strrchr(zipfile, PATH_SEP);
 	if (basename == NULL)
@@ -3168,39 +4793,22 @@ static pack_t *FS_LoadZipFile(const char *zipfile)
 	fileNameLen = (int)strlen(zipfile) + 1;
 	baseNameLen = (int)strlen(basename) + 1;
 
-	uf = unzOpen(zipfile);
-	err = unzGetGlobalInfo(uf, &gi);
-
-	if (err != UNZ_OK)
-	{
-		return NULL;
-	}
-
 	namelen = 0;
 	filecount = 0;
-	unzGoToFirstFile(uf);
-	for (i = 0; i < gi.number_entry; i++)
+	for (i = 0, e = scan->entries; i < scan->numEntries; i++, e++)
 	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		filename_inzip[sizeof(filename_inzip) - 1] = '\0';
-		if (err != UNZ_OK)
-		{
-			break;
-		}
-		if (file_info.compression_method != 0 && file_info.compression_method != 8 /*Z_DEFLATED*/)
+		if (e->method != 0 && e->method != 8 /*Z_DEFLATED*/)
 		{
-			Com_Printf(S_COLOR_YELLOW "%s|%s: unsupported compression method %i\n", basename, filename_inzip, (int)file_info.compression_method);
-			unzGoToNextFile(uf);
+			Com_Printf(S_COLOR_YELLOW "%s|%s: unsupported compression method %i\n", basename, scan->names + e->name, e->method);
 			continue;
 		}
-		namelen += strlen(filename_inzip) + 1;
-		unzGoToNextFile(uf);
+		namelen += strlen(scan->names + e->name) + 1;
 		filecount++;
 	}
 
 	if (filecount == 0)
 	{
-		unzClose(uf);
+		free(ownScan);
 		return NULL;
 	}
 
@@ -3218,7 +4826,8 @@ static pack_t *FS_LoadZipFile(const char *zipfile)
 	pack = Z_TagMalloc(size, TAG_PACK);
 	Com_Memset(pack, 0, size);
 
-	pack->handle = uf;
+	// opened on first read, like paks restored from the cache file
+	pack->handle = NULL;
 	pack->numfiles = filecount;
 	pack->hashSize = hashSize;
 	pack->hashTable = (fileInPack_t **)(pack + 1);
@@ -3244,32 +4853,25 @@ static pack_t *FS_LoadZipFile(const char *zipfile)
 	// strip .pk3 if needed
 	FS_StripExt(pack->pakBasename, ".pk3");
 
-	unzGoToFirstFile(uf);
 	curFile = pack->buildBuffer;
-	for (i = 0; i < gi.number_entry; i++)
+	for (i = 0, e = scan->entries; i < scan->numEntries; i++, e++)
 	{
-		err = unzGetCurrentFileInfo(uf, &file_info, filename_inzip, sizeof(filename_inzip), NULL, 0, NULL, 0);
-		filename_inzip[sizeof(filename_inzip) - 1] = '\0';
-		if (err != UNZ_OK)
-		{
-			break;
-		}
-		if (file_info.compression_method != 0 && file_info.compression_method != 8 /*Z_DEFLATED*/)
+		if (e->method != 0 && e->method != 8 /*Z_DEFLATED*/)
 		{
-			unzGoToNextFile(uf);
 			continue;
 		}
-		if (file_info.uncompressed_size > 0)
+		if (e->size > 0)
 		{
-			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(file_info.crc);
+			fs_headerLongs[fs_numHeaderLongs++] = LittleLong(e->crc);
 		}
 
+		Q_strncpyz(filename_inzip, scan->names + e->name, sizeof(filename_inzip));
 		FS_ConvertFilename(filename_inzip);
 		if (!FS_BannedPakFile(filename_inzip))
 		{
 			// store the file position in the zip
-			unzGetCurrentFileInfoPosition(uf, &curFile->pos);
-			curFile->size = file_info.uncompressed_size;
+			curFile->pos = e->pos;
+			curFile->size = e->size;
 			curFile->name = namePtr;
 			strcpy(curFile->name, filename_inzip);
 			namePtr += strlen(filename_inzip) + 1;
@@ -3284,10 +4886,10 @@ static pack_t *FS_LoadZipFile(const char *zipfile)
 		{
 			pack->numfiles--;
 		}
-
-		unzGoToNextFile(uf);
 	}
 
+	free(ownScan);
+
 	pack->checksum = Com_BlockChecksum(fs_headerLongs + 1, sizeof(fs_headerLongs[0]) * (fs_numHeaderLongs - 1));
 	pack->checksum = LittleLong(pack->checksum);
 
@@ -3302,13 +4904,10 @@ static pack_t *FS_LoadZipFile(const char *zipfile)
 	Z_Free(fs_headerLongs);
 #endif
 
-#ifdef USE_HANDLE_CACHE
-	FS_AddToHandleList(pack);
-#else
-	if (fs_locked->integer == 0)
+#ifndef USE_HANDLE_CACHE
+	if (fs_locked->integer)
 	{
-		unzClose(pack->handle);
-		pack->handle = NULL;
+		pack->handle = unzOpen(pack->pakFilename);
 	}
 #endif
 
@@ -3319,9 +4918,104 @@ static pack_t *FS_LoadZipFile(const char *zipfile)
 #endif
 #endif
 
+	fs_startupTimes.build += Sys_Microseconds() - start;
+	fs_startupTimes.paks++;
+
 	return pack;
 }
 
+/*
+=================
+FS_ScanZipJob
+=================
+*/
+static void FS_ScanZipJob(void *data, int index)
+{
+	fsZipScanJob_t *job = (fsZipScanJob_t *)data + index;
+
+	if (job->path)
+	{
+		job->scan = FS_ScanZipFile(job->path);
+	}
+}
+
+/*
+=================
+FS_ScanZipFiles
+
+Reads central directories of paks that are not cached on all job threads,
+returns a scan for each of pakfiles, release with FS_FreeZipScans
+=================
+*/
+static fsZipScanJob_t *FS_ScanZipFiles(const char *path, const char *dir, char **pakfiles, int numfiles)
+{
+	fsZipScanJob_t *jobs;
+	const char *pakfile;
+	int64_t start;
+	int i, count;
+
+	if (numfiles < 2)
+	{
+		return NULL;
+	}
+
+	jobs = Z_Malloc(numfiles * sizeof(jobs[0]));
+
+	for (i = 0, count = 0; i < numfiles; i++)
+	{
+		if (!FS_IsExt(pakfiles[i], ".pk3", strlen(pakfiles[i])))
+		{
+			continue;
+		}
+		pakfile = FS_BuildOSPath(path, dir, pakfiles[i]);
+#ifdef USE_PK3_CACHE
+		if (FS_FindInCache(pakfile))
+		{
+			continue;
+		}
+#endif
+		// worker threads can't use FS_BuildOSPath() buffers
+		jobs[i].path = CopyString(pakfile);
+		count++;
+	}
+
+	if (count)
+	{
+		start = Sys_Microseconds();
+		Com_ParallelFor(FS_ScanZipJob, jobs, numfiles);
+		fs_startupTimes.scan += Sys_Microseconds() - start;
+		fs_startupTimes.threads = Com_JobThreads();
+	}
+
+	return jobs;
+}
+
+/*
+=================
+FS_FreeZipScans
+=================
+*/
+static void FS_FreeZipScans(fsZipScanJob_t *jobs, int numfiles)
+{
+	int i;
+
+	if (jobs == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < numfiles; i++)
+	{
+		if (jobs[i].path)
+		{
+			Z_Free(jobs[i].path);
+		}
+		free(jobs[i].scan);
+	}
+
+	Z_Free(jobs);
+}
+
 /*
 =================
 FS_FreePak
@@ -3356,7 +5050,7 @@ bool FS_CompareZipChecksum(const char *zipfile)
 	pack_t *thepak;
 	int index, checksum;
 
-	thepak = FS_LoadZipFile(zipfile);
+	thepak = FS_LoadZipFile(zipfile, NULL);
 
 	if (!thepak)
 		return false;
@@ -3385,7 +5079,7 @@ int FS_GetZipChecksum(const char *zipfile)
 	pack_t *pak;
 	int checksum;
 
-	pak = FS_LoadZipFile(zipfile);
+	pak = FS_LoadZipFile(zipfile, NULL);
 
 	if (!pak)
 		return 0xFFFFFFFF;
@@ -4396,6 +6090,334 @@ static void FS_Which_f(void)
 	}
 }
 
+/*
+============
+FS_LookupTime
+
+Returns lookups per second, with cold set every pass starts
+without directory listings
+============
+*/
+static double FS_LookupTime(char **names, int count, int *results, bool cold)
+{
+	int64_t start, elapsed;
+	int i, passes;
+
+	passes = 0;
+	elapsed = 0;
+	do
+	{
+		if (cold)
+		{
+			FS_FreeListings();
+		}
+		start = Sys_Microseconds();
+		for (i = 0; i < count; i++)
+		{
+			results[i] = FS_FOpenFileRead(names[i], NULL, false);
+		}
+		elapsed += Sys_Microseconds() - start;
+		passes++;
+	} while (elapsed < 250000);
+
+	return (double)passes * count * 1000000.0 / (double)elapsed;
+}
+
+/*
+============
+FS_LookupBench_f
+
+Times file existence lookups with and without the global file index,
+the index both with directory listings dropped before every pass and
+with listings kept
+============
+*/
+static void FS_LookupBench_f(void)
+{
+	const fsIndexEntry_t *e;
+	char **names;
+	int *cold, *warm, *linear;
+	int i, n, count, step, mismatches;
+	double coldRate, warmRate, linearRate;
+
+	if (!fs_index.valid)
+	{
+		FS_BuildIndex();
+	}
+
+	count = atoi(Cmd_Argv(1));
+	if (count <= 0)
+	{
+		count = 4096;
+	}
+	count = MIN(count, 65536);
+
+	n = 0;
+	for (i = 0; i < fs_index.hashSize; i++)
+	{
+		for (e = fs_index.hashTable[i]; e; e = e->next)
+			n++;
+	}
+	if (n == 0)
+	{
+		Com_Printf("No pak files to sample names from.\n");
+		return;
+	}
+
+	// pak file names, and same names with another extension which are
+	// mostly missing and have to be looked up in every search path
+	names = Z_Malloc(count * (sizeof(names[0]) + MAX_QPATH));
+	step = MAX(n / (count / 2 + 1), 1);
+	for (i = 0; i < count; i++)
+	{
+		e = fs_index.entries + ((i / 2) * step) % n;
+		names[i] = (char *)(names + count) + i * MAX_QPATH;
+		Q_strncpyz(names[i], e->pakFile->name, MAX_QPATH);
+		if (i & 1)
+		{
+			COM_StripExtension(e->pakFile->name, names[i], MAX_QPATH - 4);
+			Q_strcat(names[i], MAX_QPATH, (i & 2) ? ".png" : ".tga");
+		}
+	}
+
+	cold = Z_Malloc(count * 3 * sizeof(int));
+	warm = cold + count;
+	linear = warm + count;
+
+	coldRate = FS_LookupTime(names, count, cold, true);
+	warmRate = FS_LookupTime(names, count, warm, false);
+
+	fs_index.disabled = true;
+	linearRate = FS_LookupTime(names, count, linear, false);
+	fs_index.disabled = false;
+
+	mismatches = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (cold[i] != linear[i] || warm[i] != linear[i])
+		{
+			if (mismatches < 8)
+			{
+				Com_Printf(S_COLOR_YELLOW "mismatch: %s cold %i warm %i linear %i\n", names[i], cold[i], warm[i], linear[i]);
+			}
+			mismatches++;
+		}
+	}
+
+	Com_Printf("%i names, %i indexed pak files, %i directories\n", count, n, fs_index.numDirs);
+	Com_Printf("indexed, cold: %.0f lookups/sec\n", coldRate);
+	Com_Printf("indexed, warm: %.0f lookups/sec\n", warmRate);
+	Com_Printf("linear:        %.0f lookups/sec\n", linearRate);
+	if (mismatches)
+	{
+		Com_Printf(S_COLOR_YELLOW "%i mismatches\n", mismatches);
+	}
+
+	Z_Free(cold);
+	Z_Free(names);
+}
+
+/*
+============
+FS_ReadCompressedEntry
+
+Reads raw deflated data of current pak entry, returns its length or -1 on error
+============
+*/
+static int FS_ReadCompressedEntry(unzFile zip, void *buf)
+{
+	file_in_zip_read_info_s *info;
+	int len;
+
+	if (unzOpenCurrentFile(zip) != UNZ_OK)
+	{
+		return -1;
+	}
+
+	info = ((unz_s *)zip)->pfile_in_zip_read;
+	len = (int)info->rest_read_compressed;
+	if (fseek(info->file, info->pos_in_zipfile + info->byte_before_the_zipfile, SEEK_SET) != 0 ||
+		fread(buf, len, 1, info->file) != 1)
+	{
+		len = -1;
+	}
+
+	unzCloseCurrentFile(zip);
+
+	return len;
+}
+
+/*
+============
+FS_InflateBench_f
+
+Decompresses every deflated entry of loaded pk3 files with zlib inflate
+and with the fast decoder and reports throughput. Entries below the fast
+decoder threshold are skipped, entries it rejects are only counted.
+============
+*/
+static void FS_InflateBench_f(void)
+{
+	const searchpath_t *search;
+	const fileInPack_t *pakFile;
+	const pack_t *pak;
+	unz_file_info info;
+	unzFile zip;
+	byte *cbuf, *zbuf, *fbuf;
+	int64_t zlibTime, fastTime, t1, t2;
+	int64_t compressed, uncompressed;
+	unsigned long maxSize, maxCompressed;
+	int i, j, len, numPaks, numEntries, numSmall, rejected, errors, mismatches;
+
+	maxSize = maxCompressed = 0;
+	numPaks = 0;
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+		if (!search->pack)
+			continue;
+		pak = search->pack;
+		for (j = 1; j < Cmd_Argc(); j++)
+		{
+			if (!Q_stricmp(pak->pakBasename, Cmd_Argv(j)))
+				break;
+		}
+		if (Cmd_Argc() > 1 && j == Cmd_Argc())
+			continue;
+		zip = unzOpen(pak->pakFilename);
+		if (!zip)
+			continue;
+		for (i = 0; i < pak->numfiles; i++)
+		{
+			if (unzSetCurrentFileInfoPosition(zip, pak->buildBuffer[i].pos) != UNZ_OK)
+				continue;
+			if (unzGetCurrentFileInfo(zip, &info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK)
+				continue;
+			if (info.uncompressed_size > maxSize)
+				maxSize = info.uncompressed_size;
+			if (info.compressed_size > maxCompressed)
+				maxCompressed = info.compressed_size;
+		}
+		unzClose(zip);
+		numPaks++;
+	}
+
+	if (!numPaks)
+	{
+		Com_Printf("usage: fs_inflatebench [pak basename ...]\n");
+		return;
+	}
+
+	cbuf = Hunk_AllocateTempMemory(maxCompressed + 1);
+	zbuf = Hunk_AllocateTempMemory(maxSize + 1);
+	fbuf = Hunk_AllocateTempMemory(maxSize + 1);
+
+	zlibTime = fastTime = 0;
+	compressed = uncompressed = 0;
+	numEntries = numSmall = rejected = errors = mismatches = 0;
+
+	// time zlib alone, the fast decoder is called directly below
+	unzSetFastInflate(false);
+
+	for (search = fs_searchpaths; search; search = search->next)
+	{
+		if (!search->pack)
+			continue;
+		pak = search->pack;
+		for (j = 1; j < Cmd_Argc(); j++)
+		{
+			if (!Q_stricmp(pak->pakBasename, Cmd_Argv(j)))
+				break;
+		}
+		if (Cmd_Argc() > 1 && j == Cmd_Argc())
+			continue;
+
+		zip = unzOpen(pak->pakFilename);
+		if (!zip)
+		{
+			Com_Printf(S_COLOR_YELLOW "Couldn't open %s\n", pak->pakFilename);
+			continue;
+		}
+
+		for (i = 0; i < pak->numfiles; i++)
+		{
+			pakFile = pak->buildBuffer + i;
+			if (unzSetCurrentFileInfoPosition(zip, pakFile->pos) != UNZ_OK)
+				continue;
+			if (unzGetCurrentFileInfo(zip, &info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK)
+				continue;
+			if (info.compression_method == 0 || info.uncompressed_size == 0)
+				continue;
+			if (info.uncompressed_size < UNZ_FASTINFLATE_MIN)
+			{
+				// always inflated by zlib
+				numSmall++;
+				continue;
+			}
+
+			len = FS_ReadCompressedEntry(zip, cbuf);
+			if (len < 0)
+			{
+				Com_Printf(S_COLOR_YELLOW "Error reading %s from %s\n", pakFile->name, pak->pakFilename);
+				errors++;
+				continue;
+			}
+
+			t1 = Sys_Microseconds();
+			if (unzInflateBuffer(zbuf, info.uncompressed_size, cbuf, len) != (int)info.uncompressed_size)
+			{
+				Com_Printf(S_COLOR_YELLOW "Error inflating %s from %s\n", pakFile->name, pak->pakFilename);
+				errors++;
+				continue;
+			}
+			t2 = Sys_Microseconds();
+			zlibTime += t2 - t1;
+
+			if (unzFastInflateBuffer(fbuf, info.uncompressed_size, cbuf, len) != (int)info.uncompressed_size)
+			{
+				if (rejected < 8)
+					Com_Printf(S_COLOR_YELLOW "rejected by fast decoder: %s from %s\n", pakFile->name, pak->pakFilename);
+				rejected++;
+				zlibTime -= t2 - t1;
+				continue;
+			}
+			fastTime += Sys_Microseconds() - t2;
+
+			if (memcmp(zbuf, fbuf, info.uncompressed_size) != 0)
+			{
+				if (mismatches < 8)
+					Com_Printf(S_COLOR_YELLOW "mismatch: %s from %s\n", pakFile->name, pak->pakFilename);
+				mismatches++;
+			}
+
+			compressed += len;
+			uncompressed += info.uncompressed_size;
+			numEntries++;
+		}
+
+		unzClose(zip);
+	}
+
+	unzSetFastInflate(true);
+
+	Hunk_FreeTempMemory(fbuf);
+	Hunk_FreeTempMemory(zbuf);
+	Hunk_FreeTempMemory(cbuf);
+
+	Com_Printf("%i deflated entries from %i paks, %.1f MB compressed, %.1f MB uncompressed\n",
+		numEntries, numPaks, compressed / (1024.0 * 1024.0), uncompressed / (1024.0 * 1024.0));
+	Com_Printf("%i entries below %i KB skipped, %i rejected by fast decoder\n",
+		numSmall, UNZ_FASTINFLATE_MIN / 1024, rejected);
+	if (numEntries)
+	{
+		Com_Printf("zlib: %.1f MB/s\n", uncompressed / (double)MAX(zlibTime, 1) * (1000000.0 / (1024.0 * 1024.0)));
+		Com_Printf("fast: %.1f MB/s\n", uncompressed / (double)MAX(fastTime, 1) * (1000000.0 / (1024.0 * 1024.0)));
+	}
+	if (errors || mismatches)
+	{
+		Com_Printf(S_COLOR_YELLOW "%i errors, %i mismatches\n", errors, mismatches);
+	}
+}
+
 //===========================================================================
 
 /*
@@ -4417,6 +6439,7 @@ static void FS_AddGameDirectory(const char *path, const char *dir)
 	char *pakfile;
 	int numfiles;
 	char **pakfiles;
+	fsZipScanJob_t *scans;
 	int pakfilesi;
 	int numdirs;
 	char **pakdirs;
@@ -4467,6 +6490,8 @@ static void FS_AddGameDirectory(const char *path, const char *dir)
 	if (numfiles >= 2)
 		FS_SortFileList(pakfiles, numfiles - 1);
 
+	scans = FS_ScanZipFiles(path, dir, pakfiles, numfiles);
+
 	pakfilesi = 0;
 	pakdirsi = 0;
 
@@ -4517,7 +6542,7 @@ static void FS_AddGameDirectory(const char *path, const char *dir)
 
 			// The next .pk3 file is before the next .pk3dir
 			pakfile = FS_BuildOSPath(path, dir, pakfiles[pakfilesi]);
-			if ((pak = FS_LoadZipFile(pakfile)) == NULL)
+			if ((pak = FS_LoadZipFile(pakfile, scans ? scans[pakfilesi].scan : NULL)) == NULL)
 			{
 				// This isn't a .pk3! Next!
 				pakfilesi++;
@@ -4582,6 +6607,7 @@ static void FS_AddGameDirectory(const char *path, const char *dir)
 	}
 
 	// done
+	FS_FreeZipScans(scans, numfiles);
 	Sys_FreeFileList(pakdirs);
 	Sys_FreeFileList(pakfiles);
 }
@@ -4613,7 +6639,7 @@ bool FS_idPak(const char *pak, const char *base, int numPaks)
 ================
 FS_InvalidGameDir
 return true if path is a reference to current directory or directory traversal
-or a sub-directory
+or a sub-directory, or the vm code cache
 ================
 */
 bool FS_InvalidGameDir(const char *gamedir)
@@ -4623,6 +6649,12 @@ bool FS_InvalidGameDir(const char *gamedir)
 		return true;
 	}
 
+	// native code cache of the vms, see VM_LoadCodeCache
+	if (!Q_stricmp(gamedir, "vmcache"))
+	{
+		return true;
+	}
+
 	return false;
 }
 
@@ -4767,6 +6799,8 @@ void FS_Shutdown(bool closemfp)
 	searchpath_t *p, *next;
 	int i;
 
+	FS_ShutdownAsync();
+
 	// close opened files
 	if (closemfp)
 	{
@@ -4826,6 +6860,10 @@ void FS_Shutdown(bool closemfp)
 	Cmd_RemoveCommand("which");
 	Cmd_RemoveCommand("lsof");
 	Cmd_RemoveCommand("fs_restart");
+	Cmd_RemoveCommand("fs_lookupbench");
+	Cmd_RemoveCommand("fs_inflatebench");
+
+	FS_FreeIndex();
 }
 
 /*
@@ -4891,6 +6929,8 @@ static void FS_ReorderPurePaks(void)
 
 	fs_reordered = false;
 
+	FS_InvalidateIndex();
+
 	// only relevant when connected to pure server
 	if (!fs_numServerPaks)
 		return;
@@ -5047,6 +7087,14 @@ static void FS_Startup(void)
 								   " 1 - keep file handle locked, more consistent, total pk3 files count limited to ~1k-4k\n");
 #endif
 
+	fs_mmap = Cvar_Get("fs_mmap", "1", 0);
+	Cvar_CheckRange(fs_mmap, "0", "1", CV_INTEGER);
+	Cvar_SetDescription(fs_mmap, "Read large pk3 entries through memory mapped views of pk3 files, stored entries are not copied at all.");
+
+	fs_asyncRead = Cvar_Get("fs_asyncRead", "1", 0);
+	Cvar_CheckRange(fs_asyncRead, "0", "1", CV_INTEGER);
+	Cvar_SetDescription(fs_asyncRead, "Read and inflate files requested ahead of time on a background thread.");
+
 	homePath = Sys_DefaultHomePath();
 	if (homePath == NULL || homePath[0] == '\0')
 	{
@@ -5071,6 +7119,7 @@ static void FS_Startup(void)
 						"Format is <moddir>/<pakname> (without .pk3 suffix), you may list multiple entries separated by space.");
 
 	start = Sys_Milliseconds();
+	Com_Memset(&fs_startupTimes, 0, sizeof(fs_startupTimes));
 
 #ifdef USE_PK3_CACHE
 #ifdef USE_PK3_CACHE_FILE
@@ -5145,6 +7194,8 @@ static void FS_Startup(void)
 	// reorder the pure pk3 files according to server order
 	FS_ReorderPurePaks();
 
+	FS_BuildIndex();
+
 	// get the pure checksums of the pk3 files loaded by the server
 	FS_LoadedPakPureChecksums();
 
@@ -5165,10 +7216,17 @@ static void FS_Startup(void)
 	Cmd_AddCommand("which", FS_Which_f);
 	Cmd_SetCommandCompletionFunc("which", FS_CompleteFileName);
 	Cmd_AddCommand("fs_restart", FS_Reload);
+	Cmd_AddCommand("fs_lookupbench", FS_LookupBench_f);
+	Cmd_AddCommand("fs_inflatebench", FS_InflateBench_f);
 
 	// print the current search paths
 	// FS_Path_f();
 	Com_Printf("...loaded in %i milliseconds\n", end - start);
+	if (fs_startupTimes.paks)
+	{
+		Com_Printf("...%i paks read from disk: %i ms scanning on %i threads, %i ms building\n", fs_startupTimes.paks,
+				   (int)(fs_startupTimes.scan / 1000), MAX(fs_startupTimes.threads, 1), (int)(fs_startupTimes.build / 1000));
+	}
 
 	Com_Printf("----------------------\n");
 	Com_Printf("%d files in %d pk3 files\n", fs_packFiles, fs_packCount);
@@ -5598,6 +7656,10 @@ void FS_ClearPakReferences(int flags)
 	{
 		flags = -1;
 	}
+
+	// level change, pick up files other programs added since directories were listed
+	fs_index.generation++;
+
 	for (search = fs_searchpaths; search; search = search->next)
 	{
 		// is the element a pak file and has it been referenced?
@@ -6146,6 +8208,8 @@ fileHandle_t FS_PipeOpenWrite(const char *cmd, const char *filename)
 		return FS_INVALID_HANDLE;
 	}
 
+	FS_IndexDiskChanged();
+
 	Q_strncpyz(fd->name, filename, sizeof(fd->name));
 	fd->handleSync = false;
 	fd->zipFile = false;
@@ -281,17 +281,27 @@ static int Huff_Receive(node_t *node, int *ch, byte *fin) {
 	return (*ch = node->symbol);
 }
 
-/* Send the prefix code for this node */
-static void send(node_t *node, node_t *child, byte *fout) {
-	if (node->parent) {
-		send(node->parent, node, fout);
+/* Send the prefix code for this node, several bits at once */
+static void send(node_t *node, byte *fout) {
+	byte		path[HMAX*2+1];
+	uint32_t	code;
+	int			depth, count, i;
+
+	/* path is collected from the leaf, root bit goes first */
+	depth = 0;
+	for ( ; node->parent; node = node->parent ) {
+		path[depth++] = (node->parent->right == node);
 	}
-	if (child) {
-		if (node->right == child) {
-			add_bit(1, fout);
-		} else {
-			add_bit(0, fout);
+
+	while ( depth > 0 ) {
+		count = depth > 24 ? 24 : depth;
+		code = 0;
+		for ( i = 0; i < count; i++ ) {
+			code |= path[depth - 1 - i] << i;
 		}
+		HuffmanPutBits(fout, bloc, code, count);
+		bloc += count;
+		depth -= count;
 	}
 }
 
@@ -305,7 +315,7 @@ static void Huff_transmit( huff_t *huff, int ch, byte *fout ) {
 			add_bit((char)((ch >> i) & 0x1), fout);
 		}
 	} else {
-		send(huff->loc[ch], NULL, fout);
+		send(huff->loc[ch], fout);
 	}
 }
 
@@ -175,20 +175,35 @@ void HuffmanPutBit( byte* fout, int32_t bitIndex, int bit )
 }
 
 
+// writes up to 24 bits at once, same result as HuffmanPutBit() for each of them
+void HuffmanPutBits( byte* fout, uint32_t offset, uint32_t bits, int count )
+{
+	byte *out = fout + ( offset >> 3 );
+	const uint32_t shift = offset & 7;
+	uint32_t value;
+	int i, numBytes;
+
+	value = ( bits & ( ( 1U << count ) - 1 ) ) << shift;
+
+	// current byte is merged, following ones are overwritten
+	if ( shift )
+		value |= out[0];
+
+	numBytes = ( shift + count + 7 ) >> 3;
+	for ( i = 0; i < numBytes; i++ )
+	{
+		out[ i ] = (byte)( value >> ( i * 8 ) );
+	}
+}
+
+
 int HuffmanPutSymbol( byte* fout, uint32_t offset, int symbol )
 {
-	int32_t bits;
-	uint32_t i;
 	const uint16_t result = HuffmanEncoderTable[ symbol ];
 	const uint16_t bitCount = result & 15;
 	const uint16_t code = (result >> 4) & 0x7FF;
 
-	bits = (int32_t)code;
-	for( i = 0; i < bitCount; ++i )
-	{
-		HuffmanPutBit( fout, offset + i, bits & 1 );
-		bits >>= 1;
-	}
+	HuffmanPutBits( fout, offset, code, bitCount );
 
 	return bitCount;
 }
@@ -200,6 +215,20 @@ int HuffmanGetBit( const byte* buffer, int bitIndex )
 }
 
 
+// reads up to 8 bits at once
+int HuffmanGetBits( const byte* buffer, int bitIndex, int count )
+{
+	const byte *in = buffer + ( bitIndex >> 3 );
+	uint32_t value;
+
+	value = in[0];
+	if ( ( bitIndex & 7 ) + count > 8 )
+		value |= in[1] << 8;
+
+	return ( value >> ( bitIndex & 7 ) ) & ( ( 1U << count ) - 1 );
+}
+
+
 int HuffmanGetSymbol( unsigned int* symbol, const byte* buffer, int bitIndex )
 {
 	const uint16_t code = ((*(const uint32_t*)(buffer + (bitIndex >> 3))) >> ((uint32_t)bitIndex & 7)) & 0x7FF;
@@ -209,3 +238,137 @@ int HuffmanGetSymbol( unsigned int* symbol, const byte* buffer, int bitIndex )
 
 	return (int)(entry >> 8);
 }
+
+
+/*
+=================
+Huff_Benchmark_f
+
+Measures throughput of the static and adaptive huffman coders
+=================
+*/
+#define HUFF_BENCH_BLOCK	8192
+#define HUFF_BENCH_BYTES	(32 * 1024 * 1024)
+
+static double HuffmanRate( int bytes, int64_t usec )
+{
+	if ( usec <= 0 )
+		usec = 1;
+	return (double)bytes / (double)usec; // bytes per usec == MB/s
+}
+
+void Huff_Benchmark_f( void )
+{
+	byte *data, *fileData, *encoded, *compressed;
+	int size, rounds, total, n, i, j, bit, bits;
+	unsigned int sym;
+	int64_t start;
+	bool failed;
+	msg_t msg;
+
+	fileData = NULL;
+	if ( Cmd_Argc() > 1 ) {
+		size = FS_ReadFile( Cmd_Argv( 1 ), (void **)&fileData );
+		if ( size <= 0 ) {
+			Com_Printf( "Couldn't read %s\n", Cmd_Argv( 1 ) );
+			return;
+		}
+		if ( size > HUFF_BENCH_BLOCK ) {
+			size = HUFF_BENCH_BLOCK;
+		}
+	} else {
+		size = HUFF_BENCH_BLOCK;
+	}
+
+	data = Z_Malloc( size );
+	encoded = Z_Malloc( size * 2 + 8 );
+	compressed = Z_Malloc( size * 2 + 16 );
+
+	if ( fileData ) {
+		Com_Memcpy( data, fileData, size );
+		FS_FreeFile( fileData );
+	} else {
+		// skewed towards small values, like the network data
+		for ( i = 0; i < size; i++ ) {
+			data[i] = ( rand() & rand() & rand() ) & 255;
+		}
+	}
+
+	rounds = HUFF_BENCH_BYTES / size;
+	total = rounds * size;
+	failed = false;
+
+	Com_Printf( "%i bytes x %i rounds\n", size, rounds );
+
+	// static encoder, one bit at a time as it used to be
+	start = Sys_Microseconds();
+	for ( n = 0; n < rounds; n++ ) {
+		for ( i = 0, bit = 0; i < size; i++ ) {
+			const uint16_t result = HuffmanEncoderTable[ data[i] ];
+			const int count = result & 15;
+			int code = ( result >> 4 ) & 0x7FF;
+			for ( j = 0; j < count; j++, bit++ ) {
+				HuffmanPutBit( encoded, bit, code & 1 );
+				code >>= 1;
+			}
+		}
+	}
+	Com_Printf( "static encode, bitwise: %7.1f MB/s\n", HuffmanRate( total, Sys_Microseconds() - start ) );
+	bits = bit;
+
+	// static encoder, whole code at once
+	start = Sys_Microseconds();
+	for ( n = 0; n < rounds; n++ ) {
+		for ( i = 0, bit = 0; i < size; i++ ) {
+			bit += HuffmanPutSymbol( encoded, bit, data[i] );
+		}
+	}
+	Com_Printf( "static encode, table:   %7.1f MB/s\n", HuffmanRate( total, Sys_Microseconds() - start ) );
+	if ( bit != bits ) {
+		failed = true;
+	}
+
+	// static decoder, padding for the 32-bit lookahead
+	Com_Memset( encoded + ( ( bit + 7 ) >> 3 ), 0, 4 );
+	start = Sys_Microseconds();
+	for ( n = 0; n < rounds; n++ ) {
+		for ( i = 0, bit = 0; i < size; i++ ) {
+			bit += HuffmanGetSymbol( &sym, encoded, bit );
+			if ( sym != data[i] ) {
+				failed = true;
+			}
+		}
+	}
+	Com_Printf( "static decode, table:   %7.1f MB/s\n", HuffmanRate( total, Sys_Microseconds() - start ) );
+
+	// adaptive coder, as used for connect packets
+	MSG_Init( &msg, compressed, size * 2 + 16 );
+	start = Sys_Microseconds();
+	for ( n = 0; n < rounds; n++ ) {
+		Com_Memcpy( compressed, data, size );
+		msg.cursize = size;
+		Huff_Compress( &msg, 0 );
+	}
+	Com_Printf( "adaptive compress:      %7.1f MB/s\n", HuffmanRate( total, Sys_Microseconds() - start ) );
+
+	Com_Memcpy( encoded, compressed, msg.cursize );
+	bits = msg.cursize;
+	start = Sys_Microseconds();
+	for ( n = 0; n < rounds; n++ ) {
+		Com_Memcpy( compressed, encoded, bits );
+		msg.cursize = bits;
+		Huff_Decompress( &msg, 0 );
+	}
+	Com_Printf( "adaptive decompress:    %7.1f MB/s\n", HuffmanRate( total, Sys_Microseconds() - start ) );
+	if ( msg.cursize != size || memcmp( compressed, data, size ) ) {
+		failed = true;
+	}
+
+	if ( failed ) {
+		Com_Printf( S_COLOR_RED "round trip failed!\n" );
+	}
+
+	Z_Free( compressed );
+	Z_Free( encoded );
+	Z_Free( data );
+}
@@ -0,0 +1,329 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// jobs.c -- worker thread pool for data-parallel loops
+
+#include "q_shared.h"
+#include "qcommon.h"
+
+/*
+==============================================================================
+
+Com_ParallelFor() splits [0..count) into chunks that are claimed by the
+calling (main) thread and by the worker threads, and returns only when every
+index has been processed. There is only one batch in flight at any time and
+nested calls are executed serially on the calling thread.
+
+The batch state and the worker threads are owned by the main thread: calls
+from any other thread, including nested calls from job functions running on
+workers, are executed serially without looking at them, and Com_JobThreads()
+only restarts the workers when called on the main thread between batches.
+
+Worker threads are started on first use so nothing is spawned unless some
+subsystem actually asks for parallel execution.
+
+==============================================================================
+*/
+
+#define MAX_JOB_THREADS 16
+
+static cvar_t *com_jobThreads;
+static THREADLOCAL bool jobsMainThread;
+
+static struct {
+	void		*threads[ MAX_JOB_THREADS ];
+	int			numWorkers;		// spawned worker threads, main thread not included
+	bool		started;
+
+	void		*mutex;
+	void		*wake;			// new batch is available or shutdown requested
+	void		*done;			// last index of the current batch has been processed
+
+	jobFunc_t	func;
+	void		*data;
+	int			count;
+	int			chunk;
+	int			next;			// next unclaimed index
+	int			finished;		// number of processed indexes
+	int			batch;			// incremented with each new batch
+	bool		active;			// batch in flight, used to serialize nested calls on the main thread
+	bool		shutdown;
+} jobs;
+
+
+/*
+=================
+Com_RunJobChunks
+
+Claims and executes chunks of the current batch until it is drained,
+must be called with jobs.mutex held
+=================
+*/
+static void Com_RunJobChunks( void ) {
+	jobFunc_t func;
+	void *data;
+	int start, end, i;
+
+	while ( jobs.next < jobs.count ) {
+		start = jobs.next;
+		end = start + jobs.chunk;
+		if ( end > jobs.count ) {
+			end = jobs.count;
+		}
+		jobs.next = end;
+		func = jobs.func;
+		data = jobs.data;
+
+		Sys_UnlockMutex( jobs.mutex );
+		for ( i = start; i < end; i++ ) {
+			func( data, i );
+		}
+		Sys_LockMutex( jobs.mutex );
+
+		jobs.finished += end - start;
+		if ( jobs.finished == jobs.count ) {
+			Sys_BroadcastCond( jobs.done );
+		}
+	}
+}
+
+
+/*
+=================
+Com_JobWorker
+=================
+*/
+static void Com_JobWorker( void *arg ) {
+	int batch;
+
+	Sys_LockMutex( jobs.mutex );
+	batch = jobs.batch;
+	for ( ;; ) {
+		while ( !jobs.shutdown && jobs.batch == batch ) {
+			Sys_WaitCond( jobs.wake, jobs.mutex );
+		}
+		if ( jobs.shutdown ) {
+			break;
+		}
+		batch = jobs.batch;
+		Com_RunJobChunks();
+	}
+	Sys_UnlockMutex( jobs.mutex );
+
+	Hunk_ReleaseScratch();
+}
+
+
+/*
+=================
+Com_StopWorkers
+=================
+*/
+static void Com_StopWorkers( void ) {
+	int i;
+
+	if ( !jobs.numWorkers ) {
+		return;
+	}
+
+	Sys_LockMutex( jobs.mutex );
+	jobs.shutdown = true;
+	Sys_BroadcastCond( jobs.wake );
+	Sys_UnlockMutex( jobs.mutex );
+
+	for ( i = 0; i < jobs.numWorkers; i++ ) {
+		Sys_JoinThread( jobs.threads[ i ] );
+		jobs.threads[ i ] = NULL;
+	}
+
+	jobs.numWorkers = 0;
+	jobs.shutdown = false;
+}
+
+
+/*
+=================
+Com_StartWorkers
+=================
+*/
+static void Com_StartWorkers( void ) {
+	int numThreads;
+
+	numThreads = com_jobThreads->integer;
+	if ( numThreads == 0 ) {
+		numThreads = Sys_CPUCount();
+	}
+	if ( numThreads > MAX_JOB_THREADS ) {
+		numThreads = MAX_JOB_THREADS;
+	}
+
+	// main thread is always the first one
+	while ( jobs.numWorkers < numThreads - 1 ) {
+		jobs.threads[ jobs.numWorkers ] = Sys_CreateThread( Com_JobWorker, NULL );
+		if ( !jobs.threads[ jobs.numWorkers ] ) {
+			Com_Printf( S_COLOR_YELLOW "WARNING: failed to create worker thread\n" );
+			break;
+		}
+		jobs.numWorkers++;
+	}
+
+	if ( jobs.numWorkers ) {
+		Com_DPrintf( "Started %i worker threads\n", jobs.numWorkers );
+	}
+
+	jobs.started = true;
+}
+
+
+/*
+=================
+Com_IsMainThread
+=================
+*/
+bool Com_IsMainThread( void ) {
+	return jobsMainThread;
+}
+
+
+/*
+=================
+Com_JobThreads
+=================
+*/
+int Com_JobThreads( void ) {
+	if ( !jobs.mutex || !jobsMainThread || jobs.active ) {
+		return 1;
+	}
+
+	if ( com_jobThreads->modified ) {
+		com_jobThreads->modified = false;
+		Com_StopWorkers();
+		jobs.started = false;
+	}
+
+	if ( !jobs.started ) {
+		Com_StartWorkers();
+	}
+
+	return jobs.numWorkers + 1;
+}
+
+
+/*
+=================
+Com_ParallelFor
+=================
+*/
+void Com_ParallelFor( jobFunc_t func, void *data, int count ) {
+	int i;
+
+	if ( count <= 0 ) {
+		return;
+	}
+
+	if ( !jobsMainThread || jobs.active || count == 1 || Com_JobThreads() == 1 ) {
+		for ( i = 0; i < count; i++ ) {
+			func( data, i );
+		}
+		return;
+	}
+
+	Sys_LockMutex( jobs.mutex );
+
+	jobs.func = func;
+	jobs.data = data;
+	jobs.count = count;
+	jobs.next = 0;
+	jobs.finished = 0;
+	// several chunks per thread to balance uneven work
+	jobs.chunk = count / ( ( jobs.numWorkers + 1 ) * 4 );
+	if ( jobs.chunk < 1 ) {
+		jobs.chunk = 1;
+	}
+	jobs.active = true;
+	jobs.batch++;
+	Sys_BroadcastCond( jobs.wake );
+
+	Com_RunJobChunks();
+
+	while ( jobs.finished < jobs.count ) {
+		Sys_WaitCond( jobs.done, jobs.mutex );
+	}
+
+	jobs.active = false;
+	jobs.func = NULL;
+	jobs.data = NULL;
+
+	Sys_UnlockMutex( jobs.mutex );
+}
+
+
+/*
+=================
+Com_InitJobs
+=================
+*/
+void Com_InitJobs( void ) {
+	jobsMainThread = true;
+
+	com_jobThreads = Cvar_Get( "com_jobThreads", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( com_jobThreads, "0", XSTRING( MAX_JOB_THREADS ), CV_INTEGER );
+	Cvar_SetDescription( com_jobThreads, "Number of threads used by parallel engine jobs:\n"
+		" 0 - one per available CPU core\n"
+		" 1 - run everything on the main thread\n"
+		" N - main thread and N-1 worker threads" );
+	com_jobThreads->modified = false;
+
+	jobs.mutex = Sys_CreateMutex();
+	jobs.wake = Sys_CreateCond();
+	jobs.done = Sys_CreateCond();
+
+	if ( !jobs.mutex || !jobs.wake || !jobs.done ) {
+		Com_Printf( S_COLOR_YELLOW "WARNING: failed to initialize job system\n" );
+		Com_ShutdownJobs();
+	}
+}
+
+
+/*
+=================
+Com_ShutdownJobs
+=================
+*/
+void Com_ShutdownJobs( void ) {
+	if ( jobs.mutex ) {
+		Com_StopWorkers();
+		Sys_DestroyMutex( jobs.mutex );
+		jobs.mutex = NULL;
+	}
+
+	if ( jobs.wake ) {
+		Sys_DestroyCond( jobs.wake );
+		jobs.wake = NULL;
+	}
+
+	if ( jobs.done ) {
+		Sys_DestroyCond( jobs.done );
+		jobs.done = NULL;
+	}
+
+	jobs.started = false;
+}
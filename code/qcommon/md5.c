@@ -352,6 +352,46 @@ char *Com_MD5Buf( const char *data, int length, const char *data2, int length2 )
 }
 
 
+/*
+ * HMAC-MD5 (RFC 2104) of data and data2 with a key of at most
+ * MD5_BLOCK_SIZE bytes, digest must hold MD5_DIGEST_SIZE bytes
+ */
+void Com_MD5HMAC( const byte *key, int keyLength, const byte *data, int length, const byte *data2, int length2, byte *digest )
+{
+	byte pad[MD5_BLOCK_SIZE];
+	MD5_CTX md5;
+	int i;
+
+	if ( keyLength > MD5_BLOCK_SIZE )
+		Com_Error( ERR_FATAL, "Com_MD5HMAC: key is too long" );
+
+	// inner hash = MD5( key ^ ipad | data | data2 )
+	memset( pad, 0x36, sizeof( pad ) );
+	for ( i = 0; i < keyLength; i++ )
+		pad[i] ^= key[i];
+
+	MD5Init( &md5 );
+	MD5Update( &md5, pad, sizeof( pad ) );
+	if ( data && length > 0 )
+		MD5Update( &md5, data, length );
+	if ( data2 && length2 > 0 )
+		MD5Update( &md5, data2, length2 );
+	MD5Final( &md5, digest );
+
+	// MD5( key ^ opad | inner hash )
+	memset( pad, 0x5C, sizeof( pad ) );
+	for ( i = 0; i < keyLength; i++ )
+		pad[i] ^= key[i];
+
+	MD5Init( &md5 );
+	MD5Update( &md5, pad, sizeof( pad ) );
+	MD5Update( &md5, digest, MD5_DIGEST_SIZE );
+	MD5Final( &md5, digest );
+
+	memset( pad, 0, sizeof( pad ) );
+}
+
+
 // stateless challenges
 
 static struct MD5Context hmac_ctx_in;
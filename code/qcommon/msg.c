@@ -22,6 +22,18 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include "q_shared.h"
 #include "qcommon.h"
 
+#if idx64 || defined( __SSE2__ )
+#include <emmintrin.h>
+#define USE_SSE2_DELTA
+#elif arm64
+#include <arm_neon.h>
+#define USE_NEON_DELTA
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 static int pcount[256];
 
 /*
@@ -130,11 +142,9 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 		if ( bits & 7 ) {
 			int nbits;
 			nbits = bits&7;
-			for ( i = 0; i < nbits ; i++ ) {
-				HuffmanPutBit( msg->data, msg->bit, (value & 1) );
-				msg->bit++;
-				value = (value>>1);
-			}
+			HuffmanPutBits( msg->data, msg->bit, value, nbits );
+			msg->bit += nbits;
+			value = (value>>nbits);
 			bits = bits - nbits;
 		}
 		if ( bits ) {
@@ -152,6 +162,52 @@ void MSG_WriteBits( msg_t *msg, int value, int bits ) {
 }
 
 
+/*
+=================
+MSG_WriteBitStream
+
+Appends numBits of huffman-encoded data previously produced by MSG_WriteBits
+into a byte-aligned buffer, unused bits of the last source byte must be zero.
+Huffman codes don't depend on the bit position so the result is the same as
+repeating the original writes, not valid for OOB messages.
+=================
+*/
+void MSG_WriteBitStream( msg_t *msg, const byte *data, int numBits ) {
+	byte	*out;
+	int		shift;
+	int		numBytes;
+	int		i;
+
+	if ( msg->overflowed || numBits <= 0 )
+		return;
+
+	if ( msg->bit + numBits > msg->maxbits ) {
+		msg->overflowed = true;
+		return;
+	}
+
+	out = msg->data + ( msg->bit >> 3 );
+	shift = msg->bit & 7;
+	numBytes = ( numBits + 7 ) >> 3;
+
+	if ( shift == 0 ) {
+		Com_Memcpy( out, data, numBytes );
+	} else {
+		// bits above msg->bit are always zero in the current byte, see HuffmanPutBit()
+		out[0] |= data[0] << shift;
+		for ( i = 1; i < numBytes; i++ ) {
+			out[i] = ( data[i-1] >> ( 8 - shift ) ) | ( data[i] << shift );
+		}
+		if ( shift + numBits > numBytes * 8 ) {
+			out[numBytes] = data[numBytes-1] >> ( 8 - shift );
+		}
+	}
+
+	msg->bit += numBits;
+	msg->cursize = ( msg->bit >> 3 ) + 1;
+}
+
+
 static int MSG_ReadBits( msg_t *msg, int bits ) {
 	int		value;
 	bool	sgn;
@@ -198,11 +254,9 @@ static int MSG_ReadBits( msg_t *msg, int bits ) {
 		const int nbits = bits & 7;
 		int bitIndex = msg->bit; // dereference optimization
 		if ( nbits )
-		{		
-			for ( i = 0; i < nbits; i++ ) {
-				value |= HuffmanGetBit( buffer, bitIndex ) << i;
-				bitIndex++;
-			}
+		{
+			value = HuffmanGetBits( buffer, bitIndex, nbits );
+			bitIndex += nbits;
 			bits -= nbits;
 		}
 		if ( bits )
@@ -738,6 +792,126 @@ static const netField_t entityStateFields[] =
 #define	FLOAT_INT_BITS	13
 #define	FLOAT_INT_BIAS	(1<<(FLOAT_INT_BITS-1))
 
+/*
+==============================================================================
+
+Change masks
+
+Delta writers compare whole structures at once, one mask bit per 32-bit word,
+and then only visit the changed words to find out the last changed field.
+
+==============================================================================
+*/
+
+#define MAX_DELTA_WORDS 128 // enough for playerState_t
+#define DELTA_MASK_SIZE ( MAX_DELTA_WORDS / 32 + 1 ) // extra word for MSG_MaskBits()
+
+#define MASK_BIT( mask, word ) ( (mask)[ (word) >> 5 ] & ( 1U << ( (word) & 31 ) ) )
+
+// changed word -> field number + 1, zero for words that are not in the field list
+static byte entityFieldNums[ MAX_DELTA_WORDS ];
+static byte playerFieldNums[ MAX_DELTA_WORDS ];
+
+static bool msg_scalarDeltas; // for benchmarking
+
+#ifdef _MSC_VER
+static ID_INLINE int MSG_LowestBit( uint32_t v ) {
+	unsigned long i;
+	_BitScanForward( &i, v );
+	return (int)i;
+}
+#else
+#define MSG_LowestBit( v ) __builtin_ctz( v )
+#endif
+
+
+/*
+==================
+MSG_ChangeMask
+
+Sets mask bit for each 32-bit word that differs
+==================
+*/
+static void MSG_ChangeMask( const void *from, const void *to, int numWords, uint32_t *mask ) {
+	const int *f = (const int *)from;
+	const int *t = (const int *)to;
+	int i;
+
+	Com_Memset( mask, 0, DELTA_MASK_SIZE * sizeof( mask[0] ) );
+
+	i = 0;
+	if ( !msg_scalarDeltas ) {
+#if defined( USE_SSE2_DELTA )
+		for ( ; i + 4 <= numWords; i += 4 ) {
+			const __m128i a = _mm_loadu_si128( (const __m128i *)( f + i ) );
+			const __m128i b = _mm_loadu_si128( (const __m128i *)( t + i ) );
+			const int equal = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( a, b ) ) );
+			mask[ i >> 5 ] |= (uint32_t)( equal ^ 15 ) << ( i & 31 );
+		}
+#elif defined( USE_NEON_DELTA )
+		static const uint32_t weights[4] = { 1, 2, 4, 8 };
+		const uint32x4_t w = vld1q_u32( weights );
+		for ( ; i + 4 <= numWords; i += 4 ) {
+			const uint32x4_t a = vld1q_u32( (const uint32_t *)( f + i ) );
+			const uint32x4_t b = vld1q_u32( (const uint32_t *)( t + i ) );
+			const uint32x4_t changed = vmvnq_u32( vceqq_u32( a, b ) );
+			mask[ i >> 5 ] |= vaddvq_u32( vandq_u32( changed, w ) ) << ( i & 31 );
+		}
+#endif
+	}
+
+	for ( ; i < numWords; i++ ) {
+		if ( f[i] != t[i] ) {
+			mask[ i >> 5 ] |= 1U << ( i & 31 );
+		}
+	}
+}
+
+
+/*
+==================
+MSG_LastChangedField
+
+Returns number of the last changed field plus one, or zero if nothing changed
+==================
+*/
+static int MSG_LastChangedField( const uint32_t *mask, const byte *fieldNums ) {
+	uint32_t bits;
+	int i, word;
+	int lc;
+
+	lc = 0;
+	for ( i = 0; i < MAX_DELTA_WORDS / 32; i++ ) {
+		bits = mask[i];
+		while ( bits ) {
+			word = ( i << 5 ) + MSG_LowestBit( bits );
+			bits &= bits - 1;
+			if ( fieldNums[ word ] > lc ) {
+				lc = fieldNums[ word ];
+			}
+		}
+	}
+
+	return lc;
+}
+
+
+/*
+==================
+MSG_MaskBits
+
+Extracts mask bits of count (up to 32) consecutive words
+==================
+*/
+static int MSG_MaskBits( const uint32_t *mask, int first, int count ) {
+	uint64_t bits;
+
+	bits = mask[ first >> 5 ] | ( (uint64_t)mask[ ( first >> 5 ) + 1 ] << 32 );
+	bits >>= first & 31;
+
+	return (int)( bits & ( ( 1ULL << count ) - 1 ) );
+}
+
 /*
 ==================
 MSG_WriteDeltaEntity
@@ -751,19 +925,17 @@ identical, under the assumption that the in-order delta code will catch it.
 */
 void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entityState_t *to, bool force ) {
 	int			i, lc;
-	int			numFields;
 	const netField_t *field;
 	int			trunc;
 	float		fullFloat;
-	const int	*fromF, *toF;
-
-	numFields = ARRAY_LEN( entityStateFields );
+	const int	*toF;
+	uint32_t	mask[ DELTA_MASK_SIZE ];
 
 	// all fields should be 32 bits to avoid any compiler packing issues
 	// the "number" field is not part of the field list
 	// if this assert fails, someone added a field to the entityState_t
 	// struct without updating the message fields
-	assert( numFields + 1 == sizeof( *from )/4 );
+	assert( ARRAY_LEN( entityStateFields ) + 1 == sizeof( *from )/4 );
 
 	// a NULL to is a delta remove message
 	if ( to == NULL ) {
@@ -779,15 +951,8 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 		Com_Error( ERR_DROP, "MSG_WriteDeltaEntity: Bad entity number: %i", to->number );
 	}
 
-	lc = 0;
-	// build the change vector as bytes so it is endian independent
-	for ( i = 0, field = entityStateFields ; i < numFields ; i++, field++ ) {
-		fromF = (int *)( (byte *)from + field->offset );
-		toF = (int *)( (byte *)to + field->offset );
-		if ( *fromF != *toF ) {
-			lc = i+1;
-		}
-	}
+	MSG_ChangeMask( from, to, sizeof( *to ) / 4, mask );
+	lc = MSG_LastChangedField( mask, entityFieldNums );
 
 	if ( lc == 0 ) {
 		// nothing at all changed
@@ -808,14 +973,13 @@ void MSG_WriteDeltaEntity( msg_t *msg, const entityState_t *from, const entitySt
 	MSG_WriteByte( msg, lc );	// # of changes
 
 	for ( i = 0, field = entityStateFields ; i < lc ; i++, field++ ) {
-		fromF = (int *)( (byte *)from + field->offset );
-		toF = (int *)( (byte *)to + field->offset );
-
-		if ( *fromF == *toF ) {
+		if ( !MASK_BIT( mask, field->offset >> 2 ) ) {
 			MSG_WriteBits( msg, 0, 1 );	// no change
 			continue;
 		}
 
+		toF = (int *)( (byte *)to + field->offset );
+
 		MSG_WriteBits( msg, 1, 1 );	// changed
 
 		if ( field->bits == 0 ) {
@@ -1048,6 +1212,37 @@ static const netField_t playerStateFields[] =
 { PSF(loopSound), 16 }
 };
 
+#define PSF_WORD(x) (int)((size_t)&((playerState_t*)0)->x / 4)
+
+
+/*
+=============
+MSG_SetupFieldNums
+=============
+*/
+static void MSG_SetupFieldNums( const netField_t *fields, int numFields, byte *fieldNums ) {
+	int i;
+
+	Com_Memset( fieldNums, 0, MAX_DELTA_WORDS );
+
+	for ( i = 0; i < numFields; i++ ) {
+		fieldNums[ fields[i].offset >> 2 ] = i + 1;
+	}
+}
+
+
+/*
+=============
+MSG_InitDeltaFields
+
+Must be called before any delta is written
+=============
+*/
+void MSG_InitDeltaFields( void ) {
+	MSG_SetupFieldNums( entityStateFields, ARRAY_LEN( entityStateFields ), entityFieldNums );
+	MSG_SetupFieldNums( playerStateFields, ARRAY_LEN( playerStateFields ), playerFieldNums );
+}
+
 /*
 =============
 MSG_WriteDeltaPlayerstate
@@ -1061,38 +1256,29 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 	int				persistantbits;
 	int				ammobits;
 	int				powerupbits;
-	int				numFields;
 	const netField_t *field;
-	const int		*fromF, *toF;
+	const int		*toF;
 	float			fullFloat;
 	int				trunc, lc;
+	uint32_t		mask[ DELTA_MASK_SIZE ];
 
 	if ( !from ) {
 		from = &dummy;
 	}
 
-	numFields = ARRAY_LEN( playerStateFields );
-
-	lc = 0;
-	for ( i = 0, field = playerStateFields ; i < numFields ; i++, field++ ) {
-		fromF = (const int *)( (byte *)from + field->offset );
-		toF = (const int *)( (byte *)to + field->offset );
-		if ( *fromF != *toF ) {
-			lc = i+1;
-		}
-	}
+	MSG_ChangeMask( from, to, sizeof( *to ) / 4, mask );
+	lc = MSG_LastChangedField( mask, playerFieldNums );
 
 	MSG_WriteByte( msg, lc );	// # of changes
 
 	for ( i = 0, field = playerStateFields ; i < lc ; i++, field++ ) {
-		fromF = (const int *)( (byte *)from + field->offset );
-		toF = (const int *)( (byte *)to + field->offset );
-
-		if ( *fromF == *toF ) {
+		if ( !MASK_BIT( mask, field->offset >> 2 ) ) {
 			MSG_WriteBits( msg, 0, 1 );	// no change
 			continue;
 		}
 
+		toF = (const int *)( (byte *)to + field->offset );
+
 		MSG_WriteBits( msg, 1, 1 );	// changed
 //		pcount[i]++;
 
@@ -1121,30 +1307,10 @@ void MSG_WriteDeltaPlayerstate( msg_t *msg, const playerState_t *from, const pla
 	//
 	// send the arrays
 	//
-	statsbits = 0;
-	for (i=0 ; i<MAX_STATS ; i++) {
-		if (to->stats[i] != from->stats[i]) {
-			statsbits |= 1<<i;
-		}
-	}
-	persistantbits = 0;
-	for (i=0 ; i<MAX_PERSISTANT ; i++) {
-		if (to->persistant[i] != from->persistant[i]) {
-			persistantbits |= 1<<i;
-		}
-	}
-	ammobits = 0;
-	for (i=0 ; i<MAX_WEAPONS ; i++) {
-		if (to->ammo[i] != from->ammo[i]) {
-			ammobits |= 1<<i;
-		}
-	}
-	powerupbits = 0;
-	for (i=0 ; i<MAX_POWERUPS ; i++) {
-		if (to->powerups[i] != from->powerups[i]) {
-			powerupbits |= 1<<i;
-		}
-	}
+	statsbits = MSG_MaskBits( mask, PSF_WORD( stats ), MAX_STATS );
+	persistantbits = MSG_MaskBits( mask, PSF_WORD( persistant ), MAX_PERSISTANT );
+	ammobits = MSG_MaskBits( mask, PSF_WORD( ammo ), MAX_WEAPONS );
+	powerupbits = MSG_MaskBits( mask, PSF_WORD( powerups ), MAX_POWERUPS );
 
 	if (!statsbits && !persistantbits && !ammobits && !powerupbits) {
 		MSG_WriteBits( msg, 0, 1 );	// no change
@@ -1347,3 +1513,84 @@ void MSG_ReadDeltaPlayerstate( msg_t *msg, const playerState_t *from, playerStat
 }
 
 //===========================================================================
+
+
+/*
+=============
+MSG_BenchmarkDeltas
+
+Encodes given entity and player state pairs with scalar and vectorized
+change masks, checks that both produce the same output and prints
+throughput of each path
+=============
+*/
+void MSG_BenchmarkDeltas( const entityState_t **from, const entityState_t **to, int numEntities,
+	const playerState_t **fromPs, const playerState_t **toPs, int numPlayers, int iterations ) {
+	static byte bufA[ MAX_MSGLEN_BUF ], bufB[ MAX_MSGLEN_BUF ];
+	msg_t		a, b;
+	int64_t		start, usec[2];
+	int			i, n, path, mismatches;
+
+	if ( numEntities + numPlayers == 0 || iterations <= 0 ) {
+		return;
+	}
+
+	// both paths must produce the same bits
+	mismatches = 0;
+	for ( i = 0; i < numEntities + numPlayers; i++ ) {
+		MSG_Init( &a, bufA, MAX_MSGLEN );
+		MSG_Init( &b, bufB, MAX_MSGLEN );
+		msg_scalarDeltas = true;
+		if ( i < numEntities )
+			MSG_WriteDeltaEntity( &a, from[i], to[i], true );
+		else
+			MSG_WriteDeltaPlayerstate( &a, fromPs[i-numEntities], toPs[i-numEntities] );
+		msg_scalarDeltas = false;
+		if ( i < numEntities )
+			MSG_WriteDeltaEntity( &b, from[i], to[i], true );
+		else
+			MSG_WriteDeltaPlayerstate( &b, fromPs[i-numEntities], toPs[i-numEntities] );
+		if ( a.bit != b.bit || memcmp( bufA, bufB, ( a.bit + 7 ) >> 3 ) ) {
+			mismatches++;
+		}
+	}
+
+	for ( path = 0; path < 2; path++ ) {
+		msg_scalarDeltas = ( path == 0 );
+		MSG_Init( &a, bufA, MAX_MSGLEN );
+		start = Sys_Microseconds();
+		for ( n = 0; n < iterations; n++ ) {
+			for ( i = 0; i < numEntities; i++ ) {
+				if ( a.bit > MAX_MSGLEN * 4 )
+					MSG_Clear( &a );
+				MSG_WriteDeltaEntity( &a, from[i], to[i], true );
+			}
+			for ( i = 0; i < numPlayers; i++ ) {
+				if ( a.bit > MAX_MSGLEN * 4 )
+					MSG_Clear( &a );
+				MSG_WriteDeltaPlayerstate( &a, fromPs[i], toPs[i] );
+			}
+		}
+		usec[ path ] = Sys_Microseconds() - start;
+		if ( usec[ path ] <= 0 )
+			usec[ path ] = 1;
+	}
+
+	msg_scalarDeltas = false;
+
+	Com_Printf( "%i entity and %i player state deltas, %i iterations\n", numEntities, numPlayers, iterations );
+	for ( path = 0; path < 2; path++ ) {
+		Com_Printf( "%-7s: %8.3f ms, %.0f deltas/sec\n", path == 0 ? "scalar" :
+#if defined( USE_SSE2_DELTA )
+			"SSE2",
+#elif defined( USE_NEON_DELTA )
+			"NEON",
+#else
+			"scalar",
+#endif
+			usec[ path ] / 1000.0, (double)( numEntities + numPlayers ) * iterations * 1e6 / usec[ path ] );
+	}
+	if ( mismatches ) {
+		Com_Printf( S_COLOR_RED "%i deltas are different!\n", mismatches );
+	}
+}
@@ -675,7 +675,9 @@ void NET_QueuePacket( netsrc_t sock, int length, const void *data, const netadr_
 
 void NET_FlushPacketQueue( int time_diff )
 {
+	Sys_BeginPacketBatch();
 	packetQueue = list_process( packetQueue, time_diff );
+	Sys_EndPacketBatch();
 }
 
 
@@ -20,6 +20,10 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 ===========================================================================
 */
 
+#ifdef __linux__
+#define _GNU_SOURCE		// recvmmsg(), sendmmsg()
+#endif
+
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
 
@@ -93,6 +97,10 @@ static bool	winsockInitialized = false;
 #		include <sys/filio.h>
 #	endif
 
+#	ifdef __linux__
+#		define USE_MMSG
+#	endif
+
 typedef int SOCKET;
 #	define INVALID_SOCKET		-1
 #	define SOCKET_ERROR			-1
@@ -175,6 +183,9 @@ static cvar_t	*net_mcast6addr;
 static cvar_t	*net_mcast6iface;
 #endif
 static cvar_t	*net_dropsim;
+#ifdef USE_MMSG
+static cvar_t	*net_mmsg;
+#endif
 
 static sockaddr_t socksRelayAddr;
 
@@ -636,6 +647,273 @@ bool NET_IsLocalAddress( const netadr_t *adr )
 
 //=============================================================================
 
+#ifdef USE_MMSG
+/*
+=============================================================================
+
+BATCHED SOCKET I/O
+
+Incoming datagrams are drained with a single recvmmsg() call and handed
+out one at a time to NET_GetPacket(). Outgoing datagrams sent between
+Sys_BeginPacketBatch() and Sys_EndPacketBatch() are collected and sent
+with one sendmmsg() call per socket. Both fall back to recvfrom()/sendto()
+when net_mmsg is disabled or the kernel does not support the calls.
+
+=============================================================================
+*/
+
+#define RECV_BATCH			16
+#define SEND_BATCH			256
+#define SEND_BATCH_DATA		( 256 * 1024 )
+
+static struct {
+	struct mmsghdr	hdr[ RECV_BATCH ];
+	struct iovec	iov[ RECV_BATCH ];
+	sockaddr_t		from[ RECV_BATCH ];
+	byte			data[ RECV_BATCH ][ MAX_MSGLEN ];
+	SOCKET			sock;		// socket the pending datagrams were read from
+	int				count;
+	int				next;
+} recvBatch;
+
+static struct {
+	struct mmsghdr	hdr[ SEND_BATCH ];
+	struct iovec	iov[ SEND_BATCH ];
+	sockaddr_t		to[ SEND_BATCH ];
+	SOCKET			sock[ SEND_BATCH ];
+	byte			data[ SEND_BATCH_DATA ];
+	int				count;
+	int				dataSize;
+	int				depth;		// open Sys_BeginPacketBatch() calls
+} sendBatch;
+
+static bool mmsgUnsupported = false;
+
+
+/*
+==================
+NET_RecvFrom
+
+recvfrom() replacement that reads up to RECV_BATCH datagrams per system call
+==================
+*/
+static int NET_RecvFrom( SOCKET sock, byte *data, int maxsize, sockaddr_t *from, socklen_t *fromlen )
+{
+	struct msghdr *hdr;
+	int i, ret, len;
+
+	if ( recvBatch.next < recvBatch.count ) {
+		if ( recvBatch.sock != sock ) {
+			// let the other socket drain its datagrams first
+			errno = EAGAIN;
+			return SOCKET_ERROR;
+		}
+	} else {
+		if ( !net_mmsg->integer || mmsgUnsupported ) {
+			return recvfrom( sock, (void *)data, maxsize, 0, (struct sockaddr *) from, fromlen );
+		}
+
+		for ( i = 0; i < RECV_BATCH; i++ ) {
+			recvBatch.iov[i].iov_base = recvBatch.data[i];
+			recvBatch.iov[i].iov_len = sizeof( recvBatch.data[i] );
+			hdr = &recvBatch.hdr[i].msg_hdr;
+			memset( hdr, 0, sizeof( *hdr ) );
+			hdr->msg_name = &recvBatch.from[i];
+			hdr->msg_namelen = sizeof( recvBatch.from[i] );
+			hdr->msg_iov = &recvBatch.iov[i];
+			hdr->msg_iovlen = 1;
+		}
+
+		recvBatch.count = 0;
+		recvBatch.next = 0;
+
+		ret = recvmmsg( sock, recvBatch.hdr, RECV_BATCH, MSG_DONTWAIT, NULL );
+		if ( ret <= 0 ) {
+			if ( ret == SOCKET_ERROR && socketError == ENOSYS ) {
+				Com_DPrintf( "recvmmsg() is not supported, using recvfrom()\n" );
+				mmsgUnsupported = true;
+				return recvfrom( sock, (void *)data, maxsize, 0, (struct sockaddr *) from, fromlen );
+			}
+			return SOCKET_ERROR;
+		}
+
+		recvBatch.sock = sock;
+		recvBatch.count = ret;
+	}
+
+	i = recvBatch.next++;
+	hdr = &recvBatch.hdr[i].msg_hdr;
+
+	len = MIN( (int)recvBatch.hdr[i].msg_len, maxsize );
+	memcpy( data, recvBatch.data[i], len );
+
+	*fromlen = MIN( hdr->msg_namelen, *fromlen );
+	memcpy( from, &recvBatch.from[i], *fromlen );
+
+	return len;
+}
+
+
+/*
+==================
+NET_FlushSendBatch
+==================
+*/
+static void NET_FlushSendBatch( void )
+{
+	struct msghdr *hdr;
+	SOCKET	sock;
+	int		i, n, ret, err;
+
+	i = 0;
+	while ( i < sendBatch.count ) {
+		sock = sendBatch.sock[i];
+
+		if ( !mmsgUnsupported ) {
+			// sendmmsg() works on a single socket so send runs of datagrams
+			for ( n = 1; i + n < sendBatch.count && sendBatch.sock[i + n] == sock; n++ )
+				;
+			ret = sendmmsg( sock, &sendBatch.hdr[i], n, 0 );
+			if ( ret > 0 ) {
+				i += ret;
+				continue;
+			}
+			err = socketError;
+			if ( ret == SOCKET_ERROR && err == ENOSYS ) {
+				Com_DPrintf( "sendmmsg() is not supported, using sendto()\n" );
+				mmsgUnsupported = true;
+				continue;
+			}
+		}
+
+		// without sendmmsg(), or when it sent nothing and reported no error,
+		// send the first datagram alone
+		if ( mmsgUnsupported || ret == 0 ) {
+			hdr = &sendBatch.hdr[i].msg_hdr;
+			ret = sendto( sock, hdr->msg_iov->iov_base, hdr->msg_iov->iov_len, 0, (struct sockaddr *) hdr->msg_name, hdr->msg_namelen );
+			if ( ret != SOCKET_ERROR ) {
+				i++;
+				continue;
+			}
+			err = socketError;
+		}
+
+		// first datagram of the run failed, drop it like Sys_SendPacket() would do
+		if ( err != EAGAIN && err != EADDRNOTAVAIL ) {
+			Com_Printf( "Sys_SendPacket: %s\n", NET_ErrorString() );
+		}
+		i++;
+	}
+
+	sendBatch.count = 0;
+	sendBatch.dataSize = 0;
+}
+
+
+/*
+==================
+NET_SendTo
+
+sendto() replacement that defers the datagram while a packet batch is open
+==================
+*/
+static int NET_SendTo( SOCKET sock, const void *data, int length, const sockaddr_t *to, socklen_t tolen )
+{
+	struct msghdr *hdr;
+	int i;
+
+	if ( !sendBatch.depth || !net_mmsg->integer || length > SEND_BATCH_DATA ) {
+		return sendto( sock, data, length, 0, (const struct sockaddr *) to, tolen );
+	}
+
+	if ( sendBatch.count == SEND_BATCH || sendBatch.dataSize + length > SEND_BATCH_DATA ) {
+		NET_FlushSendBatch();
+	}
+
+	i = sendBatch.count++;
+
+	memcpy( sendBatch.data + sendBatch.dataSize, data, length );
+	sendBatch.iov[i].iov_base = sendBatch.data + sendBatch.dataSize;
+	sendBatch.iov[i].iov_len = length;
+	sendBatch.dataSize += length;
+
+	memcpy( &sendBatch.to[i], to, tolen );
+	sendBatch.sock[i] = sock;
+
+	hdr = &sendBatch.hdr[i].msg_hdr;
+	memset( hdr, 0, sizeof( *hdr ) );
+	hdr->msg_name = &sendBatch.to[i];
+	hdr->msg_namelen = tolen;
+	hdr->msg_iov = &sendBatch.iov[i];
+	hdr->msg_iovlen = 1;
+
+	return length;
+}
+
+
+/*
+==================
+NET_ResetBatches
+
+Sends pending datagrams and drops unread ones, must be called before closing sockets
+==================
+*/
+static void NET_ResetBatches( void )
+{
+	NET_FlushSendBatch();
+
+	recvBatch.count = 0;
+	recvBatch.next = 0;
+}
+
+#else
+
+#define NET_RecvFrom( sock, data, maxsize, from, fromlen ) recvfrom( (sock), (void *)(data), (maxsize), 0, (struct sockaddr *)(from), (fromlen) )
+#define NET_SendTo( sock, data, length, to, tolen ) sendto( (sock), (data), (length), 0, (const struct sockaddr *)(to), (tolen) )
+
+#endif // USE_MMSG
+
+
+/*
+==================
+Sys_BeginPacketBatch
+
+Datagrams sent until Sys_EndPacketBatch() may be delayed and sent together,
+nested batches are sent when the outermost one ends
+==================
+*/
+void Sys_BeginPacketBatch( void )
+{
+#ifdef USE_MMSG
+	sendBatch.depth++;
+#endif
+}
+
+
+/*
+==================
+Sys_EndPacketBatch
+
+Unmatched calls are reported to developers and ignored, like the batch
+that NET_Sleep() finds left open
+==================
+*/
+void Sys_EndPacketBatch( void )
+{
+#ifdef USE_MMSG
+	if ( sendBatch.depth <= 0 ) {
+		Com_DPrintf( S_COLOR_YELLOW "WARNING: %s without Sys_BeginPacketBatch\n", __func__ );
+		sendBatch.depth = 0;
+		return;
+	}
+	if ( --sendBatch.depth == 0 ) {
+		NET_FlushSendBatch();
+	}
+#endif
+}
+
+//=============================================================================
+
 /*
 ==================
 NET_GetPacket
@@ -653,7 +931,7 @@ static bool NET_GetPacket( netadr_t *net_from, msg_t *net_message, const fd_set
 	if(ip_socket != INVALID_SOCKET && FD_ISSET(ip_socket, fdr))
 	{
 		fromlen = sizeof(from);
-		ret = recvfrom( ip_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen );
+		ret = NET_RecvFrom( ip_socket, net_message->data, net_message->maxsize, &from, &fromlen );
 
 		if (ret == SOCKET_ERROR)
 		{
@@ -698,7 +976,7 @@ static bool NET_GetPacket( netadr_t *net_from, msg_t *net_message, const fd_set
 	if(ip6_socket != INVALID_SOCKET && FD_ISSET(ip6_socket, fdr))
 	{
 		fromlen = sizeof(from);
-		ret = recvfrom(ip6_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
+		ret = NET_RecvFrom( ip6_socket, net_message->data, net_message->maxsize, &from, &fromlen );
 
 		if (ret == SOCKET_ERROR)
 		{
@@ -727,7 +1005,7 @@ static bool NET_GetPacket( netadr_t *net_from, msg_t *net_message, const fd_set
 	if(multicast6_socket != INVALID_SOCKET && multicast6_socket != ip6_socket && FD_ISSET(multicast6_socket, fdr))
 	{
 		fromlen = sizeof(from);
-		ret = recvfrom(multicast6_socket, (void *)net_message->data, net_message->maxsize, 0, (struct sockaddr *) &from, &fromlen);
+		ret = NET_RecvFrom( multicast6_socket, net_message->data, net_message->maxsize, &from, &fromlen );
 
 		if (ret == SOCKET_ERROR)
 		{
@@ -814,10 +1092,10 @@ void Sys_SendPacket( int length, const void *data, const netadr_t *to ) {
 	}
 	else {
 		if ( addr.ss.ss_family == AF_INET )
-			ret = sendto( ip_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in) );
+			ret = NET_SendTo( ip_socket, data, length, &addr, sizeof(struct sockaddr_in) );
 #ifdef USE_IPV6
 		else if ( addr.ss.ss_family == AF_INET6 )
-			ret = sendto( ip6_socket, data, length, 0, (struct sockaddr *) &addr, sizeof(struct sockaddr_in6) );
+			ret = NET_SendTo( ip6_socket, data, length, &addr, sizeof(struct sockaddr_in6) );
 #endif
 	}
 
@@ -1678,6 +1956,12 @@ static bool NET_GetCvars( void ) {
 	net_dropsim = Cvar_Get( "net_dropsim", "", CVAR_TEMP );
 	Cvar_SetDescription( net_dropsim, "Simulated packet drops." );
 
+#ifdef USE_MMSG
+	net_mmsg = Cvar_Get( "net_mmsg", "1", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( net_mmsg, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( net_mmsg, "Receive and send several UDP datagrams per system call using recvmmsg()/sendmmsg()." );
+#endif
+
 	return modified ? true : false;
 }
 
@@ -1727,6 +2011,9 @@ static void NET_Config( bool enableNetworking ) {
 	}
 
 	if( stop ) {
+#ifdef USE_MMSG
+		NET_ResetBatches();
+#endif
 		if ( ip_socket != INVALID_SOCKET ) {
 			closesocket( ip_socket );
 			ip_socket = INVALID_SOCKET;
@@ -1871,6 +2158,24 @@ bool NET_Sleep( int timeout )
 
 	FD_ZERO( &fdr );
 
+#ifdef USE_MMSG
+	if ( sendBatch.depth )
+	{
+		// batch left open by an error that dropped out of the server frame
+		Com_DPrintf( S_COLOR_YELLOW "WARNING: packet batch left open, sending it\n" );
+		sendBatch.depth = 0;
+		NET_FlushSendBatch();
+	}
+
+	if ( recvBatch.next < recvBatch.count )
+	{
+		// datagrams left over from the last recvmmsg() call
+		FD_SET( recvBatch.sock, &fdr );
+		NET_Event( &fdr );
+		return false;
+	}
+#endif
+
 	if ( ip_socket != INVALID_SOCKET )
 	{
 		FD_SET( ip_socket, &fdr );
@@ -1052,6 +1052,18 @@ typedef struct {
 // trace->entityNum can also be 0 to (MAX_GENTITIES-1)
 // or ENTITYNUM_NONE, ENTITYNUM_WORLD
 
+// a single move of a batched trace, everything is stored by value
+// so arrays of requests can be passed from the virtual machines as is
+typedef struct {
+	vec3_t		start;
+	vec3_t		mins;
+	vec3_t		maxs;
+	vec3_t		end;
+	int			passEntityNum;
+	int			contentmask;
+	int			capsule;
+} traceRequest_t;
+
 
 // markfragments are returned by R_MarkFragments()
 typedef struct {
@@ -89,6 +89,7 @@ struct entityState_s;
 struct playerState_s;
 
 void MSG_WriteBits(msg_t *msg, int value, int bits);
+void MSG_WriteBitStream(msg_t *msg, const byte *data, int numBits);
 
 void MSG_WriteChar(msg_t *sb, int c);
 void MSG_WriteByte(msg_t *sb, int c);
@@ -126,6 +127,10 @@ void MSG_ReadDeltaPlayerstate(msg_t *msg, const playerState_t *from, playerState
 
 void MSG_ReportChangeVectors_f(void);
 
+void MSG_InitDeltaFields(void);
+void MSG_BenchmarkDeltas(const entityState_t **from, const entityState_t **to, int numEntities,
+						 const playerState_t **fromPs, const playerState_t **toPs, int numPlayers, int iterations);
+
 //============================================================================
 
 /*
@@ -751,6 +756,8 @@ bool FS_SV_FileExists(const char *file);
 
 fileHandle_t FS_SV_FOpenFileWrite(const char *filename);
 int FS_SV_FOpenFileRead(const char *filename, fileHandle_t *fp);
+void *FS_SV_MapFile(const char *filename, int *length, char *mappedPath, int mappedPathSize);
+// maps a file found the same way as FS_SV_FOpenFileRead, NULL if not found
 void FS_SV_Rename(const char *from, const char *to);
 int FS_FOpenFileRead(const char *qpath, fileHandle_t *file, bool uniqueFILE);
 // if uniqueFILE is true, then a new FILE will be fopened even if the file
@@ -798,6 +805,23 @@ void FS_ForceFlush(fileHandle_t f);
 void FS_FreeFile(void *buffer);
 // frees the memory returned by FS_ReadFile
 
+typedef void (*fsReadCallback_t)(const char *qpath, void *buffer, int length, void *userData);
+
+int FS_ReadFileAsync(const char *qpath, fsReadCallback_t callback, void *userData);
+// reads a file on the file I/O thread, returns the length of the file or -1 if
+// it is not present, callback is not called then. Otherwise callback is called
+// from FS_CompleteAsyncReads with a buffer that must be freed with FS_FreeFile,
+// or with a null buffer and -1 length if reading failed.
+
+void FS_CompleteAsyncReads(bool wait);
+// calls callbacks of finished reads, called every frame
+
+bool FS_PrefetchFile(const char *qpath);
+// starts reading a file that will be requested with FS_ReadFile soon
+
+void FS_FlushPrefetches(void);
+// drops prefetched files that were not requested
+
 void FS_WriteFile(const char *qpath, const void *buffer, int size);
 // writes a complete file, creating any subdirectories needed
 
@@ -971,6 +995,7 @@ unsigned Com_BlockChecksum(const void *buffer, int length);
 
 char *Com_MD5File(const char *filename, int length, const char *prefix, int prefix_len);
 char *Com_MD5Buf(const char *data, int length, const char *data2, int length2);
+void Com_MD5HMAC(const byte *key, int keyLength, const byte *data, int length, const byte *data2, int length2, byte *digest);
 
 // stateless challenge functions
 void Com_MD5Init(void);
@@ -997,6 +1022,17 @@ void Com_WriteConfiguration(void);
 int Com_HexStrToInt(const char *str);
 bool Com_GetHashColor(const char *str, byte *color);
 
+// jobs.c
+// functions passed to Com_ParallelFor can run on worker threads
+// so they must not call Com_Error(), Com_Printf() or touch the zone/hunk
+typedef void (*jobFunc_t)(void *data, int index);
+
+void Com_InitJobs(void);
+void Com_ShutdownJobs(void);
+bool Com_IsMainThread(void);
+int Com_JobThreads(void); // total number of threads, including the main one, 1 off the main thread
+void Com_ParallelFor(jobFunc_t func, void *data, int count); // serial off the main thread
+
 static ID_INLINE unsigned int log2pad(unsigned int v, int roundup)
 {
 	unsigned int x = 1;
@@ -1074,6 +1110,7 @@ typedef enum
 	TAG_CLIENTS,
 	TAG_SMALL,
 	TAG_STATIC,
+	TAG_SLAB,
 	TAG_COUNT
 } memtag_t;
 
@@ -1127,6 +1164,15 @@ void Hunk_FreeTempMemory(void *buf);
 int Hunk_MemoryRemaining(void);
 void Hunk_Log(void);
 
+void *Hunk_AllocScratch(int size);
+// allocates from the scratch arena of the calling thread, safe on any thread,
+// returns NULL if the arena is exhausted
+int Hunk_ScratchMark(void);
+void Hunk_ScratchReset(int mark);
+// frees everything the calling thread allocated since the mark
+void Hunk_ReleaseScratch(void);
+// must be called by threads that used scratch memory before they exit
+
 unsigned int Com_TouchMemory(void);
 
 // commandLine should not include the executable name (argv[0])
@@ -1306,6 +1352,8 @@ void Sys_ShowConsole(int level, bool quitOnClose);
 void Sys_SetErrorText(const char *text);
 
 void Sys_SendPacket(int length, const void *data, const netadr_t *to);
+void Sys_BeginPacketBatch(void);
+void Sys_EndPacketBatch(void);
 
 bool Sys_StringToAdr(const char *s, netadr_t *a, netadrtype_t family);
 // Does NOT parse port numbers, only base addresses.
@@ -1316,6 +1364,11 @@ void Sys_ShowIP(void);
 bool Sys_Mkdir(const char *path);
 FILE *Sys_FOpen(const char *ospath, const char *mode);
 bool Sys_ResetReadOnlyAttribute(const char *ospath);
+void *Sys_MapFile(const char *ospath, int *length);
+void Sys_UnmapFile(void *data, int length);
+bool Sys_GuardMappedRead(const void *src, int length, void (*func)(void *arg, const void *data, int length), void *arg);
+void *Sys_MapFileRange(const char *ospath, int64_t offset, int length);
+void Sys_UnmapFileRange(void *data, int length);
 
 const char *Sys_Pwd(void);
 const char *Sys_DefaultBasePath(void);
@@ -1327,6 +1380,7 @@ char *Sys_DefaultAppPath(void);
 #endif
 
 char **Sys_ListFiles(const char *directory, const char *extension, const char *filter, int *numfiles, bool wantsubs);
+char **Sys_ListDirNames(const char *directory, int *numNames);
 
 void Sys_FreeFileList(char **list);
 
@@ -1344,15 +1398,43 @@ void *Sys_LoadFunction(void *handle, const char *name);
 int Sys_LoadFunctionErrors(void);
 void Sys_UnloadLibrary(void *handle);
 
+// thread primitives, used by the job system
+#if defined(_MSC_VER)
+#define THREADLOCAL __declspec(thread)
+#else
+#define THREADLOCAL __thread
+#endif
+
+void *Sys_CreateThread(void (*func)(void *arg), void *arg);
+void Sys_JoinThread(void *thread);
+void *Sys_CreateMutex(void);
+void Sys_DestroyMutex(void *mutex);
+void Sys_LockMutex(void *mutex);
+void Sys_UnlockMutex(void *mutex);
+void *Sys_CreateCond(void);
+void Sys_DestroyCond(void *cond);
+void Sys_WaitCond(void *cond, void *mutex);
+void Sys_BroadcastCond(void *cond);
+int Sys_CPUCount(void);
+
+// sampling profiler timer, handler gets program counter and stack pointer of
+// the interrupted main thread and may only use async-signal-safe code
+typedef void (*sampleHandler_t)(const void *pc, const void *sp);
+bool Sys_StartSampling(int hz, sampleHandler_t handler);
+void Sys_StopSampling(void);
+
 // adaptive huffman functions
 void Huff_Compress(msg_t *buf, int offset);
 void Huff_Decompress(msg_t *buf, int offset);
 
 // static huffman functions
 void HuffmanPutBit(byte *fout, int32_t bitIndex, int bit);
+void HuffmanPutBits(byte *fout, uint32_t offset, uint32_t bits, int count);
 int HuffmanPutSymbol(byte *fout, uint32_t offset, int symbol);
 int HuffmanGetBit(const byte *buffer, int bitIndex);
+int HuffmanGetBits(const byte *buffer, int bitIndex, int count);
 int HuffmanGetSymbol(unsigned int *symbol, const byte *buffer, int bitIndex);
+void Huff_Benchmark_f(void);
 
 #define SV_ENCODE_START 4
 #define SV_DECODE_START 12
@@ -1417,6 +1417,68 @@ extern unzFile unzOpen (const char* path)
 }
 
 
+/*
+  Read the whole central directory of a zip file into the scratch arena of
+  the calling thread, or into a buffer allocated with malloc() if it does
+  not fit, so it can be called from any thread. *scratch tells which one it
+  is, release with Hunk_ScratchReset() or free(). offset_central_dir is
+  the position of the first entry as returned by unzGetCurrentFileInfoPosition.
+  return NULL if the zipfile cannot be opened or is not valid
+*/
+extern void *unzReadCentralDir (const char* path, unsigned long *offset_central_dir,
+								unsigned long *size_central_dir, unsigned long *number_entry, bool *scratch)
+{
+	byte buf[22];
+	uLong central_pos, offset, size, entries;
+	FILE * fin;
+	void *dir;
+
+    fin=F_OPEN(path,"rb");
+	if (fin==NULL)
+		return NULL;
+
+	central_pos = unzlocal_SearchCentralDir(fin);
+	if (central_pos==0 || fseek(fin,central_pos,SEEK_SET)!=0 || unzlocal_getData(fin,buf,22)!=UNZ_OK)
+	{
+		fclose(fin);
+		return NULL;
+	}
+
+	entries = (unsigned short)LittleShort( *(short*)(buf+8) );
+	size = (unsigned int)LittleLong( *(int*)(buf+12) );
+	offset = (unsigned int)LittleLong( *(int*)(buf+16) );
+
+	/* spanning is not supported, same checks as in unzOpen */
+	if (*(short*)(buf+4) || *(short*)(buf+6) ||
+		entries != (unsigned short)LittleShort( *(short*)(buf+10) ) ||
+		central_pos < offset + size || size == 0)
+	{
+		fclose(fin);
+		return NULL;
+	}
+
+	dir = size <= INT_MAX ? Hunk_AllocScratch((int)size) : NULL;
+	*scratch = (dir != NULL);
+	if (dir == NULL)
+		dir = malloc(size);
+	if (dir == NULL || fseek(fin,central_pos-size,SEEK_SET)!=0 || fread(dir,size,1,fin)!=1)
+	{
+		if (!*scratch)
+			free(dir);
+		fclose(fin);
+		return NULL;
+	}
+
+	fclose(fin);
+
+	*offset_central_dir = offset;
+	*size_central_dir = size;
+	*number_entry = entries;
+
+	return dir;
+}
+
+
 /*
   Close a ZipFile opened with unzipOpen.
   If there is files inside the .Zip opened with unzipOpenCurrentFile (see later),
@@ -1995,6 +2057,550 @@ extern int unzOpenCurrentFile (unzFile file)
 }
 
 
+/*
+  Fast inflate
+
+  Decodes a whole raw deflate stream from memory to memory, used when the
+  whole entry is wanted at once. Bits are kept in a 64-bit buffer that is
+  refilled a word at a time, so a literal or a whole length/distance pair
+  is decoded without checking for input. Huffman codes are decoded with
+  one lookup in a table indexed by the next FI_LITLEN_BITS bits, longer
+  codes continue in a subtable, and when two literal codes fit in the
+  primary table bits both are emitted by one lookup.
+
+  Table entry: bits 0..4 code length, 5..7 kind, 8..11 extra bits or
+  subtable bits, 16..31 literal(s), base value or subtable offset.
+*/
+
+#define FI_LITLEN_BITS	11
+#define FI_DIST_BITS	8
+#define FI_PRECODE_BITS	7
+#define FI_LITLEN_SIZE	((1<<FI_LITLEN_BITS) + 288*16)
+#define FI_DIST_SIZE	((1<<FI_DIST_BITS) + 32*128)
+
+#define FI_BAD		0
+#define FI_LIT		1
+#define FI_LIT2		2
+#define FI_BASE		3	/* length or distance, value + extra bits */
+#define FI_EOB		4
+#define FI_SUB		5
+
+#define FI_ENTRY(kind,extra,value)	(((kind)<<5) | ((extra)<<8) | ((unsigned int)(value)<<16))
+#define FI_LEN(e)		((e) & 31)
+#define FI_KIND(e)		(((e) >> 5) & 7)
+#define FI_EXTRA(e)		(((e) >> 8) & 15)
+#define FI_VALUE(e)		((e) >> 16)
+
+typedef unsigned int fiEntry_t;
+
+typedef struct
+{
+	fiEntry_t	litlen[FI_LITLEN_SIZE];
+	fiEntry_t	dist[FI_DIST_SIZE];
+	fiEntry_t	precode[1<<FI_PRECODE_BITS];
+	fiEntry_t	litlenSyms[288];
+	fiEntry_t	distSyms[32];
+	fiEntry_t	precodeSyms[19];
+	byte		lens[288+32];
+} fastInflate_t;
+
+static const unsigned short fi_lengthBase[29] = {
+	3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+static const byte fi_lengthExtra[29] = {
+	0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const unsigned short fi_distBase[30] = {
+	1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+static const byte fi_distExtra[30] = {
+	0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+static const byte fi_precodeOrder[19] = {
+	16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 };
+
+
+static void fi_InitSymbols (fastInflate_t *fi)
+{
+	int i;
+
+	for (i = 0; i < 256; i++)
+		fi->litlenSyms[i] = FI_ENTRY(FI_LIT, 0, i);
+	fi->litlenSyms[256] = FI_ENTRY(FI_EOB, 0, 0);
+	for (i = 0; i < 29; i++)
+		fi->litlenSyms[257+i] = FI_ENTRY(FI_BASE, fi_lengthExtra[i], fi_lengthBase[i]);
+	fi->litlenSyms[286] = fi->litlenSyms[287] = FI_BAD;
+
+	for (i = 0; i < 30; i++)
+		fi->distSyms[i] = FI_ENTRY(FI_BASE, fi_distExtra[i], fi_distBase[i]);
+	fi->distSyms[30] = fi->distSyms[31] = FI_BAD;
+
+	for (i = 0; i < 19; i++)
+		fi->precodeSyms[i] = FI_ENTRY(FI_LIT, 0, i);
+}
+
+
+/*
+  Builds decoding table for canonical Huffman code given by lens,
+  incomplete codes are allowed, unused entries decode as FI_BAD.
+  return 0 on success, -1 for over-subscribed codes
+*/
+static int fi_BuildTable (fiEntry_t *table, int tableSize, int root, const byte *lens,
+						  const fiEntry_t *syms, int num)
+{
+	unsigned short sorted[288];
+	unsigned short count[16], offs[16], next[16];
+	unsigned int code, rev, prefix, low, used, step;
+	int i, len, left, sym, sub, subBits, cur, max, total;
+	fiEntry_t e;
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < num; i++)
+		count[lens[i]]++;
+	count[0] = 0;
+
+	left = 1;
+	for (len = 1; len < 16; len++)
+	{
+		left <<= 1;
+		left -= count[len];
+		if (left < 0)
+			return -1;
+	}
+
+	offs[1] = 0;
+	for (len = 1; len < 15; len++)
+		offs[len+1] = offs[len] + count[len];
+	total = 0;
+	for (i = 0; i < num; i++)
+	{
+		if (lens[i])
+		{
+			sorted[offs[lens[i]]++] = (unsigned short)i;
+			total++;
+		}
+	}
+
+	/* first canonical code of each length */
+	code = 0;
+	for (len = 1; len < 16; len++)
+	{
+		code = (code + count[len-1]) << 1;
+		next[len] = (unsigned short)code;
+	}
+
+	max = 15;
+	while (max > 0 && count[max] == 0)
+		max--;
+
+	memset(table, 0, (1u << root) * sizeof(table[0]));
+	used = 1u << root;
+	low = ~0u;
+	sub = 0;
+	subBits = 0;
+
+	/* codes are visited in canonical order, so long codes sharing the
+	   same primary table prefix are consecutive */
+	for (i = 0; i < total; i++)
+	{
+		sym = sorted[i];
+		len = lens[sym];
+		code = next[len]++;
+
+		/* bit reverse, deflate sends codes msb first */
+		rev = 0;
+		for (cur = 0; cur < len; cur++)
+			rev |= ((code >> cur) & 1) << (len - 1 - cur);
+
+		if (len <= root)
+		{
+			e = syms[sym] ? (syms[sym] | len) : FI_BAD;
+			for (step = rev; step < (1u << root); step += 1u << len)
+				table[step] = e;
+			continue;
+		}
+
+		prefix = rev & ((1u << root) - 1);
+		if (prefix != low)
+		{
+			/* size the subtable from the codes left, like zlib does */
+			cur = len - root;
+			left = 1 << cur;
+			while (cur + root < max)
+			{
+				left -= count[cur + root];
+				if (left <= 0)
+					break;
+				cur++;
+				left <<= 1;
+			}
+			subBits = cur;
+			sub = (int)used;
+			used += 1u << subBits;
+			if (used > (unsigned)tableSize)
+				return -1;
+			memset(table + sub, 0, (1u << subBits) * sizeof(table[0]));
+			table[prefix] = FI_ENTRY(FI_SUB, subBits, sub) | root;
+			low = prefix;
+		}
+
+		e = syms[sym] ? (syms[sym] | (len - root)) : FI_BAD;
+		for (step = rev >> root; step < (1u << subBits); step += 1u << (len - root))
+			table[sub + step] = e;
+		count[len]--;
+	}
+
+	return 0;
+}
+
+
+/*
+  Replaces literal entries of the primary table with double literal
+  entries where the following code is a literal that fits in the rest
+  of the table bits. Goes down so the entry for the following bits,
+  which has a lower index, is still unchanged.
+*/
+static void fi_PairLiterals (fiEntry_t *table)
+{
+	fiEntry_t e, e2;
+	int i, len;
+
+	for (i = (1 << FI_LITLEN_BITS) - 1; i >= 0; i--)
+	{
+		e = table[i];
+		if (FI_KIND(e) != FI_LIT)
+			continue;
+		len = FI_LEN(e);
+		e2 = table[i >> len];
+		if (FI_KIND(e2) != FI_LIT || FI_LEN(e2) > FI_LITLEN_BITS - len)
+			continue;
+		table[i] = FI_ENTRY(FI_LIT2, 0, FI_VALUE(e) | (FI_VALUE(e2) << 8)) | (len + FI_LEN(e2));
+	}
+}
+
+
+#define FI_REFILL() \
+	if (in_end - in_next >= 8) { \
+		bitbuf |= fi_Load64(in_next) << bitsleft; \
+		in_next += (63 - bitsleft) >> 3; \
+		bitsleft |= 56; \
+	} else { \
+		while (bitsleft < 56) { \
+			if (in_next < in_end) \
+				bitbuf |= (unsigned long long)*in_next++ << bitsleft; \
+			else if (++overread > 8) \
+				goto error; \
+			bitsleft += 8; \
+		} \
+	}
+
+#define FI_BITS(n)		((unsigned int)bitbuf & ((1u << (n)) - 1))
+#define FI_CONSUME(n)	{ bitbuf >>= (n); bitsleft -= (n); }
+
+
+static unsigned long long fi_Load64 (const byte *p)
+{
+#ifdef Q3_LITTLE_ENDIAN
+	unsigned long long v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+#else
+	return (unsigned long long)p[0] | ((unsigned long long)p[1] << 8) | ((unsigned long long)p[2] << 16) |
+		((unsigned long long)p[3] << 24) | ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40) |
+		((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+#endif
+}
+
+
+/*
+  return the number of byte written to dest, -1 if stream is invalid or
+  doesn't decode to exactly destLen bytes
+*/
+static int fi_Inflate (fastInflate_t *fi, byte *dest, unsigned destLen, const byte *source, unsigned sourceLen)
+{
+	const byte *in_next = source;
+	const byte *in_end = source + sourceLen;
+	byte *out_next = dest;
+	byte *out_end = dest + destLen;
+	unsigned long long bitbuf = 0;
+	unsigned int bitsleft = 0;
+	unsigned int overread = 0;
+	unsigned int final, type, length, dist, nlen, ndist, n, i;
+	const byte *src;
+	fiEntry_t e;
+
+	fi_InitSymbols(fi);
+
+	do
+	{
+		FI_REFILL();
+		final = FI_BITS(1);
+		type = (unsigned int)(bitbuf >> 1) & 3;
+		FI_CONSUME(3);
+
+		if (type == 0)
+		{
+			/* stored block, give whole buffered bytes back to the input */
+			FI_CONSUME(bitsleft & 7);
+			if ((bitsleft >> 3) < overread)
+				goto error;
+			in_next -= (bitsleft >> 3) - overread;
+			bitbuf = 0;
+			bitsleft = 0;
+			overread = 0;
+
+			if (in_end - in_next < 4)
+				goto error;
+			length = in_next[0] | (in_next[1] << 8);
+			if ((length ^ 0xFFFF) != (unsigned int)(in_next[2] | (in_next[3] << 8)))
+				goto error;
+			in_next += 4;
+			if (length > (unsigned)(in_end - in_next) || length > (unsigned)(out_end - out_next))
+				goto error;
+			memcpy(out_next, in_next, length);
+			in_next += length;
+			out_next += length;
+			continue;
+		}
+
+		if (type == 1)
+		{
+			for (i = 0; i < 144; i++) fi->lens[i] = 8;
+			for (; i < 256; i++) fi->lens[i] = 9;
+			for (; i < 280; i++) fi->lens[i] = 7;
+			for (; i < 288; i++) fi->lens[i] = 8;
+			for (; i < 288+32; i++) fi->lens[i] = 5;
+			nlen = 288;
+			ndist = 32;
+		}
+		else if (type == 2)
+		{
+			nlen = FI_BITS(5) + 257;
+			ndist = ((unsigned int)(bitbuf >> 5) & 31) + 1;
+			n = ((unsigned int)(bitbuf >> 10) & 15) + 4;
+			FI_CONSUME(14);
+
+			memset(fi->lens, 0, 19);
+			for (i = 0; i < n; i++)
+			{
+				FI_REFILL();
+				fi->lens[fi_precodeOrder[i]] = (byte)FI_BITS(3);
+				FI_CONSUME(3);
+			}
+			if (fi_BuildTable(fi->precode, ARRAY_LEN(fi->precode), FI_PRECODE_BITS, fi->lens, fi->precodeSyms, 19) < 0)
+				goto error;
+
+			for (i = 0; i < nlen + ndist; )
+			{
+				FI_REFILL();
+				e = fi->precode[FI_BITS(FI_PRECODE_BITS)];
+				if (FI_KIND(e) != FI_LIT)
+					goto error;
+				FI_CONSUME(FI_LEN(e));
+				n = FI_VALUE(e);
+				if (n < 16)
+				{
+					fi->lens[i++] = (byte)n;
+					continue;
+				}
+				if (n == 16)
+				{
+					if (i == 0)
+						goto error;
+					length = 3 + FI_BITS(2);
+					FI_CONSUME(2);
+					n = fi->lens[i-1];
+				}
+				else if (n == 17)
+				{
+					length = 3 + FI_BITS(3);
+					FI_CONSUME(3);
+					n = 0;
+				}
+				else
+				{
+					length = 11 + FI_BITS(7);
+					FI_CONSUME(7);
+					n = 0;
+				}
+				if (i + length > nlen + ndist)
+					goto error;
+				memset(fi->lens + i, n, length);
+				i += length;
+			}
+			/* end of block code must be present */
+			if (fi->lens[256] == 0)
+				goto error;
+		}
+		else
+		{
+			goto error;
+		}
+
+		if (fi_BuildTable(fi->litlen, ARRAY_LEN(fi->litlen), FI_LITLEN_BITS, fi->lens, fi->litlenSyms, nlen) < 0)
+			goto error;
+		if (fi_BuildTable(fi->dist, ARRAY_LEN(fi->dist), FI_DIST_BITS, fi->lens + nlen, fi->distSyms, ndist) < 0)
+			goto error;
+		fi_PairLiterals(fi->litlen);
+
+		/* decode the block, a refill gives at least 56 bits, which is
+		   enough for a length code, a distance code and their extra bits */
+		for (;;)
+		{
+			FI_REFILL();
+
+			e = fi->litlen[FI_BITS(FI_LITLEN_BITS)];
+			if (FI_KIND(e) == FI_SUB)
+			{
+				FI_CONSUME(FI_LITLEN_BITS);
+				e = fi->litlen[FI_VALUE(e) + FI_BITS(FI_EXTRA(e))];
+			}
+			FI_CONSUME(FI_LEN(e));
+
+			switch (FI_KIND(e))
+			{
+			case FI_LIT2:
+				if (out_end - out_next < 2)
+					goto error;
+				out_next[0] = (byte)FI_VALUE(e);
+				out_next[1] = (byte)(FI_VALUE(e) >> 8);
+				out_next += 2;
+				continue;
+
+			case FI_LIT:
+				if (out_next == out_end)
+					goto error;
+				*out_next++ = (byte)FI_VALUE(e);
+				continue;
+
+			case FI_BASE:
+				break;
+
+			case FI_EOB:
+				goto end_of_block;
+
+			default:
+				goto error;
+			}
+
+			length = FI_VALUE(e) + FI_BITS(FI_EXTRA(e));
+			FI_CONSUME(FI_EXTRA(e));
+
+			e = fi->dist[FI_BITS(FI_DIST_BITS)];
+			if (FI_KIND(e) == FI_SUB)
+			{
+				FI_CONSUME(FI_DIST_BITS);
+				e = fi->dist[FI_VALUE(e) + FI_BITS(FI_EXTRA(e))];
+			}
+			if (FI_KIND(e) != FI_BASE)
+				goto error;
+			FI_CONSUME(FI_LEN(e));
+			dist = FI_VALUE(e) + FI_BITS(FI_EXTRA(e));
+			FI_CONSUME(FI_EXTRA(e));
+
+			if (dist > (unsigned)(out_next - dest) || length > (unsigned)(out_end - out_next))
+				goto error;
+
+			src = out_next - dist;
+			if (dist >= 8 && (unsigned)(out_end - out_next) >= length + 8)
+			{
+				/* whole words, may write up to 7 bytes past the match */
+				byte *dst = out_next;
+				do
+				{
+					memcpy(dst, src, 8);
+					dst += 8;
+					src += 8;
+				} while (dst < out_next + length);
+			}
+			else if (dist == 1)
+			{
+				memset(out_next, out_next[-1], length);
+			}
+			else
+			{
+				for (i = 0; i < length; i++)
+					out_next[i] = src[i];
+			}
+			out_next += length;
+		}
+end_of_block:
+		;
+	} while (!final);
+
+	/* must not have used the zero bytes fed after the end of input */
+	if (out_next != out_end || bitsleft < overread * 8)
+		goto error;
+
+	return (int)(out_next - dest);
+
+error:
+	return -1;
+}
+
+
+/*
+  Allocates fast inflate state, it's too large for the stack of
+  some threads. Uses malloc so it can be called from any thread.
+*/
+static int fi_InflateBuffer (void *dest, unsigned destLen, const void *source, unsigned sourceLen)
+{
+	fastInflate_t *fi;
+	int ret;
+
+	fi = (fastInflate_t*)malloc(sizeof(*fi));
+	if (fi == NULL)
+		return -1;
+
+	ret = fi_Inflate(fi, (byte*)dest, destLen, (const byte*)source, sourceLen);
+
+	free(fi);
+
+	return ret;
+}
+
+
+static int unz_fastInflate = 1;
+
+extern void unzSetFastInflate (int enable)
+{
+	unz_fastInflate = enable;
+}
+
+
+/*
+  Reads and decodes the whole current entry in one go with the fast
+  decoder. Leaves the read state as if streaming read everything.
+  return the number of byte copied, or <0 if the streaming path must be used
+*/
+static int unzlocal_ReadWholeCurrentFile (file_in_zip_read_info_s* p, void *buf)
+{
+	uLong compressed = p->rest_read_compressed;
+	uLong uncompressed = p->rest_read_uncompressed;
+	byte *source;
+	int ret;
+
+	if (compressed <= UNZ_BUFSIZE)
+		source = (byte*)p->read_buffer;
+	else if ((source = (byte*)malloc(compressed)) == NULL)
+		return -1;
+
+	ret = -1;
+	if (fseek(p->file, p->pos_in_zipfile + p->byte_before_the_zipfile, SEEK_SET) == 0 &&
+		fread(source, compressed, 1, p->file) == 1)
+		ret = fi_InflateBuffer(buf, uncompressed, source, compressed);
+
+	if (source != (byte*)p->read_buffer)
+		free(source);
+
+	if (ret < 0)
+		return -1;
+
+	p->pos_in_zipfile += compressed;
+	p->rest_read_compressed = 0;
+	p->rest_read_uncompressed = 0;
+	p->stream.total_out = uncompressed;
+
+	return ret;
+}
+
+
 /*
   Read bytes from the current file.
   buf contain buffer where data must be copied
@@ -2033,6 +2639,18 @@ extern int unzReadCurrentFile  (unzFile file, void *buf, unsigned len)
 		pfile_in_zip_read_info->stream.avail_out = 
 		  (uInt)pfile_in_zip_read_info->rest_read_uncompressed;
 
+	/* whole entry wanted at once, try the fast decoder */
+	if (unz_fastInflate && pfile_in_zip_read_info->compression_method!=0 &&
+		pfile_in_zip_read_info->stream.total_out == 0 &&
+		pfile_in_zip_read_info->rest_read_compressed == s->cur_file_info.compressed_size &&
+		pfile_in_zip_read_info->rest_read_uncompressed >= UNZ_FASTINFLATE_MIN &&
+		len >= pfile_in_zip_read_info->rest_read_uncompressed)
+	{
+		int ret = unzlocal_ReadWholeCurrentFile(pfile_in_zip_read_info, buf);
+		if (ret >= 0)
+			return ret;
+	}
+
 	while (pfile_in_zip_read_info->stream.avail_out>0)
 	{
 		if ((pfile_in_zip_read_info->stream.avail_in==0) &&
@@ -2261,6 +2879,68 @@ extern int unzCloseCurrentFile (unzFile file)
 }
 
 
+static void *unzlocal_Alloc (void *opaque, unsigned items, unsigned size)
+{
+	return malloc(items * size);
+}
+
+static void unzlocal_Free (void *opaque, void *ptr)
+{
+	free(ptr);
+}
+
+
+/*
+  Inflate a whole deflated entry from memory to memory.
+  Doesn't touch the zone so it can be used by any thread.
+  return the number of byte written to dest, or an error code <0
+*/
+extern int unzInflateBuffer (void *dest, unsigned destLen, const void *source, unsigned sourceLen)
+{
+	z_stream stream;
+	int err;
+
+	if (unz_fastInflate && destLen >= UNZ_FASTINFLATE_MIN && fi_InflateBuffer(dest, destLen, source, sourceLen) >= 0)
+		return (int)destLen;
+
+	Com_Memset(&stream, 0, sizeof(stream));
+	stream.zalloc = unzlocal_Alloc;
+	stream.zfree = unzlocal_Free;
+
+	err = inflateInit2(&stream, -MAX_WBITS);
+	if (err != Z_OK)
+		return err;
+
+	stream.next_in = (Byte*)source;
+	stream.avail_in = sourceLen;
+	stream.next_out = (Byte*)dest;
+	stream.avail_out = destLen;
+
+	/* without the dummy byte after the stream inflate may stop with Z_OK
+	   or Z_BUF_ERROR after writing everything, sizes tell when it's done */
+	err = inflate(&stream, Z_SYNC_FLUSH);
+	inflateEnd(&stream);
+
+	if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+		return err;
+
+	if (stream.total_out != destLen)
+		return Z_DATA_ERROR;
+
+	return (int)stream.total_out;
+}
+
+
+/*
+  Inflate a whole deflated entry with the fast decoder only.
+  return the number of byte written to dest, or <0 if the fast decoder can't handle it
+*/
+extern int unzFastInflateBuffer (void *dest, unsigned destLen, const void *source, unsigned sourceLen)
+{
+	return fi_InflateBuffer(dest, destLen, source, sourceLen);
+}
+
+
 /*
   Get the global comment string of the ZipFile, in the szComment buffer.
   uSizeBuf is the size of the szComment buffer.
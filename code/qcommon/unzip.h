@@ -180,6 +180,8 @@ extern int unzStringFileNameCompare (const char* fileName1, const char* fileName
 
 extern unzFile unzOpen (const char *path);
 extern unzFile unzReOpen (const char* path, unzFile file);
+extern void *unzReadCentralDir (const char* path, unsigned long *offset_central_dir,
+								unsigned long *size_central_dir, unsigned long *number_entry, bool *scratch);
 
 /*
   Open a Zip file. path contain the full pathname (by example,
@@ -294,6 +296,33 @@ extern int unzCloseCurrentFile (unzFile file);
   Return UNZ_CRCERROR if all the file was read but the CRC is not good
 */
 
+extern int unzInflateBuffer (void *dest, unsigned destLen, const void *source, unsigned sourceLen);
+
+/*
+  Inflate a whole deflated entry which is already in memory, without a
+  zlib header, as stored in zip files. Safe to call from any thread.
+  return the number of byte written to dest, or an error code <0
+*/
+
+extern int unzFastInflateBuffer (void *dest, unsigned destLen, const void *source, unsigned sourceLen);
+
+/*
+  Same as unzInflateBuffer but with the fast decoder only, without zlib
+  fallback. Used to measure the fast decoder.
+  return the number of byte written to dest, or <0 if the fast decoder can't handle it
+*/
+
+/* table setup costs more than the faster decoding saves for small entries */
+#define UNZ_FASTINFLATE_MIN (16*1024)
+
+extern void unzSetFastInflate (int enable);
+
+/*
+  Enable or disable the fast decoder used by unzInflateBuffer and by
+  unzReadCurrentFile when the whole entry is read at once, zlib inflate
+  is used when it is disabled or the fast decoder fails
+*/
+
 												
 extern int unzReadCurrentFile (unzFile file, void* buf, unsigned len);
 
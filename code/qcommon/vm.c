@@ -203,6 +203,8 @@ const char *opname[256] = {
 	"OP_CVFI"};
 
 cvar_t *vm_rtChecks;
+cvar_t *vm_jitTier;
+static cvar_t *vm_cache;
 
 #ifdef DEBUG
 int vm_debugLevel;
@@ -221,6 +223,47 @@ static const char *vmName[VM_COUNT] = {
 static void VM_VmInfo_f(void);
 static void VM_VmProfile_f(void);
 
+#ifdef USE_VM_SAMPLER
+#define SAMPLE_MAX_DEPTH 64
+#define SAMPLE_SYSCALL -1	   // frame index for engine code called by the vm
+#define SAMPLE_HASH_SIZE 16384 // unique stacks, power of two
+#define SAMPLE_POOL_SIZE 262144 // frames of all unique stacks
+
+typedef struct
+{
+	uint32_t hash;
+	int count;
+	int depth; // 0 if unused
+	int offset; // in sampler.pool, innermost frame first
+} vmStack_t;
+
+static struct
+{
+	vm_t *vm;
+	const void *volatile stackTop; // native stack above outermost VM_Call of sampled vm, NULL if it is not running
+
+	int numProcs;
+	intptr_t *procAddr; // native entry points, ascending
+	char **procNames;
+	char vmName[MAX_QPATH];
+
+	vmStack_t *stacks;
+	int32_t *pool;
+	int poolUsed;
+	int numStacks;
+
+	int samples;  // in vm or its system calls
+	int outside;  // vm was not running
+	int dropped;  // tables are full
+	int hz;
+	int startTime;
+	int duration;
+} sampler;
+
+static void VM_VmSample_f(void);
+static void VM_SampleFree(vm_t *vm);
+#endif
+
 #ifdef DEBUG
 void VM_Debug(int level)
 {
@@ -273,8 +316,24 @@ void VM_Init(void)
 #endif
 	Cvar_Get("vm_game", "2", CVAR_ARCHIVE | CVAR_PROTECTED); // !@# SHIP WITH SET TO 2
 
+	vm_cache = Cvar_Get("vm_cache", "1", CVAR_ARCHIVE_ND);
+	Cvar_CheckRange(vm_cache, "0", "1", CV_INTEGER);
+	Cvar_SetDescription(vm_cache, "Store compiled vm code in vmcache directory and reuse it on next load.");
+
+	vm_jitTier = Cvar_Get("vm_jitTier", "0", CVAR_ARCHIVE_ND);
+	Cvar_CheckRange(vm_jitTier, "0", "1", CV_INTEGER);
+	Cvar_SetDescription(vm_jitTier, "Compiler tier used for vm code, applied on next vm load:\n"
+									" 0 - baseline compiler\n"
+									" 1 - optimizing compiler, removes dead local stores and temporaries and\n"
+									"     keeps locals in registers between calls");
+
 	Cmd_AddCommand("vmprofile", VM_VmProfile_f);
 	Cmd_AddCommand("vminfo", VM_VmInfo_f);
+#ifdef USE_VM_SAMPLER
+	Cmd_AddCommand("vmsample", VM_VmSample_f);
+#endif
+
+	VM_InitTrace();
 
 	Com_Memset(vmTable, 0, sizeof(vmTable));
 }
@@ -1081,8 +1140,8 @@ static void VM_Fixup(instruction_t *buf, int instructionCount)
 		if (i->op == OP_LOCAL)
 		{
 
-			// skip useless sequences
-			if ((i + 1)->op == OP_LOCAL && (i + 0)->value == (i + 1)->value && (i + 2)->op == OP_LOAD4 && (i + 3)->op == OP_STORE4)
+			// skip useless sequences, unless they carry a jump label
+			if ((i + 1)->op == OP_LOCAL && (i + 0)->value == (i + 1)->value && (i + 2)->op == OP_LOAD4 && (i + 3)->op == OP_STORE4 && !(i + 0)->jused)
 			{
 				VM_IgnoreInstructions(i, 4);
 				i += 4;
@@ -1769,215 +1828,1347 @@ const char *VM_CheckInstructions(instruction_t *buf,
 	return NULL;
 }
 
+/*
+=============================================================================
+
+OPTIMIZING TIER
+
+Works on one procedure at a time: finds the locals whose address never
+escapes, splits the procedure into basic blocks and computes liveness of
+those locals across the blocks. Stores to locals that are never read again
+are turned into plain pops and store/load round trips through temporaries
+are removed so the value stays in a register of the code generator.
+
+Remaining accesses are then split into regions at calls. Each local
+accessed more than once in a region gets a live interval in instruction
+order, stretched over the loops it is used in, and the intervals are
+assigned to home registers of the code generator by linear scan, separately
+for integer and float values. Stores write through to memory, so a forward
+pass over the blocks only has to find the loads that may see another local
+in the home register and have to fill it first.
+
+Procedures with indirect jumps or with local addresses that are used for
+anything but a direct load/store are left untouched.
+
+=============================================================================
+*/
+
+#define OPT_MAX_SLOTS 256 // 4-byte locals within first 1K of the frame
+#define OPT_MAX_REGS 15	  // home registers per class, limited by instruction_t.reg
+#define OPT_MAX_HOMES (OPT_MAX_REGS * 2) // integer homes first, then float ones
+#define OPT_SET_WORDS (OPT_MAX_SLOTS / 32)
+
+#define OPT_SET(set, n) ((set)[(n) >> 5] |= 1U << ((n) & 31))
+#define OPT_CLEAR(set, n) ((set)[(n) >> 5] &= ~(1U << ((n) & 31)))
+#define OPT_TEST(set, n) ((set)[(n) >> 5] & (1U << ((n) & 31)))
+
+typedef struct
+{
+	int start, end; // instruction range
+	int succ[2];	// successor blocks, -1 if none
+	uint32_t use[OPT_SET_WORDS];
+	uint32_t def[OPT_SET_WORDS];
+	uint32_t in[OPT_SET_WORDS];
+	uint32_t out[OPT_SET_WORDS];
+	short home[OPT_MAX_HOMES]; // local held by home register on entry, -1 if unknown
+	bool visited;
+} optBlock_t;
+
+typedef struct
+{
+	instruction_t *buf;
+	int *slot;	// LOAD4/STORE4 local slot, -1 if not a candidate access
+	int *addr;	// STORE4 address producer if it is OP_LOCAL
+	int *block; // basic block of instruction
+	optBlock_t *blocks;
+	uint32_t excluded[OPT_SET_WORDS]; // partially accessed or address-taken slots
+	int numRegs[2];					  // home registers for integer and float values
+	int range[OPT_MAX_SLOTS];		  // live interval of slot in current region, -1 if none
+	int removedStores;
+	int removedLoads;
+	int allocated;
+	int spilled;
+} optState_t;
+
+typedef struct
+{
+	int slot;
+	int start, end; // first and last access, live interval of the local
+	int uses;
+	int sse;		// local holds a float value
+	int reg;		// home register + 1, 0 if spilled
+} optRange_t;
+
 /*
 =================
-VM_ReplaceInstructions
+VM_OptExclude
 =================
 */
-void VM_ReplaceInstructions(vm_t *vm, instruction_t *buf)
+static void VM_OptExclude(optState_t *st, int addr, int size)
 {
-	instruction_t *ip;
+	int n;
 
-	// Com_Printf( S_COLOR_GREEN "VMINFO [%s] crc: %08X, ic: %i, dl: %i\n", vm->name, vm->crc32sum, vm->instructionCount, vm->exactDataLength );
+	for (n = addr >> 2; n <= (addr + size - 1) >> 2; n++)
+	{
+		if (n >= 0 && n < OPT_MAX_SLOTS)
+			OPT_SET(st->excluded, n);
+	}
+}
 
-	if (vm->index == VM_CGAME)
+/*
+=================
+VM_OptAnalyzeProc
+
+Tracks producers of opStack values to find out how local addresses are used,
+returns false if any local address escapes
+=================
+*/
+static bool VM_OptAnalyzeProc(optState_t *st, int start, int end)
+{
+	int producer[PROC_OPSTACK_SIZE];
+	instruction_t *ci;
+	int n, k, p, v, size, depth, pops, pushes, frame;
+
+	Com_Memset(st->excluded, 0, sizeof(st->excluded));
+
+	frame = st->buf[start].value;
+	depth = 0;
+
+	for (n = start + 1; n <= end; n++)
 	{
-		if (vm->crc32sum == 0x3E93FC1A && vm->instructionCount == 123596 && vm->exactDataLength == 2007536)
+		ci = &st->buf[n];
+		st->slot[n] = -1;
+		st->addr[n] = -1;
+
+		// values carried over jump labels can't be tracked
+		if (ci->jused && depth != 0)
+			return false;
+
+		pops = ops[ci->op].nargs == 3 ? 2 : ops[ci->op].nargs;
+		pushes = pops + ops[ci->op].stack / 4;
+		if (pushes < 0)
 		{
-			ip = buf + 110190;
-			if (ip->op == OP_ENTER && (ip + 183)->op == OP_LEAVE && ip->value == (ip + 183)->value)
-			{
-				ip++;
-				ip->op = OP_CONST;
-				ip->value = 110372;
-				ip++;
-				ip->op = OP_JUMP;
-				ip->value = 0;
-				ip++;
-				ip->op = OP_IGNORE;
-				ip->value = 0;
-			}
-			if (buf[4358].op == OP_LOCAL && buf[4358].value == 308 && buf[4359].op == OP_CONST && !buf[4359].value)
-			{
-				buf[4359].value++;
-			}
+			pops -= pushes;
+			pushes = 0;
 		}
-		else if (vm->crc32sum == 0xF0F1AE90 && vm->instructionCount == 123552 && vm->exactDataLength == 2007520)
+		if (pops > depth)
+			return false;
+
+		for (k = 0; k < pops; k++)
 		{
-			ip = buf + 110177;
-			if (ip->op == OP_ENTER && (ip + 183)->op == OP_LEAVE && ip->value == (ip + 183)->value)
-			{
-				ip++;
-				ip->op = OP_CONST;
-				ip->value = 110359;
-				ip++;
-				ip->op = OP_JUMP;
-				ip->value = 0;
-				ip++;
-				ip->op = OP_IGNORE;
-				ip->value = 0;
-			}
-			if (buf[4358].op == OP_LOCAL && buf[4358].value == 308 && buf[4359].op == OP_CONST && !buf[4359].value)
+			p = producer[depth - 1 - k];
+			if (st->buf[p].op != OP_LOCAL)
+				continue;
+			v = st->buf[p].value;
+			switch (ci->op)
 			{
-				buf[4359].value++;
+			case OP_LOAD1:
+			case OP_LOAD2:
+			case OP_LOAD4:
+			case OP_STORE1:
+			case OP_STORE2:
+			case OP_STORE4:
+				if (ci->op >= OP_STORE1 && k != 1)
+					return false; // address is stored somewhere
+				if (ci->op == OP_LOAD4 || ci->op == OP_STORE4)
+					size = 4;
+				else if (ci->op == OP_LOAD2 || ci->op == OP_STORE2)
+					size = 2;
+				else
+					size = 1;
+				if (size == 4 && (v & 3) == 0 && v >= 8 && v < frame && (v >> 2) < OPT_MAX_SLOTS)
+					st->slot[n] = v >> 2;
+				else
+					VM_OptExclude(st, v, size);
+				if (ci->op == OP_STORE4)
+					st->addr[n] = p;
+				break;
+			case OP_BLOCK_COPY:
+				VM_OptExclude(st, v, ci->value);
+				break;
+			default:
+				return false;
 			}
 		}
-		else if (vm->crc32sum == 0x051D4668 && vm->instructionCount == 267812 && vm->exactDataLength == 38064376)
+
+		depth -= pops;
+
+		// outgoing arguments are read by the callee
+		if (ci->op == OP_ARG)
+			VM_OptExclude(st, ci->value, 4);
+
+		for (k = 0; k < pushes; k++)
 		{
-			ip = buf + 235;
-			if (ip->value == 70943)
-			{
-				VM_IgnoreInstructions(ip, 8);
-			}
+			if (depth >= ARRAY_LEN(producer))
+				return false;
+			producer[depth++] = n;
 		}
 	}
 
-	if (vm->index == VM_GAME)
+	return true;
+}
+
+/*
+=================
+VM_OptBuildBlocks
+
+Returns number of basic blocks, 0 on failure
+=================
+*/
+static int VM_OptBuildBlocks(optState_t *st, int start, int end)
+{
+	instruction_t *ci;
+	optBlock_t *b;
+	int n, v, numBlocks;
+
+	// mark block leaders
+	for (n = start + 1; n <= end; n++)
+		st->block[n] = 0;
+	st->block[start + 1] = 1;
+
+	for (n = start + 1; n <= end; n++)
 	{
-		if (vm->crc32sum == 0x5AAE0ACC && vm->instructionCount == 251521 && vm->exactDataLength == 1872720)
+		ci = &st->buf[n];
+		if (ci->jused)
+			st->block[n] = 1;
+		if ((ops[ci->op].flags & JUMP) || ci->op == OP_JUMP)
 		{
-			vm->forceDataMask = true; // OSP server doing some bad things with memory
+			if (ci->op == OP_JUMP && st->buf[n - 1].op != OP_CONST)
+				return 0; // indirect jump
+			v = ci->value;
+			if (v <= start || v > end)
+				return 0;
+			st->block[v] = 1;
 		}
-		else
+		if (((ops[ci->op].flags & JUMP) || ci->op == OP_JUMP || ci->op == OP_LEAVE) && n < end)
+			st->block[n + 1] = 1;
+	}
+
+	numBlocks = 0;
+	b = st->blocks;
+	for (n = start + 1; n <= end; n++)
+	{
+		if (st->block[n])
 		{
-			vm->forceDataMask = false;
+			b = &st->blocks[numBlocks++];
+			Com_Memset(b, 0, sizeof(*b));
+			b->start = n;
 		}
+		b->end = n;
+		st->block[n] = numBlocks - 1;
 	}
 
-	if (vm->index == VM_UI)
+	// link successors
+	for (v = 0, b = st->blocks; v < numBlocks; v++, b++)
 	{
-		// fix OSP demo UI
-		if (vm->crc32sum == 0xCA84F31D && vm->instructionCount == 78585 && vm->exactDataLength == 542180)
+		ci = &st->buf[b->end];
+		b->succ[0] = b->succ[1] = -1;
+		if (ci->op == OP_JUMP)
 		{
-			if (memcmp(vm->dataBase + 0x3D2E, "dm_67", 5) == 0)
+			b->succ[0] = st->block[ci->value];
+		}
+		else if (ci->op != OP_LEAVE)
+		{
+			if (ops[ci->op].flags & JUMP)
+				b->succ[1] = st->block[ci->value];
+			if (v + 1 < numBlocks)
+				b->succ[0] = v + 1;
+		}
+	}
+
+	return numBlocks;
+}
+
+/*
+=================
+VM_OptLiveness
+=================
+*/
+static void VM_OptLiveness(optState_t *st, int numBlocks)
+{
+	optBlock_t *b;
+	uint32_t out, in;
+	bool changed;
+	int i, n, s;
+
+	for (i = 0, b = st->blocks; i < numBlocks; i++, b++)
+	{
+		for (n = b->start; n <= b->end; n++)
+		{
+			s = st->slot[n];
+			if (s < 0)
+				continue;
+			if (st->buf[n].op == OP_LOAD4)
 			{
-				memcpy(vm->dataBase + 0x3D2E, "dm_??", 5);
+				if (!OPT_TEST(b->def, s))
+					OPT_SET(b->use, s);
 			}
-			if (memcmp(vm->dataBase + 0x3D50, "\"%s.%s\"\n", 8) == 0)
+			else
 			{
-				memcpy(vm->dataBase + 0x3D50, "\"%s\"\n", 6);
+				OPT_SET(b->def, s);
 			}
 		}
-		// fix defrag-1.91.25 demo UI - masked Q_strupr() calls for directories and filenames
-		if (vm->crc32sum == 0x6E51985F && vm->instructionCount == 125942 && vm->exactDataLength == 1334788)
+	}
+
+	do
+	{
+		changed = false;
+		for (i = numBlocks - 1; i >= 0; i--)
 		{
-			ip = buf + 60150;
-			if (ip[0].op == OP_LOCAL && ip[0].value == 28 && ip[1].op == OP_LOAD4 && ip[2].op == OP_ARG && ip[3].value == 124325)
+			b = &st->blocks[i];
+			for (n = 0; n < OPT_SET_WORDS; n++)
 			{
-				VM_IgnoreInstructions(ip, 6);
-				ip = buf + 60438;
-				VM_IgnoreInstructions(ip, 6);
+				out = 0;
+				if (b->succ[0] >= 0)
+					out |= st->blocks[b->succ[0]].in[n];
+				if (b->succ[1] >= 0)
+					out |= st->blocks[b->succ[1]].in[n];
+				in = b->use[n] | (out & ~b->def[n]);
+				if (in != b->in[n] || out != b->out[n])
+				{
+					b->in[n] = in;
+					b->out[n] = out;
+					changed = true;
+				}
 			}
 		}
-	}
+	} while (changed);
 }
 
 /*
 =================
-VM_Restart
-
-Reload the data, but leave everything else in place
-This allows a server to do a map_restart without changing memory allocation
+VM_OptRewriteBlock
 =================
 */
-vm_t *VM_Restart(vm_t *vm)
+static void VM_OptRewriteBlock(optState_t *st, const optBlock_t *b)
 {
-	vmHeader_t *header;
-
-	// DLL's can't be restarted in place
-	if (vm->dllHandle)
-	{
-		syscall_t systemCall;
-		dllSyscall_t dllSyscall;
-		vmIndex_t index;
-
-		index = vm->index;
-		systemCall = vm->systemCall;
-		dllSyscall = vm->dllSyscall;
-
-		VM_Free(vm);
+	uint32_t live[OPT_SET_WORDS];
+	instruction_t *buf;
+	int n, s;
 
-		vm = VM_Create(index, systemCall, dllSyscall, VMI_NATIVE);
-		return vm;
-	}
+	buf = st->buf;
+	Com_Memcpy(live, b->out, sizeof(live));
 
-	// load the image
-	if ((header = VM_LoadQVM(vm, false)) == NULL)
+	for (n = b->end; n >= b->start; n--)
 	{
-		Com_Printf(S_COLOR_RED "VM_Restart() failed\n");
-		return NULL;
-	}
-
-	Com_Printf("VM_Restart()\n");
-
-	// free the original file
-	FS_FreeFile(header);
+		s = st->slot[n];
+		if (s < 0)
+			continue;
 
-	return vm;
+		if (buf[n].op == OP_LOAD4)
+		{
+			// OP_STORE4 + OP_LOCAL + OP_LOAD4 of temporary that is not used later
+			if (!OPT_TEST(live, s) && !OPT_TEST(st->excluded, s) && n - 2 >= b->start &&
+				!buf[n].jused && !buf[n - 1].jused && buf[n - 1].op == OP_LOCAL &&
+				buf[n - 2].op == OP_STORE4 && st->slot[n - 2] == s && st->addr[n - 2] >= b->start &&
+				!buf[st->addr[n - 2]].jused)
+			{
+				VM_IgnoreInstructions(buf + st->addr[n - 2], 1);
+				VM_IgnoreInstructions(buf + n - 2, 3);
+				st->removedStores++;
+				st->removedLoads++;
+				n -= 2;
+				continue;
+			}
+			OPT_SET(live, s);
+		}
+		else
+		{
+			// value is never read, just drop it; an address producer that is
+			// also a jump target has to stay in place
+			if (!OPT_TEST(live, s) && !OPT_TEST(st->excluded, s) && st->addr[n] >= b->start &&
+				!buf[st->addr[n]].jused)
+			{
+				VM_IgnoreInstructions(buf + st->addr[n], 1);
+				buf[n].op = OP_POP;
+				buf[n].value = 0;
+				buf[n].safe = 0;
+				st->removedStores++;
+			}
+			OPT_CLEAR(live, s);
+		}
+	}
 }
 
 /*
 =================
-Sys_LoadDll
-
-Used to load a development dll instead of a virtual machine
+VM_OptFloatValue
 
-TTimo: added some verbosity in debug
+Checks if value stored at n is a result of float operation
 =================
 */
-static void *QDECL VM_LoadDll(const char *name, vmMainFunc_t *entryPoint, dllSyscall_t systemcalls)
+static bool VM_OptFloatValue(const instruction_t *buf, int n, int start)
 {
+	// value is produced by the last instruction of its expression
+	while (--n >= start && buf[n].op == OP_IGNORE)
+		;
 
-	const char *gamedir = FS_GetCurrentGameDir();
-	char filename[MAX_QPATH];
-	void *libHandle;
-	dllEntry_t dllEntry;
-
-	Com_sprintf(filename, sizeof(filename), "%s%c%s" ARCH_STRING DLL_EXT, gamedir, PATH_SEP, name);
-
-	libHandle = FS_LoadLibrary(filename);
+	if (n < start)
+		return false;
 
-	if (!libHandle)
+	switch (buf[n].op)
 	{
-		Com_Printf("VM_LoadDLL '%s' failed\n", filename);
-		return NULL;
+	case OP_NEGF:
+	case OP_ADDF:
+	case OP_SUBF:
+	case OP_DIVF:
+	case OP_MULF:
+	case OP_CVIF:
+		return true;
+	default:
+		return false;
 	}
+}
 
-	Com_Printf("VM_LoadDLL '%s' ok\n", filename);
-
-	dllEntry = /* ( dllEntry_t ) */ Sys_LoadFunction(libHandle, "dllEntry");
-	*entryPoint = /* ( dllSyscall_t ) */ Sys_LoadFunction(libHandle, "vmMain");
-	if (!*entryPoint || !dllEntry)
-	{
-		Sys_UnloadLibrary(libHandle);
-		return NULL;
-	}
+/*
+=================
+VM_OptRangeSort
+=================
+*/
+static int QDECL VM_OptRangeSort(const void *a, const void *b)
+{
+	const optRange_t *ra = (const optRange_t *)a;
+	const optRange_t *rb = (const optRange_t *)b;
 
-	Com_Printf("VM_LoadDll(%s) found **vmMain** at %p\n", name, *entryPoint);
-	dllEntry(systemcalls);
-	Com_Printf("VM_LoadDll(%s) succeeded!\n", name);
+	if (ra->start != rb->start)
+		return ra->start - rb->start;
 
-	return libHandle;
+	return ra->slot - rb->slot;
 }
 
 /*
-================
-VM_Create
+=================
+VM_OptAllocRegion
 
-If image ends in .qvm it will be interpreted, otherwise
-it will attempt to load as a system dll
-================
+Linear scan over live intervals of the locals accessed in [start, end],
+a region of the procedure that contains no calls
+=================
 */
-vm_t *VM_Create(vmIndex_t index, syscall_t systemCalls, dllSyscall_t dllSyscalls, vmInterpret_t interpret)
+static void VM_OptAllocRegion(optState_t *st, int start, int end)
 {
-	int remaining;
-	const char *name;
-	vmHeader_t *header;
-	vm_t *vm;
-
-	if (!systemCalls)
+	optRange_t ranges[OPT_MAX_SLOTS];
+	optRange_t *active[2][OPT_MAX_REGS];
+	int numActive[2];
+	uint32_t used[2];
+	instruction_t *buf;
+	optRange_t *r, *a;
+	int i, k, c, n, s, t, numRanges;
+	bool changed;
+
+	buf = st->buf;
+	numRanges = 0;
+
+	// build intervals
+	for (n = start; n <= end; n++)
 	{
-		Com_Error(ERR_FATAL, "VM_Create: bad parms");
+		s = st->slot[n];
+		if (s < 0 || OPT_TEST(st->excluded, s))
+			continue;
+		if (st->range[s] < 0)
+		{
+			st->range[s] = numRanges;
+			r = &ranges[numRanges++];
+			Com_Memset(r, 0, sizeof(*r));
+			r->slot = s;
+			r->start = n;
+		}
+		r = &ranges[st->range[s]];
+		r->end = n;
+		r->uses++;
+		if (buf[n].op == OP_LOAD4 ? buf[n].fpu : VM_OptFloatValue(buf, n, start))
+			r->sse = 1;
+	}
+
+	for (i = 0; i < numRanges; i++)
+		st->range[ranges[i].slot] = -1;
+
+	// a local used inside a loop stays live over the whole loop
+	do
+	{
+		changed = false;
+		for (n = start; n <= end; n++)
+		{
+			if (!(ops[buf[n].op].flags & JUMP) && buf[n].op != OP_JUMP)
+				continue;
+			t = buf[n].value;
+			if (t < start || t > n)
+				continue;
+			for (i = 0; i < numRanges; i++)
+			{
+				r = &ranges[i];
+				if (r->start > n || r->end < t || (r->start <= t && r->end >= n))
+					continue;
+				r->start = MIN(r->start, t);
+				r->end = MAX(r->end, n);
+				changed = true;
+			}
+		}
+	} while (changed);
+
+	qsort(ranges, numRanges, sizeof(ranges[0]), VM_OptRangeSort);
+
+	numActive[0] = numActive[1] = 0;
+	used[0] = used[1] = 0;
+
+	for (i = 0; i < numRanges; i++)
+	{
+		r = &ranges[i];
+		if (r->uses < 2)
+			continue; // nothing to win
+		c = (r->sse && st->numRegs[1]) ? 1 : 0;
+		if (st->numRegs[c] == 0)
+			continue;
+
+		// expire intervals that end before this one
+		for (k = 0; k < numActive[c];)
+		{
+			a = active[c][k];
+			if (a->end < r->start)
+			{
+				used[c] &= ~(1U << (a->reg - 1));
+				active[c][k] = active[c][--numActive[c]];
+			}
+			else
+			{
+				k++;
+			}
+		}
+
+		if (numActive[c] < st->numRegs[c])
+		{
+			for (n = 0; used[c] & (1U << n); n++)
+				;
+			used[c] |= 1U << n;
+			r->reg = n + 1;
+			active[c][numActive[c]++] = r;
+			continue;
+		}
+
+		// spill interval that lives longest
+		for (a = NULL, n = 0, k = 0; k < numActive[c]; k++)
+		{
+			if (!a || active[c][k]->end > a->end)
+			{
+				a = active[c][k];
+				n = k;
+			}
+		}
+		if (a->end > r->end)
+		{
+			r->reg = a->reg;
+			a->reg = 0;
+			active[c][n] = r;
+		}
+		st->spilled++;
+	}
+
+	// annotate accesses with home registers
+	for (i = 0; i < numRanges; i++)
+	{
+		r = &ranges[i];
+		if (!r->reg)
+			continue;
+		st->allocated++;
+		for (n = r->start; n <= r->end; n++)
+		{
+			if (st->slot[n] != r->slot)
+				continue;
+			buf[n].value = r->slot << 2; // LOAD4/STORE4 carry no operand
+			buf[n].reg = r->reg;
+			buf[n].sse = (r->sse && st->numRegs[1]) ? 1 : 0;
+		}
+	}
+}
+
+/*
+=================
+VM_OptAllocProc
+=================
+*/
+static void VM_OptAllocProc(optState_t *st, int start, int end)
+{
+	int n, first;
+
+	// calls clobber home registers
+	for (first = n = start + 1; n <= end; n++)
+	{
+		if (st->buf[n].op == OP_CALL)
+		{
+			VM_OptAllocRegion(st, first, n);
+			first = n + 1;
+		}
+	}
+
+	if (first <= end)
+		VM_OptAllocRegion(st, first, end);
+}
+
+/*
+=================
+VM_OptHomeTransfer
+
+Tracks locals held by home registers through the block, marks loads
+that have to fill the home register from memory
+=================
+*/
+static void VM_OptHomeTransfer(optState_t *st, const optBlock_t *b, short *home, bool mark)
+{
+	instruction_t *ci;
+	int n, h;
+
+	for (n = b->start; n <= b->end; n++)
+	{
+		ci = &st->buf[n];
+		if (ci->op == OP_CALL)
+		{
+			for (h = 0; h < OPT_MAX_HOMES; h++)
+				home[h] = -1;
+			continue;
+		}
+		if (!ci->reg)
+			continue;
+		h = ci->reg - 1 + (ci->sse ? OPT_MAX_REGS : 0);
+		if (mark && ci->op == OP_LOAD4 && home[h] != (ci->value >> 2))
+			ci->fill = 1;
+		home[h] = ci->value >> 2;
+	}
+}
+
+/*
+=================
+VM_OptPlaceFills
+
+Stores always write through to memory, so a home register only has to be
+filled where some path may reach the load with another local in it
+=================
+*/
+static void VM_OptPlaceFills(optState_t *st, int numBlocks)
+{
+	short home[OPT_MAX_HOMES];
+	optBlock_t *b, *sb;
+	bool changed;
+	int i, k, h;
+
+	for (h = 0; h < OPT_MAX_HOMES; h++)
+		st->blocks[0].home[h] = -1;
+	st->blocks[0].visited = true;
+
+	do
+	{
+		changed = false;
+		for (i = 0, b = st->blocks; i < numBlocks; i++, b++)
+		{
+			if (!b->visited)
+				continue;
+			Com_Memcpy(home, b->home, sizeof(home));
+			VM_OptHomeTransfer(st, b, home, false);
+			for (k = 0; k < 2; k++)
+			{
+				if (b->succ[k] < 0)
+					continue;
+				sb = &st->blocks[b->succ[k]];
+				if (!sb->visited)
+				{
+					Com_Memcpy(sb->home, home, sizeof(home));
+					sb->visited = true;
+					changed = true;
+					continue;
+				}
+				for (h = 0; h < OPT_MAX_HOMES; h++)
+				{
+					if (sb->home[h] != home[h] && sb->home[h] != -1)
+					{
+						sb->home[h] = -1;
+						changed = true;
+					}
+				}
+			}
+		}
+	} while (changed);
+
+	for (i = 0, b = st->blocks; i < numBlocks; i++, b++)
+	{
+		if (!b->visited)
+		{
+			for (h = 0; h < OPT_MAX_HOMES; h++)
+				b->home[h] = -1;
+		}
+		Com_Memcpy(home, b->home, sizeof(home));
+		VM_OptHomeTransfer(st, b, home, true);
+	}
+}
+
+/*
+=================
+VM_OptimizeInstructions
+
+Returns number of removed memory accesses
+=================
+*/
+int VM_OptimizeInstructions(instruction_t *buf, int instructionCount, int intRegs, int sseRegs)
+{
+	optState_t st;
+	int i, n, start, end, maxLength, numBlocks;
+
+	// find longest procedure
+	maxLength = 0;
+	for (start = -1, i = 0; i < instructionCount; i++)
+	{
+		if (buf[i].op == OP_ENTER)
+			start = i;
+		else if (buf[i].op == OP_LEAVE && buf[i].endp && start >= 0 && i - start > maxLength)
+			maxLength = i - start;
+	}
+
+	if (maxLength == 0)
+		return 0;
+
+	Com_Memset(&st, 0, sizeof(st));
+	st.buf = buf;
+	st.numRegs[0] = MIN(intRegs, OPT_MAX_REGS);
+	st.numRegs[1] = MIN(sseRegs, OPT_MAX_REGS);
+	for (i = 0; i < OPT_MAX_SLOTS; i++)
+		st.range[i] = -1;
+	st.slot = Z_Malloc(instructionCount * sizeof(int) * 3);
+	st.addr = st.slot + instructionCount;
+	st.block = st.addr + instructionCount;
+	st.blocks = Z_Malloc(maxLength * sizeof(optBlock_t));
+
+	for (i = 0; i < instructionCount; i++)
+	{
+		if (buf[i].op != OP_ENTER)
+			continue;
+
+		start = i;
+		for (end = start + 1; end < instructionCount; end++)
+		{
+			if (buf[end].op == OP_LEAVE && buf[end].endp)
+				break;
+		}
+		i = end;
+
+		if (end >= instructionCount || buf[start].swtch)
+			continue;
+
+		if (!VM_OptAnalyzeProc(&st, start, end))
+			continue;
+
+		numBlocks = VM_OptBuildBlocks(&st, start, end);
+		if (numBlocks == 0)
+			continue;
+
+		VM_OptLiveness(&st, numBlocks);
+
+		for (n = numBlocks - 1; n >= 0; n--)
+		{
+			VM_OptRewriteBlock(&st, &st.blocks[n]);
+		}
+
+		if (st.numRegs[0] == 0 && st.numRegs[1] == 0)
+			continue;
+
+		// collect accesses that survived the rewrites
+		if (!VM_OptAnalyzeProc(&st, start, end))
+			continue;
+
+		VM_OptAllocProc(&st, start, end);
+		VM_OptPlaceFills(&st, numBlocks);
+	}
+
+	Z_Free(st.blocks);
+	Z_Free(st.slot);
+
+	Com_DPrintf("%s: removed %i stores and %i loads, %i locals in registers, %i spilled\n", __func__,
+				st.removedStores, st.removedLoads, st.allocated, st.spilled);
+
+	return st.removedStores + st.removedLoads;
+}
+
+/*
+=================
+VM_ReplaceInstructions
+=================
+*/
+void VM_ReplaceInstructions(vm_t *vm, instruction_t *buf)
+{
+	instruction_t *ip;
+
+	// Com_Printf( S_COLOR_GREEN "VMINFO [%s] crc: %08X, ic: %i, dl: %i\n", vm->name, vm->crc32sum, vm->instructionCount, vm->exactDataLength );
+
+	if (vm->index == VM_CGAME)
+	{
+		if (vm->crc32sum == 0x3E93FC1A && vm->instructionCount == 123596 && vm->exactDataLength == 2007536)
+		{
+			ip = buf + 110190;
+			if (ip->op == OP_ENTER && (ip + 183)->op == OP_LEAVE && ip->value == (ip + 183)->value)
+			{
+				ip++;
+				ip->op = OP_CONST;
+				ip->value = 110372;
+				ip++;
+				ip->op = OP_JUMP;
+				ip->value = 0;
+				ip++;
+				ip->op = OP_IGNORE;
+				ip->value = 0;
+			}
+			if (buf[4358].op == OP_LOCAL && buf[4358].value == 308 && buf[4359].op == OP_CONST && !buf[4359].value)
+			{
+				buf[4359].value++;
+			}
+		}
+		else if (vm->crc32sum == 0xF0F1AE90 && vm->instructionCount == 123552 && vm->exactDataLength == 2007520)
+		{
+			ip = buf + 110177;
+			if (ip->op == OP_ENTER && (ip + 183)->op == OP_LEAVE && ip->value == (ip + 183)->value)
+			{
+				ip++;
+				ip->op = OP_CONST;
+				ip->value = 110359;
+				ip++;
+				ip->op = OP_JUMP;
+				ip->value = 0;
+				ip++;
+				ip->op = OP_IGNORE;
+				ip->value = 0;
+			}
+			if (buf[4358].op == OP_LOCAL && buf[4358].value == 308 && buf[4359].op == OP_CONST && !buf[4359].value)
+			{
+				buf[4359].value++;
+			}
+		}
+		else if (vm->crc32sum == 0x051D4668 && vm->instructionCount == 267812 && vm->exactDataLength == 38064376)
+		{
+			ip = buf + 235;
+			if (ip->value == 70943)
+			{
+				VM_IgnoreInstructions(ip, 8);
+			}
+		}
+	}
+
+	if (vm->index == VM_GAME)
+	{
+		if (vm->crc32sum == 0x5AAE0ACC && vm->instructionCount == 251521 && vm->exactDataLength == 1872720)
+		{
+			vm->forceDataMask = true; // OSP server doing some bad things with memory
+		}
+		else
+		{
+			vm->forceDataMask = false;
+		}
+	}
+
+	if (vm->index == VM_UI)
+	{
+		// fix defrag-1.91.25 demo UI - masked Q_strupr() calls for directories and filenames
+		if (vm->crc32sum == 0x6E51985F && vm->instructionCount == 125942 && vm->exactDataLength == 1334788)
+		{
+			ip = buf + 60150;
+			if (ip[0].op == OP_LOCAL && ip[0].value == 28 && ip[1].op == OP_LOAD4 && ip[2].op == OP_ARG && ip[3].value == 124325)
+			{
+				VM_IgnoreInstructions(ip, 6);
+				ip = buf + 60438;
+				VM_IgnoreInstructions(ip, 6);
+			}
+		}
+	}
+}
+
+/*
+=================
+VM_ReplaceData
+
+Data fixups, applied on load regardless of how the code is prepared
+=================
+*/
+static void VM_ReplaceData(vm_t *vm)
+{
+	if (vm->index == VM_UI)
+	{
+		// fix OSP demo UI
+		if (vm->crc32sum == 0xCA84F31D && vm->instructionCount == 78585 && vm->exactDataLength == 542180)
+		{
+			if (memcmp(vm->dataBase + 0x3D2E, "dm_67", 5) == 0)
+			{
+				memcpy(vm->dataBase + 0x3D2E, "dm_??", 5);
+			}
+			if (memcmp(vm->dataBase + 0x3D50, "\"%s.%s\"\n", 8) == 0)
+			{
+				memcpy(vm->dataBase + 0x3D50, "\"%s\"\n", 6);
+			}
+		}
+	}
+}
+
+/*
+==============================================================================
+
+NATIVE CODE CACHE
+
+Compiled code is stored in vmcache/ under the home path together with the
+list of absolute addresses embedded in it, so the next load only has to copy
+and patch it. The file is keyed by everything that affects code generation:
+qvm and jump table checksums, engine and backend build, CPU features and
+vm_rtChecks. Outdated or damaged files are ignored and replaced by the next
+compilation.
+
+The files are executed as native code, so they are authenticated with an
+HMAC keyed by a random per-install secret in vmcache/. VMs can't read or
+write there: "vmcache" is not a valid game directory and the filesystem
+refuses to write .jit files for them.
+
+==============================================================================
+*/
+
+#define VM_CACHE_IDENT (('C' << 24) + ('M' << 16) + ('V' << 8) + 'Q')
+#define VM_CACHE_VERSION 2
+#define VM_CACHE_SECRET "vmcache/secret.key"
+#define VM_CACHE_SECRET_SIZE 32
+#define VM_CACHE_MAC_SIZE 16
+
+typedef struct
+{
+	int32_t ident;
+	int32_t version;
+	uint32_t build;
+	int32_t cpuFlags;
+	int32_t rtChecks;
+	uint32_t crc32sum;
+	uint32_t jtsChecksum;
+	int32_t index;
+	int32_t instructionCount;
+	uint32_t exactDataLength;
+	uint32_t dataMask;
+	int32_t stackBottom;
+	// end of key
+	int32_t codeLength;
+	int32_t procsLength;
+	int32_t numRelocs;
+	byte mac[VM_CACHE_MAC_SIZE]; // header up to here and everything after it
+} vmCacheHeader_t;
+
+/*
+=================
+VM_CacheSecret
+
+Loads the key of the cache files, creates it on first use,
+returns NULL if there is no secret to use
+=================
+*/
+static const byte *VM_CacheSecret(void)
+{
+	static byte secret[VM_CACHE_SECRET_SIZE];
+	static bool loaded;
+	fileHandle_t f;
+	int length;
+
+	if (loaded)
+	{
+		return secret;
+	}
+
+	length = FS_SV_FOpenFileRead(VM_CACHE_SECRET, &f);
+	if (f != FS_INVALID_HANDLE)
+	{
+		loaded = (length == sizeof(secret) && FS_Read(secret, sizeof(secret), f) == sizeof(secret));
+		FS_FCloseFile(f);
+		if (loaded)
+		{
+			return secret;
+		}
+	}
+
+	if (!Sys_RandomBytes(secret, sizeof(secret)))
+	{
+		return NULL;
+	}
+
+	// files keyed by a replaced secret are simply recompiled
+	f = FS_SV_FOpenFileWrite(VM_CACHE_SECRET ".tmp");
+	if (f == FS_INVALID_HANDLE)
+	{
+		return NULL;
+	}
+	length = FS_Write(secret, sizeof(secret), f);
+	FS_FCloseFile(f);
+	if (length != sizeof(secret))
+	{
+		return NULL;
+	}
+	FS_SV_Rename(VM_CACHE_SECRET ".tmp", VM_CACHE_SECRET);
+
+	loaded = true;
+	return secret;
+}
+
+/*
+=================
+VM_CacheMAC
+=================
+*/
+static void VM_CacheMAC(const byte *secret, const byte *data, int length, byte *mac)
+{
+	Com_MD5HMAC(secret, VM_CACHE_SECRET_SIZE, data, offsetof(vmCacheHeader_t, mac),
+				data + sizeof(vmCacheHeader_t), length - (int)sizeof(vmCacheHeader_t), mac);
+}
+
+/*
+=================
+VM_CacheFileName
+=================
+*/
+static void VM_CacheFileName(const vm_t *vm, char *filename, int size)
+{
+	Com_sprintf(filename, size, "vmcache/%s-%08x.jit", vm->name, vm->crc32sum);
+}
+
+/*
+=================
+VM_InitCacheHeader
+=================
+*/
+static void VM_InitCacheHeader(const vm_t *vm, const vmCodeCache_t *cache, vmCacheHeader_t *header)
+{
+	const char *build;
+
+	build = va("%s %s %s %s %s", Q3_VERSION, ARCH_STRING, __DATE__, __TIME__, cache->build);
+
+	Com_Memset(header, 0, sizeof(*header));
+	header->ident = VM_CACHE_IDENT;
+	header->version = VM_CACHE_VERSION;
+	header->build = crc32_buffer((const byte *)build, strlen(build));
+	header->cpuFlags = CPU_Flags;
+	header->rtChecks = vm_rtChecks->integer;
+	header->crc32sum = vm->crc32sum;
+	if (vm->jumpTableTargets)
+	{
+		header->jtsChecksum = crc32_buffer((const byte *)vm->jumpTableTargets, vm->numJumpTableTargets * sizeof(int32_t));
+	}
+	header->index = vm->index;
+	header->instructionCount = vm->instructionCount;
+	header->exactDataLength = vm->exactDataLength;
+	header->dataMask = vm->dataMask;
+	header->stackBottom = vm->stackBottom;
+}
+
+/*
+=================
+VM_LoadCodeCache
+
+Returns false if there is no valid cached code for the vm,
+on success the cache must be released with VM_FreeCodeCache()
+=================
+*/
+bool VM_LoadCodeCache(vm_t *vm, vmCodeCache_t *cache)
+{
+	vmCacheHeader_t key, *header;
+	char filename[MAX_QPATH];
+	fileHandle_t f;
+	const int32_t *offsets;
+	const vmReloc_t *relocs;
+	const byte *secret;
+	byte mac[VM_CACHE_MAC_SIZE];
+	byte *data;
+	int length, remaining, i;
+
+	cache->data = NULL;
+
+	if (!vm_cache->integer)
+	{
+		return false;
+	}
+
+	secret = VM_CacheSecret();
+	if (!secret)
+	{
+		return false;
+	}
+
+	VM_CacheFileName(vm, filename, sizeof(filename));
+
+	length = FS_SV_FOpenFileRead(filename, &f);
+	if (f == FS_INVALID_HANDLE)
+	{
+		return false;
+	}
+
+	if (length <= (int)sizeof(*header))
+	{
+		FS_FCloseFile(f);
+		return false;
+	}
+
+	data = Z_Malloc(length);
+	if (FS_Read(data, length, f) != length)
+	{
+		FS_FCloseFile(f);
+		Z_Free(data);
+		return false;
+	}
+	FS_FCloseFile(f);
+
+	header = (vmCacheHeader_t *)data;
+	VM_InitCacheHeader(vm, cache, &key);
+
+	// file length must exactly match code, offsets table and relocations
+	remaining = length - (int)sizeof(*header) - vm->instructionCount * (int)sizeof(int32_t);
+	if (header->codeLength > 0 && header->codeLength <= remaining)
+	{
+		remaining -= header->codeLength;
+	}
+	else
+	{
+		remaining = -1;
+	}
+
+	if (memcmp(header, &key, offsetof(vmCacheHeader_t, codeLength)) != 0 || remaining < 0 ||
+		header->procsLength < 0 || header->procsLength > header->codeLength ||
+		remaining % sizeof(vmReloc_t) != 0 || header->numRelocs != remaining / (int)sizeof(vmReloc_t))
+	{
+		Com_DPrintf("Discarding outdated %s\n", filename);
+		Z_Free(data);
+		return false;
+	}
+
+	VM_CacheMAC(secret, data, length, mac);
+	if (memcmp(mac, header->mac, sizeof(mac)) != 0)
+	{
+		Com_Printf(S_COLOR_YELLOW "Discarding %s: not created by this installation\n", filename);
+		Z_Free(data);
+		return false;
+	}
+
+	offsets = (const int32_t *)(data + sizeof(*header) + header->codeLength);
+	for (i = 0; i < vm->instructionCount; i++)
+	{
+		if (offsets[i] < -1 || offsets[i] >= header->codeLength)
+			break;
+	}
+
+	relocs = (const vmReloc_t *)(offsets + vm->instructionCount);
+	if (i == vm->instructionCount)
+	{
+		for (i = 0; i < header->numRelocs; i++)
+		{
+			if (relocs[i].offset < 0 || relocs[i].offset > header->codeLength - (int)sizeof(intptr_t))
+				break;
+		}
+		if (i == header->numRelocs)
+		{
+			i = -1;
+		}
+	}
+
+	if (i != -1)
+	{
+		Com_DPrintf("Discarding damaged %s\n", filename);
+		Z_Free(data);
+		return false;
+	}
+
+	cache->data = data;
+	cache->code = data + sizeof(*header);
+	cache->codeLength = header->codeLength;
+	cache->procsLength = header->procsLength;
+	cache->instructionOffsets = offsets;
+	cache->relocs = relocs;
+	cache->numRelocs = header->numRelocs;
+
+	return true;
+}
+
+/*
+=================
+VM_SaveCodeCache
+=================
+*/
+void VM_SaveCodeCache(vm_t *vm, const vmCodeCache_t *cache)
+{
+	vmCacheHeader_t *header;
+	char filename[MAX_QPATH];
+	char tempname[MAX_QPATH];
+	fileHandle_t f;
+	const byte *secret;
+	byte *data, *code;
+	int tableLength, length, written, i;
+
+	if (!vm_cache->integer)
+	{
+		return;
+	}
+
+	secret = VM_CacheSecret();
+	if (!secret)
+	{
+		Com_DPrintf("No secret for vm code cache\n");
+		return;
+	}
+
+	tableLength = vm->instructionCount * sizeof(int32_t);
+	length = sizeof(*header) + cache->codeLength + tableLength + cache->numRelocs * sizeof(vmReloc_t);
+
+	data = Z_Malloc(length);
+	header = (vmCacheHeader_t *)data;
+	VM_InitCacheHeader(vm, cache, header);
+	header->codeLength = cache->codeLength;
+	header->procsLength = cache->procsLength;
+	header->numRelocs = cache->numRelocs;
+
+	code = data + sizeof(*header);
+	Com_Memcpy(code, cache->code, cache->codeLength);
+	// addresses of this process are meaningless for another one
+	for (i = 0; i < cache->numRelocs; i++)
+	{
+		Com_Memset(code + cache->relocs[i].offset, 0, sizeof(intptr_t));
+	}
+	Com_Memcpy(code + cache->codeLength, cache->instructionOffsets, tableLength);
+	Com_Memcpy(code + cache->codeLength + tableLength, cache->relocs, cache->numRelocs * sizeof(vmReloc_t));
+
+	VM_CacheMAC(secret, data, length, header->mac);
+
+	// write to temporary file first so other processes never see a partial file
+	VM_CacheFileName(vm, filename, sizeof(filename));
+	Com_sprintf(tempname, sizeof(tempname), "%s.tmp", filename);
+
+	f = FS_SV_FOpenFileWrite(tempname);
+	if (f == FS_INVALID_HANDLE)
+	{
+		Com_DPrintf("Couldn't write %s\n", tempname);
+		Z_Free(data);
+		return;
+	}
+
+	written = FS_Write(data, length, f);
+	FS_FCloseFile(f);
+	Z_Free(data);
+
+	if (written == length)
+	{
+		FS_SV_Rename(tempname, filename);
+	}
+}
+
+/*
+=================
+VM_FreeCodeCache
+=================
+*/
+void VM_FreeCodeCache(vmCodeCache_t *cache)
+{
+	if (cache->data)
+	{
+		Z_Free(cache->data);
+		cache->data = NULL;
+	}
+}
+
+/*
+=================
+VM_Restart
+
+Reload the data, but leave everything else in place
+This allows a server to do a map_restart without changing memory allocation
+=================
+*/
+vm_t *VM_Restart(vm_t *vm)
+{
+	vmHeader_t *header;
+
+	// DLL's can't be restarted in place
+	if (vm->dllHandle)
+	{
+		syscall_t systemCall;
+		dllSyscall_t dllSyscall;
+		vmIndex_t index;
+
+		index = vm->index;
+		systemCall = vm->systemCall;
+		dllSyscall = vm->dllSyscall;
+
+		VM_Free(vm);
+
+		vm = VM_Create(index, systemCall, dllSyscall, VMI_NATIVE);
+		return vm;
+	}
+
+	// load the image
+	if ((header = VM_LoadQVM(vm, false)) == NULL)
+	{
+		Com_Printf(S_COLOR_RED "VM_Restart() failed\n");
+		return NULL;
+	}
+
+	Com_Printf("VM_Restart()\n");
+
+	// free the original file
+	FS_FreeFile(header);
+
+	return vm;
+}
+
+/*
+=================
+Sys_LoadDll
+
+Used to load a development dll instead of a virtual machine
+
+TTimo: added some verbosity in debug
+=================
+*/
+static void *QDECL VM_LoadDll(const char *name, vmMainFunc_t *entryPoint, dllSyscall_t systemcalls)
+{
+
+	const char *gamedir = FS_GetCurrentGameDir();
+	char filename[MAX_QPATH];
+	void *libHandle;
+	dllEntry_t dllEntry;
+
+	Com_sprintf(filename, sizeof(filename), "%s%c%s" ARCH_STRING DLL_EXT, gamedir, PATH_SEP, name);
+
+	libHandle = FS_LoadLibrary(filename);
+
+	if (!libHandle)
+	{
+		Com_Printf("VM_LoadDLL '%s' failed\n", filename);
+		return NULL;
+	}
+
+	Com_Printf("VM_LoadDLL '%s' ok\n", filename);
+
+	dllEntry = /* ( dllEntry_t ) */ Sys_LoadFunction(libHandle, "dllEntry");
+	*entryPoint = /* ( dllSyscall_t ) */ Sys_LoadFunction(libHandle, "vmMain");
+	if (!*entryPoint || !dllEntry)
+	{
+		Sys_UnloadLibrary(libHandle);
+		return NULL;
+	}
+
+	Com_Printf("VM_LoadDll(%s) found **vmMain** at %p\n", name, *entryPoint);
+	dllEntry(systemcalls);
+	Com_Printf("VM_LoadDll(%s) succeeded!\n", name);
+
+	return libHandle;
+}
+
+/*
+================
+VM_Create
+
+If image ends in .qvm it will be interpreted, otherwise
+it will attempt to load as a system dll
+================
+*/
+vm_t *VM_Create(vmIndex_t index, syscall_t systemCalls, dllSyscall_t dllSyscalls, vmInterpret_t interpret)
+{
+	int remaining;
+	const char *name;
+	vmHeader_t *header;
+	vm_t *vm;
+
+	if (!systemCalls)
+	{
+		Com_Error(ERR_FATAL, "VM_Create: bad parms");
 	}
 
 	if ((unsigned)index >= VM_COUNT)
@@ -2055,6 +3246,11 @@ vm_t *VM_Create(vmIndex_t index, syscall_t systemCalls, dllSyscall_t dllSyscalls
 
 	vm->compiled = false;
 
+	VM_ReplaceData(vm);
+
+	// wraps system calls, so it must be done before compilation
+	VM_RecordStart(vm, header);
+
 #ifdef NO_VM_COMPILED
 	if (interpret >= VMI_COMPILED)
 	{
@@ -2118,6 +3314,11 @@ void VM_Free(vm_t *vm)
 		}
 	}
 
+	VM_RecordFree(vm);
+#ifdef USE_VM_SAMPLER
+	VM_SampleFree(vm);
+#endif
+
 	if (vm->destroy)
 		vm->destroy(vm);
 
@@ -2224,12 +3425,7 @@ intptr_t QDECL VM_Call(vm_t *vm, int nargs, int callnum, ...)
 	else
 	{
 #if id386 && !defined __clang__ // calling convention doesn't need conversion in some cases
-#ifndef NO_VM_COMPILED
-		if (vm->compiled)
-			r = VM_CallCompiled(vm, nargs + 1, (int32_t *)&callnum);
-		else
-#endif
-			r = VM_CallInterpreted2(vm, nargs + 1, (int32_t *)&callnum);
+		int32_t *args = (int32_t *)&callnum;
 #else
 		int32_t args[MAX_VMMAIN_CALL_ARGS];
 		va_list ap;
@@ -2241,13 +3437,28 @@ intptr_t QDECL VM_Call(vm_t *vm, int nargs, int callnum, ...)
 			args[i + 1] = va_arg(ap, int32_t);
 		}
 		va_end(ap);
+#endif
+		VM_RecordCall(vm, nargs + 1, args);
+#ifdef USE_VM_SAMPLER
+		if (vm == sampler.vm && vm->callLevel == 1)
+		{
+			// everything sampled vm runs is below this
+			sampler.stackTop = &r;
+		}
+#endif
 #ifndef NO_VM_COMPILED
 		if (vm->compiled)
-			r = VM_CallCompiled(vm, nargs + 1, &args[0]);
+			r = VM_CallCompiled(vm, nargs + 1, args);
 		else
 #endif
-			r = VM_CallInterpreted2(vm, nargs + 1, &args[0]);
+			r = VM_CallInterpreted2(vm, nargs + 1, args);
+#ifdef USE_VM_SAMPLER
+		if (vm == sampler.vm && vm->callLevel == 1)
+		{
+			sampler.stackTop = NULL;
+		}
 #endif
+		VM_RecordReturn(vm, r);
 	}
 	--vm->callLevel;
 
@@ -2361,6 +3572,479 @@ static void VM_VmProfile_f(void)
 	Z_Free(sorted);
 }
 
+#ifdef USE_VM_SAMPLER
+/*
+==============================================================================
+
+SAMPLING PROFILER
+
+A system timer interrupts the main thread, the interrupted native stack is
+walked by the compiler backend and every frame is mapped to the compiled
+procedure containing it. Unique stacks are counted in preallocated tables
+since that happens inside of a signal handler. Results are written as
+collapsed stacks, one "root;caller;callee count" line per unique stack,
+understood by flamegraph tools.
+
+==============================================================================
+*/
+
+/*
+=================
+VM_SampleProc
+
+Returns index of procedure containing native address, -1 if there is none
+=================
+*/
+static int VM_SampleProc(const void *addr)
+{
+	int lo, hi, mid;
+
+	if (sampler.numProcs == 0 || (intptr_t)addr < sampler.procAddr[0])
+	{
+		return -1;
+	}
+
+	lo = 0;
+	hi = sampler.numProcs - 1;
+	while (lo < hi)
+	{
+		mid = (lo + hi + 1) / 2;
+		if (sampler.procAddr[mid] <= (intptr_t)addr)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	return lo;
+}
+
+/*
+=================
+VM_Sample
+
+Timer handler, must not allocate or lock
+=================
+*/
+static void VM_Sample(const void *pc, const void *sp)
+{
+	const void *frames[SAMPLE_MAX_DEPTH];
+	int32_t procs[SAMPLE_MAX_DEPTH];
+	const void *stackTop;
+	vmStack_t *st;
+	uint32_t hash;
+	int i, n, depth, p;
+
+	stackTop = sampler.stackTop;
+	if (!sampler.vm || !stackTop)
+	{
+		sampler.outside++;
+		return;
+	}
+
+	n = VM_CompiledBacktrace(sampler.vm, pc, sp, stackTop, frames, ARRAY_LEN(frames));
+
+	hash = 2166136261U;
+	for (i = 0, depth = 0; i < n; i++)
+	{
+		if (frames[i] == NULL)
+		{
+			p = SAMPLE_SYSCALL;
+		}
+		else if ((p = VM_SampleProc(frames[i])) < 0)
+		{
+			continue;
+		}
+		procs[depth++] = p;
+		hash = (hash ^ (uint32_t)p) * 16777619U;
+	}
+
+	if (depth == 0)
+	{
+		sampler.dropped++;
+		return;
+	}
+
+	for (i = hash & (SAMPLE_HASH_SIZE - 1);; i = (i + 1) & (SAMPLE_HASH_SIZE - 1))
+	{
+		st = &sampler.stacks[i];
+		if (st->depth == 0)
+		{
+			break;
+		}
+		if (st->hash == hash && st->depth == depth && !memcmp(sampler.pool + st->offset, procs, depth * sizeof(procs[0])))
+		{
+			st->count++;
+			sampler.samples++;
+			return;
+		}
+	}
+
+	if (sampler.numStacks >= SAMPLE_HASH_SIZE * 3 / 4 || sampler.poolUsed + depth > SAMPLE_POOL_SIZE)
+	{
+		sampler.dropped++;
+		return;
+	}
+
+	Com_Memcpy(sampler.pool + sampler.poolUsed, procs, depth * sizeof(procs[0]));
+	st->hash = hash;
+	st->count = 1;
+	st->offset = sampler.poolUsed;
+	st->depth = depth;
+
+	sampler.poolUsed += depth;
+	sampler.numStacks++;
+	sampler.samples++;
+}
+
+/*
+=================
+VM_SampleStop
+=================
+*/
+static void VM_SampleStop(void)
+{
+	if (!sampler.vm)
+	{
+		return;
+	}
+
+	Sys_StopSampling();
+
+	sampler.duration = Sys_Milliseconds() - sampler.startTime;
+	sampler.vm = NULL;
+	sampler.stackTop = NULL;
+}
+
+/*
+=================
+VM_SampleClear
+=================
+*/
+static void VM_SampleClear(void)
+{
+	int i;
+
+	VM_SampleStop();
+
+	for (i = 0; i < sampler.numProcs; i++)
+	{
+		Z_Free(sampler.procNames[i]);
+	}
+
+	if (sampler.procNames)
+		Z_Free(sampler.procNames);
+	if (sampler.procAddr)
+		Z_Free(sampler.procAddr);
+	if (sampler.stacks)
+		Z_Free(sampler.stacks);
+	if (sampler.pool)
+		Z_Free(sampler.pool);
+
+	Com_Memset(&sampler, 0, sizeof(sampler));
+}
+
+/*
+=================
+VM_SampleFree
+
+Keeps collected samples of unloaded vm
+=================
+*/
+static void VM_SampleFree(vm_t *vm)
+{
+	if (vm == sampler.vm)
+	{
+		VM_SampleStop();
+		Com_Printf("%s unloaded, sampling stopped.\n", vm->name);
+	}
+}
+
+/*
+=================
+VM_SampleStart
+
+Locates procedure entry points in the qvm image, they are not kept after
+compilation
+=================
+*/
+static void VM_SampleStart(vm_t *vm, int hz)
+{
+	const intptr_t *pointers;
+	instruction_t *buf;
+	vmHeader_t *header;
+	const char *errMsg, *name;
+	char filename[MAX_QPATH];
+	int i, n, length;
+
+	VM_SampleClear();
+
+	if (!vm->compiled)
+	{
+		Com_Printf("%s is not compiled, sampling is not available for interpreted code.\n", vm->name);
+		return;
+	}
+
+	Com_sprintf(filename, sizeof(filename), "vm/%s.qvm", vm->name);
+	length = FS_ReadFile(filename, (void **)&header);
+	if (!header)
+	{
+		Com_Printf("Couldn't load %s\n", filename);
+		return;
+	}
+
+	if (crc32_buffer((const byte *)header, length) != vm->crc32sum || VM_ValidateHeader(header, length) ||
+		header->instructionCount != vm->instructionCount)
+	{
+		Com_Printf("%s doesn't match running %s vm\n", filename, vm->name);
+		FS_FreeFile(header);
+		return;
+	}
+
+	buf = Z_Malloc((header->instructionCount + 8) * sizeof(instruction_t));
+	errMsg = VM_LoadInstructions((byte *)header + header->codeOffset, header->codeLength, header->instructionCount, buf);
+	FS_FreeFile(header);
+	if (errMsg)
+	{
+		Com_Printf("%s: %s\n", filename, errMsg);
+		Z_Free(buf);
+		return;
+	}
+
+	for (i = 0, n = 0; i < vm->instructionCount; i++)
+	{
+		if (buf[i].op == OP_ENTER)
+			n++;
+	}
+
+	sampler.procAddr = Z_Malloc(n * sizeof(sampler.procAddr[0]));
+	sampler.procNames = Z_Malloc(n * sizeof(sampler.procNames[0]));
+
+	pointers = VM_CompiledInstructionPointers(vm);
+	for (i = 0, n = 0; i < vm->instructionCount; i++)
+	{
+		if (buf[i].op != OP_ENTER)
+			continue;
+		if (vm->symbols)
+			name = VM_ValueToSymbol(vm, i);
+		else
+			name = va("proc_%i", i);
+		sampler.procAddr[n] = pointers[i];
+		sampler.procNames[n] = CopyString(name);
+		n++;
+	}
+	sampler.numProcs = n;
+
+	Z_Free(buf);
+
+	sampler.stacks = Z_Malloc(SAMPLE_HASH_SIZE * sizeof(sampler.stacks[0]));
+	sampler.pool = Z_Malloc(SAMPLE_POOL_SIZE * sizeof(sampler.pool[0]));
+
+	Q_strncpyz(sampler.vmName, vm->name, sizeof(sampler.vmName));
+	sampler.hz = hz;
+	sampler.startTime = Sys_Milliseconds();
+	sampler.vm = vm;
+
+	if (!Sys_StartSampling(hz, VM_Sample))
+	{
+		Com_Printf("Sampling timer is not available on this platform.\n");
+		VM_SampleClear();
+		return;
+	}
+
+	Com_Printf("Sampling %s at %i Hz, %i procedures.\n", vm->name, hz, sampler.numProcs);
+}
+
+/*
+=================
+VM_SampleName
+=================
+*/
+static const char *VM_SampleName(int proc)
+{
+	if (proc == SAMPLE_SYSCALL)
+		return "[syscall]";
+
+	return sampler.procNames[proc];
+}
+
+/*
+=================
+VM_SampleSummary
+=================
+*/
+static void VM_SampleSummary(void)
+{
+	const vmStack_t *st;
+	int *self, *total, *seen, *sorted;
+	int i, j, n, p, count;
+
+	n = sampler.numProcs + 1; // last one counts system calls
+	self = Z_Malloc(n * sizeof(int));
+	total = Z_Malloc(n * sizeof(int));
+	seen = Z_Malloc(n * sizeof(int));
+	sorted = Z_Malloc(n * sizeof(int));
+
+	for (i = 0; i < n; i++)
+	{
+		seen[i] = -1;
+		sorted[i] = i;
+	}
+
+	// a recursive procedure is counted once per stack in total time
+	for (i = 0, st = sampler.stacks; i < SAMPLE_HASH_SIZE; i++, st++)
+	{
+		for (j = 0; j < st->depth; j++)
+		{
+			p = sampler.pool[st->offset + j];
+			if (p == SAMPLE_SYSCALL)
+				p = n - 1;
+			if (j == 0)
+				self[p] += st->count;
+			if (seen[p] != i)
+			{
+				seen[p] = i;
+				total[p] += st->count;
+			}
+		}
+	}
+
+	// sort by self time
+	for (i = 1; i < n; i++)
+	{
+		p = sorted[i];
+		for (j = i; j > 0 && self[sorted[j - 1]] < self[p]; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = p;
+	}
+
+	count = sampler.samples + sampler.outside + sampler.dropped;
+	Com_Printf("%i samples in %.1f seconds, %i in %s, %i dropped, %i unique stacks\n", count,
+			   (sampler.vm ? Sys_Milliseconds() - sampler.startTime : sampler.duration) / 1000.0f,
+			   sampler.samples, sampler.vmName, sampler.dropped, sampler.numStacks);
+
+	if (sampler.samples)
+	{
+		Com_Printf("  self  total  procedure\n");
+		for (i = 0; i < n && i < 20 && self[sorted[i]]; i++)
+		{
+			p = sorted[i];
+			Com_Printf("%5.1f%% %5.1f%%  %s\n", 100.0f * self[p] / sampler.samples, 100.0f * total[p] / sampler.samples,
+					   p == n - 1 ? VM_SampleName(SAMPLE_SYSCALL) : VM_SampleName(p));
+		}
+	}
+
+	Z_Free(sorted);
+	Z_Free(seen);
+	Z_Free(total);
+	Z_Free(self);
+}
+
+/*
+=================
+VM_SampleWrite
+
+Writes collapsed stacks, samples taken outside of the vm go to "engine"
+=================
+*/
+static void VM_SampleWrite(const char *name)
+{
+	const vmStack_t *st;
+	fileHandle_t f;
+	int i, j;
+
+	f = FS_SV_FOpenFileWrite(name);
+	if (f == FS_INVALID_HANDLE)
+	{
+		Com_Printf(S_COLOR_YELLOW "Couldn't open %s for writing.\n", name);
+		return;
+	}
+
+	for (i = 0, st = sampler.stacks; i < SAMPLE_HASH_SIZE; i++, st++)
+	{
+		if (!st->depth)
+			continue;
+		FS_Printf(f, "%s", sampler.vmName);
+		for (j = st->depth - 1; j >= 0; j--)
+		{
+			FS_Printf(f, ";%s", VM_SampleName(sampler.pool[st->offset + j]));
+		}
+		FS_Printf(f, " %i\n", st->count);
+	}
+
+	if (sampler.outside)
+	{
+		FS_Printf(f, "engine %i\n", sampler.outside);
+	}
+
+	FS_FCloseFile(f);
+
+	Com_Printf("Wrote %i stacks to %s\n", sampler.numStacks, name);
+}
+
+/*
+==============
+VM_VmSample_f
+==============
+*/
+static void VM_VmSample_f(void)
+{
+	const char *cmd;
+	vm_t *vm;
+	int hz;
+
+	cmd = Cmd_Argv(1);
+
+	if (!Q_stricmp(cmd, "stop"))
+	{
+		if (sampler.vm)
+		{
+			VM_SampleStop();
+		}
+		if (!sampler.stacks)
+		{
+			Com_Printf("Nothing was sampled.\n");
+			return;
+		}
+		VM_SampleSummary();
+		if (Cmd_Argc() > 2)
+		{
+			VM_SampleWrite(Cmd_Argv(2));
+		}
+		return;
+	}
+
+	if (*cmd == '\0')
+	{
+		Com_Printf("usage: %s <game|cgame|ui> [hz]\n"
+				   "       %s stop [collapsed stacks file]\n",
+				   Cmd_Argv(0), Cmd_Argv(0));
+		if (sampler.vm)
+		{
+			Com_Printf("sampling %s, %i samples\n", sampler.vmName, sampler.samples);
+		}
+		return;
+	}
+
+	vm = VM_NameToVM(cmd);
+	if (vm == NULL)
+	{
+		return;
+	}
+
+	hz = 997; // avoid lockstep with 1 ms frame timers
+	if (Cmd_Argc() > 2)
+	{
+		hz = atoi(Cmd_Argv(2));
+		if (hz < 10)
+			hz = 10;
+		else if (hz > 10000)
+			hz = 10000;
+	}
+
+	VM_SampleStart(vm, hz);
+}
+#endif // USE_VM_SAMPLER
+
 /*
 ==============
 VM_VmInfo_f
@@ -152,6 +152,9 @@ typedef struct
 	unsigned endp : 1;	// for last OP_LEAVE instruction
 	unsigned fpu : 1;	// load into FPU register
 	unsigned njump : 1; // near jump
+	unsigned reg : 4;	// local kept in home register reg - 1, set by the optimizing tier
+	unsigned sse : 1;	// home register is a scalar FPU register
+	unsigned fill : 1;	// load home register from the local first
 } instruction_t;
 
 typedef struct vmSymbol_s
@@ -200,6 +203,7 @@ struct vm_s
 	vmFunc_t codeBase;
 	unsigned int codeSize;	 // code + jump targets, needed for proper munmap()
 	unsigned int codeLength; // just for information
+	unsigned int procsLength; // compiled procedures, backend helper functions follow them
 
 	int32_t instructionCount;
 	intptr_t *instructionPointers;
@@ -230,6 +234,12 @@ struct vm_s
 bool VM_Compile(vm_t *vm, vmHeader_t *header);
 int32_t VM_CallCompiled(vm_t *vm, int nargs, int32_t *args);
 
+#if (id386 || idx64) && !defined(NO_VM_COMPILED)
+#define USE_VM_SAMPLER
+const intptr_t *VM_CompiledInstructionPointers(const vm_t *vm);
+int VM_CompiledBacktrace(const vm_t *vm, const void *pc, const void *sp, const void *stackTop, const void **frames, int maxFrames);
+#endif
+
 bool VM_PrepareInterpreter2(vm_t *vm, vmHeader_t *header);
 int32_t VM_CallInterpreted2(vm_t *vm, int nargs, int32_t *args);
 
@@ -245,6 +255,39 @@ const char *VM_CheckInstructions(instruction_t *buf, int instructionCount,
 								 int dataLength);
 
 void VM_ReplaceInstructions(vm_t *vm, instruction_t *buf);
+int VM_OptimizeInstructions(instruction_t *buf, int instructionCount, int intRegs, int sseRegs);
+
+extern cvar_t *vm_jitTier;
+
+// vm_trace.c
+void VM_InitTrace(void);
+void VM_RecordStart(vm_t *vm, const vmHeader_t *header);
+void VM_RecordCall(vm_t *vm, int nargs, const int32_t *args);
+void VM_RecordReturn(vm_t *vm, intptr_t result);
+void VM_RecordFree(vm_t *vm);
+
+// native code cache, compiled code is relocated by patching pointer-sized fields
+typedef struct
+{
+	int32_t offset; // position of the field in code
+	int32_t symbol; // backend specific symbol index
+} vmReloc_t;
+
+typedef struct
+{
+	const char *build; // backend build identifier, part of the cache key
+	void *data;		   // file buffer allocated by VM_LoadCodeCache()
+	const byte *code;
+	int32_t codeLength;
+	int32_t procsLength;
+	const int32_t *instructionOffsets; // -1 if instruction is not a jump target
+	const vmReloc_t *relocs;
+	int32_t numRelocs;
+} vmCodeCache_t;
+
+bool VM_LoadCodeCache(vm_t *vm, vmCodeCache_t *cache);
+void VM_SaveCodeCache(vm_t *vm, const vmCodeCache_t *cache);
+void VM_FreeCodeCache(vmCodeCache_t *cache);
 
 #define JUMP (1 << 0)
 #define FPU (1 << 1)
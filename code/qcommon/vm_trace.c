@@ -0,0 +1,832 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// vm_trace.c -- recording and replaying of vm calls for differential testing
+
+#include "vm_local.h"
+
+/*
+==============================================================================
+
+"vmrecord" arms recording of a vm that will be loaded next, so the trace
+always starts from a freshly loaded image. Every vmMain call, every system
+call with its result and every change the engine made to vm memory while
+the vm was not running is written to the trace file.
+
+"vmreplay" loads the same qvm with the interpreter and with every compiler
+tier, feeds it with recorded calls and system call results and compares
+system call arguments, vmMain results and data segment checksums with the
+recording, so any code generator difference shows up as a divergence.
+
+Memory changes are found by comparing the data segment with a copy taken
+when the vm handed control to the engine, so recording is slow for vms with
+big data segments.
+
+==============================================================================
+*/
+
+#define TRACE_IDENT			(('T'<<24)+('M'<<16)+('V'<<8)+'Q')
+#define TRACE_VERSION		1
+
+#define TRACE_SYSCALL_ARGS	16		// as passed by interpreter and compilers
+#define TRACE_BUFFER		65536
+
+typedef enum {
+	TRACE_CALL = 1,		// nargs, args[ nargs ], writes
+	TRACE_RETURN,		// result, data segment checksum
+	TRACE_SYSCALL,		// args[ TRACE_SYSCALL_ARGS ]
+	TRACE_SYSRET		// result, writes
+} traceEvent_t;
+
+// writes are stored as offset, length and data, terminated by offset -1
+
+typedef struct {
+	int32_t		ident;
+	int32_t		version;
+	int32_t		index;
+	int32_t		crc32sum;
+	int32_t		instructionCount;
+	int32_t		dataSize;
+	int32_t		exactDataLength;
+	int32_t		numSyscalls;	// followed by pairs of system call number and number of passed arguments
+} traceHeader_t;
+
+static struct {
+	int				armed;			// vm index + 1
+	char			fileName[ MAX_QPATH ];
+
+	vm_t			*vm;			// vm that uses VM_RecordSyscall, recording or not
+	syscall_t		systemCall;		// original system call handler of that vm
+
+	fileHandle_t	file;
+	byte			*shadow;		// vm memory as the vm has left it
+	byte			buffer[ TRACE_BUFFER ];
+	int				used;
+	int				numCalls;
+	int				numSyscalls;
+} rec;
+
+static struct {
+	byte			*data;
+	int				length;
+	int				pos;
+
+	vm_t			*vm;
+	const traceHeader_t *header;
+	int32_t			*argCount;		// number of passed arguments by system call number, -1 if unknown
+	int				maxSyscall;
+
+	int				numCalls;
+	int				numSyscalls;
+	bool			desync;			// vm took another path, rest of the trace can't be used
+	char			error[ 256 ];	// first divergence
+} rep;
+
+
+/*
+=================
+VM_NameToIndex
+=================
+*/
+static int VM_NameToIndex( const char *name ) {
+	if ( !Q_stricmp( name, "game" ) )
+		return VM_GAME;
+	if ( !Q_stricmp( name, "cgame" ) )
+		return VM_CGAME;
+	if ( !Q_stricmp( name, "ui" ) )
+		return VM_UI;
+	return -1;
+}
+
+
+/*
+=================
+VM_CountSyscallArgs
+
+Returns array of passed argument counts indexed by system call number,
+arguments are counted by OP_ARG instructions preceding the call
+=================
+*/
+static int32_t *VM_CountSyscallArgs( const vmHeader_t *header, int *maxSyscall ) {
+	instruction_t *inst;
+	int32_t *count;
+	int i, n, args;
+
+	*maxSyscall = 0;
+
+	inst = Z_Malloc( ( header->instructionCount + 8 ) * sizeof( instruction_t ) );
+	if ( VM_LoadInstructions( (const byte *)header + header->codeOffset, header->codeLength, header->instructionCount, inst ) ) {
+		Z_Free( inst );
+		return NULL;
+	}
+
+	for ( i = 1; i < header->instructionCount; i++ ) {
+		if ( inst[i].op == OP_CALL && inst[i-1].op == OP_CONST && inst[i-1].value < 0 && ~inst[i-1].value >= *maxSyscall ) {
+			*maxSyscall = ~inst[i-1].value + 1;
+		}
+	}
+
+	count = Z_Malloc( ( *maxSyscall + 1 ) * sizeof( int32_t ) );
+	for ( i = 0; i < *maxSyscall; i++ ) {
+		count[i] = -1;
+	}
+
+	args = 0;
+	for ( i = 0; i < header->instructionCount; i++ ) {
+		switch ( inst[i].op ) {
+			case OP_ENTER:
+				args = 0;
+				break;
+			case OP_ARG:
+				n = ( inst[i].value - 8 ) / 4 + 1;
+				if ( n > args )
+					args = MIN( n, TRACE_SYSCALL_ARGS - 1 );
+				break;
+			case OP_CALL:
+				if ( i > 0 && inst[i-1].op == OP_CONST && inst[i-1].value < 0 ) {
+					n = ~inst[i-1].value;
+					if ( args > count[n] )
+						count[n] = args;
+				}
+				args = 0;
+				break;
+			default:
+				break;
+		}
+	}
+
+	Z_Free( inst );
+
+	return count;
+}
+
+
+/*
+=================
+VM_RecordFlush
+=================
+*/
+static void VM_RecordFlush( void ) {
+	if ( rec.used ) {
+		FS_Write( rec.buffer, rec.used, rec.file );
+		rec.used = 0;
+	}
+}
+
+
+/*
+=================
+VM_RecordData
+=================
+*/
+static void VM_RecordData( const void *data, int length ) {
+	if ( rec.used + length > sizeof( rec.buffer ) ) {
+		VM_RecordFlush();
+		if ( length > sizeof( rec.buffer ) ) {
+			FS_Write( data, length, rec.file );
+			return;
+		}
+	}
+	Com_Memcpy( rec.buffer + rec.used, data, length );
+	rec.used += length;
+}
+
+
+/*
+=================
+VM_RecordInt
+=================
+*/
+static void VM_RecordInt( int32_t value ) {
+	value = LittleLong( value );
+	VM_RecordData( &value, sizeof( value ) );
+}
+
+
+/*
+=================
+VM_RecordWrites
+
+Stores memory changes made outside of vm code and syncs the shadow copy
+=================
+*/
+static void VM_RecordWrites( void ) {
+	const byte *mem = rec.vm->dataBase;
+	const int size = rec.vm->dataMask + 1;
+	int ofs, start;
+
+	start = -1;
+	for ( ofs = 0; ofs < size; ofs += 4 ) {
+		// skip unchanged blocks quickly
+		if ( start < 0 && ( ofs & 255 ) == 0 && ofs + 256 <= size && !memcmp( mem + ofs, rec.shadow + ofs, 256 ) ) {
+			ofs += 256 - 4;
+			continue;
+		}
+		if ( memcmp( mem + ofs, rec.shadow + ofs, 4 ) ) {
+			if ( start < 0 )
+				start = ofs;
+		} else if ( start >= 0 ) {
+			VM_RecordInt( start );
+			VM_RecordInt( ofs - start );
+			VM_RecordData( mem + start, ofs - start );
+			Com_Memcpy( rec.shadow + start, mem + start, ofs - start );
+			start = -1;
+		}
+	}
+
+	if ( start >= 0 ) {
+		VM_RecordInt( start );
+		VM_RecordInt( size - start );
+		VM_RecordData( mem + start, size - start );
+		Com_Memcpy( rec.shadow + start, mem + start, size - start );
+	}
+
+	VM_RecordInt( -1 );
+}
+
+
+/*
+=================
+VM_RecordSyscall
+=================
+*/
+static intptr_t VM_RecordSyscall( intptr_t *args ) {
+	intptr_t r;
+	int i;
+
+	if ( rec.file == FS_INVALID_HANDLE ) {
+		return rec.systemCall( args );
+	}
+
+	VM_RecordInt( TRACE_SYSCALL );
+	for ( i = 0; i < TRACE_SYSCALL_ARGS; i++ ) {
+		VM_RecordInt( (int32_t)args[i] );
+	}
+	Com_Memcpy( rec.shadow, rec.vm->dataBase, rec.vm->dataMask + 1 );
+	rec.numSyscalls++;
+
+	r = rec.systemCall( args );
+
+	// recording may be stopped by a command executed from the system call
+	if ( rec.file != FS_INVALID_HANDLE ) {
+		VM_RecordInt( TRACE_SYSRET );
+		VM_RecordInt( (int32_t)r );
+		VM_RecordWrites();
+	}
+
+	return r;
+}
+
+
+/*
+=================
+VM_RecordStart
+
+Called for a just loaded qvm, before compilation
+=================
+*/
+void VM_RecordStart( vm_t *vm, const vmHeader_t *header ) {
+	traceHeader_t h;
+	int32_t *count;
+	int i, n, maxSyscall;
+
+	if ( rec.armed != vm->index + 1 || rec.vm ) {
+		return;
+	}
+
+	rec.armed = 0;
+
+	rec.file = FS_SV_FOpenFileWrite( rec.fileName );
+	if ( rec.file == FS_INVALID_HANDLE ) {
+		Com_Printf( S_COLOR_YELLOW "Couldn't open %s for writing.\n", rec.fileName );
+		return;
+	}
+
+	count = VM_CountSyscallArgs( header, &maxSyscall );
+	for ( i = 0, n = 0; count && i < maxSyscall; i++ ) {
+		if ( count[i] >= 0 )
+			n++;
+	}
+
+	h.ident = LittleLong( TRACE_IDENT );
+	h.version = LittleLong( TRACE_VERSION );
+	h.index = LittleLong( vm->index );
+	h.crc32sum = LittleLong( vm->crc32sum );
+	h.instructionCount = LittleLong( vm->instructionCount );
+	h.dataSize = LittleLong( vm->dataMask + 1 );
+	h.exactDataLength = LittleLong( vm->exactDataLength );
+	h.numSyscalls = LittleLong( n );
+
+	rec.used = 0;
+	VM_RecordData( &h, sizeof( h ) );
+	for ( i = 0; count && i < maxSyscall; i++ ) {
+		if ( count[i] >= 0 ) {
+			VM_RecordInt( i );
+			VM_RecordInt( count[i] );
+		}
+	}
+
+	if ( count ) {
+		Z_Free( count );
+	}
+
+	rec.vm = vm;
+	rec.systemCall = vm->systemCall;
+	vm->systemCall = VM_RecordSyscall;
+
+	rec.shadow = Z_Malloc( vm->dataMask + 1 );
+	Com_Memcpy( rec.shadow, vm->dataBase, vm->dataMask + 1 );
+
+	rec.numCalls = 0;
+	rec.numSyscalls = 0;
+
+	Com_Printf( "Recording %s calls to %s\n", vm->name, rec.fileName );
+}
+
+
+/*
+=================
+VM_RecordStop
+=================
+*/
+static void VM_RecordStop( void ) {
+	if ( rec.file == FS_INVALID_HANDLE ) {
+		return;
+	}
+
+	VM_RecordFlush();
+	FS_FCloseFile( rec.file );
+	rec.file = FS_INVALID_HANDLE;
+
+	Z_Free( rec.shadow );
+	rec.shadow = NULL;
+
+	Com_Printf( "Recorded %i calls and %i system calls to %s\n", rec.numCalls, rec.numSyscalls, rec.fileName );
+}
+
+
+/*
+=================
+VM_RecordCall
+=================
+*/
+void VM_RecordCall( vm_t *vm, int nargs, const int32_t *args ) {
+	int i;
+
+	if ( vm != rec.vm || rec.file == FS_INVALID_HANDLE ) {
+		return;
+	}
+
+	VM_RecordInt( TRACE_CALL );
+	VM_RecordInt( nargs );
+	for ( i = 0; i < nargs; i++ ) {
+		VM_RecordInt( args[i] );
+	}
+	VM_RecordWrites();
+	rec.numCalls++;
+}
+
+
+/*
+=================
+VM_RecordReturn
+=================
+*/
+void VM_RecordReturn( vm_t *vm, intptr_t result ) {
+	if ( vm != rec.vm || rec.file == FS_INVALID_HANDLE ) {
+		return;
+	}
+
+	VM_RecordInt( TRACE_RETURN );
+	VM_RecordInt( (int32_t)result );
+	VM_RecordInt( crc32_buffer( vm->dataBase, vm->exactDataLength ) );
+	Com_Memcpy( rec.shadow, vm->dataBase, vm->dataMask + 1 );
+}
+
+
+/*
+=================
+VM_RecordFree
+=================
+*/
+void VM_RecordFree( vm_t *vm ) {
+	if ( vm != rec.vm ) {
+		return;
+	}
+
+	VM_RecordStop();
+	rec.vm = NULL;
+	rec.systemCall = NULL;
+}
+
+
+/*
+=================
+VM_Record_f
+=================
+*/
+static void VM_Record_f( void ) {
+	int index;
+
+	if ( Cmd_Argc() == 2 && !Q_stricmp( Cmd_Argv( 1 ), "stop" ) ) {
+		rec.armed = 0;
+		VM_RecordStop();
+		return;
+	}
+
+	if ( Cmd_Argc() != 3 || ( index = VM_NameToIndex( Cmd_Argv( 1 ) ) ) < 0 ) {
+		Com_Printf( "usage: vmrecord <game|cgame|ui> <file>\n       vmrecord stop\n" );
+		if ( rec.file != FS_INVALID_HANDLE ) {
+			Com_Printf( "recording %s, %i calls\n", rec.vm->name, rec.numCalls );
+		}
+		return;
+	}
+
+	if ( rec.file != FS_INVALID_HANDLE ) {
+		Com_Printf( "Already recording %s.\n", rec.vm->name );
+		return;
+	}
+
+	Q_strncpyz( rec.fileName, Cmd_Argv( 2 ), sizeof( rec.fileName ) );
+	rec.armed = index + 1;
+
+	Com_Printf( "Recording will start on next load of the vm.\n" );
+}
+
+
+/*
+=================
+VM_ReplayDiverged
+=================
+*/
+static void FORMAT_PRINTF( 1, 2 ) VM_ReplayDiverged( const char *fmt, ... ) {
+	va_list argptr;
+	int n;
+
+	if ( rep.error[0] ) {
+		return;
+	}
+
+	n = Com_sprintf( rep.error, sizeof( rep.error ), "call %i, system call %i: ", rep.numCalls, rep.numSyscalls );
+
+	va_start( argptr, fmt );
+	Q_vsnprintf( rep.error + n, sizeof( rep.error ) - n, fmt, argptr );
+	va_end( argptr );
+}
+
+
+/*
+=================
+VM_ReplayInt
+=================
+*/
+static int32_t VM_ReplayInt( void ) {
+	int32_t value;
+
+	if ( rep.pos + sizeof( value ) > rep.length ) {
+		VM_ReplayDiverged( "unexpected end of trace" );
+		rep.desync = true;
+		return 0;
+	}
+
+	Com_Memcpy( &value, rep.data + rep.pos, sizeof( value ) );
+	rep.pos += sizeof( value );
+
+	return LittleLong( value );
+}
+
+
+/*
+=================
+VM_ReplayWrites
+=================
+*/
+static void VM_ReplayWrites( void ) {
+	int ofs, len;
+
+	for ( ;; ) {
+		ofs = VM_ReplayInt();
+		if ( ofs == -1 || rep.desync ) {
+			return;
+		}
+		len = VM_ReplayInt();
+		if ( ofs < 0 || len < 0 || len > rep.vm->dataMask + 1 - ofs || len > rep.length - rep.pos ) {
+			VM_ReplayDiverged( "bad memory write %i:%i in trace", ofs, len );
+			rep.desync = true;
+			return;
+		}
+		Com_Memcpy( rep.vm->dataBase + ofs, rep.data + rep.pos, len );
+		rep.pos += len;
+	}
+}
+
+
+static void VM_ReplayCall( void );
+
+/*
+=================
+VM_ReplaySyscall
+=================
+*/
+static intptr_t VM_ReplaySyscall( intptr_t *args ) {
+	int32_t recorded[ TRACE_SYSCALL_ARGS ];
+	int32_t event, r;
+	int i, n;
+
+	if ( rep.desync ) {
+		return 0;
+	}
+
+	if ( VM_ReplayInt() != TRACE_SYSCALL ) {
+		VM_ReplayDiverged( "unexpected system call %i", (int)args[0] );
+		rep.desync = true;
+		return 0;
+	}
+
+	for ( i = 0; i < TRACE_SYSCALL_ARGS; i++ ) {
+		recorded[i] = VM_ReplayInt();
+	}
+
+	if ( (int32_t)args[0] != recorded[0] ) {
+		VM_ReplayDiverged( "system call %i, recorded %i", (int)args[0], recorded[0] );
+		rep.desync = true;
+		return 0;
+	}
+
+	// unused argument slots may hold anything
+	n = -1;
+	if ( recorded[0] >= 0 && recorded[0] < rep.maxSyscall ) {
+		n = rep.argCount[ recorded[0] ];
+	}
+	if ( n < 0 ) {
+		n = 0;
+	}
+
+	for ( i = 1; i <= n; i++ ) {
+		if ( (int32_t)args[i] != recorded[i] ) {
+			VM_ReplayDiverged( "argument %i of system call %i is %i, recorded %i", i, recorded[0], (int)args[i], recorded[i] );
+			break;
+		}
+	}
+
+	rep.numSyscalls++;
+
+	for ( ;; ) {
+		event = VM_ReplayInt();
+		if ( rep.desync ) {
+			return 0;
+		}
+		if ( event == TRACE_CALL ) {
+			// engine called the vm back
+			VM_ReplayCall();
+			continue;
+		}
+		if ( event == TRACE_SYSRET ) {
+			r = VM_ReplayInt();
+			VM_ReplayWrites();
+			return r;
+		}
+		VM_ReplayDiverged( "unexpected trace event %i", event );
+		rep.desync = true;
+		return 0;
+	}
+}
+
+
+/*
+=================
+VM_ReplayCall
+
+Replays TRACE_CALL event and everything nested in it
+=================
+*/
+static void VM_ReplayCall( void ) {
+	int32_t args[ MAX_VMMAIN_CALL_ARGS ];
+	int32_t result, checksum;
+	intptr_t r;
+	int i, nargs;
+
+	Com_Memset( args, 0, sizeof( args ) );
+
+	nargs = VM_ReplayInt();
+	if ( nargs < 1 || nargs > MAX_VMMAIN_CALL_ARGS ) {
+		VM_ReplayDiverged( "bad vmMain argument count %i", nargs );
+		rep.desync = true;
+		return;
+	}
+	for ( i = 0; i < nargs; i++ ) {
+		args[i] = VM_ReplayInt();
+	}
+
+	VM_ReplayWrites();
+	if ( rep.desync ) {
+		return;
+	}
+
+	r = VM_Call( rep.vm, nargs - 1, args[0], args[1], args[2], args[3] );
+	if ( rep.desync ) {
+		return;
+	}
+
+	if ( VM_ReplayInt() != TRACE_RETURN ) {
+		VM_ReplayDiverged( "vmMain(%i) returned before recorded system calls", args[0] );
+		rep.desync = true;
+		return;
+	}
+
+	result = VM_ReplayInt();
+	checksum = VM_ReplayInt();
+
+	if ( (int32_t)r != result ) {
+		VM_ReplayDiverged( "vmMain(%i) returned %i, recorded %i", args[0], (int)r, result );
+	} else if ( (int32_t)crc32_buffer( rep.vm->dataBase, rep.vm->exactDataLength ) != checksum ) {
+		VM_ReplayDiverged( "data segment differs after vmMain(%i)", args[0] );
+	}
+
+	rep.numCalls++;
+}
+
+
+/*
+=================
+VM_ReplayRun
+=================
+*/
+static void VM_ReplayRun( const char *modeName, vmInterpret_t interpret ) {
+	const traceHeader_t *h = rep.header;
+	int64_t start;
+	int pos;
+
+	if ( rep.vm ) {
+		// left by an error during previous replay
+		VM_Forced_Unload_Start();
+		VM_Free( rep.vm );
+		VM_Forced_Unload_Done();
+		rep.vm = NULL;
+	}
+
+	rep.vm = VM_Create( LittleLong( h->index ), VM_ReplaySyscall, NULL, interpret );
+	if ( !rep.vm ) {
+		Com_Printf( "%-12s failed to load vm\n", modeName );
+		return;
+	}
+
+	if ( rep.vm->systemCall != VM_ReplaySyscall ) {
+		Com_Printf( "%s is running, unload it first.\n", rep.vm->name );
+		rep.vm = NULL;
+		return;
+	}
+
+	if ( rep.vm->crc32sum != LittleLong( h->crc32sum ) || rep.vm->dataMask + 1 != LittleLong( h->dataSize ) ) {
+		Com_Printf( "%-12s vm doesn't match the recorded one\n", modeName );
+	} else if ( interpret == VMI_COMPILED && !rep.vm->compiled ) {
+		Com_Printf( "%-12s vm compiler is not available\n", modeName );
+	} else {
+		pos = rep.pos;
+		rep.numCalls = 0;
+		rep.numSyscalls = 0;
+		rep.desync = false;
+		rep.error[0] = '\0';
+
+		start = Sys_Microseconds();
+		while ( !rep.desync && rep.pos < rep.length ) {
+			if ( VM_ReplayInt() != TRACE_CALL ) {
+				VM_ReplayDiverged( "unexpected trace event" );
+				break;
+			}
+			VM_ReplayCall();
+		}
+
+		Com_Printf( "%-12s %7i calls %9i system calls %9i usec  %s\n", modeName, rep.numCalls, rep.numSyscalls,
+			(int)( Sys_Microseconds() - start ), rep.error[0] ? rep.error : "OK" );
+
+		rep.pos = pos;
+	}
+
+	VM_Free( rep.vm );
+	rep.vm = NULL;
+}
+
+
+/*
+=================
+VM_Replay_f
+=================
+*/
+static void VM_Replay_f( void ) {
+	static const struct {
+		const char		*name;
+		vmInterpret_t	interpret;
+		const char		*tier;
+	} modes[] = {
+		{ "interpreter", VMI_BYTECODE, NULL },
+		{ "jit tier 0", VMI_COMPILED, "0" },
+		{ "jit tier 1", VMI_COMPILED, "1" }
+	};
+	char savedTier[ MAX_CVAR_VALUE_STRING ];
+	fileHandle_t f;
+	int i, n, num, len;
+
+	if ( Cmd_Argc() != 2 ) {
+		Com_Printf( "usage: vmreplay <file>\n" );
+		return;
+	}
+
+	if ( rec.file != FS_INVALID_HANDLE || rec.armed ) {
+		Com_Printf( "Stop recording first.\n" );
+		return;
+	}
+
+	len = FS_SV_FOpenFileRead( Cmd_Argv( 1 ), &f );
+	if ( f == FS_INVALID_HANDLE ) {
+		Com_Printf( "Couldn't open %s\n", Cmd_Argv( 1 ) );
+		return;
+	}
+
+	rep.data = Z_Malloc( len + 1 );
+	rep.length = FS_Read( rep.data, len, f );
+	FS_FCloseFile( f );
+
+	rep.header = (const traceHeader_t *)rep.data;
+	rep.pos = sizeof( traceHeader_t );
+	rep.desync = false;
+	rep.error[0] = '\0';
+
+	if ( rep.length < sizeof( traceHeader_t ) || LittleLong( rep.header->ident ) != TRACE_IDENT
+		|| LittleLong( rep.header->version ) != TRACE_VERSION || (unsigned)LittleLong( rep.header->index ) >= VM_COUNT ) {
+		Com_Printf( "%s is not a vm trace\n", Cmd_Argv( 1 ) );
+		Z_Free( rep.data );
+		rep.data = NULL;
+		return;
+	}
+
+	// passed argument counts
+	n = LittleLong( rep.header->numSyscalls );
+	rep.maxSyscall = 0;
+	for ( i = 0; i < n && !rep.desync; i++ ) {
+		num = VM_ReplayInt();
+		VM_ReplayInt();
+		if ( num >= rep.maxSyscall )
+			rep.maxSyscall = num + 1;
+	}
+	if ( rep.desync || n < 0 || rep.maxSyscall > 0x10000 ) {
+		Com_Printf( "%s is damaged\n", Cmd_Argv( 1 ) );
+		Z_Free( rep.data );
+		rep.data = NULL;
+		return;
+	}
+	rep.argCount = Z_Malloc( ( rep.maxSyscall + 1 ) * sizeof( int32_t ) );
+	for ( i = 0; i < rep.maxSyscall; i++ ) {
+		rep.argCount[i] = -1;
+	}
+	rep.pos = sizeof( traceHeader_t );
+	for ( i = 0; i < n; i++ ) {
+		num = VM_ReplayInt();
+		rep.argCount[ num ] = VM_ReplayInt();
+	}
+
+	Q_strncpyz( savedTier, vm_jitTier->string, sizeof( savedTier ) );
+
+	for ( i = 0; i < ARRAY_LEN( modes ); i++ ) {
+		if ( modes[i].tier ) {
+			Cvar_Set( "vm_jitTier", modes[i].tier );
+		}
+		VM_ReplayRun( modes[i].name, modes[i].interpret );
+	}
+
+	Cvar_Set( "vm_jitTier", savedTier );
+
+	Z_Free( rep.argCount );
+	rep.argCount = NULL;
+	Z_Free( rep.data );
+	rep.data = NULL;
+}
+
+
+/*
+=================
+VM_InitTrace
+=================
+*/
+void VM_InitTrace( void ) {
+	Cmd_AddCommand( "vmrecord", VM_Record_f );
+	Cmd_AddCommand( "vmreplay", VM_Replay_f );
+}
@@ -209,6 +209,38 @@ static	int jumpSizeChanged;
 
 static	int	funcOffset[ FUNC_LAST ];
 
+// compiler tier selected by vm_jitTier for current compilation
+static	int	jitTier;
+
+// identifies code generator in the native code cache key
+#define VM_BUILD_ID "x86 jit " __DATE__ " " __TIME__
+
+// absolute addresses embedded in generated code, patched when code is loaded from cache
+typedef enum
+{
+	SYM_DATABASE,		// vm->dataBase
+	SYM_INSPOINTERS,	// instructionPointers
+	SYM_SYSCALL,		// vm->systemCall
+	SYM_PSTACK_PTR,		// &vm->programStack
+	SYM_OPSTACK_PTR,	// &vm->opStack
+	SYM_OPSTACKTOP_PTR,	// &vm->opStackTop
+	SYM_SYSCALL_PTR,	// &vm->systemCall
+	SYM_BADSTACK,
+	SYM_BADOPSTACK,
+	SYM_BADJUMP,
+	SYM_ERRJUMP,
+	SYM_BADDATAREAD,
+	SYM_BADDATAWRITE,
+	SYM_FPCW,
+	SYM_LAST
+} sym_t;
+
+static	intptr_t symValue[ SYM_LAST ];
+
+static	vmReloc_t *relocs;
+static	int numRelocs;
+static	int maxRelocs;
+
 
 static void *VM_Alloc_Compiled( vm_t *vm, int codeLength, int tableLength );
 static void VM_Destroy_Compiled( vm_t *vm );
@@ -275,6 +307,16 @@ typedef enum {
 	R_XMM3 = 0x03,
 	R_XMM4 = 0x04,
 	R_XMM5 = 0x05
+#if idx64
+	,R_XMM8 = 0x08,
+	R_XMM9 = 0x09,
+	R_XMM10 = 0x0A,
+	R_XMM11 = 0x0B,
+	R_XMM12 = 0x0C,
+	R_XMM13 = 0x0D,
+	R_XMM14 = 0x0E,
+	R_XMM15 = 0x0F
+#endif
 } xmmreg_t;
 
 typedef union {
@@ -694,40 +736,25 @@ static void mov_rx_imm32( uint32_t reg, int32_t imm32 )
 	}
 }
 
-#if idx64
-// wrapper function
-static void mov_rx_imm64( uint32_t reg, int64_t imm64 )
+// records symbol address that has been just emitted as the last field of instruction
+static void EmitReloc( sym_t sym )
 {
-	if ( imm64 == 0 ) {
-		emit_xor_rx( reg & ~R_REX, reg & ~R_REX );
-	} else {
-		if ( (uint64_t) imm64 > 0xFFFFFFFFULL ) {
-			// move to 64-bit register
-			if ( imm64 < 0 && imm64 >= -0x80000000LL ) {
-				// sign-extend to 64 bit
-				emit_rex1( reg | R_REX );
-				Emit1( 0xC7 );
-				Emit1( 0xC0 + ( reg & 7 ) ); // modrm: 11.000.reg
-				Emit4( (int32_t)imm64 );
-			} else {
-				// worst case
-				emit_mov_rx_imm64( reg, imm64 );
-			}
-		} else {
-			// move to 32-bit register with implicit zero-extension to 64-bits
-			emit_mov_rx_imm32( reg, (int32_t)imm64 );
-		}
+	if ( numRelocs < maxRelocs ) {
+		relocs[ numRelocs ].offset = compiledOfs - sizeof( intptr_t );
+		relocs[ numRelocs ].symbol = sym;
 	}
+	numRelocs++;
 }
-#endif
 
-static void mov_rx_ptr( uint32_t reg, const void *ptr )
+// constant size so the address can be patched later
+static void mov_rx_sym( uint32_t reg, sym_t sym )
 {
 #if idx64
-	mov_rx_imm64( reg, (intptr_t) ptr );
+	emit_mov_rx_imm64( reg, symValue[ sym ] );
 #else
-	mov_rx_imm32( reg, (intptr_t) ptr );
+	emit_mov_rx_imm32( reg, symValue[ sym ] );
 #endif
+	EmitReloc( sym );
 }
 
 static void emit_not_rx( uint32_t reg )
@@ -1177,6 +1204,18 @@ static void emit_store_sx( uint32_t reg, uint32_t base, int32_t offset )
 	emit_op_reg_base_offset( 0x0F, 0x11, reg, base, offset );
 }
 
+#if idx64 && defined( _WIN32 )
+static void emit_load_ps( uint32_t reg, uint32_t base, int32_t offset )
+{
+	emit_op_reg_base_offset( 0x0F, 0x10, reg, base, offset );
+}
+
+static void emit_store_ps( uint32_t reg, uint32_t base, int32_t offset )
+{
+	emit_op_reg_base_offset( 0x0F, 0x11, reg, base, offset );
+}
+#endif
+
 static void emit_store_sx_index( uint32_t reg, uint32_t base, uint32_t index )
 {
 	Emit1( 0xF3 );
@@ -1351,6 +1390,18 @@ static const uint32_t sx_list_alloc[] = {
 	R_XMM3, R_XMM4, R_XMM5
 };
 
+#if idx64
+// home registers of locals assigned by the optimizing tier, see instruction_t.reg
+static const uint32_t rx_list_home[] = {
+	R_R10, R_R9, R_R8
+};
+
+static const uint32_t sx_list_home[] = {
+	R_XMM8, R_XMM9, R_XMM10, R_XMM11,
+	R_XMM12, R_XMM13, R_XMM14, R_XMM15
+};
+#endif
+
 #ifdef CONST_CACHE_RX
 static const uint32_t rx_list_cache[] = {
 	R_EDX, R_ECX, R_EAX
@@ -1428,12 +1479,18 @@ static reg_t sx_regs[NUM_SX_REGS];
 static int32_t rx_mask[NUM_RX_REGS];
 static int32_t sx_mask[NUM_SX_REGS];
 
+// general-purpose registers taken out of dynamic allocation by home registers of current procedure
+static uint32_t rx_reserved;
+
 
 static bool find_free_rx( void ) {
 	uint32_t i, n;
 #if 1
 	for ( i = 0; i < ARRAY_LEN( rx_list_alloc ); i++ ) {
 		n = rx_list_alloc[i];
+		if ( rx_reserved & ( 1 << n ) ) {
+			continue;
+		}
 		if ( rx_regs[n].type_mask == RTYPE_UNUSED ) {
 			return true;
 		}
@@ -1779,6 +1836,8 @@ static void init_opstack( void )
 
 	Com_Memset( &rx_regs[0], 0, sizeof( rx_regs ) );
 	Com_Memset( &sx_regs[0], 0, sizeof( sx_regs ) );
+
+	rx_reserved = 0;
 }
 
 
@@ -2166,7 +2225,7 @@ static uint32_t alloc_sx_const( uint32_t pref, uint32_t imm )
 static uint32_t dyn_alloc_rx( uint32_t pref )
 {
 	const uint32_t _rx_mask = build_rx_mask();
-	const uint32_t mask = _rx_mask | build_opstack_mask( TYPE_RX );
+	const uint32_t mask = _rx_mask | build_opstack_mask( TYPE_RX ) | rx_reserved;
 	const reg_t *reg, *used = NULL;
 	uint32_t i, n;
 
@@ -2773,10 +2832,35 @@ static void( *const badOpStackPtr )( void ) = BadOpStack;
 static void( *const badDataReadPtr )( void ) = BadDataRead;
 static void( *const badDataWritePtr )( void ) = BadDataWrite;
 
+static int32_t fp_cw[2] = { 0x0000, 0x0F7F }; // [0] - current value, [1] - round towards zero
+
+
+static void VM_InitSymbols( vm_t *vm )
+{
+	symValue[ SYM_DATABASE ] = (intptr_t) vm->dataBase;
+	symValue[ SYM_INSPOINTERS ] = (intptr_t) instructionPointers;
+	symValue[ SYM_SYSCALL ] = (intptr_t) vm->systemCall;
+	symValue[ SYM_PSTACK_PTR ] = (intptr_t) &vm->programStack;
+	symValue[ SYM_OPSTACK_PTR ] = (intptr_t) &vm->opStack;
+	symValue[ SYM_OPSTACKTOP_PTR ] = (intptr_t) &vm->opStackTop;
+	symValue[ SYM_SYSCALL_PTR ] = (intptr_t) &vm->systemCall;
+	symValue[ SYM_BADSTACK ] = (intptr_t) &badStackPtr;
+	symValue[ SYM_BADOPSTACK ] = (intptr_t) &badOpStackPtr;
+	symValue[ SYM_BADJUMP ] = (intptr_t) &badJumpPtr;
+	symValue[ SYM_ERRJUMP ] = (intptr_t) &errJumpPtr;
+	symValue[ SYM_BADDATAREAD ] = (intptr_t) &badDataReadPtr;
+	symValue[ SYM_BADDATAWRITE ] = (intptr_t) &badDataWritePtr;
+	symValue[ SYM_FPCW ] = (intptr_t) &fp_cw;
+}
+
 
 static void VM_FreeBuffers( void )
 {
 	// should be freed in reversed allocation order
+	if ( relocs ) {
+		Z_Free( relocs );
+		relocs = NULL;
+	}
 	Z_Free( instructionOffsets );
 	Z_Free( inst );
 }
@@ -3137,7 +3221,8 @@ static void emit_CheckProc( vm_t *vm, instruction_t *ins )
 #if idx64
 		emit_cmp_rx( rx | R_REX, R_OPSTACKTOP );			// cmp rdx, opStackTop
 #else
-		emit_cmp_rx_mem( rx, (intptr_t) &vm->opStackTop );	// cmp edx, [&vm->opStackTop]
+		emit_cmp_rx_mem( rx, symValue[ SYM_OPSTACKTOP_PTR ] );	// cmp edx, [&vm->opStackTop]
+		EmitReloc( SYM_OPSTACKTOP_PTR );
 #endif
 
 		EmitString( "0F 87" );			// ja +funcOffset[FUNC_OSOF]
@@ -3179,7 +3264,8 @@ static void EmitCallFunc( vm_t *vm )
 #if idx64
 	emit_call_index( R_INSPOINTERS, R_EAX ); // call qword ptr [instructionPointers+rax*8]
 #else
-	emit_call_index_offset( (intptr_t)instructionPointers, R_EAX ); // call dword ptr [vm->instructionPointers + eax*8]
+	emit_call_index_offset( symValue[ SYM_INSPOINTERS ], R_EAX ); // call dword ptr [vm->instructionPointers + eax*8]
+	EmitReloc( SYM_INSPOINTERS );
 #endif
 
 	emit_ret();	// ret
@@ -3212,7 +3298,7 @@ static void EmitCallFunc( vm_t *vm )
 	emit_store_rx( R_EAX | R_REX, R_ECX, 0 );	// mov [rcx], rax
 
 	// vm->programStack = programStack - 4; // or 8
-	mov_rx_ptr( R_EDX, &vm->programStack ); // mov rdx, &vm->programStack
+	mov_rx_sym( R_EDX, SYM_PSTACK_PTR ); // mov rdx, &vm->programStack
 
 	emit_lea( R_EAX, R_PSTACK, -8 );		// lea eax, [programStack-8]
 	emit_store_rx( R_EAX, R_EDX, 0 );		// mov [rdx], eax
@@ -3276,7 +3362,8 @@ static void EmitCallFunc( vm_t *vm )
 
 	// currentVM->programStack = programStack - 4;
 	emit_lea( R_EDX, R_PSTACK, -8 );		// lea edx, [esi-8]
-	emit_store_rx_offset( R_EDX, (intptr_t) &vm->programStack ); // mov[ &vm->programStack ], edx
+	emit_store_rx_offset( R_EDX, symValue[ SYM_PSTACK_PTR ] ); // mov[ &vm->programStack ], edx
+	EmitReloc( SYM_PSTACK_PTR );
 
 	// params[0] = syscallNum
 	emit_store_rx( R_EAX, R_ECX, 0 );		// mov [ecx], eax
@@ -3285,7 +3372,8 @@ static void EmitCallFunc( vm_t *vm )
 	emit_store_rx( R_ECX, R_ESP, 0 );		// mov [esp], ecx
 
 	// currentVm->systemCall( param );
-	emit_call_indir( (intptr_t) &vm->systemCall ); // call dword ptr [&currentVM->systemCall]
+	emit_call_indir( symValue[ SYM_SYSCALL_PTR ] ); // call dword ptr [&currentVM->systemCall]
+	EmitReloc( SYM_SYSCALL_PTR );
 
 	// store result in opStack[4]
 	emit_store_rx( R_EAX, R_OPSTACK, 4 );	// *opstack[ 4 ] = eax
@@ -3371,7 +3459,7 @@ static void EmitFloatJump( instruction_t *i, int op, int addr )
 
 static void EmitPSOFFunc( vm_t *vm )
 {
-	mov_rx_ptr( R_EAX, &badStackPtr ); // mov eax, &badStackPtr
+	mov_rx_sym( R_EAX, SYM_BADSTACK ); // mov eax, &badStackPtr
 	EmitString( "FF 10" );		// call [eax]
 	emit_ret();					// ret
 }
@@ -3379,7 +3467,7 @@ static void EmitPSOFFunc( vm_t *vm )
 
 static void EmitOSOFFunc( vm_t *vm )
 {
-	mov_rx_ptr( R_EAX, &badOpStackPtr ); // mov eax, &badOpStackPtr
+	mov_rx_sym( R_EAX, SYM_BADOPSTACK ); // mov eax, &badOpStackPtr
 	EmitString( "FF 10" );		// call [eax]
 	emit_ret();					// ret
 }
@@ -3387,7 +3475,7 @@ static void EmitOSOFFunc( vm_t *vm )
 
 static void EmitBADJFunc( vm_t *vm )
 {
-	mov_rx_ptr( R_EAX, &badJumpPtr ); // mov eax, &badJumpPtr
+	mov_rx_sym( R_EAX, SYM_BADJUMP ); // mov eax, &badJumpPtr
 	EmitString( "FF 10" );		// call [eax]
 	emit_ret();					// ret
 }
@@ -3395,7 +3483,7 @@ static void EmitBADJFunc( vm_t *vm )
 
 static void EmitERRJFunc( vm_t *vm )
 {
-	mov_rx_ptr( R_EAX, &errJumpPtr ); // mov eax, &errJumpPtr
+	mov_rx_sym( R_EAX, SYM_ERRJUMP ); // mov eax, &errJumpPtr
 	EmitString( "FF 10" );		// call [eax]
 	emit_ret();					// ret
 }
@@ -3403,7 +3491,7 @@ static void EmitERRJFunc( vm_t *vm )
 
 static void EmitDATRFunc( vm_t *vm )
 {
-	mov_rx_ptr( R_EAX, &badDataReadPtr ); // mov eax, &badDataReadPtr
+	mov_rx_sym( R_EAX, SYM_BADDATAREAD ); // mov eax, &badDataReadPtr
 	EmitString( "FF 10" );		// call [eax]
 	emit_ret();					// ret
 }
@@ -3411,7 +3499,7 @@ static void EmitDATRFunc( vm_t *vm )
 
 static void EmitDATWFunc( vm_t *vm )
 {
-	mov_rx_ptr( R_EAX, &badDataWritePtr ); // mov eax, &badDataWritePtr
+	mov_rx_sym( R_EAX, SYM_BADDATAWRITE ); // mov eax, &badDataWritePtr
 	EmitString( "FF 10" );		// call [eax]
 	emit_ret();					// ret
 }
@@ -3477,8 +3565,9 @@ static bool ConstOptimize( vm_t *vm, instruction_t *ci, instruction_t *ni )
 	switch ( ni->op ) {
 
 		case OP_STORE4:	{
-			if ( ci->value == 0 ) {
+			if ( ci->value == 0 || ni->reg ) {
 				// "xor eax, eax" + non-const path is shorter
+				// or local is kept in home register
 				return false;
 			}
 			if ( addr_on_top( &var ) ) {
@@ -3878,6 +3967,141 @@ static void dump_code( const char *vmname, uint8_t *c, int32_t code_len )
 #endif
 
 
+/*
+=================
+VM_ProtectCompiled
+=================
+*/
+static bool VM_ProtectCompiled( vm_t *vm )
+{
+#ifdef VM_X86_MMAP
+	if ( mprotect( vm->codeBase.ptr, vm->codeSize, PROT_READ|PROT_EXEC ) ) {
+		VM_Destroy_Compiled( vm );
+		Com_Printf( S_COLOR_YELLOW "VM_CompileX86: mprotect failed\n" );
+		return false;
+	}
+#elif _WIN32
+	{
+		DWORD oldProtect = 0;
+
+		// remove write permissions.
+		if ( !VirtualProtect( vm->codeBase.ptr, vm->codeSize, PAGE_EXECUTE_READ, &oldProtect ) ) {
+			VM_Destroy_Compiled( vm );
+			Com_Printf( S_COLOR_YELLOW "%s(%s): VirtualProtect failed\n", __func__, vm->name );
+			return false;
+		}
+	}
+#endif
+	return true;
+}
+
+
+/*
+=================
+VM_BuildId
+
+Code cache key of the code generator, generated code also depends on the tier
+=================
+*/
+static const char *VM_BuildId( void )
+{
+	static char buf[ 64 ];
+
+	Com_sprintf( buf, sizeof( buf ), "%s tier %i", VM_BUILD_ID, jitTier );
+
+	return buf;
+}
+
+
+/*
+=================
+VM_LoadCompiled
+
+Restores previously compiled code from the native code cache
+=================
+*/
+static bool VM_LoadCompiled( vm_t *vm )
+{
+	vmCodeCache_t cache;
+	const vmReloc_t *r;
+	int i;
+
+	cache.build = VM_BuildId();
+	if ( !VM_LoadCodeCache( vm, &cache ) ) {
+		return false;
+	}
+
+	for ( i = 0; i < cache.numRelocs; i++ ) {
+		if ( (unsigned)cache.relocs[ i ].symbol >= SYM_LAST ) {
+			VM_FreeCodeCache( &cache );
+			return false;
+		}
+	}
+
+	code = (byte*)VM_Alloc_Compiled( vm, cache.codeLength, vm->instructionCount * sizeof( intptr_t ) );
+	if ( code == NULL ) {
+		VM_FreeCodeCache( &cache );
+		return false;
+	}
+	instructionPointers = (intptr_t*)(byte*)(code + cache.codeLength);
+	vm->procsLength = cache.procsLength;
+
+	Com_Memcpy( code, cache.code, cache.codeLength );
+
+	VM_InitSymbols( vm );
+	for ( i = 0, r = cache.relocs; i < cache.numRelocs; i++, r++ ) {
+		Com_Memcpy( code + r->offset, &symValue[ r->symbol ], sizeof( intptr_t ) );
+	}
+
+	for ( i = 0; i < vm->instructionCount; i++ ) {
+		if ( cache.instructionOffsets[ i ] < 0 ) {
+			instructionPointers[ i ] = (intptr_t)badJumpPtr;
+		} else {
+			instructionPointers[ i ] = (intptr_t)vm->codeBase.ptr + cache.instructionOffsets[ i ];
+		}
+	}
+
+	VM_FreeCodeCache( &cache );
+
+	if ( !VM_ProtectCompiled( vm ) ) {
+		return false;
+	}
+
+	vm->destroy = VM_Destroy_Compiled;
+
+	Com_Printf( "VM file %s loaded %i bytes of cached code\n", vm->name, vm->codeLength );
+
+	return true;
+}
+
+
+/*
+=================
+VM_SaveCompiled
+=================
+*/
+static void VM_SaveCompiled( vm_t *vm )
+{
+	vmCodeCache_t cache;
+
+	// should never happen as relocations are identical in all passes
+	if ( numRelocs != maxRelocs ) {
+		Com_DPrintf( S_COLOR_YELLOW "%s(%s): relocation mismatch\n", __func__, vm->name );
+		return;
+	}
+
+	cache.build = VM_BuildId();
+	cache.code = code;
+	cache.codeLength = vm->codeLength;
+	cache.procsLength = vm->procsLength;
+	cache.instructionOffsets = instructionOffsets;
+	cache.relocs = relocs;
+	cache.numRelocs = numRelocs;
+
+	VM_SaveCodeCache( vm, &cache );
+}
+
+
 /*
 =================
 VM_Compile
@@ -3903,6 +4127,12 @@ bool VM_Compile( vm_t *vm, vmHeader_t *header ) {
 	int num_compress;
 #endif
 
+	jitTier = vm_jitTier->integer;
+
+	if ( VM_LoadCompiled( vm ) ) {
+		return true;
+	}
+
 	inst = (instruction_t*)Z_Malloc( (header->instructionCount + 8 ) * sizeof( instruction_t ) );
 	instructionOffsets = (int*)Z_Malloc( header->instructionCount * sizeof( int ) );
 
@@ -3918,6 +4148,14 @@ bool VM_Compile( vm_t *vm, vmHeader_t *header ) {
 
 	VM_ReplaceInstructions( vm, inst );
 
+	if ( jitTier > 0 ) {
+#if idx64
+		VM_OptimizeInstructions( inst, vm->instructionCount, ARRAY_LEN( rx_list_home ), HasSSEFP() ? ARRAY_LEN( sx_list_home ) : 0 );
+#else
+		VM_OptimizeInstructions( inst, vm->instructionCount, 0, 0 );
+#endif
+	}
+
 	VM_FindMOps( inst, vm->instructionCount );
 
 #if JUMP_OPTIMIZE
@@ -3941,6 +4179,9 @@ bool VM_Compile( vm_t *vm, vmHeader_t *header ) {
 
 	memset( funcOffset, 0, sizeof( funcOffset ) );
 
+	VM_InitSymbols( vm );
+	maxRelocs = 0;
+
 	instructionCount = header->instructionCount;
 
 	for( pass = 0; pass < NUM_PASSES; pass++ )
@@ -3950,6 +4191,7 @@ __compile:
 	// translate all instructions
 	ip = 0;
 	compiledOfs = 0;
+	numRelocs = 0;
 #if JUMP_OPTIMIZE
 	jumpSizeChanged = 0;
 #endif
@@ -3977,21 +4219,30 @@ __compile:
 	emit_push( R_R14 );				// push r14
 	emit_push( R_R15 );				// push r15
 
-	mov_rx_ptr( R_DATABASE, vm->dataBase );			// mov rbx, vm->dataBase
+#ifdef _WIN32
+	if ( jitTier > 0 ) {
+		// home registers of the optimizing tier are non-volatile in Win64 ABI
+		emit_op_rx_imm32( X_SUB, R_ESP | R_REX, ARRAY_LEN( sx_list_home ) * 16 ); // sub rsp, 128
+		for ( i = 0; i < ARRAY_LEN( sx_list_home ); i++ ) {
+			emit_store_ps( sx_list_home[ i ], R_ESP, i * 16 );	// movups [rsp + i*16], xmm8
+		}
+	}
+#endif
+
+	mov_rx_sym( R_DATABASE, SYM_DATABASE );			// mov rbx, vm->dataBase
 
-	// do not use wrapper, force constant size there
-	emit_mov_rx_imm64( R_INSPOINTERS, (intptr_t) instructionPointers ); // mov r8, vm->instructionPointers
+	mov_rx_sym( R_INSPOINTERS, SYM_INSPOINTERS );	// mov r12, vm->instructionPointers
 
 	mov_rx_imm32( R_DATAMASK, vm->dataMask );		// mov r11d, vm->dataMask
 	mov_rx_imm32( R_STACKBOTTOM, vm->stackBottom );	// mov r14d, vm->stackBottom
 
-	mov_rx_ptr( R_EAX, &vm->opStack );				// mov rax, &vm->opStack
+	mov_rx_sym( R_EAX, SYM_OPSTACK_PTR );			// mov rax, &vm->opStack
 
 	emit_load4( R_OPSTACK | R_REX, R_EAX, 0 );		// mov rdi, [rax]
 
-	mov_rx_ptr( R_SYSCALL, vm->systemCall );		// mov r13, vm->systemCall
+	mov_rx_sym( R_SYSCALL, SYM_SYSCALL );			// mov r13, vm->systemCall
 
-	mov_rx_ptr( R_EAX, &vm->programStack );			// mov rax, &vm->programStack
+	mov_rx_sym( R_EAX, SYM_PSTACK_PTR );			// mov rax, &vm->programStack
 
 	emit_load4( R_PSTACK, R_EAX, 0 ); // mov esi, dword ptr [rax]
 
@@ -4000,10 +4251,19 @@ __compile:
 	EmitCallOffset( FUNC_ENTR );
 
 #ifdef DEBUG_VM
-	mov_rx_ptr( R_EAX, &vm->programStack );		// mov rax, &vm->programStack
+	mov_rx_sym( R_EAX, SYM_PSTACK_PTR );		// mov rax, &vm->programStack
 	emit_store_rx( R_PSTACK, R_EAX, 0 );		// mov [rax], esi
 #endif
 
+#ifdef _WIN32
+	if ( jitTier > 0 ) {
+		for ( i = 0; i < ARRAY_LEN( sx_list_home ); i++ ) {
+			emit_load_ps( sx_list_home[ i ], R_ESP, i * 16 );	// movups xmm8, [rsp + i*16]
+		}
+		emit_op_rx_imm32( X_ADD, R_ESP | R_REX, ARRAY_LEN( sx_list_home ) * 16 ); // add rsp, 128
+	}
+#endif
+
 	emit_pop( R_R15 );				// pop r15
 	emit_pop( R_R14 );				// pop r14
 	emit_pop( R_R13 );				// pop r13
@@ -4018,16 +4278,19 @@ __compile:
 
 	emit_pushad();					// pushad
 
-	mov_rx_ptr( R_DATABASE, vm->dataBase );	// mov ebx, vm->dataBase
+	mov_rx_sym( R_DATABASE, SYM_DATABASE );	// mov ebx, vm->dataBase
 
-	emit_load_rx_offset( R_PSTACK, (intptr_t) &vm->programStack ); // mov esi, [&vm->programStack]
+	emit_load_rx_offset( R_PSTACK, symValue[ SYM_PSTACK_PTR ] ); // mov esi, [&vm->programStack]
+	EmitReloc( SYM_PSTACK_PTR );
 
-	emit_load_rx_offset( R_OPSTACK, (intptr_t) &vm->opStack ); // mov edi, [&vm->opStack]
+	emit_load_rx_offset( R_OPSTACK, symValue[ SYM_OPSTACK_PTR ] ); // mov edi, [&vm->opStack]
+	EmitReloc( SYM_OPSTACK_PTR );
 
 	EmitCallOffset( FUNC_ENTR );
 
 #ifdef DEBUG_VM
-	emit_store_rx_offset( R_PSTACK, (intptr_t) &vm->programStack ); // mov [&vm->programStack], esi 
+	emit_store_rx_offset( R_PSTACK, symValue[ SYM_PSTACK_PTR ] ); // mov [&vm->programStack], esi
+	EmitReloc( SYM_PSTACK_PTR );
 #endif
 
 	// emit_store_rx_offset( R_OPSTACK, (intptr_t) &vm->opStack ); // // [&vm->opStack], edi
@@ -4094,6 +4357,22 @@ __compile:
 					break;
 				}
 
+#if idx64
+				// keep integer home registers out of dynamic allocation
+				rx_reserved = 0;
+				for ( i = ip; i < header->instructionCount; i++ ) {
+					if ( inst[ i ].reg && !inst[ i ].sse ) {
+						rx_reserved |= 1 << rx_list_home[ inst[ i ].reg - 1 ];
+					}
+					if ( inst[ i ].op == OP_LEAVE && inst[ i ].endp ) {
+						break;
+					}
+				}
+				for ( i = 0; i < ARRAY_LEN( rx_list_home ); i++ ) {
+					wipe_rx_meta( rx_list_home[ i ] );
+				}
+#endif
+
 				emit_push( R_PROCBASE );				// procBase
 				emit_push( R_PSTACK );					// programStack
 
@@ -4151,6 +4430,7 @@ __compile:
 				break;
 
 			case OP_POP:
+				discard_top(); // optimizer may drop any value, not only call results
 				dec_opstack_discard(); // opstack -= 4
 				break;
 
@@ -4175,7 +4455,8 @@ __compile:
 #if idx64
 				emit_jump_index( R_INSPOINTERS, rx[0] );				// jmp qword ptr [instructionPointers + rax*8]
 #else
-				emit_jump_index_offset( (intptr_t) instructionPointers, rx[0] ); // jmp dword ptr [instructionPointers + eax*4]
+				emit_jump_index_offset( symValue[ SYM_INSPOINTERS ], rx[0] ); // jmp dword ptr [instructionPointers + eax*4]
+				EmitReloc( SYM_INSPOINTERS );
 #endif
 				unmask_rx( rx[0] );
 				break;
@@ -4241,6 +4522,68 @@ __compile:
 			case OP_LOAD1:
 			case OP_LOAD2:
 			case OP_LOAD4:
+#if idx64
+				if ( ci->reg ) {
+					// local kept in home register, value may be cached in a scratch register too
+					discard_top();
+					var.base = R_PROCBASE;
+					var.addr = ci->value;
+					var.size = 4;
+					if ( ci->sse ) {
+						const uint32_t home = sx_list_home[ ci->reg - 1 ];
+						if ( ci->fill ) {
+							emit_load_sx( home, var.base, var.addr );			// xmm8 = [procBase + v]
+						}
+						if ( ci->fpu ) {
+							if ( find_sx_var( &sx[0], &var ) ) {
+								mask_sx( sx[0] );
+							} else {
+								sx[0] = alloc_sx( R_XMM0 );
+								emit_mov_sx( sx[0], home );						// xmm0 = xmm8
+								set_sx_var( sx[0], &var );
+							}
+							store_sx_opstack( sx[0] );							// *opstack = xmm0
+							break;
+						}
+						if ( ( reg = find_rx_var( &rx[0], &var ) ) != NULL ) {
+							reg->ext = Z_NONE;
+							mask_rx( rx[0] );
+						} else {
+							rx[0] = alloc_rx( R_EAX );
+							emit_mov_rx_sx( rx[0], home );						// eax = xmm8
+							set_rx_ext( rx[0], Z_NONE );
+							set_rx_var( rx[0], &var );
+						}
+					} else {
+						const uint32_t home = rx_list_home[ ci->reg - 1 ];
+						if ( ci->fill ) {
+							emit_load4( home, var.base, var.addr );				// r10 = [procBase + v]
+						}
+						if ( ci->fpu && HasSSEFP() ) {
+							if ( find_sx_var( &sx[0], &var ) ) {
+								mask_sx( sx[0] );
+							} else {
+								sx[0] = alloc_sx( R_XMM0 );
+								emit_mov_sx_rx( sx[0], home );					// xmm0 = r10
+								set_sx_var( sx[0], &var );
+							}
+							store_sx_opstack( sx[0] );							// *opstack = xmm0
+							break;
+						}
+						if ( ( reg = find_rx_var( &rx[0], &var ) ) != NULL ) {
+							reg->ext = Z_NONE;
+							mask_rx( rx[0] );
+						} else {
+							rx[0] = alloc_rx( R_EAX );
+							emit_mov_rx( rx[0], home );							// eax = r10
+							set_rx_ext( rx[0], Z_NONE );
+							set_rx_var( rx[0], &var );
+						}
+					}
+					store_rx_opstack( rx[0] );									// *opstack = eax
+					break;
+				}
+#endif
 #ifdef FPU_OPTIMIZE
 				if ( ci->op == OP_LOAD4 && ci->fpu && HasSSEFP() ) {
 					if ( addr_on_top( &var ) ) {
@@ -4362,6 +4705,34 @@ __compile:
 			case OP_STORE1:
 			case OP_STORE2:
 			case OP_STORE4:
+#if idx64
+				if ( ci->reg ) {
+					// local kept in home register, stores write through to memory
+					var.base = R_PROCBASE;
+					var.addr = ci->value;
+					var.size = 4;
+					if ( ci->sse ) {
+						const uint32_t home = sx_list_home[ ci->reg - 1 ];
+						sx[0] = load_sx_opstack( R_XMM0 | RCONST ); dec_opstack();	// xmm0 = *opstack; opstack -= 4
+						discard_top(); dec_opstack();
+						emit_mov_sx( home, sx[0] );									// xmm8 = xmm0
+						emit_store_sx( sx[0], var.base, var.addr );					// [procBase + v] = xmm0
+						wipe_var_range( &var );
+						set_sx_var( sx[0], &var );
+						unmask_sx( sx[0] );
+					} else {
+						const uint32_t home = rx_list_home[ ci->reg - 1 ];
+						rx[0] = load_rx_opstack( R_EAX | RCONST ); dec_opstack();	// eax = *opstack; opstack -= 4
+						discard_top(); dec_opstack();
+						emit_mov_rx( home, rx[0] );									// r10 = eax
+						emit_store_rx( rx[0], var.base, var.addr );					// [procBase + v] = eax
+						wipe_var_range( &var );
+						set_rx_var( rx[0], &var );
+						unmask_rx( rx[0] );
+					}
+					break;
+				}
+#endif
 				if ( scalar_on_top() && ci->op == OP_STORE4 && HasSSEFP() ) {
 					sx[0] = load_sx_opstack( R_XMM0 | RCONST );	dec_opstack();		// xmm0 = *opstack; opstack -= 4
 					if ( addr_on_top( &var ) ) {
@@ -4615,11 +4986,10 @@ __compile:
 					unmask_sx( sx[0] );
 					store_rx_opstack( rx[0] );				// *opstack = eax
 				} else {
-					static int32_t fp_cw[2] = { 0x0000, 0x0F7F }; // [0] - current value, [1] - round towards zero
 					flush_opstack_top();
 					alloc_rx( R_EAX | FORCED );
 					emit_fld( R_OPSTACK, opstack * sizeof( int32_t ) ); // fld dword ptr [opStack]
-					mov_rx_ptr( R_EAX, &fp_cw );
+					mov_rx_sym( R_EAX, SYM_FPCW );		// mov eax, &fp_cw
 					EmitString( "9B D9 38" );	// fnstcw word ptr [eax]
 					EmitString( "D9 68 04" );	// fldcw word ptr [eax+4]
 					emit_fistp( R_OPSTACK, opstack * sizeof( int32_t ) ); // fistp dword ptr [opStack]
@@ -4715,6 +5085,10 @@ __compile:
 		}
 		instructionPointers = (intptr_t*)(byte*)(code + PAD(compiledOfs,8));
 		//vm->instructionPointers = instructionPointers; // for debug purposes?
+		symValue[ SYM_INSPOINTERS ] = (intptr_t) instructionPointers;
+		// relocations are recorded during repeated pass
+		maxRelocs = numRelocs;
+		relocs = (vmReloc_t*)Z_Malloc( maxRelocs * sizeof( vmReloc_t ) );
 		pass = NUM_PASSES-1; // repeat last pass
 		goto __compile;
 	}
@@ -4727,31 +5101,22 @@ __compile:
 	for ( i = 0; i < header->instructionCount; i++ ) {
 		if ( !inst[i].jused ) {
 			instructionPointers[ i ] = (intptr_t)badJumpPtr;
+			instructionOffsets[ i ] = -1;
 			continue;
 		}
 		instructionPointers[ i ] = (intptr_t)vm->codeBase.ptr + instructionOffsets[ i ];
 	}
 
+	// system functions follow the last procedure
+	vm->procsLength = funcOffset[ FUNC_CALL ];
+
+	VM_SaveCompiled( vm );
+
 	VM_FreeBuffers();
 
-#ifdef VM_X86_MMAP
-	if ( mprotect( vm->codeBase.ptr, vm->codeSize, PROT_READ|PROT_EXEC ) ) {
-		VM_Destroy_Compiled( vm );
-		Com_Printf( S_COLOR_YELLOW "VM_CompileX86: mprotect failed\n" );
+	if ( !VM_ProtectCompiled( vm ) ) {
 		return false;
 	}
-#elif _WIN32
-	{
-		DWORD oldProtect = 0;
-
-		// remove write permissions.
-		if ( !VirtualProtect( vm->codeBase.ptr, vm->codeSize, PAGE_EXECUTE_READ, &oldProtect ) ) {
-			VM_Destroy_Compiled( vm );
-			Com_Printf( S_COLOR_YELLOW "%s(%s): VirtualProtect failed\n", __func__, vm->name );
-			return false;
-		}
-	}
-#endif
 
 	vm->destroy = VM_Destroy_Compiled;
 
@@ -4818,6 +5183,113 @@ static void VM_Destroy_Compiled( vm_t* vm )
 }
 
 
+/*
+=================
+VM_CompiledInstructionPointers
+
+Native addresses of jump targets, every procedure entry is a jump target
+=================
+*/
+const intptr_t *VM_CompiledInstructionPointers( const vm_t *vm )
+{
+	return (const intptr_t *)( vm->codeBase.ptr + vm->codeLength );
+}
+
+
+/*
+=================
+VM_IsProcReturn
+
+Checks if address follows a direct call inside of compiled procedures
+=================
+*/
+static bool VM_IsProcReturn( const vm_t *vm, intptr_t addr )
+{
+	const byte *p = (const byte *)addr;
+
+	if ( p < vm->codeBase.ptr + 5 || p > vm->codeBase.ptr + vm->procsLength ) {
+		return false;
+	}
+
+	return p[-5] == 0xE8; // call rel32
+}
+
+
+/*
+=================
+VM_CompiledBacktrace
+
+Collects addresses inside of compiled procedures from native stack between
+sp and stackTop, innermost first. NULL stands for engine code called by the
+vm. Must be safe to call from a signal handler.
+
+Every procedure saves caller's programStack and procBase right below its
+return address, calls through FUNC_CALL put helper's return address in
+between. Stale words left below engine frames by earlier calls are skipped
+by requiring programStack to grow towards the stack top.
+=================
+*/
+int VM_CompiledBacktrace( const vm_t *vm, const void *pc, const void *sp, const void *stackTop, const void **frames, int maxFrames )
+{
+	const byte *code = vm->codeBase.ptr;
+	const intptr_t *s, *start, *top;
+	uint32_t programStack;
+	intptr_t ret;
+	bool leafCaller;
+	int n;
+
+	start = (const intptr_t *)sp;
+	top = (const intptr_t *)stackTop;
+	if ( top - start > 0x10000 ) {
+		top = start + 0x10000;
+	}
+
+	n = 0;
+	programStack = 0;
+	leafCaller = true;
+
+	if ( (const byte *)pc >= code && (const byte *)pc < code + vm->procsLength ) {
+		frames[ n++ ] = pc;
+		leafCaller = false;
+	} else if ( (const byte *)pc < code || (const byte *)pc >= code + vm->codeLength ) {
+		// system call, procedures above it have higher programStack
+		frames[ n++ ] = NULL;
+		programStack = vm->programStack + 8;
+	}
+
+	for ( s = start; s + 3 < top && n < maxFrames; s++ ) {
+		if ( (uint32_t)s[0] <= programStack || (uint32_t)s[0] > vm->dataMask + 1 || s[1] != (intptr_t)vm->dataBase + s[0] ) {
+			continue;
+		}
+
+		// interrupted in helper or system call, its caller is right below the saved registers
+		if ( leafCaller ) {
+			if ( s > start && VM_IsProcReturn( vm, s[-1] ) ) {
+				frames[ n++ ] = (const void *)s[-1];
+				if ( n == maxFrames ) {
+					break;
+				}
+			}
+			leafCaller = false;
+		}
+
+		if ( VM_IsProcReturn( vm, s[2] ) ) {
+			ret = s[2];
+		} else if ( VM_IsProcReturn( vm, s[3] ) ) {
+			ret = s[3];
+		} else {
+			continue;
+		}
+
+		frames[ n++ ] = (const void *)ret;
+		programStack = (uint32_t)s[0];
+		s += 2;
+	}
+
+	return n;
+}
+
+
 /*
 ==============
 VM_CallCompiled
@@ -43,7 +43,6 @@ typedef struct svEntity_s {
 	int			clusternums[MAX_ENT_CLUSTERS];
 	int			lastCluster;		// if all the clusters don't fit in clusternums
 	int			areanum, areanum2;
-	int			snapshotCounter;	// used to prevent double adding from portal views
 } svEntity_t;
 
 typedef enum {
@@ -71,7 +70,6 @@ typedef struct {
 	int				serverId;			// changes each server start
 	int				restartedServerId;	// changes each map restart
 	int				checksumFeed;		// the feed key that we use to compute the pure checksum strings
-	int				snapshotCounter;	// incremented for each snapshot built
 	int				timeResidual;		// <= 1000 / sv_frame->value
 	char			*configstrings[MAX_CONFIGSTRINGS];
 	svEntity_t		svEntities[MAX_GENTITIES];
@@ -181,6 +179,7 @@ typedef struct client_s {
 	// downloading
 	char			downloadName[MAX_QPATH]; // if not empty string, we are downloading
 	fileHandle_t	download;			// file being downloaded
+	struct dlCacheEntry_s *downloadEntry;	// shared mapping of the file instead of download
  	int				downloadSize;		// total bytes (can't use EOF because of paks)
  	int				downloadCount;		// bytes sent
 	int				downloadClientBlock;	// last block we sent to the client, awaiting ack
@@ -260,6 +259,9 @@ typedef struct {
 	snapshotFrame_t	snapFrames[ NUM_SNAPSHOT_FRAMES ];
 	snapshotFrame_t	*currFrame; // current frame that clients can refer
 
+	int			deltaCacheHits;			// entity deltas copied from the cache
+	int			deltaCacheMisses;		// entity deltas encoded
+
 } serverStatic_t;
 
 #ifdef USE_BANS
@@ -311,6 +313,10 @@ extern	cvar_t	*sv_lanForceRate;
 
 extern	cvar_t *sv_levelTimeReset;
 extern	cvar_t *sv_filter;
+extern	cvar_t *sv_parallelSnapshots;
+extern	cvar_t *sv_worldIndex;
+extern	cvar_t *sv_dlCacheSize;
+extern	cvar_t *sv_frameProfile;
 
 #ifdef USE_BANS
 extern	cvar_t	*sv_banFile;
@@ -372,6 +378,8 @@ bool SV_ExecuteClientCommand( client_t *cl, const char *s );
 void SV_ClientThink( client_t *cl, usercmd_t *cmd );
 
 int SV_SendDownloadMessages( void );
+void SV_FlushDownloadCache( void );
+void SV_DownloadCacheInfo( void );
 int SV_SendQueuedMessages( void );
 
 void SV_FreeIP4DB( void );
@@ -387,7 +395,7 @@ client_t *SV_GetPlayerByHandle( void );
 // sv_snapshot.c
 //
 void SV_AddServerCommand( client_t *client, const char *cmd );
-void SV_UpdateServerCommandsToClient( client_t *client, msg_t *msg );
+void SV_UpdateServerCommandsToClient( const client_t *client, msg_t *msg );
 void SV_WriteFrameToClient( client_t *client, msg_t *msg );
 void SV_SendMessageToClient( msg_t *msg, client_t *client );
 void SV_SendClientMessages( void );
@@ -453,6 +461,7 @@ clipHandle_t SV_ClipHandleForEntity( const sharedEntity_t *ent );
 
 
 void SV_SectorList_f( void );
+void SV_SectorStats_f( void );
 
 
 int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int maxcount );
@@ -480,6 +489,9 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 // passEntityNum is explicitly excluded from clipping checks (normally ENTITYNUM_NONE)
 
 
+void SV_TraceBatch( const traceRequest_t *requests, trace_t *results, int count );
+// same as SV_Trace for every request, nearby moves share a single area query
+
 void SV_ClipToEntity( trace_t *trace, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int entityNum, int contentmask, bool capsule );
 // clip to a specific entity
 
@@ -491,6 +503,26 @@ int SV_Netchan_TransmitNextFragment( client_t *client );
 bool SV_Netchan_Process( client_t *client, msg_t *msg );
 void SV_Netchan_FreeQueue( client_t *client );
 
+//
+// sv_profile.c
+//
+typedef enum {
+	SVP_FRAME,
+	SVP_GAME,				// GAME_RUN_FRAME
+	SVP_BOTS,				// bot AI frames
+	SVP_COMMON_SNAPSHOT,	// SV_BuildCommonSnapshot
+	SVP_SNAPSHOTS,			// building and encoding client snapshots
+	SVP_NETCHAN,			// netchan transmit
+	SVP_DOWNLOADS,			// pumping download blocks
+	SVP_NUM_PHASES
+} svProfPhase_t;
+
+int64_t SV_ProfileBegin( void );
+void SV_ProfileEnd( svProfPhase_t phase, int64_t start );
+void SV_ProfileFrame( void );
+void SV_FrameProfile_f( void );
+void SV_ShutdownProfile( void );
+
 //
 // sv_filter.c
 //
@@ -203,6 +203,40 @@ static void BotImport_Trace(bsp_trace_t *bsptrace, vec3_t start, vec3_t mins, ve
 	bsptrace->contents = 0;
 }
 
+/*
+==================
+BotImport_TraceBatch
+==================
+*/
+static void BotImport_TraceBatch(bsp_trace_t *bsptraces, const traceRequest_t *requests, int count) {
+	trace_t traces[64], *trace;
+	int i, n;
+
+	while (count > 0) {
+		n = count < ARRAY_LEN(traces) ? count : ARRAY_LEN(traces);
+		SV_TraceBatch(requests, traces, n);
+		//copy the trace information
+		for (i = 0, trace = traces; i < n; i++, trace++, bsptraces++) {
+			bsptraces->allsolid = trace->allsolid;
+			bsptraces->startsolid = trace->startsolid;
+			bsptraces->fraction = trace->fraction;
+			VectorCopy(trace->endpos, bsptraces->endpos);
+			bsptraces->plane.dist = trace->plane.dist;
+			VectorCopy(trace->plane.normal, bsptraces->plane.normal);
+			bsptraces->plane.signbits = trace->plane.signbits;
+			bsptraces->plane.type = trace->plane.type;
+			bsptraces->surface.value = 0;
+			bsptraces->surface.flags = trace->surfaceFlags;
+			bsptraces->ent = trace->entityNum;
+			bsptraces->exp_dist = 0;
+			bsptraces->sidenum = 0;
+			bsptraces->contents = 0;
+		}
+		requests += n;
+		count -= n;
+	}
+}
+
 /*
 ==================
 BotImport_EntityTrace
@@ -546,6 +580,7 @@ void SV_BotInitBotLib(void) {
 	botlib_import.Print = BotImport_Print;
 	botlib_import.Trace = BotImport_Trace;
 	botlib_import.EntityTrace = BotImport_EntityTrace;
+	botlib_import.TraceBatch = BotImport_TraceBatch;
 	botlib_import.PointContents = BotImport_PointContents;
 	botlib_import.inPVS = BotImport_inPVS;
 	botlib_import.BSPEntityData = BotImport_BSPEntityData;
@@ -1300,6 +1300,13 @@ static void SV_Status_f( void ) {
 	}
 
 	Com_Printf( "\n" );
+
+	if ( svs.deltaCacheHits + svs.deltaCacheMisses ) {
+		Com_Printf( "delta cache: %i%% hits\n",
+			(int)( (float)svs.deltaCacheHits * 100.0f / (float)( svs.deltaCacheHits + svs.deltaCacheMisses ) ) );
+	}
+
+	SV_DownloadCacheInfo();
 }
 
 
@@ -1422,6 +1429,8 @@ static void SV_Serverinfo_f( void ) {
 	if ( info ) {
 		Info_Print( info );
 	}
+
+	SV_DownloadCacheInfo();
 }
 
 
@@ -1560,6 +1569,8 @@ void SV_AddOperatorCommands( void ) {
 	Cmd_AddCommand ("dumpuser", SV_DumpUser_f);
 	Cmd_AddCommand ("map_restart", SV_MapRestart_f);
 	Cmd_AddCommand ("sectorlist", SV_SectorList_f);
+	Cmd_AddCommand ("sectorstats", SV_SectorStats_f);
+	Cmd_AddCommand ("frameprofile", SV_FrameProfile_f);
 	Cmd_AddCommand ("map", SV_Map_f);
 	Cmd_SetCommandCompletionFunc( "map", SV_CompleteMapName );
 #ifndef PRE_RELEASE_DEMO
@@ -1605,6 +1616,8 @@ void SV_RemoveOperatorCommands( void ) {
 	Cmd_RemoveCommand ("dumpuser");
 	Cmd_RemoveCommand ("map_restart");
 	Cmd_RemoveCommand ("sectorlist");
+	Cmd_RemoveCommand ("sectorstats");
+	Cmd_RemoveCommand ("frameprofile");
 #endif
 }
 
@@ -1288,6 +1288,266 @@ CLIENT COMMAND EXECUTION
 ============================================================
 */
 
+/*
+============================================================
+
+DOWNLOAD CACHE
+
+Files are memory mapped once and shared by all clients downloading them,
+blocks are copied straight from the mapping into the outgoing message.
+Files nobody is downloading stay mapped until sv_dlCacheSize is exceeded
+or the server spawns a new map. Clients fall back to reading through the
+filesystem when the cache is disabled or full.
+
+Size and modification time of the file are checked when it is mapped and
+before the mapping is reused. Blocks are encoded under
+Sys_GuardMappedRead, so a file truncated in place while it is sent drops
+the client instead of raising SIGBUS.
+
+============================================================
+*/
+
+#define MAX_DL_CACHE_FILES 32
+
+typedef struct dlCacheEntry_s
+{
+	char name[MAX_QPATH];
+	char ospath[MAX_OSPATH]; // mapped file
+	byte *data;
+	int size;
+	fileTime_t mtime;
+	int refCount; // clients downloading the file
+	int lastUsed; // for eviction
+} dlCacheEntry_t;
+
+static dlCacheEntry_t dlCache[MAX_DL_CACHE_FILES];
+
+static struct
+{
+	int files;
+	int64_t mappedSize;
+	int sequence;
+	int hits;	   // opened from an existing mapping
+	int misses;	   // mapped on open
+	int fallbacks; // read through the filesystem
+	int64_t bytesSent;
+} dlCacheStats;
+
+/*
+==================
+SV_UnmapDownload
+==================
+*/
+static void SV_UnmapDownload(dlCacheEntry_t *entry)
+{
+	Sys_UnmapFile(entry->data, entry->size);
+
+	dlCacheStats.files--;
+	dlCacheStats.mappedSize -= entry->size;
+
+	Com_Memset(entry, 0, sizeof(*entry));
+}
+
+/*
+==================
+SV_DownloadChanged
+
+Returns true if the mapped file was changed or removed since it was mapped
+==================
+*/
+static bool SV_DownloadChanged(const dlCacheEntry_t *entry)
+{
+	fileOffset_t size;
+	fileTime_t mtime, ctime;
+
+	if (!Sys_GetFileStats(entry->ospath, &size, &mtime, &ctime))
+	{
+		return true;
+	}
+
+	return size != entry->size || mtime != entry->mtime;
+}
+
+/*
+==================
+SV_EvictDownloads
+
+Unmaps least recently used files nobody is downloading until size more bytes fit,
+returns false if that is not possible
+==================
+*/
+static bool SV_EvictDownloads(int size)
+{
+	dlCacheEntry_t *entry, *oldest;
+	int64_t limit;
+	int i;
+
+	limit = (int64_t)sv_dlCacheSize->integer * 1024 * 1024;
+
+	while (dlCacheStats.mappedSize + size > limit || dlCacheStats.files == MAX_DL_CACHE_FILES)
+	{
+		oldest = NULL;
+		for (i = 0, entry = dlCache; i < MAX_DL_CACHE_FILES; i++, entry++)
+		{
+			if (entry->data && entry->refCount == 0 && (!oldest || entry->lastUsed < oldest->lastUsed))
+			{
+				oldest = entry;
+			}
+		}
+
+		if (!oldest)
+		{
+			return false;
+		}
+
+		SV_UnmapDownload(oldest);
+	}
+
+	return true;
+}
+
+/*
+==================
+SV_MapDownload
+
+Returns a referenced cache entry for the file or NULL if it can't be cached
+==================
+*/
+static dlCacheEntry_t *SV_MapDownload(const char *name)
+{
+	dlCacheEntry_t *entry;
+	char ospath[MAX_OSPATH];
+	fileOffset_t fileSize;
+	fileTime_t mtime, ctime;
+	byte *data;
+	int size, i;
+
+	if (sv_dlCacheSize->integer <= 0)
+	{
+		return NULL;
+	}
+
+	for (i = 0, entry = dlCache; i < MAX_DL_CACHE_FILES; i++, entry++)
+	{
+		if (entry->data && !FS_FilenameCompare(entry->name, name))
+		{
+			if (SV_DownloadChanged(entry))
+			{
+				if (entry->refCount)
+				{
+					// still sent to other clients, they will be dropped
+					return NULL;
+				}
+				SV_UnmapDownload(entry);
+				break;
+			}
+			entry->refCount++;
+			entry->lastUsed = ++dlCacheStats.sequence;
+			dlCacheStats.hits++;
+			return entry;
+		}
+	}
+
+	data = FS_SV_MapFile(name, &size, ospath, sizeof(ospath));
+	if (!data)
+	{
+		return NULL;
+	}
+
+	// file may have been changed right after mapping
+	if (!Sys_GetFileStats(ospath, &fileSize, &mtime, &ctime) || fileSize != size)
+	{
+		Sys_UnmapFile(data, size);
+		return NULL;
+	}
+
+	if (!SV_EvictDownloads(size))
+	{
+		Sys_UnmapFile(data, size);
+		return NULL;
+	}
+
+	for (i = 0, entry = dlCache; i < MAX_DL_CACHE_FILES; i++, entry++)
+	{
+		if (!entry->data)
+		{
+			break;
+		}
+	}
+
+	Q_strncpyz(entry->name, name, sizeof(entry->name));
+	Q_strncpyz(entry->ospath, ospath, sizeof(entry->ospath));
+	entry->data = data;
+	entry->size = size;
+	entry->mtime = mtime;
+	entry->refCount = 1;
+	entry->lastUsed = ++dlCacheStats.sequence;
+
+	dlCacheStats.files++;
+	dlCacheStats.mappedSize += size;
+	dlCacheStats.misses++;
+
+	return entry;
+}
+
+/*
+==================
+SV_OpenDownload
+
+Returns file size or -1 if the file can't be opened
+==================
+*/
+static int SV_OpenDownload(client_t *cl)
+{
+	cl->downloadEntry = SV_MapDownload(cl->downloadName);
+	if (cl->downloadEntry)
+	{
+		return cl->downloadEntry->size;
+	}
+
+	dlCacheStats.fallbacks++;
+
+	return FS_SV_FOpenFileRead(cl->downloadName, &cl->download);
+}
+
+/*
+==================
+SV_FlushDownloadCache
+
+Unmaps all files nobody is downloading
+==================
+*/
+void SV_FlushDownloadCache(void)
+{
+	dlCacheEntry_t *entry;
+	int i;
+
+	for (i = 0, entry = dlCache; i < MAX_DL_CACHE_FILES; i++, entry++)
+	{
+		if (entry->data && entry->refCount == 0)
+		{
+			SV_UnmapDownload(entry);
+		}
+	}
+}
+
+/*
+==================
+SV_DownloadCacheInfo
+==================
+*/
+void SV_DownloadCacheInfo(void)
+{
+	if (!dlCacheStats.hits && !dlCacheStats.misses && !dlCacheStats.fallbacks)
+	{
+		return;
+	}
+
+	Com_Printf("download cache: %i files, %i KB mapped, %i hits, %i misses, %i uncached, %i KB sent\n",
+			   dlCacheStats.files, (int)(dlCacheStats.mappedSize / 1024), dlCacheStats.hits, dlCacheStats.misses,
+			   dlCacheStats.fallbacks, (int)(dlCacheStats.bytesSent / 1024));
+}
+
 /*
 ==================
 SV_CloseDownload
@@ -1306,6 +1566,12 @@ static void SV_CloseDownload(client_t *cl)
 		cl->download = FS_INVALID_HANDLE;
 	}
 
+	if (cl->downloadEntry)
+	{
+		cl->downloadEntry->refCount--;
+		cl->downloadEntry = NULL;
+	}
+
 	*cl->downloadName = '\0';
 
 	// Free the temporary buffer space
@@ -1415,6 +1681,18 @@ static void SV_BeginDownload_f(client_t *cl)
 	}
 }
 
+/*
+==================
+SV_WriteDownloadBlock
+
+Encodes a block straight from the download cache mapping into the message
+==================
+*/
+static void SV_WriteDownloadBlock(void *msg, const void *data, int length)
+{
+	MSG_WriteData((msg_t *)msg, data, length);
+}
+
 /*
 ==================
 SV_WriteDownloadToClient
@@ -1433,7 +1711,7 @@ static int SV_WriteDownloadToClient(client_t *cl)
 	msg_t msg;
 	byte msgBuffer[MAX_DOWNLOAD_BLKSIZE * 2 + 8];
 
-	if (cl->download == FS_INVALID_HANDLE)
+	if (cl->download == FS_INVALID_HANDLE && !cl->downloadEntry)
 	{
 		bool idPack = false;
 		bool missionPack = false;
@@ -1476,7 +1754,7 @@ static int SV_WriteDownloadToClient(client_t *cl)
 		if (!(sv_allowDownload->integer & DLF_ENABLE) ||
 			(sv_allowDownload->integer & DLF_NO_UDP) ||
 			idPack || unreferenced ||
-			(cl->downloadSize = FS_SV_FOpenFileRead(cl->downloadName, &cl->download)) < 0)
+			(cl->downloadSize = SV_OpenDownload(cl)) < 0)
 		{
 
 			// cannot auto-download file
@@ -1564,6 +1842,15 @@ static int SV_WriteDownloadToClient(client_t *cl)
 
 		curindex = (cl->downloadCurrentBlock % MAX_DOWNLOAD_WINDOW);
 
+		if (cl->downloadEntry)
+		{
+			// block is sliced out of the mapping when sent
+			cl->downloadBlockSize[curindex] = MIN(MAX_DOWNLOAD_BLKSIZE, cl->downloadSize - cl->downloadCount);
+			cl->downloadCount += cl->downloadBlockSize[curindex];
+			cl->downloadCurrentBlock++;
+			continue;
+		}
+
 		if (!cl->downloadBlocks[curindex])
 			cl->downloadBlocks[curindex] = Z_Malloc(MAX_DOWNLOAD_BLKSIZE);
 
@@ -1625,7 +1912,23 @@ static int SV_WriteDownloadToClient(client_t *cl)
 
 	// Write the block
 	if (cl->downloadBlockSize[curindex] > 0)
-		MSG_WriteData(&msg, cl->downloadBlocks[curindex], cl->downloadBlockSize[curindex]);
+	{
+		if (cl->downloadEntry)
+		{
+			if (!Sys_GuardMappedRead(cl->downloadEntry->data + cl->downloadXmitBlock * MAX_DOWNLOAD_BLKSIZE, cl->downloadBlockSize[curindex], SV_WriteDownloadBlock, &msg))
+			{
+				// remaining blocks can't be read from the mapping
+				Com_Printf("clientDownload: %d : \"%s\" changed on server\n", (int)(cl - svs.clients), cl->downloadName);
+				SV_DropClient(cl, "download changed on server");
+				return 0;
+			}
+			dlCacheStats.bytesSent += cl->downloadBlockSize[curindex];
+		}
+		else
+		{
+			MSG_WriteData(&msg, cl->downloadBlocks[curindex], cl->downloadBlockSize[curindex]);
+		}
+	}
 
 	MSG_WriteByte(&msg, svc_EOF);
 	SV_Netchan_Transmit(cl, &msg);
@@ -347,6 +347,12 @@ static bool SV_GetValue( char* value, int valueSize, const char* key )
 		return true;
 	}
 
+	if ( !Q_stricmp( key, "trap_TraceBatch_Q3E" ) )
+	{
+		Com_sprintf( value, valueSize, "%i", G_TRACEBATCH );
+		return true;
+	}
+
 	return false;
 }
 
@@ -950,6 +956,15 @@ static intptr_t SV_GameSystemCalls( intptr_t *args ) {
 	case G_TESTPRINTFLOAT:
 		return sprintf( VMA(1), "%f", VMF(2) );
 
+	case G_TRACEBATCH:
+		if ( (unsigned int)args[3] > MAX_TRACE_BATCH ) {
+			Com_Error( ERR_DROP, "G_TRACEBATCH: bad count %i", (int)args[3] );
+		}
+		VM_CHECKBOUNDS( gvm, args[1], args[3] * sizeof( traceRequest_t ) );
+		VM_CHECKBOUNDS( gvm, args[2], args[3] * sizeof( trace_t ) );
+		SV_TraceBatch( VMA(1), VMA(2), args[3] );
+		return 0;
+
 	case G_TRAP_GETVALUE:
 		VM_CHECKBOUNDS( gvm, args[1], args[2] );
 		return SV_GetValue( VMA(1), args[2], VMA(3) );
@@ -501,6 +501,8 @@ void SV_SpawnServer( const char *mapname, bool killBots ) {
 	i = sv.maxclients;
 	// wipe the entire per-level structure
 	SV_ClearServer();
+	// files may have been replaced on disk
+	SV_FlushDownloadCache();
 	sv.maxclients = i;
 	for ( i = 0; i < MAX_CONFIGSTRINGS; i++ ) {
 		sv.configstrings[i] = CopyString("");
@@ -535,6 +537,9 @@ void SV_SpawnServer( const char *mapname, bool killBots ) {
 	sv.restartedServerId = sv.serverId;
 	Cvar_SetIntegerValue( "sv_serverid", sv.serverId );
 
+	// get latched value
+	sv_worldIndex = Cvar_Get( "sv_worldIndex", "0", CVAR_ARCHIVE_ND | CVAR_LATCH );
+
 	// clear physics interaction links
 	SV_ClearWorld();
 
@@ -804,6 +809,21 @@ void SV_Init( void )
 	sv_filter = Cvar_Get( "sv_filter", "filter.txt", CVAR_ARCHIVE );
 	Cvar_SetDescription( sv_filter, "Cvar that point on filter file, if it is "" then filtering will be disabled." );
 
+	sv_parallelSnapshots = Cvar_Get( "sv_parallelSnapshots", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_parallelSnapshots, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( sv_parallelSnapshots, "Build and encode client snapshots on multiple threads, see com_jobThreads." );
+	sv_worldIndex = Cvar_Get( "sv_worldIndex", "0", CVAR_ARCHIVE_ND | CVAR_LATCH );
+	Cvar_CheckRange( sv_worldIndex, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( sv_worldIndex, "Spatial index of linked entities, applied on map load:\n"
+		" 0 - fixed sector tree\n"
+		" 1 - loose grid, scales better with thousands of entities" );
+	sv_dlCacheSize = Cvar_Get( "sv_dlCacheSize", "256", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_dlCacheSize, "0", "4096", CV_INTEGER );
+	Cvar_SetDescription( sv_dlCacheSize, "Megabytes of memory mapped files shared between downloading clients, 0 - read files separately for every client." );
+	sv_frameProfile = Cvar_Get( "sv_frameProfile", "0", CVAR_ARCHIVE_ND );
+	Cvar_CheckRange( sv_frameProfile, "0", "1", CV_INTEGER );
+	Cvar_SetDescription( sv_frameProfile, "Time server frame phases, results are shown by the frameprofile command." );
+
 	// initialize bot cvars so they are listed and can be set before loading the botlib
 	SV_BotInitCvars();
 
@@ -905,6 +925,9 @@ void SV_Shutdown( const char *finalmsg ) {
 
 		Z_Free( svs.clients );
 	}
+	SV_FlushDownloadCache();
+	SV_ShutdownProfile();
+	CM_StopCapture();
 	Com_Memset( &svs, 0, sizeof( svs ) );
 	sv.time = 0;
 
@@ -56,6 +56,10 @@ cvar_t	*sv_lanForceRate; // dedicated 1 (LAN) server forces local client rates t
 
 cvar_t *sv_levelTimeReset;
 cvar_t *sv_filter;
+cvar_t *sv_parallelSnapshots;
+cvar_t *sv_worldIndex;
+cvar_t *sv_dlCacheSize;
+cvar_t *sv_frameProfile;
 
 #ifdef USE_BANS
 cvar_t	*sv_banFile;
@@ -1285,6 +1289,7 @@ void SV_Frame( int msec ) {
 	int		frameMsec;
 	int		startTime;
 	int		i;
+	int64_t	frameStart, profileStart;
 
 	if ( Cvar_CheckGroup( CVG_SERVER ) )
 		SV_TrackCvarChanges(); // update rate settings, etc.
@@ -1325,8 +1330,11 @@ void SV_Frame( int msec ) {
 
 	sv.timeResidual += msec;
 
-	if ( !com_dedicated->integer )
+	if ( !com_dedicated->integer ) {
+		profileStart = SV_ProfileBegin();
 		SV_BotFrame( sv.time + sv.timeResidual );
+		SV_ProfileEnd( SVP_BOTS, profileStart );
+	}
 
 	// if time is about to hit the 32nd bit, kick all clients
 	// and clear sv.time, rather
@@ -1375,10 +1383,16 @@ void SV_Frame( int msec ) {
 		startTime = 0;	// quite a compiler warning
 	}
 
+	frameStart = SV_ProfileBegin();
+
 	// update ping based on the all received frames
 	SV_CalcPings();
 
-	if (com_dedicated->integer) SV_BotFrame (sv.time);
+	if ( com_dedicated->integer ) {
+		profileStart = SV_ProfileBegin();
+		SV_BotFrame( sv.time );
+		SV_ProfileEnd( SVP_BOTS, profileStart );
+	}
 
 	// run the game simulation in chunks
 	while ( sv.timeResidual >= frameMsec ) {
@@ -1387,7 +1401,9 @@ void SV_Frame( int msec ) {
 		sv.time += frameMsec;
 
 		// let everything in the world think and move
+		profileStart = SV_ProfileBegin();
 		VM_Call( gvm, 1, GAME_RUN_FRAME, sv.time );
+		SV_ProfileEnd( SVP_GAME, profileStart );
 	}
 
 	if ( com_speeds->integer ) {
@@ -1405,6 +1421,9 @@ void SV_Frame( int msec ) {
 
 	// send a heartbeat to the master if needed
 	SV_MasterHeartbeat(HEARTBEAT_FOR_MASTER);
+
+	SV_ProfileEnd( SVP_FRAME, frameStart );
+	SV_ProfileFrame();
 }
 
 
@@ -1462,6 +1481,9 @@ int SV_SendQueuedPackets( void )
 	int dlStart, deltaT, delayT;
 	static int dlNextRound = 0;
 	int timeVal = INT_MAX;
+	int64_t profileStart;
+
+	Sys_BeginPacketBatch();
 
 	// Send out fragmented packets now that we're idle
 	delayT = SV_SendQueuedMessages();
@@ -1482,10 +1504,13 @@ int SV_SendQueuedPackets( void )
 		}
 		else
 		{
+			profileStart = SV_ProfileBegin();
 			numBlocks = SV_SendDownloadMessages();
 
 			if(numBlocks)
 			{
+				SV_ProfileEnd( SVP_DOWNLOADS, profileStart );
+
 				// There are active downloads
 				deltaT = Sys_Milliseconds() - dlStart;
 
@@ -1519,9 +1544,15 @@ int SV_SendQueuedPackets( void )
 	}
 	else
 	{
+		profileStart = SV_ProfileBegin();
 		if(SV_SendDownloadMessages())
+		{
+			SV_ProfileEnd( SVP_DOWNLOADS, profileStart );
 			timeVal = 0;
+		}
 	}
 
+	Sys_EndPacketBatch();
+
 	return timeVal;
 }
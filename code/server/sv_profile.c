@@ -0,0 +1,378 @@
+/*
+===========================================================================
+Copyright (C) 1999-2005 Id Software, Inc.
+
+This file is part of Quake III Arena source code.
+
+Quake III Arena source code is free software; you can redistribute it
+and/or modify it under the terms of the GNU General Public License as
+published by the Free Software Foundation; either version 2 of the License,
+or (at your option) any later version.
+
+Quake III Arena source code is distributed in the hope that it will be
+useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Quake III Arena source code; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+===========================================================================
+*/
+// sv_profile.c -- server frame phase timers
+
+#include "server.h"
+
+/*
+============================================================================
+
+Phases are timed with SV_ProfileBegin()/SV_ProfileEnd() pairs on the main
+thread. Phase times include nested phases, e.g. snapshots include netchan.
+
+Time spent in every phase is summed over a server frame and committed by
+SV_ProfileFrame() into a window of the last PROFILE_WINDOW frames, frames
+a phase did not run in are not recorded for it. Percentiles are computed
+from the window when requested.
+
+While tracing, every timed interval is also written to a binary file that
+"frameprofile export" converts to Chrome trace JSON (chrome://tracing).
+
+============================================================================
+*/
+
+#define PROFILE_WINDOW		1024
+#define TRACE_BUFFER		4096
+#define TRACE_MAGIC			0x52505653	// "SVPR"
+#define TRACE_VERSION		1
+
+static const char *phaseNames[ SVP_NUM_PHASES ] = {
+	"frame",
+	"game",
+	"bots",
+	"common snapshot",
+	"snapshots",
+	"netchan",
+	"downloads"
+};
+
+typedef struct {
+	int			frameTime;		// usec accumulated in the current frame
+	int			frameCalls;
+	int			samples[ PROFILE_WINDOW ];
+	int			numSamples;		// total, the window keeps the last PROFILE_WINDOW
+} profilePhase_t;
+
+// binary trace record, stored little endian
+typedef struct {
+	int			startLow;		// usec since trace start
+	int			startHigh;
+	int			duration;		// usec
+	int			phase;
+} traceRecord_t;
+
+static struct {
+	profilePhase_t	phases[ SVP_NUM_PHASES ];
+
+	fileHandle_t	trace;
+	int64_t			traceStart;
+	traceRecord_t	records[ TRACE_BUFFER ];
+	int				numRecords;
+	int				totalRecords;
+} sv_profile;
+
+
+/*
+================
+SV_ProfileActive
+================
+*/
+static bool SV_ProfileActive( void ) {
+	return sv_frameProfile->integer || sv_profile.trace != FS_INVALID_HANDLE;
+}
+
+
+/*
+================
+SV_FlushTrace
+================
+*/
+static void SV_FlushTrace( void ) {
+	if ( sv_profile.numRecords && sv_profile.trace != FS_INVALID_HANDLE ) {
+		FS_Write( sv_profile.records, sv_profile.numRecords * sizeof( traceRecord_t ), sv_profile.trace );
+	}
+	sv_profile.numRecords = 0;
+}
+
+
+/*
+================
+SV_ProfileBegin
+
+Returns start time for SV_ProfileEnd, 0 if profiling is disabled
+================
+*/
+int64_t SV_ProfileBegin( void ) {
+	if ( !SV_ProfileActive() ) {
+		return 0;
+	}
+	return Sys_Microseconds();
+}
+
+
+/*
+================
+SV_ProfileEnd
+================
+*/
+void SV_ProfileEnd( svProfPhase_t phase, int64_t start ) {
+	profilePhase_t *p;
+	traceRecord_t *rec;
+	int64_t	end, offset;
+	int		duration;
+
+	if ( !start ) {
+		return;
+	}
+
+	end = Sys_Microseconds();
+	duration = (int)( end - start );
+
+	p = &sv_profile.phases[ phase ];
+	p->frameTime += duration;
+	p->frameCalls++;
+
+	if ( sv_profile.trace != FS_INVALID_HANDLE ) {
+		if ( sv_profile.numRecords == TRACE_BUFFER ) {
+			SV_FlushTrace();
+		}
+		offset = start - sv_profile.traceStart;
+		rec = &sv_profile.records[ sv_profile.numRecords++ ];
+		rec->startLow = LittleLong( (int)( offset & 0xFFFFFFFF ) );
+		rec->startHigh = LittleLong( (int)( offset >> 32 ) );
+		rec->duration = LittleLong( duration );
+		rec->phase = LittleLong( phase );
+		sv_profile.totalRecords++;
+	}
+}
+
+
+/*
+================
+SV_ProfileFrame
+
+Commits phase times of the finished server frame
+================
+*/
+void SV_ProfileFrame( void ) {
+	profilePhase_t *p;
+	int		i;
+
+	for ( i = 0, p = sv_profile.phases; i < SVP_NUM_PHASES; i++, p++ ) {
+		if ( !p->frameCalls ) {
+			continue;
+		}
+		p->samples[ p->numSamples % PROFILE_WINDOW ] = p->frameTime;
+		p->numSamples++;
+		p->frameTime = 0;
+		p->frameCalls = 0;
+	}
+
+	SV_FlushTrace();
+}
+
+
+/*
+================
+SV_StopTrace
+================
+*/
+static void SV_StopTrace( void ) {
+	if ( sv_profile.trace == FS_INVALID_HANDLE ) {
+		return;
+	}
+
+	SV_FlushTrace();
+	FS_FCloseFile( sv_profile.trace );
+	sv_profile.trace = FS_INVALID_HANDLE;
+
+	Com_Printf( "Trace stopped, %i intervals written.\n", sv_profile.totalRecords );
+}
+
+
+/*
+================
+SV_StartTrace
+================
+*/
+static void SV_StartTrace( const char *name ) {
+	int		header[2];
+
+	SV_StopTrace();
+
+	sv_profile.trace = FS_SV_FOpenFileWrite( name );
+	if ( sv_profile.trace == FS_INVALID_HANDLE ) {
+		Com_Printf( S_COLOR_YELLOW "Couldn't open %s for writing.\n", name );
+		return;
+	}
+
+	header[0] = LittleLong( TRACE_MAGIC );
+	header[1] = LittleLong( TRACE_VERSION );
+	FS_Write( header, sizeof( header ), sv_profile.trace );
+
+	sv_profile.traceStart = Sys_Microseconds();
+	sv_profile.numRecords = 0;
+	sv_profile.totalRecords = 0;
+
+	Com_Printf( "Tracing server frames to %s\n", name );
+}
+
+
+/*
+================
+SV_ExportTrace
+
+Converts binary trace to Chrome trace event JSON
+================
+*/
+static void SV_ExportTrace( const char *name, const char *jsonName ) {
+	traceRecord_t	records[ 256 ];
+	fileHandle_t	in, out;
+	int64_t			start;
+	int		header[2];
+	int		i, n, len, phase, count;
+
+	if ( FS_SV_FOpenFileRead( name, &in ) < 0 ) {
+		Com_Printf( "Couldn't open %s\n", name );
+		return;
+	}
+
+	if ( FS_Read( header, sizeof( header ), in ) != sizeof( header )
+		|| LittleLong( header[0] ) != TRACE_MAGIC || LittleLong( header[1] ) != TRACE_VERSION ) {
+		Com_Printf( "%s is not a server frame trace\n", name );
+		FS_FCloseFile( in );
+		return;
+	}
+
+	out = FS_SV_FOpenFileWrite( jsonName );
+	if ( out == FS_INVALID_HANDLE ) {
+		Com_Printf( S_COLOR_YELLOW "Couldn't open %s for writing.\n", jsonName );
+		FS_FCloseFile( in );
+		return;
+	}
+
+	FS_Printf( out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+	count = 0;
+	while ( ( len = FS_Read( records, sizeof( records ), in ) ) > 0 ) {
+		n = len / sizeof( records[0] );
+		for ( i = 0; i < n; i++ ) {
+			start = (int64_t)(unsigned int)LittleLong( records[i].startLow ) | ( (int64_t)LittleLong( records[i].startHigh ) << 32 );
+			phase = LittleLong( records[i].phase );
+			if ( (unsigned)phase >= SVP_NUM_PHASES ) {
+				continue;
+			}
+			FS_Printf( out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.0f,\"dur\":%i}",
+				count ? ",\n" : "", phaseNames[ phase ], (double)start, LittleLong( records[i].duration ) );
+			count++;
+		}
+	}
+
+	FS_Printf( out, "\n]}\n" );
+
+	FS_FCloseFile( out );
+	FS_FCloseFile( in );
+
+	Com_Printf( "Wrote %i events to %s\n", count, jsonName );
+}
+
+
+/*
+================
+SV_CompareSamples
+================
+*/
+static int QDECL SV_CompareSamples( const void *a, const void *b ) {
+	return *(const int *)a - *(const int *)b;
+}
+
+
+/*
+================
+SV_FrameProfile_f
+================
+*/
+void SV_FrameProfile_f( void ) {
+	int		sorted[ PROFILE_WINDOW ];
+	const profilePhase_t *p;
+	const char *cmd;
+	int64_t	total;
+	int		i, j, n;
+
+	cmd = Cmd_Argv( 1 );
+
+	if ( !Q_stricmp( cmd, "reset" ) ) {
+		for ( i = 0; i < SVP_NUM_PHASES; i++ ) {
+			sv_profile.phases[i].numSamples = 0;
+		}
+		return;
+	}
+
+	if ( !Q_stricmp( cmd, "trace" ) ) {
+		if ( Cmd_Argc() > 2 ) {
+			SV_StartTrace( Cmd_Argv( 2 ) );
+		} else {
+			SV_StopTrace();
+		}
+		return;
+	}
+
+	if ( !Q_stricmp( cmd, "export" ) ) {
+		if ( Cmd_Argc() < 4 ) {
+			Com_Printf( "usage: frameprofile export <trace file> <json file>\n" );
+			return;
+		}
+		SV_ExportTrace( Cmd_Argv( 2 ), Cmd_Argv( 3 ) );
+		return;
+	}
+
+	if ( *cmd ) {
+		Com_Printf( "usage: frameprofile [reset|trace [file]|export <trace file> <json file>]\n" );
+		return;
+	}
+
+	if ( !SV_ProfileActive() ) {
+		Com_Printf( "Frame profiling is disabled, set sv_frameProfile 1.\n" );
+	}
+
+	Com_Printf( "phase             frames     avg     p50     p95     p99     max (usec)\n" );
+	for ( i = 0, p = sv_profile.phases; i < SVP_NUM_PHASES; i++, p++ ) {
+		n = MIN( p->numSamples, PROFILE_WINDOW );
+		if ( !n ) {
+			continue;
+		}
+		Com_Memcpy( sorted, p->samples, n * sizeof( sorted[0] ) );
+		qsort( sorted, n, sizeof( sorted[0] ), SV_CompareSamples );
+		total = 0;
+		for ( j = 0; j < n; j++ ) {
+			total += sorted[j];
+		}
+		Com_Printf( "%-16s %7i %7i %7i %7i %7i %7i\n", phaseNames[i], n, (int)( total / n ),
+			sorted[ ( n - 1 ) * 50 / 100 ], sorted[ ( n - 1 ) * 95 / 100 ],
+			sorted[ ( n - 1 ) * 99 / 100 ], sorted[ n - 1 ] );
+	}
+
+	if ( sv_profile.trace != FS_INVALID_HANDLE ) {
+		Com_Printf( "tracing, %i intervals written\n", sv_profile.totalRecords );
+	}
+}
+
+
+/*
+================
+SV_ShutdownProfile
+================
+*/
+void SV_ShutdownProfile( void ) {
+	SV_StopTrace();
+	Com_Memset( &sv_profile, 0, sizeof( sv_profile ) );
+}
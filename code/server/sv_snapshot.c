@@ -44,6 +44,180 @@ A normal server packet will look like:
 =============================================================================
 */
 
+/*
+=============================================================================
+
+Delta entity cache
+
+Clients that acknowledged the same snapshot produce exactly the same entity
+deltas, so encoded bit ranges are cached per common snapshot, keyed by the
+(from, to) entity pointers. Static huffman codes don't depend on the bit
+position, so the cached ranges are just appended to the message.
+
+In parallel snapshot mode the cache is protected by a mutex.
+
+=============================================================================
+*/
+
+#define DELTA_CACHE_SLOTS 8192 // must be power of two
+#define DELTA_CACHE_ENTRIES (DELTA_CACHE_SLOTS * 3 / 4)
+#define DELTA_CACHE_BYTES (256 * 1024)
+#define MAX_DELTA_ENTITY_BYTES 1024 // full entityState_t delta is about 300 bytes
+
+typedef struct
+{
+	const entityState_t *from;
+	const entityState_t *to;
+	bool force;
+	int offset; // in deltaCache.data
+	int numBits;
+} deltaCacheEntry_t;
+
+static struct
+{
+	deltaCacheEntry_t *slots[DELTA_CACHE_SLOTS];
+	deltaCacheEntry_t entries[DELTA_CACHE_ENTRIES];
+	int numEntries;
+	byte data[DELTA_CACHE_BYTES];
+	int dataSize;
+	bool jobs; // accessed from job threads
+	void *mutex;
+} deltaCache;
+
+/*
+===============
+SV_ClearDeltaCache
+===============
+*/
+static void SV_ClearDeltaCache(void)
+{
+	if (deltaCache.numEntries)
+	{
+		Com_Memset(deltaCache.slots, 0, sizeof(deltaCache.slots));
+		deltaCache.numEntries = 0;
+		deltaCache.dataSize = 0;
+	}
+}
+
+/*
+===============
+SV_FindDeltaCacheSlot
+===============
+*/
+static deltaCacheEntry_t **SV_FindDeltaCacheSlot(const entityState_t *from, const entityState_t *to, bool force)
+{
+	deltaCacheEntry_t **slot;
+	unsigned int hash;
+
+	hash = (unsigned int)((size_t)from / sizeof(*from)) * 31 + (unsigned int)((size_t)to / sizeof(*to));
+	hash &= DELTA_CACHE_SLOTS - 1;
+
+	for (;;)
+	{
+		slot = &deltaCache.slots[hash];
+		if (*slot == NULL || ((*slot)->from == from && (*slot)->to == to && (*slot)->force == force))
+		{
+			return slot;
+		}
+		hash = (hash + 1) & (DELTA_CACHE_SLOTS - 1);
+	}
+}
+
+/*
+===============
+SV_WriteDeltaEntity
+
+Cached version of MSG_WriteDeltaEntity for entities of the common snapshot,
+output is bit-identical
+===============
+*/
+static void SV_WriteDeltaEntity(msg_t *msg, const entityState_t *from, const entityState_t *to, bool force)
+{
+	byte buf[MAX_DELTA_ENTITY_BYTES + 8];
+	deltaCacheEntry_t **slot, *entry;
+	int numBytes;
+	msg_t delta;
+
+	if (msg->overflowed)
+	{
+		return;
+	}
+
+	if (deltaCache.jobs)
+	{
+		if (!deltaCache.mutex)
+		{
+			MSG_WriteDeltaEntity(msg, from, to, force);
+			return;
+		}
+		Sys_LockMutex(deltaCache.mutex);
+	}
+
+	slot = SV_FindDeltaCacheSlot(from, to, force);
+	entry = *slot;
+	if (entry)
+	{
+		svs.deltaCacheHits++;
+	}
+	else
+	{
+		svs.deltaCacheMisses++;
+	}
+
+	// keep the ratio without overflowing
+	if (svs.deltaCacheHits + svs.deltaCacheMisses >= 0x40000000)
+	{
+		svs.deltaCacheHits >>= 1;
+		svs.deltaCacheMisses >>= 1;
+	}
+
+	if (deltaCache.jobs)
+	{
+		Sys_UnlockMutex(deltaCache.mutex);
+	}
+
+	// cached data is never modified until the cache is cleared on the main thread
+	if (entry)
+	{
+		MSG_WriteBitStream(msg, deltaCache.data + entry->offset, entry->numBits);
+		return;
+	}
+
+	MSG_Init(&delta, buf, MAX_DELTA_ENTITY_BYTES);
+	MSG_WriteDeltaEntity(&delta, from, to, force);
+
+	if (deltaCache.jobs)
+	{
+		Sys_LockMutex(deltaCache.mutex);
+	}
+
+	numBytes = (delta.bit + 7) >> 3;
+	if (!delta.overflowed && deltaCache.numEntries < DELTA_CACHE_ENTRIES && deltaCache.dataSize + numBytes <= DELTA_CACHE_BYTES)
+	{
+		// another thread may have added it in the meantime
+		slot = SV_FindDeltaCacheSlot(from, to, force);
+		if (*slot == NULL)
+		{
+			entry = &deltaCache.entries[deltaCache.numEntries++];
+			entry->from = from;
+			entry->to = to;
+			entry->force = force;
+			entry->offset = deltaCache.dataSize;
+			entry->numBits = delta.bit;
+			Com_Memcpy(deltaCache.data + deltaCache.dataSize, buf, numBytes);
+			deltaCache.dataSize += numBytes;
+			*slot = entry;
+		}
+	}
+
+	if (deltaCache.jobs)
+	{
+		Sys_UnlockMutex(deltaCache.mutex);
+	}
+
+	MSG_WriteBitStream(msg, buf, delta.bit);
+}
+
 /*
 =============
 SV_EmitPacketEntities
@@ -99,7 +273,7 @@ static void SV_EmitPacketEntities(const clientSnapshot_t *from, const clientSnap
 			// delta update from old position
 			// because the force parm is false, this will not result
 			// in any bytes being emitted if the entity has not changed at all
-			MSG_WriteDeltaEntity(msg, oldent, newent, false);
+			SV_WriteDeltaEntity(msg, oldent, newent, false);
 			oldindex++;
 			newindex++;
 			continue;
@@ -108,7 +282,7 @@ static void SV_EmitPacketEntities(const clientSnapshot_t *from, const clientSnap
 		if (newnum < oldnum)
 		{
 			// this is a new entity, send it from the baseline
-			MSG_WriteDeltaEntity(msg, &sv.svEntities[newnum].baseline, newent, true);
+			SV_WriteDeltaEntity(msg, &sv.svEntities[newnum].baseline, newent, true);
 			newindex++;
 			continue;
 		}
@@ -127,26 +301,22 @@ static void SV_EmitPacketEntities(const clientSnapshot_t *from, const clientSnap
 
 /*
 ==================
-SV_WriteSnapshotToClient
+SV_SelectDeltaFrame
+
+Returns the previous frame to delta compress the new snapshot from, or NULL
+for a full update. Should be called after the common snapshot is built.
 ==================
 */
-static void SV_WriteSnapshotToClient(const client_t *client, msg_t *msg)
+static const clientSnapshot_t *SV_SelectDeltaFrame(const client_t *client, int *lastframe)
 {
 	const clientSnapshot_t *oldframe;
-	const clientSnapshot_t *frame;
-	int lastframe;
-	int i;
-	int snapFlags;
-
-	// this is the snapshot we are creating
-	frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
 
 	// try to use a previous frame as the source for delta compressing the snapshot
 	if (/* client->deltaMessage <= 0 || */ client->state != CS_ACTIVE)
 	{
 		// client is asking for a retransmit
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	}
 	else if (client->netchan.outgoingSequence - client->deltaMessage >= (PACKET_BACKUP - 3))
 	{
@@ -159,22 +329,41 @@ static void SV_WriteSnapshotToClient(const client_t *client, msg_t *msg)
 			}
 		}
 		oldframe = NULL;
-		lastframe = 0;
+		*lastframe = 0;
 	}
 	else
 	{
 		// we have a valid snapshot to delta from
 		oldframe = &client->frames[client->deltaMessage & PACKET_MASK];
-		lastframe = client->netchan.outgoingSequence - client->deltaMessage;
+		*lastframe = client->netchan.outgoingSequence - client->deltaMessage;
 		// we may refer on outdated frame
 		if (oldframe->frameNum - svs.lastValidFrame < 0)
 		{
 			Com_DPrintf("%s: Delta request from out of date frame.\n", client->name);
 			oldframe = NULL;
-			lastframe = 0;
+			*lastframe = 0;
 		}
 	}
 
+	return oldframe;
+}
+
+/*
+==================
+SV_WriteSnapshotToClient
+
+Can be executed on worker threads, see SV_SendClientMessages
+==================
+*/
+static void SV_WriteSnapshotToClient(const client_t *client, const clientSnapshot_t *oldframe, int lastframe, msg_t *msg)
+{
+	const clientSnapshot_t *frame;
+	int i;
+	int snapFlags;
+
+	// this is the snapshot we are creating
+	frame = &client->frames[client->netchan.outgoingSequence & PACKET_MASK];
+
 	MSG_WriteByte(msg, svc_snapshot);
 
 	// NOTE, MRE: now sent at the start of every message from server to client
@@ -258,7 +447,7 @@ SV_UpdateServerCommandsToClient
 (re)send all server commands the client hasn't acknowledged yet
 ==================
 */
-void SV_UpdateServerCommandsToClient(client_t *client, msg_t *msg)
+void SV_UpdateServerCommandsToClient(const client_t *client, msg_t *msg)
 {
 	int i, n;
 
@@ -287,7 +476,9 @@ typedef struct
 {
 	int numSnapshotEntities;
 	entityNum_t snapshotEntities[MAX_SNAPSHOT_ENTITIES];
+	byte added[MAX_GENTITIES / 8]; // prevents double adding from portal views
 	bool unordered;
+	const char *error; // raised by the caller, as we may run on a worker thread
 } snapshotEntityNumbers_t;
 
 /*
@@ -329,10 +520,10 @@ static void SV_SortEntityNumbers(entityNum_t *num, const int size)
 SV_AddIndexToSnapshot
 ===============
 */
-static void SV_AddIndexToSnapshot(svEntity_t *svEnt, int index, snapshotEntityNumbers_t *eNums)
+static void SV_AddIndexToSnapshot(int entityNum, int index, snapshotEntityNumbers_t *eNums)
 {
 
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	eNums->added[entityNum >> 3] |= 1 << (entityNum & 7);
 
 	// if we are full, silently discard entities
 	if (eNums->numSnapshotEntities >= MAX_SNAPSHOT_ENTITIES)
@@ -344,86 +535,86 @@ static void SV_AddIndexToSnapshot(svEntity_t *svEnt, int index, snapshotEntityNu
 	eNums->numSnapshotEntities++;
 }
 
+/*
+=============================================================================
+
+Per-viewpoint visibility cache
+
+Area connectivity and PVS results only depend on the (area, cluster) pair of
+the viewpoint, so they are evaluated once per common snapshot for every
+distinct pair and then shared by all clients (and portal cameras) standing
+there. Result is a bitset over common snapshot indexes, broadcast entities
+included; per-client flags and portal recursion are still applied by
+SV_AddEntitiesVisibleFromPoint itself.
+
+New entries are only inserted from the main thread: SV_SendClientSnapshots
+fills them for every client viewpoint before dispatching the jobs, workers
+just read the cache and evaluate any missing viewpoint into a local bitset.
+
+=============================================================================
+*/
+
+#define MAX_VIS_CACHE_ENTRIES (MAX_CLIENTS * 2)
+
+typedef struct
+{
+	int area;
+	int cluster;
+	byte visible[MAX_GENTITIES / 8];
+} visCacheEntry_t;
+
+static struct
+{
+	visCacheEntry_t entries[MAX_VIS_CACHE_ENTRIES];
+	int numEntries;
+	bool locked;	// no insertion while jobs are running
+	bool clientMask; // common snapshot contains SVF_CLIENTMASK entities
+} visCache;
+
+/*
+===============
+SV_ClearVisCache
+===============
+*/
+static void SV_ClearVisCache(void)
+{
+	visCache.numEntries = 0;
+}
+
 /*
 ===============
-SV_AddEntitiesVisibleFromPoint
+SV_ComputeVisibility
+
+Marks common snapshot entities that are broadcast or visible from the given area and cluster
 ===============
 */
-static void SV_AddEntitiesVisibleFromPoint(const vec3_t origin, clientSnapshot_t *frame,
-										   snapshotEntityNumbers_t *eNums, bool portal)
+static void SV_ComputeVisibility(int clientarea, int clientcluster, byte *visible)
 {
 	int e, i;
 	sharedEntity_t *ent;
 	svEntity_t *svEnt;
 	entityState_t *es;
 	int l;
-	int clientarea, clientcluster;
-	int leafnum;
-	byte *clientpvs;
 	byte *bitvector;
 
-	// during an error shutdown message we may need to transmit
-	// the shutdown message after the server has shutdown, so
-	// specifically check for it
-	if (sv.state == SS_DEAD)
-	{
-		return;
-	}
-
-	leafnum = CM_PointLeafnum(origin);
-	clientarea = CM_LeafArea(leafnum);
-	clientcluster = CM_LeafCluster(leafnum);
-
-	// calculate the visible areas
-	frame->areabytes = CM_WriteAreaBits(frame->areabits, clientarea);
+	Com_Memset(visible, 0, (svs.currFrame->count + 7) >> 3);
 
-	clientpvs = CM_ClusterPVS(clientcluster);
+	bitvector = CM_ClusterPVS(clientcluster);
 
 	for (e = 0; e < svs.currFrame->count; e++)
 	{
 		es = svs.currFrame->ents[e];
 		ent = SV_GentityNum(es->number);
 
-		// entities can be flagged to be sent to only one client
-		if (ent->r.svFlags & SVF_SINGLECLIENT)
-		{
-			if (ent->r.singleClient != frame->ps.clientNum)
-			{
-				continue;
-			}
-		}
-		// entities can be flagged to be sent to everyone but one client
-		if (ent->r.svFlags & SVF_NOTSINGLECLIENT)
-		{
-			if (ent->r.singleClient == frame->ps.clientNum)
-			{
-				continue;
-			}
-		}
-		// entities can be flagged to be sent to a given mask of clients
-		if (ent->r.svFlags & SVF_CLIENTMASK)
-		{
-			if (frame->ps.clientNum >= 32)
-				Com_Error(ERR_DROP, "SVF_CLIENTMASK: clientNum >= 32");
-			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
-				continue;
-		}
-
-		svEnt = &sv.svEntities[es->number];
-
-		// don't double add an entity through portals
-		if (svEnt->snapshotCounter == sv.snapshotCounter)
-		{
-			continue;
-		}
-
 		// broadcast entities are always sent
 		if (ent->r.svFlags & SVF_BROADCAST)
 		{
-			SV_AddIndexToSnapshot(svEnt, e, eNums);
+			visible[e >> 3] |= 1 << (e & 7);
 			continue;
 		}
 
+		svEnt = &sv.svEntities[es->number];
+
 		// ignore if not touching a PV leaf
 		// check area
 		if (!CM_AreasConnected(clientarea, svEnt->areanum))
@@ -436,8 +627,6 @@ static void SV_AddEntitiesVisibleFromPoint(const vec3_t origin, clientSnapshot_t
 			}
 		}
 
-		bitvector = clientpvs;
-
 		// check individual leafs
 		if (!svEnt->numClusters)
 		{
@@ -477,8 +666,165 @@ static void SV_AddEntitiesVisibleFromPoint(const vec3_t origin, clientSnapshot_t
 			}
 		}
 
+		visible[e >> 3] |= 1 << (e & 7);
+	}
+}
+
+/*
+===============
+SV_GetVisibility
+
+Returns cached visibility bitset for the viewpoint, evaluates it
+into the scratch buffer if it can't be cached
+===============
+*/
+static const byte *SV_GetVisibility(int clientarea, int clientcluster, byte *scratch)
+{
+	visCacheEntry_t *entry;
+	int i;
+
+	for (i = 0, entry = visCache.entries; i < visCache.numEntries; i++, entry++)
+	{
+		if (entry->area == clientarea && entry->cluster == clientcluster)
+		{
+			return entry->visible;
+		}
+	}
+
+	if (visCache.locked || visCache.numEntries >= MAX_VIS_CACHE_ENTRIES)
+	{
+		SV_ComputeVisibility(clientarea, clientcluster, scratch);
+		return scratch;
+	}
+
+	entry->area = clientarea;
+	entry->cluster = clientcluster;
+	SV_ComputeVisibility(clientarea, clientcluster, entry->visible);
+	visCache.numEntries++;
+
+	return entry->visible;
+}
+
+/*
+===============
+SV_PrimeVisCache
+
+Makes sure that visibility from the given point is cached
+===============
+*/
+static void SV_PrimeVisCache(const vec3_t origin)
+{
+	byte scratch[MAX_GENTITIES / 8];
+	int leafnum;
+
+	leafnum = CM_PointLeafnum(origin);
+	SV_GetVisibility(CM_LeafArea(leafnum), CM_LeafCluster(leafnum), scratch);
+}
+
+/*
+===============
+SV_AddEntitiesVisibleFromPoint
+===============
+*/
+static void SV_AddEntitiesVisibleFromPoint(const vec3_t origin, clientSnapshot_t *frame,
+										   snapshotEntityNumbers_t *eNums, bool portal)
+{
+	int e;
+	sharedEntity_t *ent;
+	entityState_t *es;
+	int clientarea, clientcluster;
+	int leafnum;
+	byte scratch[MAX_GENTITIES / 8];
+	const byte *visible;
+
+	// during an error shutdown message we may need to transmit
+	// the shutdown message after the server has shutdown, so
+	// specifically check for it
+	if (sv.state == SS_DEAD)
+	{
+		return;
+	}
+
+	leafnum = CM_PointLeafnum(origin);
+	clientarea = CM_LeafArea(leafnum);
+	clientcluster = CM_LeafCluster(leafnum);
+
+	// calculate the visible areas
+	frame->areabytes = CM_WriteAreaBits(frame->areabits, clientarea);
+
+	// entities can be flagged to be sent to a given mask of clients,
+	// this is checked regardless of their visibility
+	if (visCache.clientMask && frame->ps.clientNum >= 32)
+	{
+		for (e = 0; e < svs.currFrame->count; e++)
+		{
+			ent = SV_GentityNum(svs.currFrame->ents[e]->number);
+			if (!(ent->r.svFlags & SVF_CLIENTMASK))
+				continue;
+			if ((ent->r.svFlags & SVF_SINGLECLIENT) && ent->r.singleClient != frame->ps.clientNum)
+				continue;
+			if ((ent->r.svFlags & SVF_NOTSINGLECLIENT) && ent->r.singleClient == frame->ps.clientNum)
+				continue;
+			eNums->error = "SVF_CLIENTMASK: clientNum >= 32";
+			return;
+		}
+	}
+
+	visible = SV_GetVisibility(clientarea, clientcluster, scratch);
+
+	for (e = 0; e < svs.currFrame->count; e++)
+	{
+		// skip whole byte of invisible entities
+		if (!visible[e >> 3])
+		{
+			e |= 7;
+			continue;
+		}
+		if (!(visible[e >> 3] & (1 << (e & 7))))
+		{
+			continue;
+		}
+
+		es = svs.currFrame->ents[e];
+		ent = SV_GentityNum(es->number);
+
+		// entities can be flagged to be sent to only one client
+		if (ent->r.svFlags & SVF_SINGLECLIENT)
+		{
+			if (ent->r.singleClient != frame->ps.clientNum)
+			{
+				continue;
+			}
+		}
+		// entities can be flagged to be sent to everyone but one client
+		if (ent->r.svFlags & SVF_NOTSINGLECLIENT)
+		{
+			if (ent->r.singleClient == frame->ps.clientNum)
+			{
+				continue;
+			}
+		}
+		// entities can be flagged to be sent to a given mask of clients
+		if (ent->r.svFlags & SVF_CLIENTMASK)
+		{
+			if (~ent->r.singleClient & (1 << frame->ps.clientNum))
+				continue;
+		}
+
+		// don't double add an entity through portals
+		if (eNums->added[es->number >> 3] & (1 << (es->number & 7)))
+		{
+			continue;
+		}
+
 		// add it
-		SV_AddIndexToSnapshot(svEnt, e, eNums);
+		SV_AddIndexToSnapshot(es->number, e, eNums);
+
+		// broadcast entities are always sent
+		if (ent->r.svFlags & SVF_BROADCAST)
+		{
+			continue;
+		}
 
 		// if it's a portal entity, add everything visible from its camera position
 		if (ent->r.svFlags & SVF_PORTAL && !portal)
@@ -494,6 +840,10 @@ static void SV_AddEntitiesVisibleFromPoint(const vec3_t origin, clientSnapshot_t
 			}
 			eNums->unordered = true;
 			SV_AddEntitiesVisibleFromPoint(ent->s.origin2, frame, eNums, portal);
+			if (eNums->error)
+			{
+				return;
+			}
 		}
 	}
 
@@ -523,6 +873,12 @@ void SV_InitSnapshotStorage(void)
 	svs.lastValidFrame = 0;
 
 	svs.currFrame = NULL;
+
+	SV_ClearVisCache();
+	SV_ClearDeltaCache();
+
+	svs.deltaCacheHits = 0;
+	svs.deltaCacheMisses = 0;
 }
 
 /*
@@ -536,6 +892,9 @@ void SV_IssueNewSnapshot(void)
 {
 	svs.currFrame = NULL;
 
+	SV_ClearVisCache();
+	SV_ClearDeltaCache();
+
 	// value that clients can use even for their empty frames
 	// as it will not increment on new snapshot built
 	svs.currentSnapshotFrame = svs.snapshotFrame;
@@ -560,9 +919,16 @@ static void SV_BuildCommonSnapshot(void)
 	int index;
 	int num;
 	int i;
+	int64_t profileStart;
+
+	profileStart = SV_ProfileBegin();
 
 	count = 0;
 
+	SV_ClearVisCache();
+	SV_ClearDeltaCache();
+	visCache.clientMask = false;
+
 	// gather all linked entities
 	if (sv.state != SS_DEAD)
 	{
@@ -588,13 +954,15 @@ static void SV_BuildCommonSnapshot(void)
 				continue;
 			}
 
+			if (ent->r.svFlags & SVF_CLIENTMASK)
+			{
+				visCache.clientMask = true;
+			}
+
 			list[count++] = ent;
-			sv.svEntities[num].snapshotCounter = -1;
 		}
 	}
 
-	sv.snapshotCounter = -1;
-
 	sf = &svs.snapFrames[svs.snapshotFrame % NUM_SNAPSHOT_FRAMES];
 
 	// track last valid frame
@@ -642,6 +1010,33 @@ static void SV_BuildCommonSnapshot(void)
 		svs.snapshotEntities[index] = list[i]->s;
 		sf->ents[i] = &svs.snapshotEntities[index];
 	}
+
+	SV_ProfileEnd(SVP_COMMON_SNAPSHOT, profileStart);
+}
+
+/*
+=============
+SV_NeedsCommonSnapshot
+
+Returns true if SV_BuildClientSnapshot will refer to the common snapshot
+=============
+*/
+static bool SV_NeedsCommonSnapshot(const client_t *client)
+{
+	int clientNum;
+
+	if (client->state == CS_ZOMBIE || !client->gentity)
+	{
+		return false;
+	}
+
+	clientNum = SV_GameClientNum(client - svs.clients)->clientNum;
+	if (clientNum < 0 || clientNum >= MAX_GENTITIES)
+	{
+		return false;
+	}
+
+	return true;
 }
 
 /*
@@ -655,15 +1050,18 @@ This properly handles multiple recursive portals, but the render
 currently doesn't.
 
 For viewing through other player's eyes, clent can be something other than client->gentity
+
+Returns error message that should be raised by the caller, or NULL on success.
+Can be executed on worker threads, in this case the common snapshot must be
+already built by the main thread.
 =============
 */
-static void SV_BuildClientSnapshot(client_t *client)
+static const char *SV_BuildClientSnapshot(client_t *client)
 {
 	vec3_t org;
 	clientSnapshot_t *frame;
 	snapshotEntityNumbers_t entityNumbers;
 	int i, cl;
-	svEntity_t *svEnt;
 	int clientNum;
 	playerState_t *ps;
 
@@ -680,7 +1078,7 @@ static void SV_BuildClientSnapshot(client_t *client)
 	frame->frameNum = svs.currentSnapshotFrame;
 
 	if (client->state == CS_ZOMBIE)
-		return;
+		return NULL;
 
 	// grab the current playerState_t
 	ps = SV_GameClientNum(cl);
@@ -689,7 +1087,7 @@ static void SV_BuildClientSnapshot(client_t *client)
 	clientNum = frame->ps.clientNum;
 	if (clientNum < 0 || clientNum >= MAX_GENTITIES)
 	{
-		Com_Error(ERR_DROP, "SV_SvEntityForGentity: bad gEnt");
+		return "SV_SvEntityForGentity: bad gEnt";
 	}
 
 	// we set client->gentity only after sending gamestate
@@ -697,7 +1095,7 @@ static void SV_BuildClientSnapshot(client_t *client)
 	// because new gamestate will invalidate them anyway
 	if (!client->gentity)
 	{
-		return;
+		return NULL;
 	}
 
 	if (svs.currFrame == NULL)
@@ -706,18 +1104,16 @@ static void SV_BuildClientSnapshot(client_t *client)
 		SV_BuildCommonSnapshot();
 	}
 
-	// bump the counter used to prevent double adding
-	sv.snapshotCounter++;
-
 	// empty entities before visibility check
 	entityNumbers.numSnapshotEntities = 0;
+	entityNumbers.error = NULL;
+	Com_Memset(entityNumbers.added, 0, sizeof(entityNumbers.added));
 
 	frame->frameNum = svs.currFrame->frameNum;
 
 	// never send client's own entity, because it can
 	// be regenerated from the playerstate
-	svEnt = &sv.svEntities[clientNum];
-	svEnt->snapshotCounter = sv.snapshotCounter;
+	entityNumbers.added[clientNum >> 3] |= 1 << (clientNum & 7);
 
 	// find the client's viewpoint
 	VectorCopy(ps->origin, org);
@@ -728,6 +1124,11 @@ static void SV_BuildClientSnapshot(client_t *client)
 	entityNumbers.unordered = false;
 	SV_AddEntitiesVisibleFromPoint(org, frame, &entityNumbers, false);
 
+	if (entityNumbers.error)
+	{
+		return entityNumbers.error;
+	}
+
 	// if there were portals visible, there may be out of order entities
 	// in the list which will need to be resorted for the delta compression
 	// to work correctly.  This also catches the error condition
@@ -751,6 +1152,8 @@ static void SV_BuildClientSnapshot(client_t *client)
 	{
 		frame->ents[i] = svs.currFrame->ents[entityNumbers.snapshotEntities[i]];
 	}
+
+	return NULL;
 }
 
 /*
@@ -762,13 +1165,38 @@ Called by SV_SendClientSnapshot and SV_SendClientGameState
 */
 void SV_SendMessageToClient(msg_t *msg, client_t *client)
 {
+	int64_t profileStart;
+
 	// record information about the message
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSize = msg->cursize;
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageSent = svs.msgTime;
 	client->frames[client->netchan.outgoingSequence & PACKET_MASK].messageAcked = 0;
 
 	// send the datagram
+	profileStart = SV_ProfileBegin();
 	SV_Netchan_Transmit(client, msg);
+	SV_ProfileEnd(SVP_NETCHAN, profileStart);
+}
+
+/*
+=======================
+SV_WriteClientMessage
+
+Writes acknowledge, pending reliable commands and the snapshot itself
+=======================
+*/
+static void SV_WriteClientMessage(const client_t *client, const clientSnapshot_t *oldframe, int lastframe, msg_t *msg)
+{
+	// NOTE, MRE: all server->client messages now acknowledge
+	// let the client know which reliable clientCommands we have received
+	MSG_WriteLong(msg, client->lastClientCommand);
+
+	// (re)send any reliable server commands
+	SV_UpdateServerCommandsToClient(client, msg);
+
+	// send over all the relevant entityState_t
+	// and the playerState_t
+	SV_WriteSnapshotToClient(client, oldframe, lastframe, msg);
 }
 
 /*
@@ -782,10 +1210,17 @@ Also called by SV_FinalMessage
 void SV_SendClientSnapshot(client_t *client)
 {
 	byte msg_buf[MAX_MSGLEN_BUF];
+	const clientSnapshot_t *oldframe;
+	const char *error;
+	int lastframe;
 	msg_t msg;
 
 	// build the snapshot
-	SV_BuildClientSnapshot(client);
+	error = SV_BuildClientSnapshot(client);
+	if (error)
+	{
+		Com_Error(ERR_DROP, "%s", error);
+	}
 
 	// bots need to have their snapshots build, but
 	// the query them directly without needing to be sent
@@ -797,16 +1232,9 @@ void SV_SendClientSnapshot(client_t *client)
 	MSG_Init(&msg, msg_buf, MAX_MSGLEN);
 	msg.allowoverflow = true;
 
-	// NOTE, MRE: all server->client messages now acknowledge
-	// let the client know which reliable clientCommands we have received
-	MSG_WriteLong(&msg, client->lastClientCommand);
+	oldframe = SV_SelectDeltaFrame(client, &lastframe);
 
-	// (re)send any reliable server commands
-	SV_UpdateServerCommandsToClient(client, &msg);
-
-	// send over all the relevant entityState_t
-	// and the playerState_t
-	SV_WriteSnapshotToClient(client, &msg);
+	SV_WriteClientMessage(client, oldframe, lastframe, &msg);
 
 	// check for overflow
 	if (msg.overflowed)
@@ -818,6 +1246,157 @@ void SV_SendClientSnapshot(client_t *client)
 	SV_SendMessageToClient(&msg, client);
 }
 
+/*
+=============================================================================
+
+Parallel snapshot generation
+
+Common snapshot and delta sources are selected on the main thread in client
+order, exactly as the serial path would do it, then visibility checks and
+encoding run on the job threads, each one writing into its own message buffer.
+Netchan transmission stays on the main thread and in client order, so the
+resulting packets are identical to the serial path.
+
+=============================================================================
+*/
+
+typedef struct
+{
+	client_t *client;
+	const clientSnapshot_t *oldframe;
+	int lastframe;
+	const char *error;
+	msg_t msg;
+	byte msgBuf[MAX_MSGLEN_BUF];
+} snapshotJob_t;
+
+static snapshotJob_t snapshotJobs[MAX_CLIENTS];
+
+/*
+=======================
+SV_PrimeClientVisibility
+
+Caches visibility for the client viewpoints known in advance
+=======================
+*/
+static void SV_PrimeClientVisibility(const client_t *client)
+{
+	const playerState_t *ps;
+	const sharedEntity_t *ent;
+	vec3_t org;
+
+	if (sv.state == SS_DEAD)
+	{
+		return;
+	}
+
+	ps = SV_GameClientNum(client - svs.clients);
+
+	// same viewpoint as in SV_BuildClientSnapshot
+	VectorCopy(ps->origin, org);
+	org[2] += ps->viewheight;
+	SV_PrimeVisCache(org);
+
+	ent = SV_GentityNum(ps->clientNum);
+	if (ent->r.svFlags & SVF_SELF_PORTAL2)
+	{
+		SV_PrimeVisCache(ent->r.s.origin2);
+	}
+}
+
+/*
+=======================
+SV_SnapshotJob
+=======================
+*/
+static void SV_SnapshotJob(void *data, int index)
+{
+	snapshotJob_t *job = (snapshotJob_t *)data + index;
+
+	job->error = SV_BuildClientSnapshot(job->client);
+	if (job->error || job->client->netchan.remoteAddress.type == NA_BOT)
+	{
+		return;
+	}
+
+	MSG_Init(&job->msg, job->msgBuf, MAX_MSGLEN);
+	job->msg.allowoverflow = true;
+
+	SV_WriteClientMessage(job->client, job->oldframe, job->lastframe, &job->msg);
+}
+
+/*
+=======================
+SV_SendClientSnapshots
+
+Builds and encodes snapshots for the given clients in parallel
+=======================
+*/
+static void SV_SendClientSnapshots(client_t **clients, int count)
+{
+	snapshotJob_t *job;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		job = &snapshotJobs[i];
+		job->client = clients[i];
+		job->error = NULL;
+
+		// build the common snapshot at the same point as the serial path
+		if (svs.currFrame == NULL && SV_NeedsCommonSnapshot(job->client))
+		{
+			SV_BuildCommonSnapshot();
+		}
+
+		if (job->client->netchan.remoteAddress.type != NA_BOT)
+		{
+			job->oldframe = SV_SelectDeltaFrame(job->client, &job->lastframe);
+		}
+
+		if (svs.currFrame && SV_NeedsCommonSnapshot(job->client))
+		{
+			SV_PrimeClientVisibility(job->client);
+		}
+	}
+
+	// lives until process exit
+	if (!deltaCache.mutex)
+	{
+		deltaCache.mutex = Sys_CreateMutex();
+	}
+
+	visCache.locked = true;
+	deltaCache.jobs = true;
+	Com_ParallelFor(SV_SnapshotJob, snapshotJobs, count);
+	deltaCache.jobs = false;
+	visCache.locked = false;
+
+	for (i = 0; i < count; i++)
+	{
+		job = &snapshotJobs[i];
+
+		if (job->error)
+		{
+			Com_Error(ERR_DROP, "%s", job->error);
+		}
+
+		if (job->client->netchan.remoteAddress.type != NA_BOT)
+		{
+			if (job->msg.overflowed)
+			{
+				Com_Printf("WARNING: msg overflowed for %s\n", job->client->name);
+				MSG_Clear(&job->msg);
+			}
+
+			SV_SendMessageToClient(&job->msg, job->client);
+		}
+
+		job->client->lastSnapshotTime = svs.time;
+		job->client->rateDelayed = false;
+	}
+}
+
 /*
 =======================
 SV_SendClientMessages
@@ -825,11 +1404,19 @@ SV_SendClientMessages
 */
 void SV_SendClientMessages(void)
 {
+	client_t *clients[MAX_CLIENTS];
+	int numClients;
 	int i;
 	client_t *c;
+	int64_t profileStart;
 
 	svs.msgTime = Sys_Milliseconds();
 
+	// collect datagrams of the whole frame for a single send call
+	Sys_BeginPacketBatch();
+
+	numClients = 0;
+
 	// send a message to each connected client
 	for (i = 0; i < sv.maxclients; i++)
 	{
@@ -866,9 +1453,27 @@ void SV_SendClientMessages(void)
 			continue;
 		}
 
+		if (sv_parallelSnapshots->integer)
+		{
+			// collect them for parallel generation
+			clients[numClients++] = c;
+			continue;
+		}
+
 		// generate and send a new message
+		profileStart = SV_ProfileBegin();
 		SV_SendClientSnapshot(c);
+		SV_ProfileEnd(SVP_SNAPSHOTS, profileStart);
 		c->lastSnapshotTime = svs.time;
 		c->rateDelayed = false;
 	}
+
+	if (numClients)
+	{
+		profileStart = SV_ProfileBegin();
+		SV_SendClientSnapshots(clients, numClients);
+		SV_ProfileEnd(SVP_SNAPSHOTS, profileStart);
+	}
+
+	Sys_EndPacketBatch();
 }
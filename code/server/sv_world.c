@@ -58,6 +58,12 @@ the world is carved up with an evenly spaced, axially aligned bsp tree.  Entitie
 are kept in chains either at the final leafs, or at the first node that splits
 them, which prevents having to deal with multiple fragments of a single entity.
 
+With sv_worldIndex 1 a hierarchical loose grid is used instead: every level
+halves the number of cells per axis, an entity is kept in the cell of its
+center on the finest level where the cell is at least as large as the entity,
+so big chains can't build up in a few upper nodes.  Queries visit cells
+extended by half the cell size on each level.
+
 ===============================================================================
 */
 
@@ -74,6 +80,77 @@ typedef struct worldSector_s {
 static worldSector_t	sv_worldSectors[AREA_NODES];
 static int			sv_numworldSectors;
 
+#define GRID_LEVELS		7	// 64x64 .. 1x1 cells
+#define GRID_SIZE		(1<<(GRID_LEVELS-1))
+#define GRID_CELLS		((GRID_SIZE*GRID_SIZE*4-1)/3)
+
+typedef struct {
+	int			size;		// cells per axis
+	float		cellSize;
+	float		invCellSize;
+	worldSector_t *cells;	// [size*size]
+} gridLevel_t;
+
+static struct {
+	int			index;		// sv_worldIndex value at level start
+	vec2_t		origin;
+	gridLevel_t	levels[GRID_LEVELS];
+	worldSector_t cells[GRID_CELLS];
+} sv_grid;
+
+#define AREA_HISTOGRAM	12	// 0, 1, 2-3, ... 1024+
+
+// 64-bit, a long running map sees billions of queries
+static struct {
+	int64_t	queries;
+	int64_t	sectors[AREA_HISTOGRAM];	// visited sectors per query
+	int64_t	checks[AREA_HISTOGRAM];		// tested entities per query
+	int64_t	links;
+	int64_t	relinks;					// sector changed
+} sv_areaStats;
+
+
+/*
+===============
+SV_HistogramBucket
+===============
+*/
+static int SV_HistogramBucket( int count ) {
+	int bucket;
+
+	for ( bucket = 0; count > 0 && bucket < AREA_HISTOGRAM - 1; bucket++ ) {
+		count >>= 1;
+	}
+
+	return bucket;
+}
+
+
+/*
+===============
+SV_NumSectors
+===============
+*/
+static int SV_NumSectors( void ) {
+	if ( sv_grid.index ) {
+		return GRID_CELLS;
+	}
+	return AREA_NODES;
+}
+
+
+/*
+===============
+SV_Sector
+===============
+*/
+static worldSector_t *SV_Sector( int num ) {
+	if ( sv_grid.index ) {
+		return &sv_grid.cells[ num ];
+	}
+	return &sv_worldSectors[ num ];
+}
+
 
 /*
 ===============
@@ -85,17 +162,80 @@ void SV_SectorList_f( void ) {
 	worldSector_t	*sec;
 	svEntity_t		*ent;
 
-	for ( i = 0 ; i < AREA_NODES ; i++ ) {
-		sec = &sv_worldSectors[i];
+	for ( i = 0 ; i < SV_NumSectors() ; i++ ) {
+		sec = SV_Sector( i );
 
 		c = 0;
 		for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
 			c++;
 		}
+		// there are thousands of grid cells
+		if ( !c && sv_grid.index ) {
+			continue;
+		}
 		Com_Printf( "sector %i: %i entities\n", i, c );
 	}
 }
 
+
+/*
+===============
+SV_SectorStats_f
+===============
+*/
+void SV_SectorStats_f( void ) {
+	int				i, c, used, linked, longest;
+	worldSector_t	*sec;
+	svEntity_t		*ent;
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "reset" ) ) {
+		Com_Memset( &sv_areaStats, 0, sizeof( sv_areaStats ) );
+		return;
+	}
+
+	used = linked = longest = 0;
+	for ( i = 0 ; i < SV_NumSectors() ; i++ ) {
+		sec = SV_Sector( i );
+		c = 0;
+		for ( ent = sec->entities ; ent ; ent = ent->nextEntityInWorldSector ) {
+			c++;
+		}
+		if ( c ) {
+			used++;
+			linked += c;
+		}
+		if ( c > longest ) {
+			longest = c;
+		}
+	}
+
+	Com_Printf( "index: %s\n", sv_grid.index ? "loose grid" : "sector tree" );
+	Com_Printf( "%i entities in %i of %i sectors, longest chain %i\n", linked, used, SV_NumSectors(), longest );
+	Com_Printf( "%.0f links, %.0f moved to another sector\n", (double)sv_areaStats.links, (double)sv_areaStats.relinks );
+	Com_Printf( "%.0f queries\n", (double)sv_areaStats.queries );
+
+	if ( !sv_areaStats.queries ) {
+		return;
+	}
+
+	Com_Printf( "     count   sectors  entities\n" );
+	for ( i = 0; i < AREA_HISTOGRAM; i++ ) {
+		if ( i == 0 ) {
+			Com_Printf( "%10s", "0" );
+		} else if ( i == AREA_HISTOGRAM - 1 ) {
+			Com_Printf( "%9i+", 1 << ( i - 1 ) );
+		} else if ( i == 1 ) {
+			Com_Printf( "%10s", "1" );
+		} else {
+			Com_Printf( "%10s", va( "%i-%i", 1 << ( i - 1 ), ( 1 << i ) - 1 ) );
+		}
+		Com_Printf( " %8.2f%% %8.2f%%\n",
+			sv_areaStats.sectors[i] * 100.0 / sv_areaStats.queries,
+			sv_areaStats.checks[i] * 100.0 / sv_areaStats.queries );
+	}
+}
+
+
 /*
 ===============
 SV_CreateworldSector
@@ -138,6 +278,91 @@ static worldSector_t *SV_CreateworldSector( int depth, vec3_t mins, vec3_t maxs
 	return anode;
 }
 
+
+/*
+===============
+SV_CreateGrid
+===============
+*/
+static void SV_CreateGrid( const vec3_t mins, const vec3_t maxs ) {
+	gridLevel_t	*level;
+	worldSector_t *cells;
+	float		extent;
+	int			i;
+
+	Com_Memset( sv_grid.cells, 0, sizeof( sv_grid.cells ) );
+
+	extent = MAX( maxs[0] - mins[0], maxs[1] - mins[1] );
+	if ( extent < GRID_SIZE ) {
+		extent = GRID_SIZE;
+	}
+
+	sv_grid.origin[0] = mins[0];
+	sv_grid.origin[1] = mins[1];
+
+	cells = sv_grid.cells;
+	for ( i = 0, level = sv_grid.levels; i < GRID_LEVELS; i++, level++ ) {
+		level->size = GRID_SIZE >> i;
+		level->cellSize = extent / level->size;
+		level->invCellSize = 1.0f / level->cellSize;
+		level->cells = cells;
+		cells += level->size * level->size;
+	}
+
+	for ( i = 0; i < GRID_CELLS; i++ ) {
+		sv_grid.cells[i].axis = -1;
+	}
+}
+
+
+/*
+===============
+SV_GridCoord
+
+Cell coordinate along an axis, clamped to the grid
+===============
+*/
+static int SV_GridCoord( const gridLevel_t *level, float v, int axis ) {
+	int c;
+
+	c = (int)floorf( ( v - sv_grid.origin[axis] ) * level->invCellSize );
+	if ( c < 0 ) {
+		return 0;
+	}
+	if ( c >= level->size ) {
+		return level->size - 1;
+	}
+
+	return c;
+}
+
+
+/*
+===============
+SV_GridSector
+===============
+*/
+static worldSector_t *SV_GridSector( const vec3_t absmin, const vec3_t absmax ) {
+	const gridLevel_t *level;
+	float	extent;
+	int		i, x, y;
+
+	extent = MAX( absmax[0] - absmin[0], absmax[1] - absmin[1] );
+
+	// largest level takes everything
+	for ( i = 0, level = sv_grid.levels; i < GRID_LEVELS - 1; i++, level++ ) {
+		if ( extent <= level->cellSize ) {
+			break;
+		}
+	}
+
+	x = SV_GridCoord( level, ( absmin[0] + absmax[0] ) * 0.5f, 0 );
+	y = SV_GridCoord( level, ( absmin[1] + absmax[1] ) * 0.5f, 1 );
+
+	return &level->cells[ y * level->size + x ];
+}
+
+
 /*
 ===============
 SV_ClearWorld
@@ -151,10 +376,17 @@ void SV_ClearWorld( void ) {
 	Com_Memset( sv_worldSectors, 0, sizeof(sv_worldSectors) );
 	sv_numworldSectors = 0;
 
+	Com_Memset( &sv_areaStats, 0, sizeof( sv_areaStats ) );
+
 	// get world map bounds
 	h = CM_InlineModel( 0 );
 	CM_ModelBounds( h, mins, maxs );
 	SV_CreateworldSector( 0, mins, maxs );
+
+	sv_grid.index = sv_worldIndex->integer;
+	if ( sv_grid.index ) {
+		SV_CreateGrid( mins, maxs );
+	}
 }
 
 
@@ -212,10 +444,14 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	int			lastLeaf;
 	float		*origin, *angles;
 	svEntity_t	*ent;
+	worldSector_t *oldSector;
 
 	ent = SV_SvEntityForGentity( gEnt );
 
-	if ( ent->worldSector ) {
+	oldSector = ent->worldSector;
+
+	// grid keeps entities that stay in the same cell where they are
+	if ( ent->worldSector && !sv_grid.index ) {
 		SV_UnlinkEntity( gEnt );	// unlink from old position
 	}
 
@@ -291,6 +527,9 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 	// if none of the leafs were inside the map, the
 	// entity is outside the world and can be considered unlinked
 	if ( !num_leafs ) {
+		if ( ent->worldSector ) {
+			SV_UnlinkEntity( gEnt );
+		}
 		return;
 	}
 
@@ -332,24 +571,39 @@ void SV_LinkEntity( sharedEntity_t *gEnt ) {
 
 	gEnt->r.linkcount++;
 
-	// find the first world sector node that the ent's box crosses
-	node = sv_worldSectors;
-	while (1)
-	{
-		if (node->axis == -1)
-			break;
-		if ( gEnt->r.absmin[node->axis] > node->dist)
-			node = node->children[0];
-		else if ( gEnt->r.absmax[node->axis] < node->dist)
-			node = node->children[1];
-		else
-			break;		// crosses the node
+	if ( sv_grid.index ) {
+		node = SV_GridSector( gEnt->r.absmin, gEnt->r.absmax );
+	} else {
+		// find the first world sector node that the ent's box crosses
+		node = sv_worldSectors;
+		while (1)
+		{
+			if (node->axis == -1)
+				break;
+			if ( gEnt->r.absmin[node->axis] > node->dist)
+				node = node->children[0];
+			else if ( gEnt->r.absmax[node->axis] < node->dist)
+				node = node->children[1];
+			else
+				break;		// crosses the node
+		}
+	}
+
+	sv_areaStats.links++;
+	if ( oldSector && oldSector != node ) {
+		sv_areaStats.relinks++;
+	}
+
+	if ( ent->worldSector != node ) {
+		if ( ent->worldSector ) {
+			SV_UnlinkEntity( gEnt );
+		}
+
+		// link it in
+		ent->worldSector = node;
+		ent->nextEntityInWorldSector = node->entities;
+		node->entities = ent;
 	}
-	
-	// link it in
-	ent->worldSector = node;
-	ent->nextEntityInWorldSector = node->entities;
-	node->entities = ent;
 
 	gEnt->r.linked = true;
 }
@@ -369,24 +623,31 @@ typedef struct {
 	const float	*maxs;
 	int			*list;
 	int			count, maxcount;
+	int			sectors;	// for statistics
+	int			checks;
 } areaParms_t;
 
 
 /*
 ====================
-SV_AreaEntities_r
+SV_AreaEntitiesInSector
 
+Returns false if the list is full
 ====================
 */
-static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
+static bool SV_AreaEntitiesInSector( const worldSector_t *node, areaParms_t *ap ) {
 	svEntity_t	*check, *next;
 	sharedEntity_t *gcheck;
 
+	ap->sectors++;
+
 	for ( check = node->entities  ; check ; check = next ) {
 		next = check->nextEntityInWorldSector;
 
 		gcheck = SV_GEntityForSvEntity( check );
 
+		ap->checks++;
+
 		if ( gcheck->r.absmin[0] > ap->maxs[0]
 		|| gcheck->r.absmin[1] > ap->maxs[1]
 		|| gcheck->r.absmin[2] > ap->maxs[2]
@@ -398,13 +659,28 @@ static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 
 		if ( ap->count == ap->maxcount ) {
 			Com_Printf ("SV_AreaEntities: MAXCOUNT\n");
-			return;
+			return false;
 		}
 
 		ap->list[ap->count] = check - sv.svEntities;
 		ap->count++;
 	}
-	
+
+	return true;
+}
+
+
+/*
+====================
+SV_AreaEntities_r
+
+====================
+*/
+static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
+	if ( !SV_AreaEntitiesInSector( node, ap ) ) {
+		return;
+	}
+
 	if (node->axis == -1) {
 		return;		// terminal node
 	}
@@ -418,6 +694,37 @@ static void SV_AreaEntities_r( worldSector_t *node, areaParms_t *ap ) {
 	}
 }
 
+/*
+====================
+SV_AreaEntitiesGrid
+
+====================
+*/
+static void SV_AreaEntitiesGrid( areaParms_t *ap ) {
+	const gridLevel_t *level;
+	float	margin;
+	int		i, x, y;
+	int		x0, x1, y0, y1;
+
+	for ( i = 0, level = sv_grid.levels; i < GRID_LEVELS; i++, level++ ) {
+		// entities may stick out of their cells by half cell size
+		margin = level->cellSize * 0.5f;
+		x0 = SV_GridCoord( level, ap->mins[0] - margin, 0 );
+		x1 = SV_GridCoord( level, ap->maxs[0] + margin, 0 );
+		y0 = SV_GridCoord( level, ap->mins[1] - margin, 1 );
+		y1 = SV_GridCoord( level, ap->maxs[1] + margin, 1 );
+
+		for ( y = y0; y <= y1; y++ ) {
+			for ( x = x0; x <= x1; x++ ) {
+				if ( !SV_AreaEntitiesInSector( &level->cells[ y * level->size + x ], ap ) ) {
+					return;
+				}
+			}
+		}
+	}
+}
+
+
 /*
 ================
 SV_AreaEntities
@@ -431,8 +738,18 @@ int SV_AreaEntities( const vec3_t mins, const vec3_t maxs, int *entityList, int
 	ap.list = entityList;
 	ap.count = 0;
 	ap.maxcount = maxcount;
+	ap.sectors = 0;
+	ap.checks = 0;
 
-	SV_AreaEntities_r( sv_worldSectors, &ap );
+	if ( sv_grid.index ) {
+		SV_AreaEntitiesGrid( &ap );
+	} else {
+		SV_AreaEntities_r( sv_worldSectors, &ap );
+	}
+
+	sv_areaStats.queries++;
+	sv_areaStats.sectors[ SV_HistogramBucket( ap.sectors ) ]++;
+	sv_areaStats.checks[ SV_HistogramBucket( ap.checks ) ]++;
 
 	return ap.count;
 }
@@ -504,9 +821,8 @@ SV_ClipMoveToEntities
 
 ====================
 */
-static void SV_ClipMoveToEntities( moveclip_t *clip ) {
-	int			i, num;
-	int			touchlist[MAX_GENTITIES];
+static void SV_ClipMoveToEntities( moveclip_t *clip, const int *touchlist, int num ) {
+	int			i;
 	sharedEntity_t *touch;
 	int			passOwnerNum;
 	trace_t		trace;
@@ -514,8 +830,6 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 	float		*origin;
 	const float *angles;
 
-	num = SV_AreaEntities( clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES);
-
 	if ( clip->passEntityNum != ENTITYNUM_NONE ) {
 		passOwnerNum = ( SV_GentityNum( clip->passEntityNum ) )->r.ownerNum;
 		if ( passOwnerNum == ENTITYNUM_NONE ) {
@@ -589,14 +903,13 @@ static void SV_ClipMoveToEntities( moveclip_t *clip ) {
 
 /*
 ==================
-SV_Trace
+SV_ClipMoveToWorld
 
-Moves the given mins/maxs volume through the world from start to end.
-passEntityNum and entities owned by passEntityNum are explicitly not checked.
+Clips the move against the world and sets up the entity pass,
+returns false if the move was blocked immediately by the world
 ==================
 */
-void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, bool capsule ) {
-	moveclip_t	clip;
+static bool SV_ClipMoveToWorld( moveclip_t *clip, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, bool capsule ) {
 	int			i;
 
 	if ( !mins ) {
@@ -606,24 +919,23 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 		maxs = vec3_origin;
 	}
 
-	Com_Memset ( &clip, 0, sizeof ( clip ) );
+	Com_Memset ( clip, 0, sizeof ( *clip ) );
 
 	// clip to world
-	CM_BoxTrace( &clip.trace, start, end, mins, maxs, 0, contentmask, capsule );
-	clip.trace.entityNum = clip.trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
-	if ( clip.trace.fraction == 0 ) {
-		*results = clip.trace;
-		return;		// blocked immediately by the world
-	}
-
-	clip.contentmask = contentmask;
-	clip.start = start;
-//	VectorCopy( clip.trace.endpos, clip.end );
-	VectorCopy( end, clip.end );
-	clip.mins = mins;
-	clip.maxs = maxs;
-	clip.passEntityNum = passEntityNum;
-	clip.capsule = capsule;
+	CM_BoxTrace( &clip->trace, start, end, mins, maxs, 0, contentmask, capsule );
+	clip->trace.entityNum = clip->trace.fraction != 1.0 ? ENTITYNUM_WORLD : ENTITYNUM_NONE;
+	if ( clip->trace.fraction == 0 ) {
+		return false;		// blocked immediately by the world
+	}
+
+	clip->contentmask = contentmask;
+	clip->start = start;
+//	VectorCopy( clip->trace.endpos, clip->end );
+	VectorCopy( end, clip->end );
+	clip->mins = mins;
+	clip->maxs = maxs;
+	clip->passEntityNum = passEntityNum;
+	clip->capsule = capsule;
 
 	// create the bounding box of the entire move
 	// we can limit it to the part of the move not
@@ -631,21 +943,205 @@ void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const ve
 	// a significant savings for line of sight and shot traces
 	for ( i=0 ; i<3 ; i++ ) {
 		if ( end[i] > start[i] ) {
-			clip.boxmins[i] = clip.start[i] + clip.mins[i] - 1;
-			clip.boxmaxs[i] = clip.end[i] + clip.maxs[i] + 1;
+			clip->boxmins[i] = clip->start[i] + clip->mins[i] - 1;
+			clip->boxmaxs[i] = clip->end[i] + clip->maxs[i] + 1;
 		} else {
-			clip.boxmins[i] = clip.end[i] + clip.mins[i] - 1;
-			clip.boxmaxs[i] = clip.start[i] + clip.maxs[i] + 1;
+			clip->boxmins[i] = clip->end[i] + clip->mins[i] - 1;
+			clip->boxmaxs[i] = clip->start[i] + clip->maxs[i] + 1;
 		}
 	}
 
-	// clip to other solid entities
-	SV_ClipMoveToEntities ( &clip );
+	return true;
+}
+
+
+/*
+==================
+SV_Trace
+
+Moves the given mins/maxs volume through the world from start to end.
+passEntityNum and entities owned by passEntityNum are explicitly not checked.
+==================
+*/
+void SV_Trace( trace_t *results, const vec3_t start, const vec3_t mins, const vec3_t maxs, const vec3_t end, int passEntityNum, int contentmask, bool capsule ) {
+	moveclip_t	clip;
+	trace_t		world;
+	int			touchlist[MAX_GENTITIES];
+	int			num;
+	bool		open;
+
+	open = SV_ClipMoveToWorld( &clip, start, mins, maxs, end, passEntityNum, contentmask, capsule );
+	if ( cm_capturing ) {
+		world = clip.trace;
+	}
+
+	if ( open ) {
+		// clip to other solid entities
+		num = SV_AreaEntities( clip.boxmins, clip.boxmaxs, touchlist, MAX_GENTITIES );
+		SV_ClipMoveToEntities( &clip, touchlist, num );
+	}
+
+	if ( cm_capturing ) {
+		CM_CaptureTrace( start, end, mins, maxs, passEntityNum, contentmask, capsule, &world, &clip.trace );
+	}
 
 	*results = clip.trace;
 }
 
 
+/*
+============================================================================
+
+BATCHED TRACES
+
+Consecutive moves that lie close to each other share a single area query,
+every move then picks the entities that intersect its own bounds from the
+shared list. Both area query variants return entities in an order that
+does not depend on the query bounds so the per-move lists are exactly the
+ones SV_AreaEntities() would have returned and results match SV_Trace().
+============================================================================
+*/
+
+#define TRACE_GROUP_SIZE	32		// max moves sharing an area query
+#define TRACE_GROUP_SLACK	512		// max growth of shared bounds over the largest move
+
+typedef struct {
+	moveclip_t	clips[ TRACE_GROUP_SIZE ];
+	trace_t		*results[ TRACE_GROUP_SIZE ];
+	int			numClips;
+	vec3_t		mins, maxs;			// bounds of all moves in the group
+	vec3_t		extents;			// largest move extents
+} traceGroup_t;
+
+
+/*
+==================
+SV_FlushTraceGroup
+==================
+*/
+static void SV_FlushTraceGroup( traceGroup_t *group ) {
+	int			touchlist[MAX_GENTITIES];
+	int			cliplist[MAX_GENTITIES];
+	const sharedEntity_t *check;
+	moveclip_t	*clip;
+	int			i, j, num, count;
+
+	if ( group->numClips == 0 ) {
+		return;
+	}
+
+	clip = group->clips;
+
+	if ( group->numClips == 1 ) {
+		num = SV_AreaEntities( clip->boxmins, clip->boxmaxs, touchlist, MAX_GENTITIES );
+		SV_ClipMoveToEntities( clip, touchlist, num );
+		*group->results[0] = clip->trace;
+		group->numClips = 0;
+		return;
+	}
+
+	num = SV_AreaEntities( group->mins, group->maxs, touchlist, MAX_GENTITIES );
+
+	for ( i = 0; i < group->numClips; i++, clip++ ) {
+		count = 0;
+		for ( j = 0; j < num; j++ ) {
+			check = SV_GentityNum( touchlist[j] );
+			if ( check->r.absmin[0] > clip->boxmaxs[0]
+			|| check->r.absmin[1] > clip->boxmaxs[1]
+			|| check->r.absmin[2] > clip->boxmaxs[2]
+			|| check->r.absmax[0] < clip->boxmins[0]
+			|| check->r.absmax[1] < clip->boxmins[1]
+			|| check->r.absmax[2] < clip->boxmins[2] ) {
+				continue;
+			}
+			cliplist[ count++ ] = touchlist[j];
+		}
+		SV_ClipMoveToEntities( clip, cliplist, count );
+		*group->results[i] = clip->trace;
+	}
+
+	group->numClips = 0;
+}
+
+
+/*
+==================
+SV_AddToTraceGroup
+
+Returns false if the move is too far from the moves already in the group
+==================
+*/
+static bool SV_AddToTraceGroup( traceGroup_t *group, const moveclip_t *clip, trace_t *results ) {
+	vec3_t		mins, maxs, extents;
+	int			i;
+
+	if ( group->numClips == 0 ) {
+		VectorCopy( clip->boxmins, group->mins );
+		VectorCopy( clip->boxmaxs, group->maxs );
+		VectorSubtract( clip->boxmaxs, clip->boxmins, group->extents );
+	} else {
+		if ( group->numClips == TRACE_GROUP_SIZE ) {
+			return false;
+		}
+		for ( i = 0; i < 3; i++ ) {
+			mins[i] = MIN( group->mins[i], clip->boxmins[i] );
+			maxs[i] = MAX( group->maxs[i], clip->boxmaxs[i] );
+			extents[i] = MAX( group->extents[i], clip->boxmaxs[i] - clip->boxmins[i] );
+			if ( maxs[i] - mins[i] > extents[i] + TRACE_GROUP_SLACK ) {
+				return false;
+			}
+		}
+		VectorCopy( mins, group->mins );
+		VectorCopy( maxs, group->maxs );
+		VectorCopy( extents, group->extents );
+	}
+
+	group->clips[ group->numClips ] = *clip;
+	group->results[ group->numClips ] = results;
+	group->numClips++;
+
+	return true;
+}
+
+
+/*
+==================
+SV_TraceBatch
+
+Same as calling SV_Trace() for each request
+==================
+*/
+void SV_TraceBatch( const traceRequest_t *requests, trace_t *results, int count ) {
+	traceGroup_t group;
+	moveclip_t	clip;
+	int			i;
+
+	// capture every move the way SV_Trace() sees it
+	if ( cm_capturing ) {
+		for ( i = 0; i < count; i++ ) {
+			SV_Trace( &results[i], requests[i].start, requests[i].mins, requests[i].maxs, requests[i].end,
+				requests[i].passEntityNum, requests[i].contentmask, requests[i].capsule ? true : false );
+		}
+		return;
+	}
+
+	group.numClips = 0;
+
+	for ( i = 0; i < count; i++, requests++, results++ ) {
+		if ( !SV_ClipMoveToWorld( &clip, requests->start, requests->mins, requests->maxs, requests->end,
+			requests->passEntityNum, requests->contentmask, requests->capsule ? true : false ) ) {
+			*results = clip.trace;
+			continue;
+		}
+		if ( !SV_AddToTraceGroup( &group, &clip, results ) ) {
+			SV_FlushTraceGroup( &group );
+			SV_AddToTraceGroup( &group, &clip, results );
+		}
+	}
+
+	SV_FlushTraceGroup( &group );
+}
+
 
 /*
 =============
@@ -656,12 +1152,12 @@ int SV_PointContents( const vec3_t p, int passEntityNum ) {
 	int			touch[MAX_GENTITIES];
 	sharedEntity_t *hit;
 	int			i, num;
-	int			contents, c2;
+	int			world, contents, c2;
 	clipHandle_t	clipHandle;
 	const float		*angles;
 
 	// get base contents from world
-	contents = CM_PointContents( p, 0 );
+	world = contents = CM_PointContents( p, 0 );
 
 	// or in contents from all the other entities
 	num = SV_AreaEntities( p, p, touch, MAX_GENTITIES );
@@ -683,6 +1179,10 @@ int SV_PointContents( const vec3_t p, int passEntityNum ) {
 		contents |= c2;
 	}
 
+	if ( cm_capturing ) {
+		CM_CapturePointContents( p, passEntityNum, world, contents );
+	}
+
 	return contents;
 }
 
@@ -28,10 +28,18 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <dirent.h>
 #include <unistd.h>
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/time.h>
 #include <pwd.h>
 #include <dlfcn.h>
 #include <libgen.h>
+#include <pthread.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include "../qcommon/q_shared.h"
 #include "../qcommon/qcommon.h"
@@ -299,6 +307,49 @@ char **Sys_ListFiles(const char *directory, const char *extension, const char *f
 	return listCopy;
 }
 
+/*
+=================
+Sys_ListDirNames
+
+Names of all entries of a directory except "." and "..", in directory
+order and without a stat() per entry, so subdirectories are included.
+Returns NULL if the directory can't be read, stops at MAX_FOUND_FILES - 1
+=================
+*/
+char **Sys_ListDirNames(const char *directory, int *numNames)
+{
+	struct dirent *d;
+	DIR *fdir;
+	char *list[MAX_FOUND_FILES];
+	char **listCopy;
+	int i, n;
+
+	*numNames = 0;
+
+	if ((fdir = opendir(directory)) == NULL)
+		return NULL;
+
+	n = 0;
+	while (n < MAX_FOUND_FILES - 1 && (d = readdir(fdir)) != NULL)
+	{
+		if (Q_streq(d->d_name, ".") || Q_streq(d->d_name, ".."))
+			continue;
+		list[n++] = FS_CopyString(d->d_name);
+	}
+
+	closedir(fdir);
+
+	listCopy = Z_Malloc((n + 1) * sizeof(listCopy[0]));
+	for (i = 0; i < n; i++)
+	{
+		listCopy[i] = list[i];
+	}
+	listCopy[i] = NULL;
+
+	*numNames = n;
+	return listCopy;
+}
+
 /*
 =================
 Sys_FreeFileList
@@ -396,6 +447,180 @@ bool Sys_ResetReadOnlyAttribute(const char *ospath)
 	return false;
 }
 
+/*
+=================
+Sys_MapFile
+
+Maps the whole file read-only, returns NULL on failure and for empty files
+=================
+*/
+void *Sys_MapFile(const char *ospath, int *length)
+{
+	struct stat buf;
+	void *data;
+	int fd;
+
+	fd = open(ospath, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &buf) != 0 || !S_ISREG(buf.st_mode) || buf.st_size <= 0 || buf.st_size > INT_MAX)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // mapping keeps its own reference
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	*length = (int)buf.st_size;
+	return data;
+}
+
+/*
+=================
+Sys_UnmapFile
+=================
+*/
+void Sys_UnmapFile(void *data, int length)
+{
+	munmap(data, length);
+}
+
+// the guard is per thread, a fault in another thread must not jump here
+static THREADLOCAL sigjmp_buf mapGuardJump;
+static THREADLOCAL volatile sig_atomic_t mapGuardActive;
+static struct sigaction mapGuardPrevious;
+static pthread_once_t mapGuardOnce = PTHREAD_ONCE_INIT;
+static bool mapGuardInstalled;
+
+/*
+=================
+Sys_MapGuardHandler
+
+Leaves a guarded read from a mapping, any other SIGBUS goes to the
+handler that was installed before
+=================
+*/
+static void Sys_MapGuardHandler(int sig, siginfo_t *info, void *context)
+{
+	if (mapGuardActive)
+	{
+		mapGuardActive = 0;
+		siglongjmp(mapGuardJump, 1);
+	}
+
+	if (mapGuardPrevious.sa_flags & SA_SIGINFO)
+	{
+		mapGuardPrevious.sa_sigaction(sig, info, context);
+	}
+	else if (mapGuardPrevious.sa_handler != SIG_DFL && mapGuardPrevious.sa_handler != SIG_IGN)
+	{
+		mapGuardPrevious.sa_handler(sig);
+	}
+	else
+	{
+		// faulting access is repeated on return and gets the default action
+		signal(sig, SIG_DFL);
+	}
+}
+
+/*
+=================
+Sys_InstallMapGuard
+=================
+*/
+static void Sys_InstallMapGuard(void)
+{
+	struct sigaction action;
+
+	Com_Memset(&action, 0, sizeof(action));
+	action.sa_sigaction = Sys_MapGuardHandler;
+	action.sa_flags = SA_SIGINFO | SA_NODEFER; // not blocked after siglongjmp
+	sigemptyset(&action.sa_mask);
+	mapGuardInstalled = (sigaction(SIGBUS, &action, &mapGuardPrevious) == 0);
+}
+
+/*
+=================
+Sys_GuardMappedRead
+
+Passes data of a file mapping to func, returns false instead of raising
+SIGBUS when the file was truncated under the mapping. The handler is
+installed once and the jump buffer doesn't save the signal mask, so a
+read costs no system calls. func must not leave through Com_Error.
+=================
+*/
+bool Sys_GuardMappedRead(const void *src, int length, void (*func)(void *arg, const void *data, int length), void *arg)
+{
+	pthread_once(&mapGuardOnce, Sys_InstallMapGuard);
+	if (!mapGuardInstalled)
+	{
+		return false;
+	}
+
+	if (sigsetjmp(mapGuardJump, 0))
+	{
+		return false;
+	}
+
+	mapGuardActive = 1;
+	func(arg, src, length);
+	mapGuardActive = 0;
+
+	return true;
+}
+
+/*
+=================
+Sys_MapFileRange
+
+Maps length bytes at offset copy-on-write, so the returned pointer is
+writable but changes are never written back, returns NULL on failure
+=================
+*/
+void *Sys_MapFileRange(const char *ospath, int64_t offset, int length)
+{
+	struct stat buf;
+	off_t base;
+	byte *data;
+	int fd;
+
+	fd = open(ospath, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &buf) != 0 || !S_ISREG(buf.st_mode) || length <= 0 || offset < 0 || offset + length > buf.st_size)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	base = offset & ~(off_t)(sysconf(_SC_PAGESIZE) - 1);
+	data = mmap(NULL, offset - base + length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, base);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	return data + (offset - base);
+}
+
+/*
+=================
+Sys_UnmapFileRange
+=================
+*/
+void Sys_UnmapFileRange(void *data, int length)
+{
+	intptr_t skip = (intptr_t)data & (sysconf(_SC_PAGESIZE) - 1);
+
+	munmap((byte *)data - skip, skip + length);
+}
+
 /*
 =================
 Sys_Pwd
@@ -639,3 +864,324 @@ bool Sys_SetAffinityMask(const uint64_t mask)
 	return false;
 }
 #endif // USE_AFFINITY_MASK
+
+
+/*
+================
+Sys_CreateThread
+================
+*/
+typedef struct
+{
+	void (*func)(void *arg);
+	void *arg;
+} threadStart_t;
+
+static void *Sys_ThreadMain(void *p)
+{
+	threadStart_t start = *(threadStart_t *)p;
+
+	free(p);
+	start.func(start.arg);
+
+	return NULL;
+}
+
+void *Sys_CreateThread(void (*func)(void *arg), void *arg)
+{
+	pthread_t *thread;
+	threadStart_t *start;
+
+	thread = malloc(sizeof(*thread));
+	start = malloc(sizeof(*start));
+	if (!thread || !start)
+	{
+		free(thread);
+		free(start);
+		return NULL;
+	}
+
+	start->func = func;
+	start->arg = arg;
+
+	if (pthread_create(thread, NULL, Sys_ThreadMain, start) != 0)
+	{
+		free(thread);
+		free(start);
+		return NULL;
+	}
+
+	return thread;
+}
+
+/*
+================
+Sys_JoinThread
+================
+*/
+void Sys_JoinThread(void *thread)
+{
+	pthread_join(*(pthread_t *)thread, NULL);
+	free(thread);
+}
+
+/*
+================
+Sys_CreateMutex
+================
+*/
+void *Sys_CreateMutex(void)
+{
+	pthread_mutex_t *mutex;
+
+	mutex = malloc(sizeof(*mutex));
+	if (mutex)
+	{
+		pthread_mutex_init(mutex, NULL);
+	}
+
+	return mutex;
+}
+
+void Sys_DestroyMutex(void *mutex)
+{
+	pthread_mutex_destroy(mutex);
+	free(mutex);
+}
+
+void Sys_LockMutex(void *mutex)
+{
+	pthread_mutex_lock(mutex);
+}
+
+void Sys_UnlockMutex(void *mutex)
+{
+	pthread_mutex_unlock(mutex);
+}
+
+/*
+================
+Sys_CreateCond
+================
+*/
+void *Sys_CreateCond(void)
+{
+	pthread_cond_t *cond;
+
+	cond = malloc(sizeof(*cond));
+	if (cond)
+	{
+		pthread_cond_init(cond, NULL);
+	}
+
+	return cond;
+}
+
+void Sys_DestroyCond(void *cond)
+{
+	pthread_cond_destroy(cond);
+	free(cond);
+}
+
+void Sys_WaitCond(void *cond, void *mutex)
+{
+	pthread_cond_wait(cond, mutex);
+}
+
+void Sys_BroadcastCond(void *cond)
+{
+	pthread_cond_broadcast(cond);
+}
+
+/*
+================
+Sys_CPUCount
+================
+*/
+int Sys_CPUCount(void)
+{
+	long count;
+#ifdef __linux__
+	cpu_set_t cpu_set;
+
+	// respect process affinity, i.e. taskset or com_affinityMask
+	if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0)
+	{
+		count = CPU_COUNT(&cpu_set);
+		if (count > 0)
+		{
+			return count;
+		}
+	}
+#endif
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (count < 1)
+	{
+		return 1;
+	}
+
+	return (int)count;
+}
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_SAMPLE_TIMER
+#define USE_THREAD_SAMPLE_TIMER // counts CPU time of the main thread only
+#elif defined(__FreeBSD__) && (defined(__x86_64__) || defined(__i386__))
+#define USE_SAMPLE_TIMER
+#endif
+
+#ifdef USE_THREAD_SAMPLE_TIMER
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+#endif
+
+#ifdef USE_SAMPLE_TIMER
+static volatile sampleHandler_t sampleHandler;
+static pthread_t sampleThread;
+#ifdef USE_THREAD_SAMPLE_TIMER
+static timer_t sampleTimer;
+#endif
+
+static void Sys_SampleSignal(int sig, siginfo_t *info, void *context)
+{
+	const ucontext_t *uc = (const ucontext_t *)context;
+	const sampleHandler_t handler = sampleHandler;
+	const void *pc, *sp;
+	int savedErrno;
+
+	// process timer signal may be delivered to any thread,
+	// the thread timer signals the sampled thread only
+	if (!handler || !pthread_equal(pthread_self(), sampleThread))
+	{
+		return;
+	}
+
+#if defined(__linux__) && defined(__x86_64__)
+	pc = (const void *)uc->uc_mcontext.gregs[REG_RIP];
+	sp = (const void *)uc->uc_mcontext.gregs[REG_RSP];
+#elif defined(__linux__)
+	pc = (const void *)uc->uc_mcontext.gregs[REG_EIP];
+	sp = (const void *)uc->uc_mcontext.gregs[REG_ESP];
+#elif defined(__x86_64__)
+	pc = (const void *)uc->uc_mcontext.mc_rip;
+	sp = (const void *)uc->uc_mcontext.mc_rsp;
+#else
+	pc = (const void *)uc->uc_mcontext.mc_eip;
+	sp = (const void *)uc->uc_mcontext.mc_esp;
+#endif
+
+	savedErrno = errno;
+	handler(pc, sp);
+	errno = savedErrno;
+}
+#endif
+
+/*
+================
+Sys_StartSampling
+
+Calls handler hz times per second of CPU time consumed by the calling
+thread. Where there is no thread CPU timer it is CPU time of the whole
+process, and samples that land on other threads are dropped.
+================
+*/
+bool Sys_StartSampling(int hz, sampleHandler_t handler)
+{
+#ifdef USE_SAMPLE_TIMER
+	struct sigaction sa;
+#ifdef USE_THREAD_SAMPLE_TIMER
+	struct sigevent event;
+	struct itimerspec timer;
+#else
+	struct itimerval timer;
+#endif
+
+	Sys_StopSampling();
+
+	if (hz < 1 || hz > 1000000)
+	{
+		return false;
+	}
+
+	sampleThread = pthread_self();
+	sampleHandler = handler;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = Sys_SampleSignal;
+	sa.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGPROF, &sa, NULL) != 0)
+	{
+		sampleHandler = NULL;
+		return false;
+	}
+
+#ifdef USE_THREAD_SAMPLE_TIMER
+	memset(&event, 0, sizeof(event));
+	event.sigev_notify = SIGEV_THREAD_ID;
+	event.sigev_signo = SIGPROF;
+	event.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+	if (timer_create(CLOCK_THREAD_CPUTIME_ID, &event, &sampleTimer) != 0)
+	{
+		signal(SIGPROF, SIG_IGN);
+		sampleHandler = NULL;
+		return false;
+	}
+
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_nsec = 1000000000 / hz;
+	timer.it_value = timer.it_interval;
+	if (timer_settime(sampleTimer, 0, &timer, NULL) != 0)
+	{
+		timer_delete(sampleTimer);
+		signal(SIGPROF, SIG_IGN);
+		sampleHandler = NULL;
+		return false;
+	}
+#else
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 1000000 / hz;
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_PROF, &timer, NULL) != 0)
+	{
+		signal(SIGPROF, SIG_IGN);
+		sampleHandler = NULL;
+		return false;
+	}
+#endif
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+================
+Sys_StopSampling
+================
+*/
+void Sys_StopSampling(void)
+{
+#ifdef USE_SAMPLE_TIMER
+#ifndef USE_THREAD_SAMPLE_TIMER
+	struct itimerval timer;
+#endif
+
+	if (!sampleHandler)
+	{
+		return;
+	}
+
+#ifdef USE_THREAD_SAMPLE_TIMER
+	timer_delete(sampleTimer);
+#else
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+#endif
+	signal(SIGPROF, SIG_IGN);
+
+	sampleHandler = NULL;
+#endif
+}
@@ -231,6 +231,142 @@ bool Sys_ResetReadOnlyAttribute(const char* ospath) {
 }
 
 
+/*
+==============
+Sys_MapFile
+
+Maps the whole file read-only, returns NULL on failure and for empty files
+==============
+*/
+void* Sys_MapFile(const char* ospath, int* length)
+{
+	HANDLE file, mapping;
+	DWORD size, sizeHigh;
+	void* data;
+
+	file = CreateFileA(ospath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+
+	size = GetFileSize(file, &sizeHigh);
+	if (size == INVALID_FILE_SIZE || sizeHigh != 0 || size == 0 || size > INT_MAX) {
+		CloseHandle(file);
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping) {
+		return NULL;
+	}
+
+	// view keeps its own reference to the mapping
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!data) {
+		return NULL;
+	}
+
+	*length = (int)size;
+	return data;
+}
+
+
+/*
+==============
+Sys_UnmapFile
+==============
+*/
+void Sys_UnmapFile(void* data, int length) {
+	UnmapViewOfFile(data);
+}
+
+
+/*
+==============
+Sys_GuardMappedRead
+
+Windows refuses to truncate a file while a view of it is mapped,
+so reading the view can't fault
+==============
+*/
+bool Sys_GuardMappedRead(const void* src, int length, void (*func)(void* arg, const void* data, int length), void* arg) {
+	func(arg, src, length);
+	return true;
+}
+
+
+/*
+==============
+Sys_AllocationGranularity
+==============
+*/
+static DWORD Sys_AllocationGranularity( void ) {
+	static DWORD granularity;
+	SYSTEM_INFO info;
+
+	if ( !granularity ) {
+		GetSystemInfo( &info );
+		granularity = info.dwAllocationGranularity;
+	}
+
+	return granularity;
+}
+
+
+/*
+==============
+Sys_MapFileRange
+
+Maps length bytes at offset copy-on-write, so the returned pointer is
+writable but changes are never written back, returns NULL on failure
+==============
+*/
+void* Sys_MapFileRange(const char* ospath, int64_t offset, int length)
+{
+	HANDLE file, mapping;
+	LARGE_INTEGER size;
+	int64_t base;
+	byte* data;
+
+	file = CreateFileA(ospath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return NULL;
+	}
+
+	if (!GetFileSizeEx(file, &size) || length <= 0 || offset < 0 || offset + length > size.QuadPart) {
+		CloseHandle(file);
+		return NULL;
+	}
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!mapping) {
+		return NULL;
+	}
+
+	base = offset - offset % Sys_AllocationGranularity();
+	data = MapViewOfFile(mapping, FILE_MAP_COPY, (DWORD)(base >> 32), (DWORD)base, (SIZE_T)(offset - base + length));
+	CloseHandle(mapping);
+	if (!data) {
+		return NULL;
+	}
+
+	return data + (offset - base);
+}
+
+
+/*
+==============
+Sys_UnmapFileRange
+==============
+*/
+void Sys_UnmapFileRange(void* data, int length) {
+	UnmapViewOfFile((byte*)data - (intptr_t)data % Sys_AllocationGranularity());
+}
+
+
 /*
 ==============
 Sys_Pwd
@@ -422,6 +558,53 @@ char** Sys_ListFiles(const char* directory, const char* extension, const char* f
 }
 
 
+/*
+=============
+Sys_ListDirNames
+
+Names of all entries of a directory except "." and "..", subdirectories
+are included. Returns NULL if the directory can't be read, stops at
+MAX_FOUND_FILES - 1
+=============
+*/
+char** Sys_ListDirNames(const char* directory, int* numNames)
+{
+	char search[MAX_OSPATH * 2 + 3];
+	struct _finddata_t findinfo;
+	intptr_t findhandle;
+	char* list[MAX_FOUND_FILES];
+	char** listCopy;
+	int i, n;
+
+	*numNames = 0;
+
+	Com_sprintf(search, sizeof(search), "%s\\*", directory);
+	findhandle = _findfirst(search, &findinfo);
+	if (findhandle == -1) {
+		return NULL;
+	}
+
+	n = 0;
+	do {
+		if (Q_streq(findinfo.name, ".") || Q_streq(findinfo.name, "..")) {
+			continue;
+		}
+		list[n++] = FS_CopyString(findinfo.name);
+	} while (n < MAX_FOUND_FILES - 1 && _findnext(findhandle, &findinfo) == 0);
+
+	_findclose(findhandle);
+
+	listCopy = Z_Malloc((n + 1) * sizeof(listCopy[0]));
+	for (i = 0; i < n; i++) {
+		listCopy[i] = list[i];
+	}
+	listCopy[i] = NULL;
+
+	*numNames = n;
+	return listCopy;
+}
+
+
 /*
 =============
 Sys_FreeFileList
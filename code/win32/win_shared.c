@@ -30,6 +30,7 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #include <io.h>
 #include <conio.h>
 #include <intrin.h>
+#include <process.h>
 
 /*
 ================
@@ -246,3 +247,264 @@ bool Sys_SetAffinityMask( const uint64_t mask )
 	return false;
 }
 #endif // USE_AFFINITY_MASK
+
+/*
+================
+Sys_CreateThread
+================
+*/
+typedef struct {
+	void (*func)( void *arg );
+	void *arg;
+} threadStart_t;
+
+static unsigned __stdcall Sys_ThreadMain( void *p )
+{
+	threadStart_t start = *(threadStart_t *)p;
+
+	free( p );
+	start.func( start.arg );
+
+	return 0;
+}
+
+void *Sys_CreateThread( void (*func)( void *arg ), void *arg )
+{
+	threadStart_t *start;
+	uintptr_t handle;
+
+	start = malloc( sizeof( *start ) );
+	if ( !start ) {
+		return NULL;
+	}
+
+	start->func = func;
+	start->arg = arg;
+
+	handle = _beginthreadex( NULL, 0, Sys_ThreadMain, start, 0, NULL );
+	if ( handle == 0 ) {
+		free( start );
+		return NULL;
+	}
+
+	return (void *)handle;
+}
+
+
+/*
+================
+Sys_JoinThread
+================
+*/
+void Sys_JoinThread( void *thread )
+{
+	WaitForSingleObject( (HANDLE)thread, INFINITE );
+	CloseHandle( (HANDLE)thread );
+}
+
+
+/*
+================
+Sys_CreateMutex
+================
+*/
+void *Sys_CreateMutex( void )
+{
+	CRITICAL_SECTION *cs;
+
+	cs = malloc( sizeof( *cs ) );
+	if ( cs ) {
+		InitializeCriticalSection( cs );
+	}
+
+	return cs;
+}
+
+
+void Sys_DestroyMutex( void *mutex )
+{
+	DeleteCriticalSection( (CRITICAL_SECTION *)mutex );
+	free( mutex );
+}
+
+
+void Sys_LockMutex( void *mutex )
+{
+	EnterCriticalSection( (CRITICAL_SECTION *)mutex );
+}
+
+
+void Sys_UnlockMutex( void *mutex )
+{
+	LeaveCriticalSection( (CRITICAL_SECTION *)mutex );
+}
+
+
+/*
+================
+Sys_CreateCond
+================
+*/
+void *Sys_CreateCond( void )
+{
+	CONDITION_VARIABLE *cv;
+
+	cv = malloc( sizeof( *cv ) );
+	if ( cv ) {
+		InitializeConditionVariable( cv );
+	}
+
+	return cv;
+}
+
+
+void Sys_DestroyCond( void *cond )
+{
+	free( cond );
+}
+
+
+void Sys_WaitCond( void *cond, void *mutex )
+{
+	SleepConditionVariableCS( (CONDITION_VARIABLE *)cond, (CRITICAL_SECTION *)mutex, INFINITE );
+}
+
+
+void Sys_BroadcastCond( void *cond )
+{
+	WakeAllConditionVariable( (CONDITION_VARIABLE *)cond );
+}
+
+
+/*
+================
+Sys_CPUCount
+================
+*/
+int Sys_CPUCount( void )
+{
+	SYSTEM_INFO info;
+#ifdef USE_AFFINITY_MASK
+	uint64_t mask;
+	int count;
+
+	// respect process affinity, i.e. com_affinityMask
+	mask = Sys_GetAffinityMask();
+	for ( count = 0; mask; mask &= mask - 1 ) {
+		count++;
+	}
+	if ( count > 0 ) {
+		return count;
+	}
+#endif
+
+	GetSystemInfo( &info );
+	if ( info.dwNumberOfProcessors < 1 ) {
+		return 1;
+	}
+
+	return (int)info.dwNumberOfProcessors;
+}
+
+
+#if idx64 || id386
+static struct {
+	HANDLE			thread;
+	HANDLE			target;		// main thread
+	volatile LONG	running;
+	DWORD			interval;
+	sampleHandler_t	handler;
+} sampler;
+
+static unsigned __stdcall Sys_SampleThread( void *arg )
+{
+	CONTEXT ctx;
+
+	while ( sampler.running ) {
+		Sleep( sampler.interval );
+
+		if ( SuspendThread( sampler.target ) == (DWORD)-1 ) {
+			break;
+		}
+
+		ctx.ContextFlags = CONTEXT_CONTROL;
+		if ( GetThreadContext( sampler.target, &ctx ) ) {
+#if idx64
+			sampler.handler( (const void *)ctx.Rip, (const void *)ctx.Rsp );
+#else
+			sampler.handler( (const void *)ctx.Eip, (const void *)ctx.Esp );
+#endif
+		}
+
+		ResumeThread( sampler.target );
+	}
+
+	return 0;
+}
+#endif
+
+
+/*
+================
+Sys_StartSampling
+
+Windows has no profiling timer so the main thread is suspended and sampled
+from another thread, resolution is limited by the system timer
+================
+*/
+bool Sys_StartSampling( int hz, sampleHandler_t handler )
+{
+#if idx64 || id386
+	Sys_StopSampling();
+
+	if ( hz < 1 ) {
+		return false;
+	}
+
+	if ( !DuplicateHandle( GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &sampler.target,
+		THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT, FALSE, 0 ) ) {
+		return false;
+	}
+
+	sampler.interval = hz >= 1000 ? 1 : 1000 / hz;
+	sampler.handler = handler;
+	sampler.running = 1;
+
+	sampler.thread = (HANDLE)_beginthreadex( NULL, 0, Sys_SampleThread, NULL, 0, NULL );
+	if ( !sampler.thread ) {
+		CloseHandle( sampler.target );
+		sampler.target = NULL;
+		sampler.running = 0;
+		return false;
+	}
+
+	SetThreadPriority( sampler.thread, THREAD_PRIORITY_TIME_CRITICAL );
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/*
+================
+Sys_StopSampling
+================
+*/
+void Sys_StopSampling( void )
+{
+#if idx64 || id386
+	if ( !sampler.thread ) {
+		return;
+	}
+
+	sampler.running = 0;
+	WaitForSingleObject( sampler.thread, INFINITE );
+	CloseHandle( sampler.thread );
+	CloseHandle( sampler.target );
+
+	sampler.thread = NULL;
+	sampler.target = NULL;
+#endif
+}